@@ -10,21 +10,37 @@ Config::Config() {
   // 线程池内的线程数量,默认 64
   thread_num = 64;
 
+  // 一个请求内复用同一条数据库连接
+  db_affinity = "request";
+
+  // 非阻塞 MySQL 连接数
+  async_db_conns = 32;
+
   // Redis 默认配置
   redis_host = "127.0.0.1";
   redis_port = 6379;
   redis_password = "";
   redis_pool_size = 16;
   redis_db_index = 0;
+  redis_nodes = "";
+  redis_mode = "shard";
   cache_ttl = 3600;
 
   // 认证默认开启
   auth_enabled = true;
+
+  // 审计日志异步批量写入
+  audit_mode = "async";
+  audit_spill = "audit.spill";
+
+  // 布隆过滤器快照
+  bloom_snapshot = "bloom.snapshot";
+  key_filter = "bloom";
 }
 
 void Config::parse_arg(int argc, char *argv[]) {
   int opt;
-  const char *str = "p:s:t:r:a:";
+  const char *str = "p:s:t:r:a:c:k:b:f:n:m:d:q:u:l:";
   while ((opt = getopt(argc, argv, str)) != -1) {
     switch (opt) {
     case 'p': {
@@ -47,6 +63,46 @@ void Config::parse_arg(int argc, char *argv[]) {
       auth_enabled = atoi(optarg) != 0;
       break;
     }
+    case 'c': {
+      tls_cert = optarg;
+      break;
+    }
+    case 'k': {
+      tls_key = optarg;
+      break;
+    }
+    case 'b': {
+      bloom_snapshot = optarg;
+      break;
+    }
+    case 'f': {
+      key_filter = optarg;
+      break;
+    }
+    case 'n': {
+      redis_nodes = optarg;
+      break;
+    }
+    case 'm': {
+      redis_mode = optarg;
+      break;
+    }
+    case 'd': {
+      db_affinity = optarg;
+      break;
+    }
+    case 'q': {
+      async_db_conns = atoi(optarg);
+      break;
+    }
+    case 'u': {
+      audit_mode = optarg;
+      break;
+    }
+    case 'l': {
+      audit_spill = optarg;
+      break;
+    }
     default:
       break;
     }
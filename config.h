@@ -18,6 +18,12 @@ public:
   // 数据库连接池数量
   int sql_num;
 
+  // 数据库连接与 worker 的绑定: query / request / thread
+  std::string db_affinity;
+
+  // 非阻塞 MySQL 连接数（成绩缓存重建在事件循环上查库），0 = 关闭
+  int async_db_conns;
+
   // 线程池内的线程数量
   int thread_num;
 
@@ -27,10 +33,24 @@ public:
   std::string redis_password;
   int redis_pool_size;   // Redis 连接池大小
   int redis_db_index;    // Redis 数据库编号 (0-15)
+  std::string redis_nodes; // 多实例分片 "host:port,host:port"，空 = 单实例
+  std::string redis_mode;  // shard = 客户端分片, cluster = Redis Cluster（nodes 为种子）
   int cache_ttl;         // 缓存基础 TTL（秒）
 
   // ── 认证开关 ────────────────────────────────
   bool auth_enabled;     // true=完整认证+CRUD, false=仅旧版 SELECT
+
+  // ── TLS ─────────────────────────────────────
+  std::string tls_cert;  // PEM 证书链，与 tls_key 同时指定时启用 HTTPS
+  std::string tls_key;   // PEM 私钥
+
+  // ── 审计日志 ────────────────────────────────
+  std::string audit_mode;   // async（批量写）| durable（等待落盘）| sync（逐条同步写）
+  std::string audit_spill;  // MySQL 不可用时的本地溢出文件
+
+  // ── 布隆过滤器 ──────────────────────────────
+  std::string bloom_snapshot;  // 快照文件路径（重启后直接加载，免全表扫描）
+  std::string key_filter;      // bloom（省内存）| cuckoo（支持删除）
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,503 @@
+#include "h2_session.h"
+#include "response_header.h"
+
+#include <algorithm>
+#include <cstring>
+
+// base64url 解码（HTTP2-Settings 头，无填充），非法字符返回 false
+static bool base64url_decode(std::string_view in, std::string &out) {
+  auto val = [](char c) -> int {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-' || c == '+') return 62;
+    if (c == '_' || c == '/') return 63;
+    return -1;
+  };
+  uint32_t acc = 0;
+  int bits = 0;
+  for (char c : in) {
+    if (c == '=')
+      break;
+    int v = val(c);
+    if (v < 0)
+      return false;
+    acc = (acc << 6) | v;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out.push_back(static_cast<char>((acc >> bits) & 0xff));
+    }
+  }
+  return true;
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+         (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static void put_u32(std::string &out, uint32_t v) {
+  out.push_back(static_cast<char>(v >> 24));
+  out.push_back(static_cast<char>(v >> 16));
+  out.push_back(static_cast<char>(v >> 8));
+  out.push_back(static_cast<char>(v));
+}
+
+// ── 连接建立 ────────────────────────────────────────────────────────────
+
+void H2Session::start(bool upgraded) {
+  send_settings();
+  if (upgraded) {
+    // 101 之后原 HTTP/1.1 请求即 stream 1，客户端侧已半关闭
+    Stream &s = streams_[1];
+    s.req.stream_id = 1;
+    s.headers_done = true;
+    s.remote_closed = true;
+    s.dispatched = true;
+    s.send_window = peer_initial_window_;
+    last_stream_id_ = 1;
+  }
+}
+
+bool H2Session::apply_upgrade_settings(std::string_view b64) {
+  std::string payload;
+  if (!base64url_decode(b64, payload))
+    return false;
+  // 101 响应即隐式确认，不回 SETTINGS ACK
+  return parse_settings(reinterpret_cast<const uint8_t *>(payload.data()),
+                        payload.size());
+}
+
+// ── 输入: 前言 + 帧循环 ─────────────────────────────────────────────────
+
+bool H2Session::feed(const char *data, size_t len) {
+  if (goaway_sent_)
+    return false;
+  in_.append(data, len);
+
+  size_t pos = 0;
+  if (!preface_received_) {
+    size_t n = std::min(in_.size(), PREFACE_LEN);
+    if (memcmp(in_.data(), PREFACE, n) != 0)
+      return connection_error(PROTOCOL_ERROR);
+    if (in_.size() < PREFACE_LEN)
+      return true;
+    pos = PREFACE_LEN;
+    preface_received_ = true;
+  }
+
+  bool ok = true;
+  while (in_.size() - pos >= 9) {
+    const uint8_t *h = reinterpret_cast<const uint8_t *>(in_.data()) + pos;
+    uint32_t flen = (uint32_t(h[0]) << 16) | (uint32_t(h[1]) << 8) | h[2];
+    uint8_t type = h[3];
+    uint8_t flags = h[4];
+    uint32_t sid = read_u32(h + 5) & 0x7fffffff;
+    if (flen > LOCAL_MAX_FRAME) {
+      ok = connection_error(FRAME_SIZE_ERROR);
+      break;
+    }
+    if (in_.size() - pos - 9 < flen)
+      break; // 帧不完整，等待更多数据
+    if (!handle_frame(type, flags, sid, h + 9, flen)) {
+      ok = false;
+      break;
+    }
+    pos += 9 + flen;
+  }
+  in_.erase(0, pos);
+  return ok;
+}
+
+bool H2Session::next_request(Request &req) {
+  if (ready_.empty())
+    return false;
+  req = std::move(ready_.front());
+  ready_.pop_front();
+  return true;
+}
+
+bool H2Session::handle_frame(uint8_t type, uint8_t flags, uint32_t sid,
+                             const uint8_t *p, uint32_t len) {
+  // 头部块未结束时只允许同一流的 CONTINUATION
+  if (continuation_sid_ != 0 &&
+      (type != CONTINUATION || sid != continuation_sid_))
+    return connection_error(PROTOCOL_ERROR);
+
+  switch (type) {
+  case DATA:
+    return on_data(flags, sid, p, len);
+  case HEADERS:
+    return on_headers(flags, sid, p, len);
+  case CONTINUATION:
+    if (continuation_sid_ == 0)
+      return connection_error(PROTOCOL_ERROR);
+    return on_continuation(flags, sid, p, len);
+  case PRIORITY:
+    if (sid == 0)
+      return connection_error(PROTOCOL_ERROR);
+    if (len != 5)
+      send_rst(sid, FRAME_SIZE_ERROR);
+    return true; // 不做优先级调度
+  case RST_STREAM:
+    if (sid == 0)
+      return connection_error(PROTOCOL_ERROR);
+    if (len != 4)
+      return connection_error(FRAME_SIZE_ERROR);
+    streams_.erase(sid);
+    return true;
+  case SETTINGS:
+    if (sid != 0)
+      return connection_error(PROTOCOL_ERROR);
+    return on_settings(flags, p, len);
+  case PUSH_PROMISE: // 客户端不允许推送
+    return connection_error(PROTOCOL_ERROR);
+  case PING:
+    if (sid != 0)
+      return connection_error(PROTOCOL_ERROR);
+    if (len != 8)
+      return connection_error(FRAME_SIZE_ERROR);
+    if (!(flags & ACK)) {
+      write_frame_header(8, PING, ACK, 0);
+      out_.append(reinterpret_cast<const char *>(p), 8);
+    }
+    return true;
+  case GOAWAY: // 对端不再新建流，已有流照常完成
+    return sid == 0 ? true : connection_error(PROTOCOL_ERROR);
+  case WINDOW_UPDATE:
+    return on_window_update(sid, p, len);
+  default: // 未知帧类型必须忽略
+    return true;
+  }
+}
+
+// ── HEADERS / CONTINUATION ─────────────────────────────────────────────
+
+bool H2Session::on_headers(uint8_t flags, uint32_t sid, const uint8_t *p,
+                           uint32_t len) {
+  if (sid == 0 || (sid & 1) == 0)
+    return connection_error(PROTOCOL_ERROR);
+
+  if (flags & PADDED) {
+    if (len < 1 || p[0] >= len)
+      return connection_error(PROTOCOL_ERROR);
+    len -= 1 + p[0];
+    p += 1;
+  }
+  if (flags & PRIORITY_FLAG) {
+    if (len < 5)
+      return connection_error(FRAME_SIZE_ERROR);
+    p += 5;
+    len -= 5;
+  }
+
+  auto it = streams_.find(sid);
+  if (it == streams_.end()) {
+    if (sid <= last_stream_id_) // 已关闭的流
+      return connection_error(STREAM_CLOSED);
+    last_stream_id_ = sid;
+    it = streams_.emplace(sid, Stream{}).first;
+    it->second.req.stream_id = sid;
+    it->second.send_window = peer_initial_window_;
+    // 超出并发上限: 头部块仍须解码以保持 HPACK 状态同步，完成后拒绝
+    it->second.refused = streams_.size() > MAX_CONCURRENT_STREAMS;
+  } else if (!it->second.headers_done || it->second.remote_closed) {
+    return connection_error(PROTOCOL_ERROR);
+  } else if (!(flags & END_STREAM)) { // trailers 必须结束流
+    return connection_error(PROTOCOL_ERROR);
+  }
+
+  Stream &s = it->second;
+  s.header_block.assign(reinterpret_cast<const char *>(p), len);
+  if (flags & END_STREAM)
+    s.end_stream_pending = true;
+
+  if (flags & END_HEADERS)
+    return finish_headers(sid);
+  continuation_sid_ = sid;
+  return true;
+}
+
+bool H2Session::on_continuation(uint8_t flags, uint32_t sid, const uint8_t *p,
+                                uint32_t len) {
+  Stream &s = streams_[sid];
+  s.header_block.append(reinterpret_cast<const char *>(p), len);
+  if (s.header_block.size() > MAX_HEADER_BLOCK)
+    return connection_error(ENHANCE_YOUR_CALM);
+  if (!(flags & END_HEADERS))
+    return true;
+  continuation_sid_ = 0;
+  return finish_headers(sid);
+}
+
+bool H2Session::finish_headers(uint32_t sid) {
+  Stream &s = streams_[sid];
+  std::vector<HpackHeader> headers;
+  bool ok = decoder_.decode(
+      reinterpret_cast<const uint8_t *>(s.header_block.data()),
+      s.header_block.size(), headers);
+  s.header_block.clear();
+  if (!ok)
+    return connection_error(COMPRESSION_ERROR);
+
+  if (s.refused) {
+    send_rst(sid, REFUSED_STREAM);
+    streams_.erase(sid);
+    return true;
+  }
+
+  if (!s.headers_done) {
+    for (const HpackHeader &h : headers) {
+      if (h.name == ":method")
+        s.req.method = h.value;
+      else if (h.name == ":path")
+        s.req.path = h.value;
+      else if (h.name == "authorization")
+        s.req.authorization = h.value;
+    }
+    if (s.req.method.empty() || s.req.path.empty()) {
+      send_rst(sid, PROTOCOL_ERROR);
+      streams_.erase(sid);
+      return true;
+    }
+    s.headers_done = true;
+  }
+
+  if (s.end_stream_pending) {
+    s.remote_closed = true;
+    finish_stream(sid);
+  }
+  return true;
+}
+
+void H2Session::finish_stream(uint32_t sid) {
+  Stream &s = streams_[sid];
+  if (s.dispatched)
+    return;
+  s.dispatched = true;
+  ready_.push_back(std::move(s.req));
+}
+
+// ── DATA ───────────────────────────────────────────────────────────────
+
+bool H2Session::on_data(uint8_t flags, uint32_t sid, const uint8_t *p,
+                        uint32_t len) {
+  if (sid == 0)
+    return connection_error(PROTOCOL_ERROR);
+
+  // 流量控制按整帧长度（含填充）计算，收到即归还窗口
+  uint32_t frame_len = len;
+  if (flags & PADDED) {
+    if (len < 1 || p[0] >= len)
+      return connection_error(PROTOCOL_ERROR);
+    len -= 1 + p[0];
+    p += 1;
+  }
+  if (frame_len > 0)
+    send_window_update(0, frame_len);
+
+  auto it = streams_.find(sid);
+  if (it == streams_.end() || it->second.remote_closed) {
+    if (sid > last_stream_id_)
+      return connection_error(PROTOCOL_ERROR); // idle 流
+    send_rst(sid, STREAM_CLOSED);
+    return true;
+  }
+  Stream &s = it->second;
+  if (!s.headers_done)
+    return connection_error(PROTOCOL_ERROR);
+
+  if (s.req.body.size() + len > MAX_REQUEST_BODY) {
+    send_rst(sid, CANCEL);
+    streams_.erase(it);
+    return true;
+  }
+  s.req.body.append(reinterpret_cast<const char *>(p), len);
+
+  if (flags & END_STREAM) {
+    s.remote_closed = true;
+    finish_stream(sid);
+  } else if (frame_len > 0) {
+    send_window_update(sid, frame_len);
+  }
+  return true;
+}
+
+// ── SETTINGS / WINDOW_UPDATE ───────────────────────────────────────────
+
+bool H2Session::on_settings(uint8_t flags, const uint8_t *p, uint32_t len) {
+  if (flags & ACK)
+    return len == 0 ? true : connection_error(FRAME_SIZE_ERROR);
+  if (len % 6 != 0)
+    return connection_error(FRAME_SIZE_ERROR);
+  if (!parse_settings(p, len))
+    return false;
+  write_frame_header(0, SETTINGS, ACK, 0);
+  flush_pending(); // 初始窗口可能变大
+  return true;
+}
+
+bool H2Session::parse_settings(const uint8_t *p, size_t len) {
+  if (len % 6 != 0)
+    return connection_error(FRAME_SIZE_ERROR);
+  for (size_t i = 0; i + 6 <= len; i += 6) {
+    uint16_t id = (uint16_t(p[i]) << 8) | p[i + 1];
+    uint32_t value = read_u32(p + i + 2);
+    switch (id) {
+    case 0x2: // ENABLE_PUSH
+      if (value > 1)
+        return connection_error(PROTOCOL_ERROR);
+      break;
+    case 0x4: { // INITIAL_WINDOW_SIZE，增量作用于所有已有流
+      if (value > MAX_WINDOW)
+        return connection_error(FLOW_CONTROL_ERROR);
+      int64_t delta = int64_t(value) - peer_initial_window_;
+      for (auto &kv : streams_)
+        kv.second.send_window += delta;
+      peer_initial_window_ = value;
+      break;
+    }
+    case 0x5: // MAX_FRAME_SIZE
+      if (value < 16384 || value > 16777215)
+        return connection_error(PROTOCOL_ERROR);
+      peer_max_frame_ = value;
+      break;
+    default: // HEADER_TABLE_SIZE 等: 编码端不使用动态表，忽略
+      break;
+    }
+  }
+  return true;
+}
+
+bool H2Session::on_window_update(uint32_t sid, const uint8_t *p,
+                                 uint32_t len) {
+  if (len != 4)
+    return connection_error(FRAME_SIZE_ERROR);
+  uint32_t inc = read_u32(p) & 0x7fffffff;
+  if (sid == 0) {
+    if (inc == 0)
+      return connection_error(PROTOCOL_ERROR);
+    conn_send_window_ += inc;
+    if (conn_send_window_ > MAX_WINDOW)
+      return connection_error(FLOW_CONTROL_ERROR);
+  } else {
+    auto it = streams_.find(sid);
+    if (it == streams_.end())
+      return true; // 已关闭的流，忽略
+    if (inc == 0) {
+      send_rst(sid, PROTOCOL_ERROR);
+      streams_.erase(it);
+      return true;
+    }
+    it->second.send_window += inc;
+    if (it->second.send_window > MAX_WINDOW) {
+      send_rst(sid, FLOW_CONTROL_ERROR);
+      streams_.erase(it);
+      return true;
+    }
+  }
+  flush_pending();
+  return true;
+}
+
+// ── 输出 ───────────────────────────────────────────────────────────────
+
+void H2Session::submit_response(uint32_t sid, int status,
+                                std::string_view content_type,
+                                std::string body) {
+  auto it = streams_.find(sid);
+  if (it == streams_.end())
+    return; // 客户端已 RST
+
+  char num[24];
+  size_t num_len = ResponseHeader::u64_to_ascii(num, body.size());
+  char date[ResponseHeader::DATE_LEN];
+  ResponseHeader::load_date(date);
+
+  std::string block;
+  HpackEncoder::status(block, status);
+  HpackEncoder::literal(block, HpackEncoder::IDX_CONTENT_TYPE, content_type);
+  HpackEncoder::literal(block, HpackEncoder::IDX_CONTENT_LENGTH,
+                        std::string_view(num, num_len));
+  HpackEncoder::literal(block, HpackEncoder::IDX_DATE,
+                        std::string_view(date, sizeof(date)));
+
+  uint8_t flags = END_HEADERS | (body.empty() ? END_STREAM : 0);
+  write_frame_header(block.size(), HEADERS, flags, sid);
+  out_.append(block);
+
+  if (body.empty()) {
+    streams_.erase(it);
+    return;
+  }
+  it->second.pending = std::move(body);
+  it->second.pending_off = 0;
+  it->second.responding = true;
+  if (flush_stream(it->second))
+    streams_.erase(it);
+}
+
+// 按连接级 / 流级窗口与对端最大帧长分帧发送，全部发完返回 true
+bool H2Session::flush_stream(Stream &s) {
+  while (s.pending_off < s.pending.size()) {
+    int64_t allow = std::min(conn_send_window_, s.send_window);
+    if (allow <= 0)
+      return false;
+    size_t chunk = std::min<size_t>(s.pending.size() - s.pending_off,
+                                    std::min<int64_t>(allow, peer_max_frame_));
+    bool last = s.pending_off + chunk == s.pending.size();
+    write_frame_header(chunk, DATA, last ? END_STREAM : 0, s.req.stream_id);
+    out_.append(s.pending, s.pending_off, chunk);
+    s.pending_off += chunk;
+    conn_send_window_ -= chunk;
+    s.send_window -= chunk;
+  }
+  return true;
+}
+
+void H2Session::flush_pending() {
+  for (auto it = streams_.begin(); it != streams_.end();) {
+    if (it->second.responding && flush_stream(it->second))
+      it = streams_.erase(it);
+    else
+      ++it;
+  }
+}
+
+void H2Session::write_frame_header(uint32_t len, uint8_t type, uint8_t flags,
+                                   uint32_t sid) {
+  out_.push_back(static_cast<char>(len >> 16));
+  out_.push_back(static_cast<char>(len >> 8));
+  out_.push_back(static_cast<char>(len));
+  out_.push_back(static_cast<char>(type));
+  out_.push_back(static_cast<char>(flags));
+  put_u32(out_, sid & 0x7fffffff);
+}
+
+void H2Session::send_settings() {
+  write_frame_header(6, SETTINGS, 0, 0);
+  out_.push_back(0x00);
+  out_.push_back(0x03); // MAX_CONCURRENT_STREAMS
+  put_u32(out_, MAX_CONCURRENT_STREAMS);
+}
+
+void H2Session::send_window_update(uint32_t sid, uint32_t inc) {
+  write_frame_header(4, WINDOW_UPDATE, 0, sid);
+  put_u32(out_, inc & 0x7fffffff);
+}
+
+void H2Session::send_rst(uint32_t sid, uint32_t code) {
+  write_frame_header(4, RST_STREAM, 0, sid);
+  put_u32(out_, code);
+}
+
+bool H2Session::connection_error(uint32_t code) {
+  if (!goaway_sent_) {
+    write_frame_header(8, GOAWAY, 0, 0);
+    put_u32(out_, last_stream_id_);
+    put_u32(out_, code);
+    goaway_sent_ = true;
+  }
+  return false;
+}
@@ -0,0 +1,158 @@
+#ifndef HTTP_H2_SESSION_H
+#define HTTP_H2_SESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "hpack.h"
+
+// HTTP/2 明文（h2c）连接会话 —— 帧解析、HPACK、流状态与流量控制
+//
+// 两种进入方式（RFC 7540 §3.2 / §3.4）:
+//   1. prior knowledge: 客户端首包即连接前言 "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+//   2. Upgrade: h2c:    HTTP/1.1 请求携带 Upgrade + HTTP2-Settings，
+//                       服务端回 101 后，原请求的响应作为 stream 1 发出
+//
+// 与 http_conn 的分工:
+//   - 本类只处理协议层，不做 I/O: feed() 喂入收到的字节，output() 取待发字节
+//   - 请求完整（END_STREAM）后放入就绪队列，http_conn 逐个取出并复用
+//     do_request() 的路由与业务处理，再用 submit_response() 写回对应流
+//   - DATA 按对端连接级 / 流级窗口分帧，窗口不足的部分挂起，
+//     收到 WINDOW_UPDATE 后继续发送
+class H2Session {
+public:
+  struct Request {
+    uint32_t stream_id = 0;
+    std::string method;
+    std::string path;
+    std::string authorization;
+    std::string body;
+  };
+
+  static constexpr char PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+  static constexpr size_t PREFACE_LEN = sizeof(PREFACE) - 1;
+
+  static constexpr uint32_t MAX_CONCURRENT_STREAMS = 100;
+  static constexpr size_t MAX_REQUEST_BODY = 64 * 1024;
+  static constexpr size_t MAX_HEADER_BLOCK = 64 * 1024;
+
+  // 写入服务端连接前言（SETTINGS）
+  // upgraded: 由 HTTP/1.1 Upgrade 进入，stream 1 已由原请求占用（半关闭）
+  void start(bool upgraded);
+
+  // 应用 HTTP2-Settings 头携带的对端 SETTINGS（base64url）
+  bool apply_upgrade_settings(std::string_view b64);
+
+  // 喂入收到的字节；连接级错误时写入 GOAWAY 并返回 false
+  bool feed(const char *data, size_t len);
+
+  // 取出一个已完整接收的请求
+  bool next_request(Request &req);
+
+  void submit_response(uint32_t stream_id, int status,
+                       std::string_view content_type, std::string body);
+
+  // 在前言之前追加原始字节（101 Switching Protocols）
+  void append_raw(std::string_view data) { out_.append(data); }
+
+  const std::string &output() const { return out_; }
+  void consume_output(size_t n) { out_.erase(0, n); }
+
+  // 已发送 GOAWAY，输出发完后应关闭连接
+  bool closing() const { return goaway_sent_; }
+
+private:
+  enum FrameType : uint8_t {
+    DATA = 0x0,
+    HEADERS = 0x1,
+    PRIORITY = 0x2,
+    RST_STREAM = 0x3,
+    SETTINGS = 0x4,
+    PUSH_PROMISE = 0x5,
+    PING = 0x6,
+    GOAWAY = 0x7,
+    WINDOW_UPDATE = 0x8,
+    CONTINUATION = 0x9
+  };
+
+  enum Flag : uint8_t {
+    END_STREAM = 0x1,
+    ACK = 0x1,
+    END_HEADERS = 0x4,
+    PADDED = 0x8,
+    PRIORITY_FLAG = 0x20
+  };
+
+  enum ErrorCode : uint32_t {
+    NO_ERROR = 0x0,
+    PROTOCOL_ERROR = 0x1,
+    INTERNAL_ERROR = 0x2,
+    FLOW_CONTROL_ERROR = 0x3,
+    STREAM_CLOSED = 0x5,
+    FRAME_SIZE_ERROR = 0x6,
+    REFUSED_STREAM = 0x7,
+    CANCEL = 0x8,
+    COMPRESSION_ERROR = 0x9,
+    ENHANCE_YOUR_CALM = 0xb
+  };
+
+  static constexpr uint32_t DEFAULT_WINDOW = 65535;
+  static constexpr uint32_t MAX_WINDOW = 0x7fffffff;
+  static constexpr uint32_t LOCAL_MAX_FRAME = 16384;
+
+  struct Stream {
+    Request req;
+    std::string header_block; // HEADERS + CONTINUATION 累积
+    bool headers_done = false;
+    bool end_stream_pending = false; // HEADERS 带 END_STREAM，等头部块结束后生效
+    bool refused = false;            // 超出并发上限，头部块解码后 RST
+    bool remote_closed = false;
+    bool dispatched = false;
+    int64_t send_window = DEFAULT_WINDOW;
+    std::string pending; // 受流量控制阻塞、尚未发出的响应体
+    size_t pending_off = 0;
+    bool responding = false;
+  };
+
+  bool handle_frame(uint8_t type, uint8_t flags, uint32_t sid,
+                    const uint8_t *p, uint32_t len);
+  bool on_headers(uint8_t flags, uint32_t sid, const uint8_t *p, uint32_t len);
+  bool on_continuation(uint8_t flags, uint32_t sid, const uint8_t *p,
+                       uint32_t len);
+  bool on_data(uint8_t flags, uint32_t sid, const uint8_t *p, uint32_t len);
+  bool on_settings(uint8_t flags, const uint8_t *p, uint32_t len);
+  bool parse_settings(const uint8_t *p, size_t len);
+  bool on_window_update(uint32_t sid, const uint8_t *p, uint32_t len);
+  bool finish_headers(uint32_t sid);
+  void finish_stream(uint32_t sid);
+
+  void write_frame_header(uint32_t len, uint8_t type, uint8_t flags,
+                          uint32_t sid);
+  void send_settings();
+  void send_window_update(uint32_t sid, uint32_t inc);
+  void send_rst(uint32_t sid, uint32_t code);
+  bool connection_error(uint32_t code);
+  void flush_pending();
+  bool flush_stream(Stream &s);
+
+  std::string in_;
+  std::string out_;
+  HpackDecoder decoder_;
+  std::map<uint32_t, Stream> streams_;
+  std::deque<Request> ready_;
+
+  bool preface_received_ = false;
+  bool goaway_sent_ = false;
+  uint32_t last_stream_id_ = 0;
+  uint32_t continuation_sid_ = 0; // 非 0 表示正在等待 CONTINUATION
+
+  int64_t conn_send_window_ = DEFAULT_WINDOW;
+  int64_t peer_initial_window_ = DEFAULT_WINDOW;
+  uint32_t peer_max_frame_ = 16384;
+};
+
+#endif
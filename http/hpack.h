@@ -0,0 +1,433 @@
+#ifndef HTTP_HPACK_H
+#define HTTP_HPACK_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// HPACK（RFC 7541）头部压缩 —— HTTP/2 (h2c) 使用
+//
+// 解码: 静态表 + 动态表（含表大小更新）+ Huffman，覆盖全部五种字段表示
+// 编码: 静态表索引 / 静态表名 + 字面值（不入动态表），字符串按需 Huffman 编码
+//   响应头只有 :status / content-type / content-length / date 少数几项，
+//   不维护编码端动态表，省掉与对端同步表状态的复杂度。
+
+struct HpackHeader {
+  std::string name;
+  std::string value;
+};
+
+class HpackTables {
+public:
+  struct StaticEntry {
+    const char *name;
+    const char *value;
+  };
+
+  static constexpr StaticEntry STATIC_TABLE[61] = {
+      {":authority", ""},
+      {":method", "GET"},
+      {":method", "POST"},
+      {":path", "/"},
+      {":path", "/index.html"},
+      {":scheme", "http"},
+      {":scheme", "https"},
+      {":status", "200"},
+      {":status", "204"},
+      {":status", "206"},
+      {":status", "304"},
+      {":status", "400"},
+      {":status", "404"},
+      {":status", "500"},
+      {"accept-charset", ""},
+      {"accept-encoding", "gzip, deflate"},
+      {"accept-language", ""},
+      {"accept-ranges", ""},
+      {"accept", ""},
+      {"access-control-allow-origin", ""},
+      {"age", ""},
+      {"allow", ""},
+      {"authorization", ""},
+      {"cache-control", ""},
+      {"content-disposition", ""},
+      {"content-encoding", ""},
+      {"content-language", ""},
+      {"content-length", ""},
+      {"content-location", ""},
+      {"content-range", ""},
+      {"content-type", ""},
+      {"cookie", ""},
+      {"date", ""},
+      {"etag", ""},
+      {"expect", ""},
+      {"expires", ""},
+      {"from", ""},
+      {"host", ""},
+      {"if-match", ""},
+      {"if-modified-since", ""},
+      {"if-none-match", ""},
+      {"if-range", ""},
+      {"if-unmodified-since", ""},
+      {"last-modified", ""},
+      {"link", ""},
+      {"location", ""},
+      {"max-forwards", ""},
+      {"proxy-authenticate", ""},
+      {"proxy-authorization", ""},
+      {"range", ""},
+      {"referer", ""},
+      {"refresh", ""},
+      {"retry-after", ""},
+      {"server", ""},
+      {"set-cookie", ""},
+      {"strict-transport-security", ""},
+      {"transfer-encoding", ""},
+      {"user-agent", ""},
+      {"vary", ""},
+      {"via", ""},
+      {"www-authenticate", ""},
+  };
+  static constexpr uint32_t HUFFMAN_CODES[256] = {
+      0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+      0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+      0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+      0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+      0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+      0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+      0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+      0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+      0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+      0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+      0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+      0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+      0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+      0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+      0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+      0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+      0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+      0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+      0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+      0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+      0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+      0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+      0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+      0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+      0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+      0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+      0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+      0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+      0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+      0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+      0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+      0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+  };
+  static constexpr uint8_t HUFFMAN_LENS[256] = {
+      13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+      28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+      6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+      5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+      13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+      7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+      15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+      6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+      20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+      24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+      22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+      21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+      26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+      19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+      20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+      26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+  };
+  static constexpr uint32_t HUFFMAN_EOS_CODE = 0x3fffffff;
+  static constexpr uint8_t HUFFMAN_EOS_LEN = 30;
+};
+
+class Huffman {
+public:
+  // 解码失败（非法码字 / 出现 EOS / 填充不合法）返回 false
+  static bool decode(const uint8_t *p, size_t len, std::string &out) {
+    const Trie &t = trie();
+    int node = 0;
+    int pad_bits = 0;    // 自上个完整符号以来读入的位数
+    bool pad_ones = true; // 这些位是否全为 1（合法填充须为 EOS 前缀）
+    for (size_t i = 0; i < len; ++i) {
+      for (int b = 7; b >= 0; --b) {
+        int bit = (p[i] >> b) & 1;
+        node = t.child[node][bit];
+        if (node <= 0)
+          return false;
+        ++pad_bits;
+        pad_ones = pad_ones && bit;
+        int sym = t.sym[node];
+        if (sym >= 0) {
+          if (sym == 256)
+            return false;
+          out.push_back(static_cast<char>(sym));
+          node = 0;
+          pad_bits = 0;
+          pad_ones = true;
+        }
+      }
+    }
+    return pad_bits <= 7 && pad_ones;
+  }
+
+  static size_t encoded_size(std::string_view s) {
+    size_t bits = 0;
+    for (unsigned char c : s)
+      bits += HpackTables::HUFFMAN_LENS[c];
+    return (bits + 7) / 8;
+  }
+
+  static void encode(std::string_view s, std::string &out) {
+    uint64_t acc = 0;
+    int nbits = 0;
+    for (unsigned char c : s) {
+      acc = (acc << HpackTables::HUFFMAN_LENS[c]) | HpackTables::HUFFMAN_CODES[c];
+      nbits += HpackTables::HUFFMAN_LENS[c];
+      while (nbits >= 8) {
+        nbits -= 8;
+        out.push_back(static_cast<char>(acc >> nbits));
+      }
+    }
+    if (nbits > 0) // 以 EOS 高位（全 1）填充
+      out.push_back(static_cast<char>((acc << (8 - nbits)) | (0xff >> nbits)));
+  }
+
+private:
+  // 二叉解码树: child[n][bit] 为子节点下标（0 表示不存在），sym[n] >= 0 为叶子
+  struct Trie {
+    std::vector<std::array<int16_t, 2>> child;
+    std::vector<int16_t> sym;
+  };
+
+  static const Trie &trie() {
+    static const Trie t = [] {
+      Trie t;
+      t.child.push_back({0, 0});
+      t.sym.push_back(-1);
+      for (int s = 0; s <= 256; ++s) {
+        uint32_t code = s < 256 ? HpackTables::HUFFMAN_CODES[s] : HpackTables::HUFFMAN_EOS_CODE;
+        int len = s < 256 ? HpackTables::HUFFMAN_LENS[s] : HpackTables::HUFFMAN_EOS_LEN;
+        int node = 0;
+        for (int b = len - 1; b >= 0; --b) {
+          int bit = (code >> b) & 1;
+          if (t.child[node][bit] == 0) {
+            t.child[node][bit] = static_cast<int16_t>(t.child.size());
+            t.child.push_back({0, 0});
+            t.sym.push_back(-1);
+          }
+          node = t.child[node][bit];
+        }
+        t.sym[node] = static_cast<int16_t>(s);
+      }
+      return t;
+    }();
+    return t;
+  }
+};
+
+class HpackDecoder {
+public:
+  // max_table_size: 本端通告的 SETTINGS_HEADER_TABLE_SIZE
+  explicit HpackDecoder(size_t max_table_size = 4096)
+      : settings_max_(max_table_size), max_size_(max_table_size) {}
+
+  // 解码一个完整的头部块，失败（COMPRESSION_ERROR）返回 false
+  bool decode(const uint8_t *p, size_t len, std::vector<HpackHeader> &out) {
+    const uint8_t *end = p + len;
+    bool field_seen = false;
+    while (p < end) {
+      uint8_t b = *p;
+      if (b & 0x80) { // 索引字段
+        uint64_t idx;
+        if (!decode_int(p, end, 7, idx) || idx == 0)
+          return false;
+        HpackHeader h;
+        if (!lookup(idx, h.name, &h.value))
+          return false;
+        out.push_back(std::move(h));
+        field_seen = true;
+      } else if ((b & 0xe0) == 0x20) { // 动态表大小更新，只允许出现在块首
+        uint64_t size;
+        if (field_seen || !decode_int(p, end, 5, size) || size > settings_max_)
+          return false;
+        max_size_ = size;
+        evict(0);
+      } else { // 字面字段: 01 增量索引 / 0000 不索引 / 0001 永不索引
+        bool incremental = (b & 0xc0) == 0x40;
+        int prefix = incremental ? 6 : 4;
+        uint64_t idx;
+        if (!decode_int(p, end, prefix, idx))
+          return false;
+        HpackHeader h;
+        if (idx == 0) {
+          if (!decode_string(p, end, h.name))
+            return false;
+        } else if (!lookup(idx, h.name, nullptr)) {
+          return false;
+        }
+        if (!decode_string(p, end, h.value))
+          return false;
+        if (incremental)
+          add(h);
+        out.push_back(std::move(h));
+        field_seen = true;
+      }
+    }
+    return true;
+  }
+
+private:
+  static bool decode_int(const uint8_t *&p, const uint8_t *end, int prefix,
+                         uint64_t &value) {
+    if (p >= end)
+      return false;
+    uint64_t mask = (1u << prefix) - 1;
+    value = *p++ & mask;
+    if (value < mask)
+      return true;
+    int shift = 0;
+    while (p < end) {
+      uint8_t b = *p++;
+      value += static_cast<uint64_t>(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        return true;
+      shift += 7;
+      if (shift > 28) // 超过 32 位，按溢出处理
+        return false;
+    }
+    return false;
+  }
+
+  static bool decode_string(const uint8_t *&p, const uint8_t *end,
+                            std::string &out) {
+    if (p >= end)
+      return false;
+    bool huffman = *p & 0x80;
+    uint64_t len;
+    if (!decode_int(p, end, 7, len) || len > static_cast<uint64_t>(end - p))
+      return false;
+    if (huffman) {
+      if (!Huffman::decode(p, len, out))
+        return false;
+    } else {
+      out.assign(reinterpret_cast<const char *>(p), len);
+    }
+    p += len;
+    return true;
+  }
+
+  // 1..61 为静态表，之后为动态表（最新插入的下标最小）
+  bool lookup(uint64_t idx, std::string &name, std::string *value) const {
+    if (idx <= 61) {
+      name = HpackTables::STATIC_TABLE[idx - 1].name;
+      if (value)
+        *value = HpackTables::STATIC_TABLE[idx - 1].value;
+      return true;
+    }
+    idx -= 62;
+    if (idx >= dynamic_.size())
+      return false;
+    name = dynamic_[idx].name;
+    if (value)
+      *value = dynamic_[idx].value;
+    return true;
+  }
+
+  static size_t entry_size(const HpackHeader &h) {
+    return h.name.size() + h.value.size() + 32;
+  }
+
+  // 淘汰旧条目，直到能再放下 incoming 字节
+  void evict(size_t incoming) {
+    while (!dynamic_.empty() && size_ + incoming > max_size_) {
+      size_ -= entry_size(dynamic_.back());
+      dynamic_.pop_back();
+    }
+  }
+
+  void add(const HpackHeader &h) {
+    size_t sz = entry_size(h);
+    evict(sz);
+    if (sz > max_size_) // 超大条目: 清空表且不插入
+      return;
+    dynamic_.push_front(h);
+    size_ += sz;
+  }
+
+  size_t settings_max_;
+  size_t max_size_;
+  size_t size_ = 0;
+  std::deque<HpackHeader> dynamic_;
+};
+
+class HpackEncoder {
+public:
+  // 静态表完整命中（如 :status 200）
+  static void indexed(std::string &out, uint64_t idx) {
+    encode_int(out, 0x80, 7, idx);
+  }
+
+  // 静态表名 + 字面值，不入动态表
+  static void literal(std::string &out, uint64_t name_idx,
+                      std::string_view value) {
+    encode_int(out, 0x00, 4, name_idx);
+    encode_string(out, value);
+  }
+
+  // :status —— 静态表中的 200/204/206/304/400/404/500 直接索引
+  static void status(std::string &out, int code) {
+    switch (code) {
+    case 200: return indexed(out, 8);
+    case 204: return indexed(out, 9);
+    case 206: return indexed(out, 10);
+    case 304: return indexed(out, 11);
+    case 400: return indexed(out, 12);
+    case 404: return indexed(out, 13);
+    case 500: return indexed(out, 14);
+    default:
+      literal(out, 8, std::to_string(code));
+    }
+  }
+
+  static constexpr uint64_t IDX_CONTENT_LENGTH = 28;
+  static constexpr uint64_t IDX_CONTENT_TYPE = 31;
+  static constexpr uint64_t IDX_DATE = 33;
+
+private:
+  static void encode_int(std::string &out, uint8_t first, int prefix,
+                         uint64_t value) {
+    uint64_t mask = (1u << prefix) - 1;
+    if (value < mask) {
+      out.push_back(static_cast<char>(first | value));
+      return;
+    }
+    out.push_back(static_cast<char>(first | mask));
+    value -= mask;
+    while (value >= 0x80) {
+      out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+  }
+
+  // Huffman 更短时使用 Huffman 编码
+  static void encode_string(std::string &out, std::string_view s) {
+    size_t hlen = Huffman::encoded_size(s);
+    if (hlen < s.size()) {
+      encode_int(out, 0x80, 7, hlen);
+      Huffman::encode(s, out);
+    } else {
+      encode_int(out, 0x00, 7, s.size());
+      out.append(s);
+    }
+  }
+};
+
+#endif
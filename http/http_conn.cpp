@@ -1,12 +1,18 @@
 #include "http_conn.h"
 
 #include <fstream>
+#include <unordered_map>
 #include <netinet/tcp.h>
 #include <mysql/mysql.h>
+#include "../mysql/async_mysql.h"
+#include "../mysql/audit_log.h"
+#include "../mysql/prepared_stmt.h"
 #include "../rate_limiter/rate_limiter.h"
+#include "router.h"
 #include "auth/jwt.h"
 #include "auth/password.h"
 #include "redis/redis_cache.h"
+#include "redis/score_record.h"
 
 // JWT 签名密钥：优先从环境变量读取，无则用随机生成值（每次启动不同）
 static std::string get_jwt_secret() {
@@ -29,21 +35,16 @@ static std::string get_jwt_secret() {
 
 static const std::string JWT_SECRET = get_jwt_secret();
 
-// 定义http响应的一些状态信息
-const char *ok_200_title = "OK";
-const char *error_400_title = "Bad Request";
-const char *error_400_form =
-    "Your request has bad syntax or is inherently impossible to staisfy.\n";
-const char *error_403_title = "Forbidden";
-const char *error_403_form =
+// 定义http响应的一些状态信息（状态行标题见 ResponseHeader::status_title）
+static const char error_403_form[] =
     "You do not have permission to get file form this server.\n";
-const char *error_429_title = "Too Many Requests";
-const char *error_404_title = "Not Found";
-const char *error_404_form =
+static const char error_404_form[] =
     "The requested file was not found on this server.\n";
-const char *error_500_title = "Internal Error";
-const char *error_500_form =
+static const char error_500_form[] =
     "There was an unusual problem serving the request file.\n";
+static constexpr size_t ERROR_403_FORM_LEN = sizeof(error_403_form) - 1;
+static constexpr size_t ERROR_404_FORM_LEN = sizeof(error_404_form) - 1;
+static constexpr size_t ERROR_500_FORM_LEN = sizeof(error_500_form) - 1;
 
 std::mutex m_lock;
 
@@ -80,6 +81,7 @@ void removefd(int epollfd, int fd) {
 int http_conn::m_user_count = 0;
 int http_conn::m_epollfd = -1;
 bool http_conn::s_auth_enabled = true;
+std::function<void(http_conn *)> http_conn::s_async_resume;
 
 // 关闭连接，关闭一个连接，客户总量减一
 void http_conn::close_conn(bool real_close) {
@@ -88,6 +90,9 @@ void http_conn::close_conn(bool real_close) {
     removefd(m_epollfd, m_sockfd);
     m_sockfd = -1;
     m_user_count--;
+    // 在途异步查询的回调凭代数不匹配丢弃，不会把已关闭的连接重新投递
+    ++m_conn_gen;
+    m_async_state = AsyncState::IDLE;
   }
 }
 
@@ -100,6 +105,12 @@ void http_conn::init(int sockfd, const sockaddr_in &addr, char *root,
   addfd(m_epollfd, sockfd);
   ++m_user_count;
 
+  // 连接槽复用: 释放上一个连接遗留的 TLS 状态（close_conn 不释放）
+  if (TlsConn::enabled())
+    m_tls.attach(sockfd);
+  else
+    m_tls.reset();
+
   // 当浏览器出现连接重置时，可能是网站根目录出错或http响应格式出错或者访问的文件中内容完全为空
   doc_root = root;
 
@@ -107,6 +118,10 @@ void http_conn::init(int sockfd, const sockaddr_in &addr, char *root,
   strcpy(sql_passwd, passwd.c_str());
   strcpy(sql_name, sqlname.c_str());
 
+  m_h2.reset();
+  // 上一个连接若仍有异步查询在途，其回调凭代数不匹配丢弃
+  ++m_conn_gen;
+  m_async_state = AsyncState::IDLE;
   init();
 }
 
@@ -118,6 +133,9 @@ void http_conn::init() {
   bytes_have_send = 0;
   m_check_state = CHECK_STATE_REQUESTLINE;
   m_linger = true;
+  m_http11 = true;
+  m_conn_close = false;
+  m_conn_keep_alive = false;
   m_method = GET;
   m_url = 0;
   m_version = 0;
@@ -134,6 +152,8 @@ void http_conn::init() {
   m_role.clear();
   m_username.clear();
   m_user_id = 0;
+  m_h2_upgrade = false;
+  m_h2_settings.clear();
 
   memset(m_read_buf, '\0', READ_BUFFER_SIZE);
   memset(m_write_buf, '\0', WRITE_BUFFER_SIZE);
@@ -173,7 +193,14 @@ bool http_conn::read_once() {
     return false;
   }
   int bytes_read =
-      recv(m_sockfd, m_read_buf + m_read_idx, READ_BUFFER_SIZE - m_read_idx, 0);
+      m_tls.active()
+          ? m_tls.read(m_read_buf + m_read_idx, READ_BUFFER_SIZE - m_read_idx)
+          : recv(m_sockfd, m_read_buf + m_read_idx,
+                 READ_BUFFER_SIZE - m_read_idx, 0);
+  if (bytes_read < 0 && errno == EAGAIN && m_tls.active()) {
+    // TLS 记录尚不完整: 交给 process() 按 NO_REQUEST 重新注册 EPOLLIN
+    return true;
+  }
   if (bytes_read <= 0) {
     return false;
   }
@@ -181,6 +208,22 @@ bool http_conn::read_once() {
   return true;
 }
 
+// 逗号分隔的 token 列表（Connection / Upgrade）中是否含 token，忽略大小写与两侧空白
+static bool has_token(const char *list, const char *token) {
+  size_t tlen = strlen(token);
+  while (*list) {
+    list += strspn(list, " \t,");
+    size_t len = strcspn(list, ",");
+    size_t end = len;
+    while (end > 0 && (list[end - 1] == ' ' || list[end - 1] == '\t'))
+      --end;
+    if (end == tlen && strncasecmp(list, token, tlen) == 0)
+      return true;
+    list += len;
+  }
+  return false;
+}
+
 // 解析http请求行，获得请求方法，目标url及http版本号
 http_conn::HTTP_CODE http_conn::parse_request_line(char *text) {
   m_url = strpbrk(text, " \t");
@@ -208,7 +251,12 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char *text) {
     return BAD_REQUEST;
   *m_version++ = '\0';
   m_version += strspn(m_version, " \t");
-  if (strcasecmp(m_version, "HTTP/1.1") != 0)
+  // 兼容 HTTP/1.0 客户端（健康检查等），响应状态行仍为 HTTP/1.1
+  if (strcasecmp(m_version, "HTTP/1.1") == 0)
+    m_http11 = true;
+  else if (strcasecmp(m_version, "HTTP/1.0") == 0)
+    m_http11 = false;
+  else
     return BAD_REQUEST;
   if (strncasecmp(m_url, "http://", 7) == 0) {
     m_url += 7;
@@ -232,19 +280,28 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char *text) {
 // 解析http请求的一个头部信息
 http_conn::HTTP_CODE http_conn::parse_headers(char *text) {
   if (text[0] == '\0') {
+    // 持久连接: HTTP/1.1 默认保持，HTTP/1.0 需显式 keep-alive；close 优先
+    m_linger = !m_conn_close && (m_http11 || m_conn_keep_alive);
     if (m_content_length != 0) {
       m_check_state = CHECK_STATE_CONTENT;
       return NO_REQUEST;
     }
     return GET_REQUEST;
   } else if (strncasecmp(text, "Connection:", 11) == 0) {
+    // token 列表，可能同时出现多个 Connection 头，在头部结束时统一判定
     text += 11;
+    if (has_token(text, "close"))
+      m_conn_close = true;
+    if (has_token(text, "keep-alive"))
+      m_conn_keep_alive = true;
+  } else if (strncasecmp(text, "Upgrade:", 8) == 0) {
+    // 只关心 h2c，且 h2c 升级仅适用于 HTTP/1.1
+    if (m_http11 && has_token(text + 8, "h2c"))
+      m_h2_upgrade = true;
+  } else if (strncasecmp(text, "HTTP2-Settings:", 15) == 0) {
+    text += 15;
     text += strspn(text, " \t");
-    if (strcasecmp(text, "keep-alive") == 0) {
-      m_linger = true;
-    }
-  } else if (strcasecmp(text, "close") == 0) {
-    m_linger = false;
+    m_h2_settings = text;
   } else if (strncasecmp(text, "Content-length:", 15) == 0) {
     text += 15;
     text += strspn(text, " \t");
@@ -323,21 +380,16 @@ http_conn::HTTP_CODE http_conn::do_request() {
   strcpy(m_real_file, doc_root);
   int len = strlen(doc_root);
   // printf("m_url:%s\n", m_url);
-  const char *p = strrchr(m_url, '/');
+
+  // 一次查表同时得到 handler 与限流分类（见 http/router.h）
+  const Router::Match route = Router::lookup(m_url, m_method);
 
   // ── 限流检查（在 DB / Redis / 密码哈希之前拦截） ──────────────
   {
     std::string ip = get_client_ip();
-    std::string endpoint = "global";
-    // 根据 URL 前缀细分 endpoint 类型，各接口独立的限流桶
-    if (strncmp(m_url, "/auth/register", 14) == 0)
-      endpoint = "register";
-    else if (strncmp(m_url, "/auth/login", 11) == 0)
-      endpoint = "login";
-    else if (strncmp(m_url, "/api/", 5) == 0)
-      endpoint = "api";
-
-    if (!RateLimiter::GetInstance()->allow(ip, endpoint)) {
+    // 各接口独立的限流桶
+    if (!RateLimiter::GetInstance()->allow(
+            ip, Router::rate_class_name(route.rate))) {
       m_cgi_status = 429;
       m_cgi_response =
           "{\"error\":\"too many requests\",\"retry_after\":1}";
@@ -346,26 +398,22 @@ http_conn::HTTP_CODE http_conn::do_request() {
   }
 
   // ── 认证已关闭：仅允许旧版 SELECT 路由 ────────────────────────
-  if (!s_auth_enabled) {
-    // /auth/* 和 /api/* 全部禁用
-    if (strncmp(m_url, "/auth/", 6) == 0 || strncmp(m_url, "/api/", 5) == 0) {
-      m_cgi_status = 403;
-      m_cgi_response = "{\"error\":\"auth is disabled\"}";
-      return CGI_REQUEST;
-    }
-    // /4 等旧路由继续走原有逻辑（无需令牌）
-  } else {
+  // /auth/* 和 /api/* 全部禁用，/4 等旧路由继续走原有逻辑（无需令牌）
+  if (!s_auth_enabled && route.auth_module) {
+    m_cgi_status = 403;
+    m_cgi_response = "{\"error\":\"auth is disabled\"}";
+    return CGI_REQUEST;
+  }
 
+  switch (route.handler) {
   // ── /auth/* 认证路由（无需令牌） ──────────────────────────────
-  if (cgi == 1 && strncmp(m_url, "/auth/register", 14) == 0) {
+  case Router::Handler::REGISTER:
     return handle_register();
-  }
-  if (cgi == 1 && strncmp(m_url, "/auth/login", 11) == 0) {
+  case Router::Handler::LOGIN:
     return handle_login();
-  }
 
   // ── /api/* CRUD 路由（需要 root 权限） ────────────────────────
-  if (cgi == 1 && strncmp(m_url, "/api/", 5) == 0) {
+  case Router::Handler::STUDENT_API:
     if (!verify_token())
       return CGI_REQUEST;
     if (!require_role("root"))
@@ -379,228 +427,24 @@ http_conn::HTTP_CODE http_conn::do_request() {
     m_cgi_status = 405;
     m_cgi_response = "{\"error\":\"method not allowed\"}";
     return CGI_REQUEST;
-  }
 
-  } // end if (s_auth_enabled)
+  // ── /4 成绩查询 ───────────────────────────────────────────────
+  case Router::Handler::SCORE_QUERY:
+    return handle_score_query();
+  case Router::Handler::SCORE_BATCH:
+    return handle_score_batch();
 
-  // 处理cgi
-  if (cgi == 1 && *(p + 1) == '4') {
-    // 认证开启时，成绩查询也需要登录
-    if (s_auth_enabled) {
-      if (!verify_token())
-        return CGI_REQUEST;
-    }
-    if (*(p + 1) == '4') {
-      auto hex_value = [](char c) -> int {
-        if (c >= '0' && c <= '9')
-          return c - '0';
-        if (c >= 'a' && c <= 'f')
-          return c - 'a' + 10;
-        if (c >= 'A' && c <= 'F')
-          return c - 'A' + 10;
-        return -1;
-      };
-
-      auto url_decode = [&](const std::string &src) -> std::string {
-        std::string out;
-        out.reserve(src.size());
-        for (size_t i = 0; i < src.size(); ++i) {
-          char c = src[i];
-          if (c == '+') {
-            out.push_back(' ');
-          } else if (c == '%' && i + 2 < src.size()) {
-            int h1 = hex_value(src[i + 1]);
-            int h2 = hex_value(src[i + 2]);
-            if (h1 >= 0 && h2 >= 0) {
-              out.push_back(static_cast<char>(h1 * 16 + h2));
-              i += 2;
-            } else {
-              out.push_back(c);
-            }
-          } else {
-            out.push_back(c);
-          }
-        }
-        return out;
-      };
-
-      auto get_param = [&](const std::string &body,
-                           const char *key) -> std::string {
-        std::string k = std::string(key) + "=";
-        size_t pos = body.find(k);
-        if (pos == std::string::npos)
-          return "";
-        pos += k.size();
-        size_t end = body.find('&', pos);
-        if (end == std::string::npos)
-          end = body.size();
-        return url_decode(body.substr(pos, end - pos));
-      };
-
-      auto json_escape = [](const std::string &s) -> std::string {
-        std::string out;
-        out.reserve(s.size());
-        for (char c : s) {
-          switch (c) {
-          case '"':
-            out += "\\\"";
-            break;
-          case '\\':
-            out += "\\\\";
-            break;
-          case '\b':
-            out += "\\b";
-            break;
-          case '\f':
-            out += "\\f";
-            break;
-          case '\n':
-            out += "\\n";
-            break;
-          case '\r':
-            out += "\\r";
-            break;
-          case '\t':
-            out += "\\t";
-            break;
-          default:
-            out.push_back(c);
-            break;
-          }
-        }
-        return out;
-      };
-
-      std::string body(m_string ? m_string : "");
-      std::string name = get_param(body, "name");
-      std::string id_card = get_param(body, "id_card");
-
-      if (name.empty() || id_card.empty()) {
-        m_cgi_status = 400;
-        m_cgi_response = "{\"error\":\"missing name or id_card\"}";
-        return CGI_REQUEST;
-      }
-      // 输入长度校验：mysql_real_escape_string 最坏 2×+1 膨胀，256 字节缓冲区安全上限 127 字符
-      if (name.size() > 127 || id_card.size() > 127) {
-        m_cgi_status = 400;
-        m_cgi_response = "{\"error\":\"name or id_card too long\"}";
-        return CGI_REQUEST;
-      }
-
-      // ── Redis 缓存 + MySQL 回退 ────────────────────────
-      // Cache Aside 模式：先查 Redis，命中直接返回，未命中查 DB 并回写缓存。
-      // RedisCache::get() 内部已包含三级防护：
-      //   1. 布隆过滤器防穿透  2. 熔断器容错降级  3. SETNX 互斥锁防击穿
-      std::string cache_key = "exam:score:" + name + ":" + id_card;
-
-      auto cached = RedisCache::GetInstance()->get(
-          cache_key,
-          // 缓存未命中回调：查 MySQL 并构建 JSON
-          [&]() -> std::optional<std::string> {
-            connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
-
-            char esc_name[256]{0};
-            char esc_idcard[256]{0};
-            mysql_real_escape_string(mysql, esc_name, name.c_str(), name.size());
-            mysql_real_escape_string(mysql, esc_idcard, id_card.c_str(),
-                                     id_card.size());
-
-            char sql_query[2048]{0};
-            snprintf(sql_query, sizeof(sql_query),
-                     "SELECT s.student_id, s.name, s.id_card, s.gender, "
-                     "s.province, s.school, "
-                     "subj.subject_name, sc.score "
-                     "FROM student s "
-                     "JOIN score sc ON sc.student_id = s.student_id "
-                     "JOIN subject subj ON subj.subject_id = sc.subject_id "
-                     "WHERE s.name='%s' AND s.id_card='%s';",
-                     esc_name, esc_idcard);
-
-            if (mysql_query(mysql, sql_query))
-              return std::nullopt;
-
-            MYSQL_RES *result = mysql_store_result(mysql);
-            if (!result)
-              return std::nullopt;
-
-            MYSQL_ROW row;
-            bool has_student = false;
-            std::string student_id, real_name, real_idcard, gender, province, school;
-            std::string scores_json;
-            bool first_score = true;
-
-            while ((row = mysql_fetch_row(result))) {
-              auto cell = [&](int idx) -> std::string {
-                if (!row[idx])
-                  return "";
-                return std::string(row[idx]);
-              };
-
-              if (!has_student) {
-                student_id = cell(0);
-                real_name = cell(1);
-                real_idcard = cell(2);
-                gender = cell(3);
-                province = cell(4);
-                school = cell(5);
-                has_student = true;
-              }
-
-              std::string subject_name = cell(6);
-              std::string score_str = cell(7);
-
-              if (!first_score)
-                scores_json += ",";
-              first_score = false;
-
-              if (score_str.empty())
-                score_str = "0";
-
-              scores_json += "{\"subject\":\"" + json_escape(subject_name) +
-                             "\",\"score\":" + score_str + "}";
-            }
-
-            mysql_free_result(result);
-
-            if (!has_student)
-              return std::nullopt;
-
-            std::string json;
-            json += "{\"student\":{";
-            json += "\"student_id\":\"" + json_escape(student_id) + "\",";
-            json += "\"name\":\"" + json_escape(real_name) + "\",";
-            json += "\"id_card\":\"" + json_escape(real_idcard) + "\",";
-            json += "\"gender\":\"" + json_escape(gender) + "\",";
-            json += "\"province\":\"" + json_escape(province) + "\",";
-            json += "\"school\":\"" + json_escape(school) + "\"";
-            json += "},\"scores\":[";
-            json += scores_json;
-            json += "]}";
-
-            return json;
-          },
-          3600);
-
-      if (cached.has_value()) {
-        m_cgi_status = 200;
-        m_cgi_response = cached.value();
-      } else {
-        m_cgi_status = 404;
-        m_cgi_response = "{\"error\":\"student not found\"}";
-      }
-      return CGI_REQUEST;
-    }
+  case Router::Handler::STATIC_FILE:
+    break;
   }
 
-  else {
-    // 防止目录穿越：拒绝包含 .. 的路径
-    if (strstr(m_url, "..") != nullptr) {
-      m_cgi_status = 403;
-      m_cgi_response = "{\"error\":\"forbidden\"}";
-      return CGI_REQUEST;
-    }
-    strncpy(m_real_file + len, m_url, FILENAME_LEN - len - 1);
+  // 防止目录穿越：拒绝包含 .. 的路径
+  if (strstr(m_url, "..") != nullptr) {
+    m_cgi_status = 403;
+    m_cgi_response = "{\"error\":\"forbidden\"}";
+    return CGI_REQUEST;
   }
+  strncpy(m_real_file + len, m_url, FILENAME_LEN - len - 1);
 
   if (stat(m_real_file, &m_file_stat) < 0)
     return NO_RESOURCE;
@@ -618,6 +462,331 @@ http_conn::HTTP_CODE http_conn::do_request() {
   return FILE_REQUEST;
 }
 
+// ── POST /4 — 成绩查询（user+） ─────────────────────────────────
+http_conn::HTTP_CODE http_conn::handle_score_query() {
+  // 认证开启时，成绩查询也需要登录
+  if (s_auth_enabled) {
+    if (!verify_token())
+      return CGI_REQUEST;
+  }
+
+  auto hex_value = [](char c) -> int {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  };
+
+  auto url_decode = [&](const std::string &src) -> std::string {
+    std::string out;
+    out.reserve(src.size());
+    for (size_t i = 0; i < src.size(); ++i) {
+      char c = src[i];
+      if (c == '+') {
+        out.push_back(' ');
+      } else if (c == '%' && i + 2 < src.size()) {
+        int h1 = hex_value(src[i + 1]);
+        int h2 = hex_value(src[i + 2]);
+        if (h1 >= 0 && h2 >= 0) {
+          out.push_back(static_cast<char>(h1 * 16 + h2));
+          i += 2;
+        } else {
+          out.push_back(c);
+        }
+      } else {
+        out.push_back(c);
+      }
+    }
+    return out;
+  };
+
+  auto get_param = [&](const std::string &body,
+                       const char *key) -> std::string {
+    std::string k = std::string(key) + "=";
+    size_t pos = body.find(k);
+    if (pos == std::string::npos)
+      return "";
+    pos += k.size();
+    size_t end = body.find('&', pos);
+    if (end == std::string::npos)
+      end = body.size();
+    return url_decode(body.substr(pos, end - pos));
+  };
+
+  std::string body(m_string ? m_string : "");
+  std::string name = get_param(body, "name");
+  std::string id_card = get_param(body, "id_card");
+
+  if (name.empty() || id_card.empty()) {
+    m_cgi_status = 400;
+    m_cgi_response = "{\"error\":\"missing name or id_card\"}";
+    return CGI_REQUEST;
+  }
+  // 输入长度校验：超长输入不查缓存也不查库
+  if (name.size() > 127 || id_card.size() > 127) {
+    m_cgi_status = 400;
+    m_cgi_response = "{\"error\":\"name or id_card too long\"}";
+    return CGI_REQUEST;
+  }
+
+  // ── Redis 缓存 + MySQL 回退 ────────────────────────
+  // Cache Aside 模式：先查 Redis，命中直接返回，未命中查 DB 并回写缓存。
+  // RedisCache::get() 内部已包含三级防护：
+  //   1. 布隆过滤器防穿透  2. 熔断器容错降级  3. SETNX 互斥锁防击穿
+  std::string cache_key = RedisCache::score_key(name, id_card);
+
+  m_score_name = name;
+  m_score_idcard = id_card;
+
+  // HTTP/1.x: Redis 往返交给事件循环，worker 不等待网络
+  // （h2 多路复用的多个流共用一个连接对象，仍走同步路径）
+  if (s_async_resume && !m_h2 && !m_h2_upgrade) {
+    m_async_retries = 0;
+    return lookup_score_async(0);
+  }
+
+  return score_response(
+      RedisCache::GetInstance()->get(cache_key, score_loader(), 3600));
+}
+
+RedisCache::DbQuery http_conn::score_loader() const {
+  return [name = m_score_name, id_card = m_score_idcard]() {
+    return load_score(name, id_card);
+  };
+}
+
+// 把一行成绩查询结果并入记录（列顺序见 StmtId::SCORE_LOOKUP），
+// col(i) 返回第 i 列（NULL 为空串）
+template <typename Col>
+static void append_score_row(ScoreRecord &rec, bool &has_student, Col &&col) {
+  if (!has_student) {
+    rec.student_id = col(0);
+    rec.name = col(1);
+    rec.id_card = col(2);
+    rec.gender = col(3);
+    rec.province = col(4);
+    rec.school = col(5);
+    has_student = true;
+  }
+
+  std::string score_str = col(7);
+  if (score_str.empty())
+    score_str = "0";
+  rec.subjects.push_back({col(6), std::move(score_str)});
+}
+
+// 异步查询（文本协议）的结果集 → 编码后的成绩记录
+static std::optional<std::string> score_from_result(MYSQL_RES *result) {
+  bool has_student = false;
+  ScoreRecord rec;
+  while (MYSQL_ROW row = mysql_fetch_row(result)) {
+    unsigned long *lengths = mysql_fetch_lengths(result);
+    append_score_row(rec, has_student, [&](int idx) -> std::string {
+      if (!row[idx])
+        return "";
+      return std::string(row[idx], lengths[idx]);
+    });
+  }
+  if (!has_student)
+    return std::nullopt;
+  return rec.encode();
+}
+
+// 缓存未命中回调：查 MySQL 并编码为二进制成绩记录（见 score_record.h）
+RedisCache::DbResult http_conn::load_score(const std::string &name,
+                                           const std::string &id_card) {
+  // MySQL 熔断时直接返回，不再占用连接排队
+  CircuitBreaker &breaker = connection_pool::GetInstance()->query_breaker();
+  if (!breaker.allow_request())
+    return RedisCache::DbResult::unavailable_result();
+
+  // 后台刷新线程也会调用，不能借用连接对象的 mysql 成员
+  MYSQL *mysql = nullptr;
+  connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
+
+  PreparedQuery query(mysql, StmtId::SCORE_LOOKUP);
+  query.arg(name).arg(id_card);
+
+  auto start = std::chrono::steady_clock::now();
+  if (!query.execute()) {
+    breaker.on_failure();
+    return RedisCache::DbResult::unavailable_result();
+  }
+  breaker.on_success(std::chrono::steady_clock::now() - start);
+
+  bool has_student = false;
+  ScoreRecord rec;
+
+  while (query.fetch())
+    append_score_row(rec, has_student,
+                     [&](int idx) -> const std::string & { return query.col(idx); });
+
+  if (!has_student)
+    return RedisCache::DbResult(); // 确认不存在
+
+  return RedisCache::DbResult(rec.encode());
+}
+
+http_conn::HTTP_CODE
+http_conn::score_response(std::optional<std::string> value) {
+  if (value.has_value()) {
+    m_cgi_status = 200;
+    // 缓存中是二进制记录，响应时才渲染；解码失败的是旧版本缓存的 JSON 文本
+    ScoreRecord rec;
+    if (rec.decode(value.value())) {
+      m_cgi_response = rec.to_json();
+    } else if (ScoreRecord::is_record(value.value())) {
+      // 本构建无法解码的记录（如未启用 LZ4 时读到压缩记录）: 直接查库渲染
+      RedisCache::DbResult fresh = load_score(m_score_name, m_score_idcard);
+      if (fresh.unavailable)
+        return score_unavailable(); // 查库失败不等于查无此人
+      if (fresh.value.has_value() && rec.decode(fresh.value.value())) {
+        m_cgi_response = rec.to_json();
+      } else {
+        m_cgi_status = 404;
+        m_cgi_response = "{\"error\":\"student not found\"}";
+      }
+    } else {
+      m_cgi_response = std::move(value.value());
+    }
+  } else {
+    m_cgi_status = 404;
+    m_cgi_response = "{\"error\":\"student not found\"}";
+  }
+  return CGI_REQUEST;
+}
+
+// 成绩库不可用（熔断 / 查询出错）: 结果未知，不能答 404
+http_conn::HTTP_CODE http_conn::score_unavailable() {
+  m_cgi_status = 503;
+  m_cgi_response = "{\"error\":\"score service unavailable\"}";
+  return CGI_REQUEST;
+}
+
+// 异步结果回调（事件循环线程执行）: 存入结果并重新投递到线程池
+RedisCache::AsyncDone http_conn::async_done() {
+  uint32_t gen = m_conn_gen;
+  return [this, gen](RedisCache::AsyncResult &&r) {
+    // 等待期间连接被定时器关闭并复用给新客户端: 丢弃
+    if (m_conn_gen != gen || m_async_state != AsyncState::PENDING)
+      return;
+    m_async_result = std::move(r);
+    m_async_state = AsyncState::READY;
+    s_async_resume(this);
+  };
+}
+
+// 提交异步 GET；布隆 / L1 可就地判定时直接完成
+http_conn::HTTP_CODE http_conn::lookup_score_async(int delay_ms) {
+  RedisCache *cache = RedisCache::GetInstance();
+  std::string key = RedisCache::score_key(m_score_name, m_score_idcard);
+  RedisCache::AsyncResult res;
+
+  // 先置 PENDING 再提交: 回调可能在本函数返回前就在事件循环线程执行
+  m_async_state = AsyncState::PENDING;
+  RedisCache::Lookup lookup = cache->get_async(key, score_loader(), 3600, res,
+                                               async_done(), delay_ms);
+  if (lookup == RedisCache::Lookup::PENDING)
+    return ASYNC_REQUEST; // 此后不能再访问成员，连接可能已被其他 worker 接手
+
+  m_async_state = AsyncState::IDLE;
+  if (lookup == RedisCache::Lookup::DONE)
+    return finish_score_query(res);
+  return score_response(cache->get(key, score_loader(), 3600));
+}
+
+http_conn::HTTP_CODE
+http_conn::finish_score_query(RedisCache::AsyncResult &res) {
+  RedisCache *cache = RedisCache::GetInstance();
+  std::string key = RedisCache::score_key(m_score_name, m_score_idcard);
+  auto loader = score_loader();
+
+  switch (res.status) {
+  case RedisCache::AsyncResult::HIT:
+    return score_response(std::move(res.value));
+  case RedisCache::AsyncResult::NEGATIVE:
+    return score_response(std::nullopt);
+  case RedisCache::AsyncResult::MISS: {
+    // 重试耗尽: 与同步路径一致，最终直接查库
+    if (m_async_retries >= RedisCache::MAX_RETRIES)
+      return score_response(cache->load_direct(key, loader));
+    std::optional<std::string> value;
+    // 异步 MySQL 可用时查库也不占 worker: 取锁后由 load_score_async() 提交
+    RedisCache::PendingLoad load;
+    bool defer = AsyncMysql::GetInstance()->connected();
+    m_async_state = AsyncState::PENDING;
+    RedisCache::Rebuild rebuild = cache->rebuild_async(
+        key, loader, 3600, value, async_done(), defer ? &load : nullptr);
+    if (rebuild == RedisCache::Rebuild::JOINED)
+      return ASYNC_REQUEST; // 搭乘本进程在途的重建，结果到达时回调
+    m_async_state = AsyncState::IDLE;
+    if (rebuild == RedisCache::Rebuild::LOAD)
+      return load_score_async(std::move(load));
+    if (rebuild == RedisCache::Rebuild::DONE)
+      return score_response(std::move(value));
+    // 其他节点正在重建: 不 sleep，交给事件循环稍后重新 GET
+    ++m_async_retries;
+    return lookup_score_async(RedisCache::RETRY_SLEEP_MS);
+  }
+  case RedisCache::AsyncResult::ERROR:
+  default:
+    // Redis 出错 / 超时: 回到同步路径（含熔断降级）
+    return score_response(cache->get(key, loader, 3600));
+  }
+}
+
+// 重建的查库阶段（已持有重建锁）: 查询交给 AsyncMysql，worker 立即返回；
+// 结果在事件循环线程回写缓存、唤醒同 key 等待者后重新投递连接。
+// 提交失败（未连接 / 排队过多）时就地同步查询，与 fill_locked() 结果一致。
+// 查库失败不当作查无此人: 异步失败回到同步路径，就地查询失败返回 503
+http_conn::HTTP_CODE http_conn::load_score_async(RedisCache::PendingLoad load) {
+  CircuitBreaker &breaker = connection_pool::GetInstance()->query_breaker();
+  if (breaker.allow_request()) {
+    uint32_t gen = m_conn_gen;
+    auto start = std::chrono::steady_clock::now();
+    // 先置 PENDING 再提交: 回调可能在本函数返回前就在事件循环线程执行
+    m_async_state = AsyncState::PENDING;
+    bool submitted = AsyncMysql::GetInstance()->submit(
+        StmtId::SCORE_LOOKUP, {m_score_name, m_score_idcard},
+        [this, gen, load, start, &breaker](MYSQL_RES *res) {
+          RedisCache::DbResult result =
+              RedisCache::DbResult::unavailable_result();
+          if (res) {
+            breaker.on_success(std::chrono::steady_clock::now() - start);
+            result = score_from_result(res);
+          } else {
+            breaker.on_failure();
+          }
+          // 连接是否还在都要完成重建，否则同 key 的等待者一直挂起
+          RedisCache::GetInstance()->finish_rebuild(load, result);
+          if (m_conn_gen != gen || m_async_state != AsyncState::PENDING)
+            return;
+          std::optional<std::string> &value = result.value;
+          if (result.unavailable) // 查库失败不等于查无此人: 回到同步路径
+            m_async_result.status = RedisCache::AsyncResult::ERROR;
+          else if (value.has_value())
+            m_async_result.status = RedisCache::AsyncResult::HIT;
+          else
+            m_async_result.status = RedisCache::AsyncResult::NEGATIVE;
+          m_async_result.value = value.has_value() ? std::move(*value) : "";
+          m_async_state = AsyncState::READY;
+          s_async_resume(this);
+        });
+    if (submitted)
+      return ASYNC_REQUEST; // 此后不能再访问成员
+    m_async_state = AsyncState::IDLE;
+  }
+
+  RedisCache::DbResult result = load_score(m_score_name, m_score_idcard);
+  RedisCache::GetInstance()->finish_rebuild(load, result);
+  if (result.unavailable)
+    return score_unavailable();
+  return score_response(std::move(result.value));
+}
+
 // ── /auth/register ───────────────────────────────────────────────
 http_conn::HTTP_CODE http_conn::handle_register() {
   auto hex_value = [](char c) -> int {
@@ -669,34 +838,24 @@ http_conn::HTTP_CODE http_conn::handle_register() {
   connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
 
   // 检查用户名是否已存在
-  // esc_user[128] 安全容纳上限 = floor((128-1)/2) = 63 字符（mysql_real_escape_string 最坏 2×+1）
-  char esc_user[128]{0};
-  mysql_real_escape_string(mysql, esc_user, username.c_str(), username.size());
-  char check_sql[256];
-  snprintf(check_sql, sizeof(check_sql),
-           "SELECT id FROM server_users WHERE username='%s'", esc_user);
-  if (mysql_query(mysql, check_sql)) {
+  PreparedQuery exists(mysql, StmtId::USER_EXISTS);
+  exists.arg(username);
+  if (!exists.execute()) {
     m_cgi_status = 500;
     m_cgi_response = "{\"error\":\"internal error\"}";
     return CGI_REQUEST;
   }
-  MYSQL_RES *res = mysql_store_result(mysql);
-  if (res && mysql_num_rows(res) > 0) {
-    mysql_free_result(res);
+  if (exists.fetch()) {
     m_cgi_status = 409;
     m_cgi_response = "{\"error\":\"username already exists\"}";
     return CGI_REQUEST;
   }
-  if (res) mysql_free_result(res);
 
   // 插入新用户
   std::string hash = Password::hash(password);
-  char insert_sql[1024];
-  snprintf(insert_sql, sizeof(insert_sql),
-           "INSERT INTO server_users (username, password_hash, role) "
-           "VALUES ('%s', '%s', 'user')",
-           esc_user, hash.c_str());
-  if (mysql_query(mysql, insert_sql)) {
+  PreparedQuery insert(mysql, StmtId::USER_INSERT);
+  insert.arg(username).arg(hash);
+  if (!insert.execute()) {
     m_cgi_status = 500;
     m_cgi_response = "{\"error\":\"internal error\"}";
     return CGI_REQUEST;
@@ -754,31 +913,22 @@ http_conn::HTTP_CODE http_conn::handle_login() {
 
   connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
 
-  char esc_user[128]{0};
-  mysql_real_escape_string(mysql, esc_user, username.c_str(), username.size());
-  char sql[512];
-  snprintf(sql, sizeof(sql),
-           "SELECT id, password_hash, role FROM server_users "
-           "WHERE username='%s' LIMIT 1",
-           esc_user);
-  if (mysql_query(mysql, sql)) {
+  PreparedQuery query(mysql, StmtId::USER_LOGIN);
+  query.arg(username);
+  if (!query.execute()) {
     m_cgi_status = 500;
     m_cgi_response = "{\"error\":\"internal error\"}";
     return CGI_REQUEST;
   }
 
-  MYSQL_RES *result = mysql_store_result(mysql);
-  if (!result || mysql_num_rows(result) == 0) {
-    if (result) mysql_free_result(result);
+  if (!query.fetch()) {
     m_cgi_status = 401;
     m_cgi_response = "{\"error\":\"invalid username or password\"}";
     return CGI_REQUEST;
   }
 
-  MYSQL_ROW row = mysql_fetch_row(result);
-  std::string stored_hash = row[1] ? row[1] : "";
-  std::string role = row[2] ? row[2] : "user";
-  mysql_free_result(result);
+  std::string stored_hash = query.col(1);
+  std::string role = query.is_null(2) ? "user" : query.col(2);
 
   if (!Password::verify(password, stored_hash)) {
     m_cgi_status = 401;
@@ -820,19 +970,21 @@ bool http_conn::require_role(const char *required) {
   return true;
 }
 
-void http_conn::write_audit_log(const char *operation, const char *target,
+bool http_conn::write_audit_log(const char *operation, const char *target,
                                 const char *detail) {
-  connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
-  char esc_user[128]{0}, esc_target[256]{0}, esc_detail[4096]{0};
-  mysql_real_escape_string(mysql, esc_user,   m_username.c_str(), m_username.size());
-  mysql_real_escape_string(mysql, esc_target, target,  strlen(target));
-  mysql_real_escape_string(mysql, esc_detail, detail,  strlen(detail));
-  char sql[4608];
-  snprintf(sql, sizeof(sql),
-           "INSERT INTO audit_log (username, operation, target, detail) "
-           "VALUES ('%s','%s','%s','%s')",
-           esc_user, operation, esc_target, esc_detail);
-  mysql_query(mysql, sql); // best-effort, 不影响主流程
+  // 入队后由后台线程批量写入（见 audit_log.h）；非 durable 模式 best-effort,
+  // durable 模式等落盘确认，失败时让调用方如实告知客户端
+  AuditLog *audit = AuditLog::GetInstance();
+  return audit->record(m_username, operation, target, detail) ||
+         !audit->durable();
+}
+
+// 数据已修改，但审计记录未确认落盘（durable 模式）
+http_conn::HTTP_CODE http_conn::audit_unavailable() {
+  m_cgi_status = 503;
+  m_cgi_response =
+      "{\"error\":\"change applied but audit log not acknowledged\"}";
+  return CGI_REQUEST;
 }
 
 // ── URL 解码 / 表单参数提取（局部复用） ─────────────────────────
@@ -867,6 +1019,212 @@ static std::string get_form_param(const std::string &body, const char *key) {
   return url_decode_str(body.substr(pos, end - pos));
 }
 
+// 审计详情为 JSON 文本: 字段值中的引号、反斜杠与控制字符需转义
+static std::string json_escape(const std::string &src) {
+  std::string out;
+  out.reserve(src.size());
+  for (unsigned char c : src) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+// ── POST /4/batch — 批量成绩查询（user+） ─────────────────────
+// body 中 name / id_card 成对重复出现，按出现顺序配对，最多 SCORE_BATCH_MAX 组。
+// 经 RedisCache::mget() 每个分片一次往返读缓存，未命中的合并为一次 IN 查询。
+// 响应 {"results":[成绩对象或 null, ...]}，顺序与请求一致
+static constexpr size_t SCORE_BATCH_MAX = 100;
+
+http_conn::HTTP_CODE http_conn::handle_score_batch() {
+  if (s_auth_enabled) {
+    if (!verify_token())
+      return CGI_REQUEST;
+  }
+
+  std::vector<std::string> names, id_cards;
+  std::string body(m_string ? m_string : "");
+  for (size_t pos = 0; pos < body.size();) {
+    size_t end = body.find('&', pos);
+    if (end == std::string::npos)
+      end = body.size();
+    std::string field = body.substr(pos, end - pos);
+    if (field.compare(0, 5, "name=") == 0)
+      names.push_back(url_decode_str(field.substr(5)));
+    else if (field.compare(0, 8, "id_card=") == 0)
+      id_cards.push_back(url_decode_str(field.substr(8)));
+    pos = end + 1;
+  }
+
+  if (names.empty() || names.size() != id_cards.size()) {
+    m_cgi_status = 400;
+    m_cgi_response = "{\"error\":\"name and id_card must come in pairs\"}";
+    return CGI_REQUEST;
+  }
+  if (names.size() > SCORE_BATCH_MAX) {
+    m_cgi_status = 400;
+    m_cgi_response = "{\"error\":\"too many students in one batch\"}";
+    return CGI_REQUEST;
+  }
+
+  std::vector<std::string> keys;
+  std::unordered_map<std::string, std::pair<std::string, std::string>> people;
+  keys.reserve(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    // 与 /4 相同的长度校验；超长的一组不查缓存也不查库
+    if (names[i].empty() || id_cards[i].empty() || names[i].size() > 127 ||
+        id_cards[i].size() > 127) {
+      keys.emplace_back();
+      continue;
+    }
+    keys.push_back(RedisCache::score_key(names[i], id_cards[i]));
+    people.emplace(keys.back(), std::make_pair(names[i], id_cards[i]));
+  }
+
+  // 只查询 mget 判定未命中的 key；失败时返回空结果，mget 不回写
+  bool db_failed = false;
+  auto db_query = [&](const std::vector<std::string> &miss_keys) {
+    std::vector<std::pair<std::string, std::string>> miss;
+    miss.reserve(miss_keys.size());
+    for (const std::string &key : miss_keys) {
+      auto it = people.find(key);
+      miss.push_back(it != people.end() ? it->second
+                                        : std::pair<std::string, std::string>());
+    }
+    auto rows = load_scores(miss);
+    db_failed = rows.size() != miss.size();
+    return rows;
+  };
+
+  std::vector<std::string> lookup_keys;
+  std::vector<size_t> lookup_idx;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i].empty())
+      continue;
+    lookup_keys.push_back(keys[i]);
+    lookup_idx.push_back(i);
+  }
+  auto values = RedisCache::GetInstance()->mget(lookup_keys, db_query, 3600);
+  if (db_failed)
+    return score_unavailable();
+
+  std::string out = "{\"results\":[";
+  size_t next = 0;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (i)
+      out.push_back(',');
+    std::optional<std::string> value;
+    if (next < lookup_idx.size() && lookup_idx[next] == i)
+      value = std::move(values[next++]);
+    ScoreRecord rec;
+    if (!value.has_value())
+      out += "null";
+    else if (rec.decode(value.value()))
+      out += rec.to_json();
+    else if (ScoreRecord::is_record(value.value()))
+      out += "null"; // 本构建无法解码的记录（见 score_response）
+    else
+      out += value.value(); // 旧版本缓存的 JSON 文本
+  }
+  out += "]}";
+
+  m_cgi_status = 200;
+  m_cgi_response = std::move(out);
+  return CGI_REQUEST;
+}
+
+std::vector<std::optional<std::string>> http_conn::load_scores(
+    const std::vector<std::pair<std::string, std::string>> &people) {
+  CircuitBreaker &breaker = connection_pool::GetInstance()->query_breaker();
+  if (!breaker.allow_request())
+    return {};
+
+  MYSQL *mysql = nullptr;
+  connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
+  if (!mysql)
+    return {};
+
+  // 组数不定，无法用预编译语句: 每组一段与 StmtId::SCORE_LOOKUP 相同条件的
+  // SELECT（参数转义后代入），首列为组下标，UNION ALL 成一条语句。
+  // 比较语义（排序规则、尾随空格）与单条查询完全一致
+  std::string sql;
+  auto append_quoted = [&](const std::string &v) {
+    size_t pos = sql.size();
+    sql.resize(pos + 2 * v.size() + 3);
+    sql[pos] = '\'';
+    unsigned long n =
+        mysql_real_escape_string(mysql, &sql[pos + 1], v.data(), v.size());
+    sql.resize(pos + 1 + n);
+    sql.push_back('\'');
+  };
+  for (size_t i = 0; i < people.size(); ++i) {
+    if (i)
+      sql += " UNION ALL ";
+    sql += "SELECT " + std::to_string(i) +
+           ", s.student_id, s.name, s.id_card, s.gender, "
+           "s.province, s.school, subj.subject_name, sc.score "
+           "FROM student s "
+           "JOIN score sc ON sc.student_id = s.student_id "
+           "JOIN subject subj ON subj.subject_id = sc.subject_id "
+           "WHERE s.name=";
+    append_quoted(people[i].first);
+    sql += " AND s.id_card=";
+    append_quoted(people[i].second);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  MYSQL_RES *result = nullptr;
+  if (mysql_real_query(mysql, sql.data(), sql.size()) ||
+      !(result = mysql_store_result(mysql))) {
+    breaker.on_failure();
+    return {};
+  }
+  breaker.on_success(std::chrono::steady_clock::now() - start);
+
+  // 各行按首列的组下标归并到对应考生的记录
+  std::vector<ScoreRecord> recs(people.size());
+  std::vector<bool> has_student(people.size(), false);
+  while (MYSQL_ROW row = mysql_fetch_row(result)) {
+    unsigned long *lengths = mysql_fetch_lengths(result);
+    size_t i = row[0] ? strtoul(row[0], nullptr, 10) : people.size();
+    if (i >= people.size())
+      continue;
+    bool found = has_student[i];
+    append_score_row(recs[i], found, [&](int idx) -> std::string {
+      if (!row[idx + 1])
+        return "";
+      return std::string(row[idx + 1], lengths[idx + 1]);
+    });
+    has_student[i] = found;
+  }
+  mysql_free_result(result);
+
+  std::vector<std::optional<std::string>> rows(people.size());
+  for (size_t i = 0; i < people.size(); ++i) {
+    if (has_student[i])
+      rows[i] = recs[i].encode();
+  }
+  return rows;
+}
+
+// 按学号查出成绩缓存键（name + id_card），学生不存在返回空串
+static std::string student_score_key(MYSQL *mysql, const std::string &sid) {
+  PreparedQuery query(mysql, StmtId::STUDENT_KEY);
+  query.arg(sid);
+  if (!query.execute() || !query.fetch() || query.is_null(0) ||
+      query.is_null(1))
+    return "";
+  return RedisCache::score_key(query.col(0), query.col(1));
+}
+
 // ── POST /api/student — 新增学生（root） ────────────────────────
 http_conn::HTTP_CODE http_conn::handle_insert() {
   std::string body(m_string ? m_string : "");
@@ -881,7 +1239,7 @@ http_conn::HTTP_CODE http_conn::handle_insert() {
     m_cgi_response = "{\"error\":\"name and id_card are required\"}";
     return CGI_REQUEST;
   }
-  // mysql_real_escape_string 最坏 2×+1 膨胀，校验各字段不超过缓冲区安全上限
+  // 各字段长度上限（同时限定审计详情的长度）
   if (name.size() > 127 || id_card.size() > 127 || gender.size() > 31 ||
       province.size() > 63 || school.size() > 127) {
     m_cgi_status = 400;
@@ -891,34 +1249,28 @@ http_conn::HTTP_CODE http_conn::handle_insert() {
 
   connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
 
-  char esc_name[256]{0}, esc_idcard[256]{0};
-  char esc_gender[64]{0}, esc_province[128]{0}, esc_school[256]{0};
-  mysql_real_escape_string(mysql, esc_name,     name.c_str(),     name.size());
-  mysql_real_escape_string(mysql, esc_idcard,   id_card.c_str(),  id_card.size());
-  mysql_real_escape_string(mysql, esc_gender,   gender.c_str(),   gender.size());
-  mysql_real_escape_string(mysql, esc_province, province.c_str(), province.size());
-  mysql_real_escape_string(mysql, esc_school,   school.c_str(),   school.size());
-
-  char sql[2048];
-  snprintf(sql, sizeof(sql),
-           "INSERT INTO student (name, id_card, gender, province, school) "
-           "VALUES ('%s','%s','%s','%s','%s')",
-           esc_name, esc_idcard, esc_gender, esc_province, esc_school);
-
-  if (mysql_query(mysql, sql)) {
+  PreparedQuery query(mysql, StmtId::STUDENT_INSERT);
+  query.arg(name).arg(id_card).arg(gender).arg(province).arg(school);
+
+  if (!query.execute()) {
     m_cgi_status = 500;
     m_cgi_response = "{\"error\":\"insert failed\"}";
     return CGI_REQUEST;
   }
 
-  long long new_id = mysql_insert_id(mysql);
+  long long new_id = static_cast<long long>(query.insert_id());
+  // 清掉此前查询留下的空值标记（Redis + 各节点 L1）
+  RedisCache::GetInstance()->del(RedisCache::score_key(name, id_card));
+  RedisCache::GetInstance()->bloom_sync(static_cast<uint64_t>(new_id));
 
   char audit_detail[1024];
   snprintf(audit_detail, sizeof(audit_detail),
-           "{\"student_id\":%lld,\"name\":\"%s\"}", new_id, esc_name);
+           "{\"student_id\":%lld,\"name\":\"%s\"}", new_id,
+           json_escape(name).c_str());
   char audit_target[64];
   snprintf(audit_target, sizeof(audit_target), "student#%lld", new_id);
-  write_audit_log("INSERT", audit_target, audit_detail);
+  if (!write_audit_log("INSERT", audit_target, audit_detail))
+    return audit_unavailable();
 
   m_cgi_status = 201;
   m_cgi_response = "{\"student_id\":" + std::to_string(new_id) +
@@ -949,7 +1301,7 @@ http_conn::HTTP_CODE http_conn::handle_update() {
     m_cgi_response = "{\"error\":\"at least one field to update is required\"}";
     return CGI_REQUEST;
   }
-  // mysql_real_escape_string 缓冲区安全上限检查
+  // 字段长度上限检查
   if (sid.size() > 15 || name.size() > 127 || id_card.size() > 127 ||
       gender.size() > 31 || province.size() > 63 || school.size() > 127) {
     m_cgi_status = 400;
@@ -959,52 +1311,57 @@ http_conn::HTTP_CODE http_conn::handle_update() {
 
   connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
 
-  // 动态拼接 SET 子句
+  // 审计详情中记录修改了哪些字段（语句固定，未提供的字段绑定 NULL 保持原值）
   std::string set_clause;
-  char buf[512];
-
-  auto append_field = [&](const char *col, const std::string &val) {
+  auto describe_field = [&](const char *col, const std::string &val) {
     if (val.empty()) return;
-    char esc[512]{0};
-    mysql_real_escape_string(mysql, esc, val.c_str(), val.size());
     if (!set_clause.empty()) set_clause += ", ";
-    snprintf(buf, sizeof(buf), "%s='%s'", col, esc);
-    set_clause += buf;
+    set_clause += std::string(col) + "='" + json_escape(val) + "'";
   };
 
-  append_field("name",     name);
-  append_field("id_card",  id_card);
-  append_field("gender",   gender);
-  append_field("province", province);
-  append_field("school",   school);
+  describe_field("name",     name);
+  describe_field("id_card",  id_card);
+  describe_field("gender",   gender);
+  describe_field("province", province);
+  describe_field("school",   school);
 
-  char esc_sid[32]{0};
-  mysql_real_escape_string(mysql, esc_sid, sid.c_str(), sid.size());
+  // 改名 / 改身份证号会换键，旧键与新键都要失效
+  std::string old_key = student_score_key(mysql, sid);
 
-  char sql[2048];
-  snprintf(sql, sizeof(sql),
-           "UPDATE student SET %s WHERE student_id='%s'",
-           set_clause.c_str(), esc_sid);
+  PreparedQuery query(mysql, StmtId::STUDENT_UPDATE);
+  query.arg_or_null(name).arg_or_null(id_card).arg_or_null(gender)
+      .arg_or_null(province).arg_or_null(school).arg(sid);
 
-  if (mysql_query(mysql, sql)) {
+  if (!query.execute()) {
     m_cgi_status = 500;
     m_cgi_response = "{\"error\":\"update failed\"}";
     return CGI_REQUEST;
   }
 
-  unsigned long affected = mysql_affected_rows(mysql);
+  unsigned long affected = static_cast<unsigned long>(query.affected_rows());
   if (affected == 0) {
     m_cgi_status = 404;
     m_cgi_response = "{\"error\":\"student not found\"}";
     return CGI_REQUEST;
   }
 
+  if (!old_key.empty())
+    RedisCache::GetInstance()->del(old_key);
+  std::string new_key = student_score_key(mysql, sid);
+  if (!new_key.empty() && new_key != old_key) {
+    RedisCache::GetInstance()->del(new_key);
+    RedisCache::GetInstance()->bloom_add(new_key);
+    if (!old_key.empty())
+      RedisCache::GetInstance()->bloom_remove(old_key); // 改名 / 改证件号
+  }
+
   char audit_target[64];
-  snprintf(audit_target, sizeof(audit_target), "student#%s", esc_sid);
+  snprintf(audit_target, sizeof(audit_target), "student#%s", sid.c_str());
   char audit_detail[1024];
   snprintf(audit_detail, sizeof(audit_detail),
            "{\"set\":\"%s\",\"affected\":%lu}", set_clause.c_str(), affected);
-  write_audit_log("UPDATE", audit_target, audit_detail);
+  if (!write_audit_log("UPDATE", audit_target, audit_detail))
+    return audit_unavailable();
 
   m_cgi_status = 200;
   m_cgi_response = "{\"message\":\"student updated\",\"affected\":" +
@@ -1022,7 +1379,7 @@ http_conn::HTTP_CODE http_conn::handle_delete() {
     m_cgi_response = "{\"error\":\"student_id is required\"}";
     return CGI_REQUEST;
   }
-  if (sid.size() > 15) {  // esc_sid[32] 安全上限 = (32-1)/2 ≈ 15
+  if (sid.size() > 15) {
     m_cgi_status = 400;
     m_cgi_response = "{\"error\":\"student_id too long\"}";
     return CGI_REQUEST;
@@ -1030,29 +1387,32 @@ http_conn::HTTP_CODE http_conn::handle_delete() {
 
   connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
 
-  char esc_sid[32]{0};
-  mysql_real_escape_string(mysql, esc_sid, sid.c_str(), sid.size());
+  std::string old_key = student_score_key(mysql, sid);
 
-  char sql[512];
-  snprintf(sql, sizeof(sql),
-           "DELETE FROM student WHERE student_id='%s'", esc_sid);
+  PreparedQuery query(mysql, StmtId::STUDENT_DELETE);
+  query.arg(sid);
 
-  if (mysql_query(mysql, sql)) {
+  if (!query.execute()) {
     m_cgi_status = 500;
     m_cgi_response = "{\"error\":\"delete failed\"}";
     return CGI_REQUEST;
   }
 
-  unsigned long affected = mysql_affected_rows(mysql);
+  unsigned long affected = static_cast<unsigned long>(query.affected_rows());
   if (affected == 0) {
     m_cgi_status = 404;
     m_cgi_response = "{\"error\":\"student not found\"}";
     return CGI_REQUEST;
   }
 
+  if (!old_key.empty()) {
+    RedisCache::GetInstance()->del(old_key);
+    RedisCache::GetInstance()->bloom_remove(old_key);
+  }
   char audit_target[64];
-  snprintf(audit_target, sizeof(audit_target), "student#%s", esc_sid);
-  write_audit_log("DELETE", audit_target, "{\"affected\":1}");
+  snprintf(audit_target, sizeof(audit_target), "student#%s", sid.c_str());
+  if (!write_audit_log("DELETE", audit_target, "{\"affected\":1}"))
+    return audit_unavailable();
 
   m_cgi_status = 200;
   m_cgi_response = "{\"message\":\"student deleted\",\"affected\":" +
@@ -1067,6 +1427,9 @@ void http_conn::unmap() {
   }
 }
 bool http_conn::write() {
+  if (m_h2)
+    return write_h2();
+
   if (bytes_to_send == 0) {
     modfd(m_epollfd, m_sockfd, EPOLLIN);
     init();
@@ -1078,7 +1441,8 @@ bool http_conn::write() {
   setsockopt(m_sockfd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
 
   while (1) {
-    int temp = writev(m_sockfd, m_iv, m_iv_count);
+    int temp = m_tls.active() ? m_tls.writev(m_iv, m_iv_count)
+                              : writev(m_sockfd, m_iv, m_iv_count);
 
     if (temp < 0) {
       if (errno == EAGAIN) {
@@ -1117,93 +1481,59 @@ bool http_conn::write() {
     }
   }
 }
-bool http_conn::add_response(const char *format, ...) {
-  if (m_write_idx >= WRITE_BUFFER_SIZE)
+// 响应头: 预渲染模板 memcpy + Content-Length itoa（见 http/response_header.h）
+bool http_conn::add_header_block(int status, ResponseHeader::Type type,
+                                 size_t content_length) {
+  int len = ResponseHeader::render(m_write_buf + m_write_idx,
+                                   WRITE_BUFFER_SIZE - 1 - m_write_idx, status,
+                                   type, content_length, m_linger);
+  if (len < 0)
     return false;
-  va_list arg_list;
-  va_start(arg_list, format);
-  int len = vsnprintf(m_write_buf + m_write_idx,
-                      WRITE_BUFFER_SIZE - 1 - m_write_idx, format, arg_list);
-  if (len >= (WRITE_BUFFER_SIZE - 1 - m_write_idx)) {
-    va_end(arg_list);
-    return false;
-  }
   m_write_idx += len;
-  va_end(arg_list);
-
   return true;
 }
-
-bool http_conn::add_status_line(int status, const char *title) {
-  return add_response("%s %d %s\r\n", "HTTP/1.1", status, title);
-}
-bool http_conn::add_headers(int content_len) {
-  return add_content_length(content_len) && add_linger() && add_blank_line();
-}
-bool http_conn::add_content_length(int content_len) {
-  return add_response("Content-Length:%d\r\n", content_len);
-}
-bool http_conn::add_content_type() {
-  return add_response("Content-Type:%s\r\n", "text/html");
-}
-bool http_conn::add_linger() {
-  return add_response("Connection:%s\r\n",
-                      (m_linger == true) ? "keep-alive" : "close");
-}
-bool http_conn::add_blank_line() { return add_response("%s", "\r\n"); }
-bool http_conn::add_content(const char *content) {
-  return add_response("%s", content);
+bool http_conn::add_content(const char *content, size_t len) {
+  if (len > static_cast<size_t>(WRITE_BUFFER_SIZE - 1 - m_write_idx))
+    return false;
+  memcpy(m_write_buf + m_write_idx, content, len);
+  m_write_idx += len;
+  return true;
 }
 bool http_conn::process_write(HTTP_CODE ret) {
   switch (ret) {
   case CGI_REQUEST: {
-    const char *title = ok_200_title;
-    if (m_cgi_status == 400)
-      title = error_400_title;
-    else if (m_cgi_status == 403)
-      title = error_403_title;
-    else if (m_cgi_status == 404)
-      title = error_404_title;
-    else if (m_cgi_status == 429)
-      title = error_429_title;
-    else if (m_cgi_status == 500)
-      title = error_500_title;
-
     if (m_cgi_response.empty())
       m_cgi_response = "{}";
 
-    add_status_line(m_cgi_status, title);
-    add_response("Content-Type:%s\r\n", "application/json");
-    add_headers(m_cgi_response.size());
-    if (!add_content(m_cgi_response.c_str()))
+    if (!add_header_block(m_cgi_status, ResponseHeader::Type::JSON,
+                          m_cgi_response.size()) ||
+        !add_content(m_cgi_response.data(), m_cgi_response.size()))
       return false;
     break;
   }
   case INTERNAL_ERROR: {
-    add_status_line(500, error_500_title);
-    add_headers(strlen(error_500_form));
-    if (!add_content(error_500_form))
+    if (!add_header_block(500, ResponseHeader::Type::HTML, ERROR_500_FORM_LEN) ||
+        !add_content(error_500_form, ERROR_500_FORM_LEN))
       return false;
     break;
   }
   case BAD_REQUEST: {
-    add_status_line(404, error_404_title);
-    add_headers(strlen(error_404_form));
-    if (!add_content(error_404_form))
+    if (!add_header_block(404, ResponseHeader::Type::HTML, ERROR_404_FORM_LEN) ||
+        !add_content(error_404_form, ERROR_404_FORM_LEN))
       return false;
     break;
   }
   case FORBIDDEN_REQUEST: {
-    add_status_line(403, error_403_title);
-    add_headers(strlen(error_403_form));
-    if (!add_content(error_403_form))
+    if (!add_header_block(403, ResponseHeader::Type::HTML, ERROR_403_FORM_LEN) ||
+        !add_content(error_403_form, ERROR_403_FORM_LEN))
       return false;
     break;
   }
   case FILE_REQUEST: {
-    add_status_line(200, ok_200_title);
     if (m_file_stat.st_size != 0) {
-      add_headers(m_file_stat.st_size);
+      if (!add_header_block(200, ResponseHeader::type_for_path(m_real_file),
+                            m_file_stat.st_size))
+        return false;
       m_iv[0].iov_base = m_write_buf;
       m_iv[0].iov_len = m_write_idx;
       m_iv[1].iov_base = m_file_address;
@@ -1212,16 +1542,17 @@ bool http_conn::process_write(HTTP_CODE ret) {
       bytes_to_send = m_write_idx + m_file_stat.st_size;
       return true;
     } else {
-      const char *ok_string = "<html><body></body></html>";
-      add_headers(strlen(ok_string));
-      if (!add_content(ok_string))
+      static const char ok_string[] = "<html><body></body></html>";
+      if (!add_header_block(200, ResponseHeader::Type::HTML,
+                            sizeof(ok_string) - 1) ||
+          !add_content(ok_string, sizeof(ok_string) - 1))
         return false;
     }
+    break;
   }
   case NO_RESOURCE: {
-    add_status_line(404, error_404_title);
-    add_headers(strlen(error_404_form));
-    if (!add_content(error_404_form))
+    if (!add_header_block(404, ResponseHeader::Type::HTML, ERROR_404_FORM_LEN) ||
+        !add_content(error_404_form, ERROR_404_FORM_LEN))
       return false;
     break;
   }
@@ -1234,13 +1565,215 @@ bool http_conn::process_write(HTTP_CODE ret) {
   bytes_to_send = m_write_idx;
   return true;
 }
+// ── HTTP/2 (h2c) ─────────────────────────────────────────────────
+
+// HTTP/1.1 → h2c 升级: 回 101 + 服务端 SETTINGS，原请求的响应作为 stream 1
+// HTTP2-Settings 缺失或非法时返回 false，按 HTTP/1.1 正常响应
+bool http_conn::upgrade_h2(HTTP_CODE ret) {
+  auto h2 = std::make_unique<H2Session>();
+  if (m_h2_settings.empty() || !h2->apply_upgrade_settings(m_h2_settings))
+    return false;
+
+  // 原请求之后已到达的字节（通常是客户端连接前言）
+  long consumed = m_checked_idx;
+  if (m_check_state == CHECK_STATE_CONTENT)
+    consumed += m_content_length;
+  std::string rest;
+  if (m_read_idx > consumed)
+    rest.assign(m_read_buf + consumed, m_read_idx - consumed);
+
+  static const char switching[] = "HTTP/1.1 101 Switching Protocols\r\n"
+                                  "Connection: Upgrade\r\n"
+                                  "Upgrade: h2c\r\n\r\n";
+  h2->append_raw(switching);
+  h2->start(true);
+  m_h2 = std::move(h2);
+  respond_h2(1, ret);
+  process_h2(rest.data(), rest.size());
+  return true;
+}
+
+// 喂入新数据，依次处理所有已完整接收的流，再注册写事件
+void http_conn::process_h2(const char *data, size_t len) {
+  bool ok = m_h2->feed(data, len);
+  m_read_idx = 0; // 数据已移交会话，腾出读缓冲区
+  // OpenSSL 内部已解密的剩余数据不会再触发 EPOLLIN，在此取尽
+  while (ok && m_tls.pending() > 0 && read_once()) {
+    ok = m_h2->feed(m_read_buf, m_read_idx);
+    m_read_idx = 0;
+  }
+
+  H2Session::Request req;
+  while (ok && m_h2->next_request(req))
+    serve_h2(req);
+
+  if (!m_h2->output().empty())
+    modfd(m_epollfd, m_sockfd, EPOLLOUT);
+  else
+    modfd(m_epollfd, m_sockfd, EPOLLIN);
+}
+
+// 将一个 HTTP/2 流映射为单次请求状态，复用 do_request() 的路由与处理
+void http_conn::serve_h2(H2Session::Request &req) {
+  init();
+
+  if (req.method == "GET") {
+    m_method = GET;
+  } else if (req.method == "POST") {
+    m_method = POST;
+    cgi = 1;
+  } else if (req.method == "PUT") {
+    m_method = PUT;
+    cgi = 1;
+  } else if (req.method == "DELETE") {
+    m_method = DELETE;
+    cgi = 1;
+  } else {
+    m_h2->submit_response(req.stream_id, 405, "application/json",
+                          "{\"error\":\"method not allowed\"}");
+    return;
+  }
+
+  // m_url 指向读缓冲区（do_request 可能就地修改），预留 "index.html" 的空间
+  if (req.path[0] != '/' || req.path.size() + 11 > READ_BUFFER_SIZE) {
+    m_h2->submit_response(req.stream_id, 400, "application/json",
+                          "{\"error\":\"bad path\"}");
+    return;
+  }
+  memcpy(m_read_buf, req.path.c_str(), req.path.size() + 1);
+  m_url = m_read_buf;
+  if (strcmp(m_url, "/") == 0)
+    strcat(m_url, "index.html");
+
+  if (strncasecmp(req.authorization.c_str(), "Bearer ", 7) == 0)
+    m_auth_token = req.authorization.substr(7);
+  m_string = req.body.data();
+  m_content_length = req.body.size();
+
+  respond_h2(req.stream_id, do_request());
+}
+
+void http_conn::respond_h2(uint32_t stream_id, HTTP_CODE ret) {
+  switch (ret) {
+  case CGI_REQUEST:
+    if (m_cgi_response.empty())
+      m_cgi_response = "{}";
+    m_h2->submit_response(stream_id, m_cgi_status, "application/json",
+                          std::move(m_cgi_response));
+    break;
+  case FILE_REQUEST: {
+    std::string body;
+    if (m_file_stat.st_size != 0)
+      body.assign(m_file_address, m_file_stat.st_size);
+    else
+      body = "<html><body></body></html>";
+    unmap();
+    const char *type =
+        m_file_stat.st_size != 0
+            ? ResponseHeader::type_name(ResponseHeader::type_for_path(m_real_file))
+            : "text/html";
+    m_h2->submit_response(stream_id, 200, type, std::move(body));
+    break;
+  }
+  case FORBIDDEN_REQUEST:
+    m_h2->submit_response(stream_id, 403, "text/html",
+                          std::string(error_403_form, ERROR_403_FORM_LEN));
+    break;
+  case INTERNAL_ERROR:
+    m_h2->submit_response(stream_id, 500, "text/html",
+                          std::string(error_500_form, ERROR_500_FORM_LEN));
+    break;
+  default:
+    m_h2->submit_response(stream_id, 404, "text/html",
+                          std::string(error_404_form, ERROR_404_FORM_LEN));
+    break;
+  }
+}
+
+// 主线程调用: 推进 TLS 握手，等待 I/O 时按方向重新注册事件；失败返回 false
+bool http_conn::tls_handshake() {
+  switch (m_tls.handshake()) {
+  case TlsConn::Io::DONE:
+  case TlsConn::Io::WANT_READ:
+    modfd(m_epollfd, m_sockfd, EPOLLIN);
+    return true;
+  case TlsConn::Io::WANT_WRITE:
+    modfd(m_epollfd, m_sockfd, EPOLLOUT);
+    return true;
+  default:
+    return false;
+  }
+}
+
+// 主线程调用: 发送会话输出缓冲区，GOAWAY 发完后关闭连接
+bool http_conn::write_h2() {
+  while (!m_h2->output().empty()) {
+    const std::string &out = m_h2->output();
+    ssize_t n = m_tls.active() ? m_tls.send(out.data(), out.size())
+                               : send(m_sockfd, out.data(), out.size(), 0);
+    if (n < 0) {
+      if (errno == EAGAIN) {
+        modfd(m_epollfd, m_sockfd, EPOLLOUT);
+        return true;
+      }
+      return false;
+    }
+    m_h2->consume_output(n);
+  }
+  if (m_h2->closing())
+    return false;
+  modfd(m_epollfd, m_sockfd, EPOLLIN);
+  return true;
+}
+
 void http_conn::process() {
+  // ── 异步成绩查询的回复已到达，继续完成请求 ───────────────────
+  if (m_async_state == AsyncState::READY) {
+    m_async_state = AsyncState::IDLE;
+    RedisCache::AsyncResult res = std::move(m_async_result);
+    complete_request(finish_score_query(res));
+    return;
+  }
+
+  // ── h2c prior knowledge: 连接以 HTTP/2 前言开头 ──────────────
+  if (!m_h2 && m_check_state == CHECK_STATE_REQUESTLINE && m_read_idx > 0) {
+    size_t n = std::min<size_t>(m_read_idx, H2Session::PREFACE_LEN);
+    if (memcmp(m_read_buf, H2Session::PREFACE, n) == 0) {
+      if (n < H2Session::PREFACE_LEN) { // 前言不完整，继续读
+        modfd(m_epollfd, m_sockfd, EPOLLIN);
+        return;
+      }
+      m_h2 = std::make_unique<H2Session>();
+      m_h2->start(false);
+    }
+  }
+  if (m_h2) {
+    process_h2(m_read_buf, m_read_idx);
+    return;
+  }
+
   HTTP_CODE read_ret = process_read();
   if (read_ret == NO_REQUEST) {
     modfd(m_epollfd, m_sockfd, EPOLLIN);
     return;
   }
-  bool write_ret = process_write(read_ret);
+  // 异步查询在途: 回调可能已把连接交给其他 worker，不能再访问成员
+  if (read_ret == ASYNC_REQUEST)
+    return;
+  // ── Upgrade: h2c ─────────────────────────────────────────────
+  // h2c 升级仅用于明文连接，TLS 上的 HTTP/2 由 ALPN 协商
+  if (m_h2_upgrade && !m_tls.active() && read_ret != BAD_REQUEST &&
+      upgrade_h2(read_ret))
+    return;
+
+  complete_request(read_ret);
+}
+
+void http_conn::complete_request(HTTP_CODE ret) {
+  // 异步查询在途: 不注册任何事件，回调到达后重新投递到线程池
+  if (ret == ASYNC_REQUEST)
+    return;
+  bool write_ret = process_write(ret);
   if (!write_ret) {
     close_conn();
   }
@@ -4,6 +4,8 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <netinet/in.h>
 #include <signal.h>
@@ -23,7 +25,11 @@
 #include <unistd.h>
 
 #include "../mysql/mysql_pool.h"
+#include "../redis/redis_cache.h"
 #include "../timer/lst_timer.h"
+#include "h2_session.h"
+#include "response_header.h"
+#include "tls_conn.h"
 
 // 面向应用层，处理每个客户端的HTTP连接，包括解析HTTP请求、生成HTTP响应、管理连接状态等。
 class http_conn {
@@ -62,7 +68,8 @@ public:
     FILE_REQUEST,
     CGI_REQUEST,
     INTERNAL_ERROR,
-    CLOSED_CONNECTION
+    CLOSED_CONNECTION,
+    ASYNC_REQUEST // 等待异步 Redis 回复，回调到达后重新投递到线程池
   };
 
   enum LINE_STATUS { LINE_OK = 0, LINE_BAD, LINE_OPEN };
@@ -91,6 +98,11 @@ public:
   void process();
   bool read_once();
   bool write();
+  // TLS 握手阶段由主线程非阻塞推进，完成前不投递到线程池
+  bool tls_handshaking() const { return m_tls.active() && !m_tls.established(); }
+  bool tls_handshake();
+  // 连接槽代数: 关闭 / 复用时递增，事件循环据此识别已关闭的连接
+  uint32_t conn_gen() const { return m_conn_gen; }
   sockaddr_in *get_address() { return &m_address; }
   std::string get_client_ip() const {
     char buf[INET_ADDRSTRLEN];
@@ -102,6 +114,8 @@ public:
   static int m_user_count; // Make m_user_count public
   static int m_epollfd;    // Make m_epollfd public
   static bool s_auth_enabled; // 认证开关（false = 仅允许 SELECT）
+  // 异步查询完成后重新投递连接（事件循环线程调用），未设置时走同步路径
+  static std::function<void(http_conn *)> s_async_resume;
 
   MYSQL *mysql; // Make mysql public
 
@@ -116,24 +130,45 @@ private:
   HTTP_CODE do_request();
   HTTP_CODE handle_register();
   HTTP_CODE handle_login();
+  HTTP_CODE handle_score_query();
+  // 熔断 / 查询失败时返回 unavailable，缓存层不会把它当作"不存在"缓存
+  static RedisCache::DbResult load_score(const std::string &name,
+                                         const std::string &id_card);
+  // 按值捕获查询条件: 缓存层可能在后台线程刷新时调用
+  RedisCache::DbQuery score_loader() const;
+  HTTP_CODE score_response(std::optional<std::string> value);
+  HTTP_CODE score_unavailable();
+  RedisCache::AsyncDone async_done();
+  HTTP_CODE lookup_score_async(int delay_ms);
+  HTTP_CODE finish_score_query(RedisCache::AsyncResult &res);
+  HTTP_CODE load_score_async(RedisCache::PendingLoad load);
+  HTTP_CODE handle_score_batch();
+  // 一次 IN 查询取回多名考生的成绩记录，结果与入参等长（查无为 nullopt）；
+  // 熔断或查询失败返回空 vector
+  static std::vector<std::optional<std::string>>
+  load_scores(const std::vector<std::pair<std::string, std::string>> &people);
+  void complete_request(HTTP_CODE ret);
   HTTP_CODE handle_insert();
   HTTP_CODE handle_update();
   HTTP_CODE handle_delete();
   bool verify_token();
   bool require_role(const char *required);
-  void write_audit_log(const char *operation, const char *target,
+  // durable 模式下未确认落盘时返回 false（调用方回 503）；否则尽力而为，总返回 true
+  bool write_audit_log(const char *operation, const char *target,
                        const char *detail);
+  HTTP_CODE audit_unavailable();
   char *get_line() { return m_read_buf + m_start_line; };
   LINE_STATUS parse_line();
   void unmap();
-  bool add_response(const char *format, ...);
-  bool add_content(const char *content);
-  bool add_status_line(int status, const char *title);
-  bool add_headers(int content_length);
-  bool add_content_type();
-  bool add_content_length(int content_length);
-  bool add_linger();
-  bool add_blank_line();
+  bool add_header_block(int status, ResponseHeader::Type type,
+                        size_t content_length);
+  bool add_content(const char *content, size_t len);
+  // HTTP/2 (h2c)
+  bool upgrade_h2(HTTP_CODE ret);
+  void process_h2(const char *data, size_t len);
+  void serve_h2(H2Session::Request &req);
+  void respond_h2(uint32_t stream_id, HTTP_CODE ret);
+  bool write_h2();
 
 private:
   // Private Members
@@ -157,6 +192,9 @@ private:
   char *m_host;
   long m_content_length;
   bool m_linger;
+  bool m_http11;          // HTTP/1.1（否则为 HTTP/1.0）
+  bool m_conn_close;      // Connection 头含 close
+  bool m_conn_keep_alive; // Connection 头含 keep-alive
 
   char *m_file_address;
   struct stat m_file_stat;
@@ -175,6 +213,24 @@ private:
   std::string m_username;   // 从令牌解析的用户名
   int m_user_id = 0;        // 令牌中的用户 ID
 
+  // HTTP/2: 升级或 prior knowledge 后创建，连接关闭前一直复用
+  std::unique_ptr<H2Session> m_h2;
+  bool m_h2_upgrade;         // 请求携带 Upgrade: h2c
+  std::string m_h2_settings; // HTTP2-Settings 头（base64url）
+
+  // TLS（-c/-k 指定证书时启用），握手后尽量走 kTLS
+  TlsConn m_tls;
+
+  // 异步成绩查询: PENDING 期间连接不属于任何 worker，
+  // 回调在事件循环线程写入结果并置 READY 后重新投递
+  enum class AsyncState : uint8_t { IDLE, PENDING, READY };
+  std::atomic<AsyncState> m_async_state{AsyncState::IDLE};
+  RedisCache::AsyncResult m_async_result;
+  int m_async_retries = 0;   // 重建锁竞争时的异步重试次数
+  std::atomic<uint32_t> m_conn_gen{0}; // 每次关闭 / 复用连接槽递增，丢弃过期回调
+  std::string m_score_name;
+  std::string m_score_idcard;
+
   char sql_user[100];
   char sql_passwd[100];
   char sql_name[100];
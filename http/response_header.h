@@ -0,0 +1,258 @@
+#ifndef HTTP_RESPONSE_HEADER_H
+#define HTTP_RESPONSE_HEADER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <strings.h>
+#include <ctime>
+#include <string>
+
+// 预渲染响应头模板 + 每秒刷新的 Date 缓存
+//
+// 常用状态行与 Content-Type 在首次使用时拼好，之后每个响应头只需:
+//   memcpy(模板头) + memcpy(Date) + 一次 itoa(Content-Length) + memcpy(Connection 尾部)
+// 取代 add_response() 多次 vsnprintf + va_list 的逐行格式化。
+//
+// 输出格式:
+//   HTTP/1.1 <status> <title>\r\n
+//   Content-Type:<type>\r\n
+//   Date: <IMF-fixdate>\r\n
+//   Content-Length:<n>\r\n
+//   Connection:keep-alive|close\r\n
+//   \r\n
+//
+// Date 由 reactor（主线程 eventLoop）调用 refresh_date() 每秒更新一次，
+// worker 线程通过 seqlock 无锁读取，字节存放在 atomic 字中，无数据竞争。
+class ResponseHeader {
+public:
+  // 静态文件按扩展名取类型（见 type_for_path）
+  enum class Type : uint8_t {
+    JSON = 0,
+    HTML,
+    CSS,
+    JS,
+    PNG,
+    JPEG,
+    GIF,
+    SVG,
+    ICO,
+    TEXT,
+    OCTET, // 未知扩展名
+    TYPE_COUNT
+  };
+
+  static const char *type_name(Type type) {
+    static const char *NAME[] = {
+        "application/json",         "text/html",
+        "text/css",                 "application/javascript",
+        "image/png",                "image/jpeg",
+        "image/gif",                "image/svg+xml",
+        "image/x-icon",             "text/plain",
+        "application/octet-stream"};
+    static_assert(sizeof(NAME) / sizeof(NAME[0]) == (size_t)Type::TYPE_COUNT);
+    return NAME[(int)type];
+  }
+
+  // 按扩展名（不区分大小写）判断静态文件的 Content-Type
+  static Type type_for_path(const char *path) {
+    const char *dot = strrchr(path, '.');
+    const char *slash = strrchr(path, '/');
+    if (!dot || (slash && dot < slash))
+      return Type::OCTET;
+    static const struct {
+      const char *ext;
+      Type type;
+    } EXT[] = {{"html", Type::HTML}, {"htm", Type::HTML}, {"css", Type::CSS},
+               {"js", Type::JS},     {"png", Type::PNG},  {"jpg", Type::JPEG},
+               {"jpeg", Type::JPEG}, {"gif", Type::GIF},  {"svg", Type::SVG},
+               {"ico", Type::ICO},   {"txt", Type::TEXT}, {"json", Type::JSON}};
+    for (const auto &e : EXT)
+      if (strcasecmp(dot + 1, e.ext) == 0)
+        return e.type;
+    return Type::OCTET;
+  }
+
+  static constexpr size_t DATE_LEN = 29; // "Sun, 06 Nov 1994 08:49:37 GMT"
+
+  // 将完整响应头写入 buf，返回写入字节数；空间不足返回 -1
+  static int render(char *buf, size_t cap, int status, Type type,
+                    size_t content_length, bool keep_alive) {
+    const std::string &head = templates().head[slot(status)][(int)type];
+    static constexpr char CL[] = "\r\nContent-Length:";
+    static constexpr char KEEP[] = "\r\nConnection:keep-alive\r\n\r\n";
+    static constexpr char CLOSE[] = "\r\nConnection:close\r\n\r\n";
+    const char *tail = keep_alive ? KEEP : CLOSE;
+    size_t tail_len = keep_alive ? sizeof(KEEP) - 1 : sizeof(CLOSE) - 1;
+
+    char num[24];
+    size_t num_len = u64_to_ascii(num, content_length);
+
+    size_t total = head.size() + DATE_LEN + (sizeof(CL) - 1) + num_len + tail_len;
+    if (total > cap)
+      return -1;
+
+    char *p = buf;
+    memcpy(p, head.data(), head.size());
+    p += head.size();
+    load_date(p);
+    p += DATE_LEN;
+    memcpy(p, CL, sizeof(CL) - 1);
+    p += sizeof(CL) - 1;
+    memcpy(p, num, num_len);
+    p += num_len;
+    memcpy(p, tail, tail_len);
+    return static_cast<int>(total);
+  }
+
+  // reactor 调用: 秒数变化时重新生成 Date，同一秒内重复调用只有一次 time() 开销
+  // 仅允许主线程调用（seqlock 单写者）；eventListen() 中先调用一次完成初始化
+  static void refresh_date() {
+    time_t now = time(nullptr);
+    if (now == s_date_sec.load(std::memory_order_relaxed))
+      return;
+
+    char buf[DATE_WORDS * 8] = {0};
+    format_imf_date(now, buf);
+
+    // seqlock 写端: 奇数表示写入中
+    uint32_t seq = s_date_seq.load(std::memory_order_relaxed);
+    s_date_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < DATE_WORDS; ++i) {
+      uint64_t w;
+      memcpy(&w, buf + i * 8, 8);
+      s_date_words[i].store(w, std::memory_order_relaxed);
+    }
+    s_date_seq.store(seq + 2, std::memory_order_release);
+    s_date_sec.store(now, std::memory_order_relaxed);
+  }
+
+  // 整数转十进制 ASCII（两位一组查表），返回写入长度，out 至少 20 字节
+  static size_t u64_to_ascii(char *out, uint64_t v) {
+    static constexpr char DIGITS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char tmp[20];
+    char *p = tmp + sizeof(tmp);
+    while (v >= 100) {
+      unsigned idx = static_cast<unsigned>(v % 100) * 2;
+      v /= 100;
+      *--p = DIGITS[idx + 1];
+      *--p = DIGITS[idx];
+    }
+    if (v >= 10) {
+      unsigned idx = static_cast<unsigned>(v) * 2;
+      *--p = DIGITS[idx + 1];
+      *--p = DIGITS[idx];
+    } else {
+      *--p = static_cast<char>('0' + v);
+    }
+    size_t len = tmp + sizeof(tmp) - p;
+    memcpy(out, p, len);
+    return len;
+  }
+
+  // 读取当前 Date（seqlock 读端），out 至少 DATE_LEN 字节；HTTP/2 响应头亦复用
+  static void load_date(char *out) {
+    char buf[DATE_WORDS * 8];
+    uint32_t before, after;
+    do {
+      before = s_date_seq.load(std::memory_order_acquire);
+      for (size_t i = 0; i < DATE_WORDS; ++i) {
+        uint64_t w = s_date_words[i].load(std::memory_order_relaxed);
+        memcpy(buf + i * 8, &w, 8);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = s_date_seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    memcpy(out, buf, DATE_LEN);
+  }
+
+  static const char *status_title(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 429: return "Too Many Requests";
+    case 503: return "Service Unavailable";
+    default:  return "Internal Error";
+    }
+  }
+
+private:
+  static constexpr int STATUSES[] = {200, 201, 400, 401, 403,
+                                     404, 405, 409, 429, 503, 500};
+  static constexpr size_t STATUS_COUNT = sizeof(STATUSES) / sizeof(STATUSES[0]);
+  static constexpr size_t DATE_WORDS = (DATE_LEN + 7) / 8;
+
+  struct Templates {
+    std::string head[STATUS_COUNT][(int)Type::TYPE_COUNT];
+  };
+
+  // 未列出的状态码按 500 处理
+  static size_t slot(int status) {
+    for (size_t i = 0; i < STATUS_COUNT; ++i)
+      if (STATUSES[i] == status)
+        return i;
+    return STATUS_COUNT - 1;
+  }
+
+  static const Templates &templates() {
+    static const Templates t = [] {
+      Templates t;
+      for (size_t i = 0; i < STATUS_COUNT; ++i) {
+        for (int ty = 0; ty < (int)Type::TYPE_COUNT; ++ty) {
+          t.head[i][ty] = "HTTP/1.1 " + std::to_string(STATUSES[i]) + " " +
+                          status_title(STATUSES[i]) + "\r\nContent-Type:" +
+                          type_name(static_cast<Type>(ty)) + "\r\nDate: ";
+        }
+      }
+      return t;
+    }();
+    return t;
+  }
+
+  // RFC 7231 IMF-fixdate，不依赖 locale
+  static void format_imf_date(time_t t, char *out) {
+    static const char *WDAY[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    static const char *MON[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    auto two = [](char *p, int v) {
+      p[0] = static_cast<char>('0' + v / 10);
+      p[1] = static_cast<char>('0' + v % 10);
+    };
+    memcpy(out, WDAY[tm.tm_wday], 3);
+    out[3] = ',';
+    out[4] = ' ';
+    two(out + 5, tm.tm_mday);
+    out[7] = ' ';
+    memcpy(out + 8, MON[tm.tm_mon], 3);
+    out[11] = ' ';
+    int year = tm.tm_year + 1900;
+    two(out + 12, year / 100);
+    two(out + 14, year % 100);
+    out[16] = ' ';
+    two(out + 17, tm.tm_hour);
+    out[19] = ':';
+    two(out + 20, tm.tm_min);
+    out[22] = ':';
+    two(out + 23, tm.tm_sec);
+    memcpy(out + 25, " GMT", 4);
+  }
+
+  static inline std::atomic<uint32_t> s_date_seq{0};
+  static inline std::atomic<time_t> s_date_sec{0};
+  static inline std::atomic<uint64_t> s_date_words[DATE_WORDS];
+};
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef HTTP_ROUTER_H
+#define HTTP_ROUTER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// 路由表 —— 编译期构建，一次查找同时得到 handler 与限流分类
+//
+// 取代 do_request() 中逐个 strncmp 的 if 链:
+//   - ROUTES 为 constexpr 数组，新增接口只需加一行
+//   - 编译期将各路径的 FNV-1a 哈希放入开放寻址槽表（2 的幂大小，线性探测）
+//   - 查找时对 URL 单遍扫描并滚动计算哈希: 每遇到 '/' 探测一次前缀路由，
+//     扫描结束探测一次精确路由，总复杂度 O(路径长度)
+//   - 槽位命中后再 memcmp 确认，哈希冲突不影响正确性
+//
+// 匹配规则: 精确路由优先于前缀路由，前缀路由取最长者；'?' 之后的查询串不参与匹配。
+// path 命中但方法不在 methods 中时，handler 退化为 STATIC_FILE（与旧逻辑一致），
+// 限流分类和 auth_module 标记仍按该路由生效。
+class Router {
+public:
+  enum class Handler : uint8_t {
+    STATIC_FILE = 0, // 静态文件（兜底）
+    REGISTER,        // POST /auth/register
+    LOGIN,           // POST /auth/login
+    STUDENT_API,     // POST/PUT/DELETE /api/*
+    SCORE_QUERY,     // POST /4
+    SCORE_BATCH      // POST /4/batch
+  };
+
+  // 对应 RateLimiter 的 endpoint 分类
+  enum class RateClass : uint8_t { GLOBAL = 0, REGISTER, LOGIN, API };
+
+  // 方法位掩码: 第 i 位对应 http_conn::METHOD 的第 i 个枚举值
+  static constexpr uint8_t M_GET = 1u << 0;
+  static constexpr uint8_t M_POST = 1u << 1;
+  static constexpr uint8_t M_HEAD = 1u << 2;
+  static constexpr uint8_t M_PUT = 1u << 3;
+  static constexpr uint8_t M_DELETE = 1u << 4;
+
+  struct Route {
+    std::string_view path;
+    bool prefix;      // true: 以 path 开头即命中（path 须以 '/' 结尾）
+    uint8_t methods;  // 允许的方法掩码
+    Handler handler;
+    RateClass rate;
+    bool auth_module; // 属于认证/CRUD 模块，认证关闭（-a 0）时整体禁用
+  };
+
+  struct Match {
+    Handler handler = Handler::STATIC_FILE;
+    RateClass rate = RateClass::GLOBAL;
+    bool auth_module = false;
+  };
+
+  // ── 路由表 ─────────────────────────────────────────────────────
+  static constexpr Route ROUTES[] = {
+      {"/auth/",         true,  0,                       Handler::STATIC_FILE, RateClass::GLOBAL,   true},
+      {"/auth/register", false, M_POST,                  Handler::REGISTER,    RateClass::REGISTER, true},
+      {"/auth/login",    false, M_POST,                  Handler::LOGIN,       RateClass::LOGIN,    true},
+      {"/api/",          true,  M_POST | M_PUT | M_DELETE, Handler::STUDENT_API, RateClass::API,    true},
+      {"/4",             false, M_POST,                  Handler::SCORE_QUERY, RateClass::GLOBAL,   false},
+      {"/4/batch",       false, M_POST,                  Handler::SCORE_BATCH, RateClass::GLOBAL,   false},
+  };
+
+  // method: http_conn::METHOD 枚举值
+  static Match lookup(const char *url, int method) {
+    uint64_t h = FNV_OFFSET;
+    int best_prefix = -1;
+    size_t len = 0;
+    for (; url[len] != '\0' && url[len] != '?'; ++len) {
+      h = (h ^ static_cast<unsigned char>(url[len])) * FNV_PRIME;
+      if (url[len] == '/') {
+        int r = probe(h, url, len + 1, true);
+        if (r >= 0)
+          best_prefix = r;
+      }
+    }
+    int r = probe(h, url, len, false);
+    if (r < 0)
+      r = best_prefix;
+
+    Match m;
+    if (r < 0)
+      return m;
+    const Route &route = ROUTES[r];
+    if (route.methods & (1u << method))
+      m.handler = route.handler;
+    m.rate = route.rate;
+    m.auth_module = route.auth_module;
+    return m;
+  }
+
+  static const char *rate_class_name(RateClass rc) {
+    switch (rc) {
+    case RateClass::REGISTER: return "register";
+    case RateClass::LOGIN:    return "login";
+    case RateClass::API:      return "api";
+    default:                  return "global";
+    }
+  }
+
+  // 路由表自检（类外 static_assert）
+  static constexpr bool routes_valid() {
+    for (const Route &route : ROUTES) {
+      if (route.path.empty() || route.path.front() != '/')
+        return false;
+      if (route.prefix && route.path.back() != '/')
+        return false;
+    }
+    return true;
+  }
+
+private:
+  static constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+  static constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+  static constexpr size_t ROUTE_COUNT = sizeof(ROUTES) / sizeof(ROUTES[0]);
+  static constexpr size_t SLOT_COUNT = 16; // 2 的幂，至少为路由数的 2 倍
+  static_assert(SLOT_COUNT >= 2 * ROUTE_COUNT, "route slot table too small");
+
+  static constexpr uint64_t fnv1a(std::string_view s) {
+    uint64_t h = FNV_OFFSET;
+    for (char c : s)
+      h = (h ^ static_cast<unsigned char>(c)) * FNV_PRIME;
+    return h;
+  }
+
+  static constexpr std::array<int8_t, SLOT_COUNT> build_slots() {
+    std::array<int8_t, SLOT_COUNT> slots{};
+    for (auto &s : slots)
+      s = -1;
+    for (size_t r = 0; r < ROUTE_COUNT; ++r) {
+      size_t s = fnv1a(ROUTES[r].path) & (SLOT_COUNT - 1);
+      while (slots[s] != -1)
+        s = (s + 1) & (SLOT_COUNT - 1);
+      slots[s] = static_cast<int8_t>(r);
+    }
+    return slots;
+  }
+
+  // 槽表: 槽位存路由下标，-1 为空（类外以 constexpr 定义）
+  static const std::array<int8_t, SLOT_COUNT> SLOTS;
+
+  // 在槽表中查找 (hash, url[0, len), prefix) 对应的路由下标，未命中返回 -1
+  static int probe(uint64_t h, const char *url, size_t len, bool prefix) {
+    size_t s = h & (SLOT_COUNT - 1);
+    while (SLOTS[s] != -1) {
+      const Route &route = ROUTES[SLOTS[s]];
+      if (route.prefix == prefix && route.path.size() == len &&
+          memcmp(route.path.data(), url, len) == 0)
+        return SLOTS[s];
+      s = (s + 1) & (SLOT_COUNT - 1);
+    }
+    return -1;
+  }
+};
+
+inline constexpr std::array<int8_t, Router::SLOT_COUNT> Router::SLOTS =
+    Router::build_slots();
+
+static_assert(Router::routes_valid(),
+              "route paths must start with '/', prefix routes must end with '/'");
+
+#endif
@@ -0,0 +1,153 @@
+#include "tls_conn.h"
+#include "../log/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+
+// ALPN: 客户端提供 h2 时优先协商 HTTP/2（连接前言由 http_conn 识别）
+static int select_alpn(SSL *, const unsigned char **out, unsigned char *outlen,
+                       const unsigned char *in, unsigned int inlen, void *) {
+  static const unsigned char protos[] = "\x02h2\x08http/1.1";
+  unsigned char *sel = nullptr;
+  if (SSL_select_next_proto(&sel, outlen, protos, sizeof(protos) - 1, in,
+                            inlen) != OPENSSL_NPN_NEGOTIATED)
+    return SSL_TLSEXT_ERR_NOACK;
+  *out = sel;
+  return SSL_TLSEXT_ERR_OK;
+}
+
+bool TlsConn::init_context(const std::string &cert_file,
+                           const std::string &key_file) {
+  SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+  if (!ctx)
+    return false;
+
+  SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+  SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION);
+  // 部分写 + 重试时允许缓冲区地址变化（writev 循环会重算 iovec）；
+  // 空闲连接释放读写缓冲区，65536 个连接槽不常驻 ~34KB/连接
+  SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                            SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                            SSL_MODE_RELEASE_BUFFERS);
+  SSL_CTX_set_alpn_select_cb(ctx, select_alpn, nullptr);
+
+  if (SSL_CTX_use_certificate_chain_file(ctx, cert_file.c_str()) != 1 ||
+      SSL_CTX_use_PrivateKey_file(ctx, key_file.c_str(), SSL_FILETYPE_PEM) !=
+          1 ||
+      SSL_CTX_check_private_key(ctx) != 1) {
+    char err[256];
+    ERR_error_string_n(ERR_get_error(), err, sizeof(err));
+    LOG_ERROR("TLS: failed to load cert=%s key=%s: %s", cert_file.c_str(),
+              key_file.c_str(), err);
+    SSL_CTX_free(ctx);
+    return false;
+  }
+
+  s_ctx = ctx;
+  return true;
+}
+
+bool TlsConn::attach(int fd) {
+  reset();
+  m_ssl = SSL_new(s_ctx);
+  if (!m_ssl)
+    return false;
+  SSL_set_fd(m_ssl, fd);
+  SSL_set_accept_state(m_ssl);
+  m_fd = fd;
+  return true;
+}
+
+void TlsConn::reset() {
+  if (m_ssl) {
+    SSL_free(m_ssl);
+    m_ssl = nullptr;
+  }
+  m_fd = -1;
+  m_established = false;
+  m_ktls_send = false;
+}
+
+TlsConn::Io TlsConn::handshake() {
+  ERR_clear_error();
+  int ret = SSL_do_handshake(m_ssl);
+  if (ret == 1) {
+    m_established = true;
+    m_ktls_send = BIO_get_ktls_send(SSL_get_wbio(m_ssl)) != 0;
+
+    // 首个连接记录一次 kTLS 状态，便于确认内核 tls 模块是否生效
+    static std::atomic<bool> logged{false};
+    if (!logged.exchange(true)) {
+      LOG_INFO("TLS: %s, cipher=%s, kTLS tx=%s rx=%s", SSL_get_version(m_ssl),
+               SSL_get_cipher_name(m_ssl), m_ktls_send ? "on" : "off",
+               BIO_get_ktls_recv(SSL_get_rbio(m_ssl)) ? "on" : "off");
+    }
+    return Io::DONE;
+  }
+  switch (SSL_get_error(m_ssl, ret)) {
+  case SSL_ERROR_WANT_READ:
+    return Io::WANT_READ;
+  case SSL_ERROR_WANT_WRITE:
+    return Io::WANT_WRITE;
+  default:
+    return Io::FAILED;
+  }
+}
+
+// SSL_read/SSL_write 返回值 → 系统调用风格
+ssize_t TlsConn::io_result(int ret) {
+  if (ret > 0)
+    return ret;
+  switch (SSL_get_error(m_ssl, ret)) {
+  case SSL_ERROR_WANT_READ:
+  case SSL_ERROR_WANT_WRITE:
+    errno = EAGAIN;
+    return -1;
+  case SSL_ERROR_ZERO_RETURN: // 对端 close_notify
+    return 0;
+  default:
+    errno = EIO;
+    return -1;
+  }
+}
+
+ssize_t TlsConn::read(void *buf, size_t len) {
+  ERR_clear_error();
+  return io_result(SSL_read(m_ssl, buf, static_cast<int>(len)));
+}
+
+ssize_t TlsConn::ssl_write(const void *buf, size_t len) {
+  ERR_clear_error();
+  return io_result(SSL_write(m_ssl, buf, static_cast<int>(len)));
+}
+
+ssize_t TlsConn::send(const void *buf, size_t len) {
+  if (m_ktls_send)
+    return ::send(m_fd, buf, len, 0);
+  return ssl_write(buf, len);
+}
+
+// kTLS TX: 内核按记录加密，直接 writev（文件体不经用户态拷贝）
+// 回退路径: 合并为 ≤16KB 的明文块再 SSL_write，避免响应头单独成一条 TLS 记录
+ssize_t TlsConn::writev(const struct iovec *iov, int iovcnt) {
+  if (m_ktls_send)
+    return ::writev(m_fd, iov, iovcnt);
+
+  static constexpr size_t MAX_RECORD = 16384;
+  char buf[MAX_RECORD];
+  size_t n = 0;
+  for (int i = 0; i < iovcnt && n < MAX_RECORD; ++i) {
+    size_t take = std::min(iov[i].iov_len, MAX_RECORD - n);
+    memcpy(buf + n, iov[i].iov_base, take);
+    n += take;
+  }
+  if (n == 0)
+    return 0;
+  return ssl_write(buf, n);
+}
@@ -0,0 +1,68 @@
+#ifndef HTTP_TLS_CONN_H
+#define HTTP_TLS_CONN_H
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <openssl/ssl.h>
+
+// 原生 TLS 终结 + kTLS 卸载
+//
+// 握手由 OpenSSL 在用户态完成（主线程非阻塞推进），握手结束后若内核支持
+// kTLS（SSL_OP_ENABLE_KTLS，需加载 tls 模块且协商到 AES-GCM / ChaCha20），
+// 记录层加解密下沉到内核:
+//   - 发送: kTLS TX 生效时 writev()/send() 直接写 socket，
+//           mmap 文件体与响应头仍走原有的 writev 零拷贝路径
+//   - 接收: SSL_read() 在 kTLS RX 生效时由 OpenSSL 直接 recvmsg 明文
+// kTLS 不可用时回退到 SSL_write()，对上层接口不变。
+//
+// 返回值约定与系统调用一致: 需等待 I/O 时返回 -1 且 errno = EAGAIN，
+// http_conn 的读写循环无需区分明文 / TLS 连接。
+class TlsConn {
+public:
+  enum class Io { DONE, WANT_READ, WANT_WRITE, FAILED };
+
+  // 全局 SSL_CTX: 证书链 + 私钥，开启 kTLS 与 ALPN（h2 / http/1.1）
+  static bool init_context(const std::string &cert_file,
+                           const std::string &key_file);
+  static bool enabled() { return s_ctx != nullptr; }
+
+  TlsConn() = default;
+  ~TlsConn() { reset(); }
+  TlsConn(const TlsConn &) = delete;
+  TlsConn &operator=(const TlsConn &) = delete;
+
+  // 新连接: 绑定 fd 并进入服务端握手状态
+  bool attach(int fd);
+  // 释放 SSL 对象（fd 由调用方关闭）
+  void reset();
+
+  bool active() const { return m_ssl != nullptr; }
+  bool established() const { return m_established; }
+  bool ktls_send() const { return m_ktls_send; }
+
+  // 推进握手（非阻塞），DONE 之后才能收发应用数据
+  Io handshake();
+
+  ssize_t read(void *buf, size_t len);
+  ssize_t send(const void *buf, size_t len);
+  ssize_t writev(const struct iovec *iov, int iovcnt);
+
+  // OpenSSL 内部已解密但尚未读出的字节（不会再触发 EPOLLIN）
+  int pending() const { return m_ssl ? SSL_pending(m_ssl) : 0; }
+
+private:
+  ssize_t ssl_write(const void *buf, size_t len);
+  ssize_t io_result(int ret);
+
+  static inline SSL_CTX *s_ctx = nullptr;
+
+  SSL *m_ssl = nullptr;
+  int m_fd = -1;
+  bool m_established = false;
+  bool m_ktls_send = false;
+};
+
+#endif
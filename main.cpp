@@ -1,5 +1,6 @@
 #include "config.h"
 #include "log/log.h"
+#include <chrono>
 
 int main(int argc, char *argv[]) {
   // 日志初始化
@@ -21,6 +22,18 @@ int main(int argc, char *argv[]) {
 
   WebServer server;
 
+  // 启动耗时按阶段记录
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point boot = Clock::now(), phase_start = boot;
+  auto phase_done = [&](const char *phase) {
+    Clock::time_point now = Clock::now();
+    LOG_INFO("Startup: %s took %lld ms", phase,
+             static_cast<long long>(
+                 std::chrono::duration_cast<std::chrono::milliseconds>(
+                     now - phase_start).count()));
+    phase_start = now;
+  };
+
   // 初始化
   server.init(config.PORT, user, passwd, databasename, config.sql_num,
               config.thread_num, config.auth_enabled);
@@ -30,16 +43,38 @@ int main(int argc, char *argv[]) {
            config.redis_pool_size, config.auth_enabled ? "on" : "off");
 
   // 数据库
-  server.init_mysql_pool();
+  server.init_mysql_pool(config.db_affinity, config.async_db_conns);
+  phase_done("mysql pool");
+
+  // 审计日志
+  server.init_audit_log(config.audit_mode, config.audit_spill);
+  phase_done("audit log");
 
   // 线程池
   server.init_thread_pool();
+  phase_done("thread pool");
 
   // Redis
-  server.init_redis_pool();
+  server.init_redis_pool(config.redis_nodes, config.redis_mode);
+  phase_done("redis pool");
+
+  // 键过滤器（快照加载 + 后台追赶）
+  server.init_bloom(config.key_filter, config.bloom_snapshot);
+  phase_done("key filter");
+
+  // TLS（可选）
+  if (!config.tls_cert.empty() && !config.tls_key.empty()) {
+    server.init_tls(config.tls_cert, config.tls_key);
+    phase_done("tls");
+  }
 
   // 监听
   server.eventListen();
+  phase_done("listen");
+  LOG_INFO("Startup: ready in %lld ms",
+           static_cast<long long>(
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   Clock::now() - boot).count()));
 
   // 运行
   server.eventLoop();
@@ -0,0 +1,364 @@
+#include "async_mysql.h"
+#include "log/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mysql/errmsg.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+AsyncMysql *AsyncMysql::GetInstance() {
+  static AsyncMysql instance;
+  return &instance;
+}
+
+int64_t AsyncMysql::now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool AsyncMysql::init(int epollfd, const std::string &host,
+                      const std::string &user, const std::string &password,
+                      const std::string &db, int port, int conns) {
+  epollfd_ = epollfd;
+  host_ = host;
+  user_ = user;
+  password_ = password;
+  db_ = db;
+  port_ = port;
+
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (event_fd_ < 0 || timer_fd_ < 0) {
+    LOG_ERROR("AsyncMysql: eventfd/timerfd failed: %s", strerror(errno));
+    return false;
+  }
+  for (int fd : {event_fd_, timer_fd_}) {
+    epoll_event ev{};
+    ev.data.fd = fd;
+    ev.events = EPOLLIN;
+    epoll_ctl(epollfd_, EPOLL_CTL_ADD, fd, &ev);
+  }
+  // 首次连接失败不影响启用，tick() 会持续重连
+  for (int i = 0; i < conns; ++i)
+    links_.push_back(std::make_unique<Link>());
+  for (auto &link : links_)
+    connect(*link);
+  arm_timer();
+  return true;
+}
+
+AsyncMysql::Link *AsyncMysql::link_of(int fd) const {
+  for (const auto &link : links_)
+    if (link->fd == fd)
+      return link.get();
+  return nullptr;
+}
+
+// ── 连接管理 ────────────────────────────────────────────────────────────
+
+bool AsyncMysql::connect(Link &link) {
+  MYSQL *mysql = mysql_init(nullptr);
+  if (!mysql)
+    return false;
+  unsigned int connect_timeout = CONNECT_TIMEOUT_MS / 1000;
+  mysql_options(mysql, MYSQL_OPT_CONNECT_TIMEOUT, &connect_timeout);
+
+  link.mysql = mysql;
+  link.state = Link::State::CONNECTING;
+  link.deadline_ms = now_ms() + CONNECT_TIMEOUT_MS;
+  drive(link);
+  return link.state != Link::State::CLOSED;
+}
+
+void AsyncMysql::close_link(Link &link) {
+  bool was_connected = link.state != Link::State::CLOSED &&
+                       link.state != Link::State::CONNECTING;
+  if (link.query)
+    finish_query(link, nullptr);
+  if (link.fd >= 0 && link.events)
+    epoll_ctl(epollfd_, EPOLL_CTL_DEL, link.fd, nullptr);
+  if (link.mysql)
+    mysql_close(link.mysql);
+  link.mysql = nullptr;
+  link.fd = -1;
+  link.events = 0;
+  link.deadline_ms = 0;
+  link.state = Link::State::CLOSED;
+  if (was_connected &&
+      connected_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    LOG_WARN("AsyncMysql: all connections to %s:%d lost", host_.c_str(), port_);
+}
+
+void AsyncMysql::tick() {
+  if (epollfd_ < 0)
+    return;
+  for (auto &link : links_)
+    if (link->state == Link::State::CLOSED)
+      connect(*link);
+  arm_timer();
+}
+
+void AsyncMysql::watch(Link &link, uint32_t events) {
+  if (link.fd < 0 || link.events == events)
+    return;
+  epoll_event ev{};
+  ev.data.fd = link.fd;
+  ev.events = events;
+  epoll_ctl(epollfd_, link.events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, link.fd,
+            &ev);
+  link.events = events;
+}
+
+// ── 状态机 ──────────────────────────────────────────────────────────────
+//
+// 非阻塞 API 只返回"未就绪"，不区分等读还是等写。查询包很小，发送总能一次写完，
+// 因此除 TCP 建连（首次 NOT_READY 时同时关注可写）外只等待可读
+
+void AsyncMysql::drive(Link &link) {
+  for (;;) {
+    net_async_status st;
+    switch (link.state) {
+    case Link::State::CLOSED:
+      return;
+
+    case Link::State::CONNECTING:
+      st = mysql_real_connect_nonblocking(
+          link.mysql, host_.c_str(), user_.c_str(), password_.c_str(),
+          db_.c_str(), port_, nullptr, 0);
+      if (st == NET_ASYNC_NOT_READY) {
+        bool first = link.fd < 0;
+        link.fd = mysql_get_socket_descriptor(link.mysql);
+        if (link.fd < 0) {
+          close_link(link);
+          return;
+        }
+        watch(link, first ? EPOLLIN | EPOLLOUT : EPOLLIN);
+        return;
+      }
+      if (st != NET_ASYNC_COMPLETE) {
+        // 所有连接同时重连，同一原因每秒只记一次
+        int64_t now = now_ms();
+        if (now - last_warn_ms_ >= 1000) {
+          last_warn_ms_ = now;
+          LOG_WARN("AsyncMysql: connect to %s:%d failed: %s", host_.c_str(),
+                   port_, mysql_error(link.mysql));
+        }
+        close_link(link);
+        return;
+      }
+      link.fd = mysql_get_socket_descriptor(link.mysql);
+      link.deadline_ms = 0;
+      link.state = Link::State::IDLE;
+      if (connected_.fetch_add(1, std::memory_order_acq_rel) == 0)
+        LOG_INFO("AsyncMysql: connected to %s:%d", host_.c_str(), port_);
+      break;
+
+    case Link::State::IDLE:
+      if (pending_.empty()) {
+        // 空闲时仍关注可读: 服务端主动断开（wait_timeout 等）时及时发现
+        watch(link, EPOLLIN);
+        return;
+      }
+      start_query(link, std::move(pending_.front()));
+      pending_.pop_front();
+      break;
+
+    case Link::State::QUERYING:
+      st = mysql_real_query_nonblocking(link.mysql, link.sql.data(),
+                                        link.sql.size());
+      if (st == NET_ASYNC_NOT_READY) {
+        watch(link, EPOLLIN);
+        return;
+      }
+      if (st != NET_ASYNC_COMPLETE) {
+        unsigned int err = mysql_errno(link.mysql);
+        finish_query(link, nullptr);
+        if (err >= CR_MIN_ERROR) // 客户端 / 连接错误，SQL 错误不影响连接
+          close_link(link);
+        break;
+      }
+      link.state = Link::State::STORING;
+      break;
+
+    case Link::State::STORING: {
+      MYSQL_RES *res = nullptr;
+      st = mysql_store_result_nonblocking(link.mysql, &res);
+      if (st == NET_ASYNC_NOT_READY) {
+        watch(link, EPOLLIN);
+        return;
+      }
+      if (st != NET_ASYNC_COMPLETE) {
+        finish_query(link, nullptr);
+        close_link(link);
+        break;
+      }
+      finish_query(link, res);
+      break;
+    }
+    }
+  }
+}
+
+void AsyncMysql::start_query(Link &link, std::unique_ptr<Query> q) {
+  // 参数按本连接的字符集转义后代入 ?
+  const char *tmpl = stmt_sql(q->id);
+  std::string &sql = link.sql;
+  sql.clear();
+  size_t next = 0;
+  for (const char *p = tmpl; *p; ++p) {
+    if (*p != '?' || next == q->params.size()) {
+      sql.push_back(*p);
+      continue;
+    }
+    const std::string &v = q->params[next++];
+    size_t pos = sql.size();
+    sql.resize(pos + 2 * v.size() + 3);
+    sql[pos] = '\'';
+    unsigned long n =
+        mysql_real_escape_string(link.mysql, &sql[pos + 1], v.data(), v.size());
+    sql.resize(pos + 1 + n);
+    sql.push_back('\'');
+  }
+
+  link.deadline_ms = q->queued_ms + QUERY_TIMEOUT_MS;
+  link.query = std::move(q);
+  link.state = Link::State::QUERYING;
+}
+
+void AsyncMysql::finish_query(Link &link, MYSQL_RES *res) {
+  std::unique_ptr<Query> q = std::move(link.query);
+  link.deadline_ms = 0;
+  link.state = Link::State::IDLE;
+  q->cb(res);
+  if (res)
+    mysql_free_result(res);
+  queued_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// ── 提交 / 分发 ─────────────────────────────────────────────────────────
+
+bool AsyncMysql::submit(StmtId id, std::vector<std::string> params,
+                        Callback cb) {
+  if (event_fd_ < 0 || !connected())
+    return false;
+  if (queued_.fetch_add(1, std::memory_order_relaxed) >= MAX_QUEUED) {
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  auto q = std::make_unique<Query>();
+  q->id = id;
+  q->params = std::move(params);
+  q->cb = std::move(cb);
+  q->queued_ms = now_ms();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    incoming_.push_back(std::move(q));
+  }
+  uint64_t one = 1;
+  ssize_t n = write(event_fd_, &one, sizeof(one));
+  (void)n; // 计数器溢出时写失败也无妨，主线程仍会被已有计数唤醒
+  return true;
+}
+
+void AsyncMysql::drain_incoming() {
+  std::vector<std::unique_ptr<Query>> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch.swap(incoming_);
+  }
+  for (auto &q : batch)
+    pending_.push_back(std::move(q));
+  dispatch();
+}
+
+void AsyncMysql::dispatch() {
+  for (auto &link : links_) {
+    if (pending_.empty())
+      break;
+    if (link->state == Link::State::IDLE)
+      drive(*link);
+  }
+  // 连接全部断开: 排队的查询不再等待重连
+  if (connected_.load(std::memory_order_acquire) == 0) {
+    while (!pending_.empty()) {
+      std::unique_ptr<Query> q = std::move(pending_.front());
+      pending_.pop_front();
+      q->cb(nullptr);
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+  arm_timer();
+}
+
+// ── 事件循环 ────────────────────────────────────────────────────────────
+
+void AsyncMysql::handle_event(int fd, uint32_t events) {
+  if (fd == event_fd_) {
+    uint64_t cnt;
+    while (read(event_fd_, &cnt, sizeof(cnt)) > 0) {
+    }
+    drain_incoming();
+  } else if (fd == timer_fd_) {
+    uint64_t cnt;
+    while (read(timer_fd_, &cnt, sizeof(cnt)) > 0) {
+    }
+    run_timers();
+  } else if (Link *link = link_of(fd)) {
+    if (link->state == Link::State::IDLE) {
+      // 空闲连接可读只可能是服务端断开或报错
+      close_link(*link);
+      dispatch();
+      return;
+    }
+    (void)events; // 出错 / 挂断由下一次非阻塞调用返回 NET_ASYNC_ERROR
+    drive(*link);
+    dispatch();
+  }
+}
+
+void AsyncMysql::run_timers() {
+  int64_t now = now_ms();
+  for (auto &link : links_) {
+    if (!link->deadline_ms || link->deadline_ms > now)
+      continue;
+    // 非阻塞查询无法中途取消，只能断开连接；在途查询以失败回调
+    if (link->state == Link::State::CONNECTING)
+      LOG_WARN("AsyncMysql: connect to %s:%d timed out", host_.c_str(), port_);
+    else
+      LOG_WARN("AsyncMysql: query timed out after %dms, reconnecting",
+               QUERY_TIMEOUT_MS);
+    close_link(*link);
+  }
+  // 排队过久的查询直接失败（调用方按查询失败处理）
+  while (!pending_.empty() &&
+         pending_.front()->queued_ms + QUERY_TIMEOUT_MS <= now) {
+    std::unique_ptr<Query> q = std::move(pending_.front());
+    pending_.pop_front();
+    q->cb(nullptr);
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  dispatch();
+}
+
+void AsyncMysql::arm_timer() {
+  int64_t next = 0;
+  if (!pending_.empty())
+    next = pending_.front()->queued_ms + QUERY_TIMEOUT_MS;
+  for (const auto &link : links_)
+    if (link->deadline_ms && (!next || link->deadline_ms < next))
+      next = link->deadline_ms;
+
+  struct itimerspec its {};
+  if (next) {
+    int64_t delta = std::max<int64_t>(next - now_ms(), 1);
+    its.it_value.tv_sec = delta / 1000;
+    its.it_value.tv_nsec = (delta % 1000) * 1000000;
+  }
+  timerfd_settime(timer_fd_, 0, &its, nullptr);
+}
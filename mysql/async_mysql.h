@@ -0,0 +1,120 @@
+#ifndef ASYNC_MYSQL_H
+#define ASYNC_MYSQL_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <mysql/mysql.h>
+
+#include "prepared_stmt.h" // StmtId
+
+// 非阻塞 MySQL 客户端 —— libmysqlclient 的 *_nonblocking API 挂在主线程的 epoll 上
+//
+// 同步连接池在每次查询往返期间都占着一个 worker（默认 64 线程 / 100 连接就是为此）。
+// 这里改为:
+//   worker 调用 submit() 把查询放入队列，写 eventfd 唤醒主线程后立即返回
+//   主线程在空闲连接上发出查询，socket 可读时推进 query → store_result，
+//   结果集取完后在主线程执行回调；回调只做轻量工作，不做阻塞 I/O
+// MySQL 协议一条连接同时只能有一条查询，在途查询数 = 连接数，其余在主线程排队。
+//
+// 语句与预编译语句缓存共用 StmtId 与 SQL 文本；非阻塞 API 只支持文本协议，
+// 参数在主线程按连接字符集转义后代入 ?（SQL 文本的字面量中不得含 ?）。
+// 连接断开 / 查询超时时以 nullptr 结果回调，调用方按查询失败处理；
+// 主线程定时 tick() 重连。
+class AsyncMysql {
+public:
+  // res 为 nullptr 表示失败（断线 / 超时 / SQL 错误）；结果集在回调返回后释放
+  using Callback = std::function<void(MYSQL_RES *res)>;
+
+  static AsyncMysql *GetInstance();
+
+  // 主线程调用: 注册 eventfd / timerfd 并发起 conns 条连接（结果异步确定）
+  bool init(int epollfd, const std::string &host, const std::string &user,
+            const std::string &password, const std::string &db, int port,
+            int conns);
+
+  // 至少一条连接可用
+  bool connected() const {
+    return connected_.load(std::memory_order_acquire) > 0;
+  }
+
+  // 任意线程: 提交一条返回结果集的语句，params 依次代入 ?。
+  // 返回 false 表示未连接或排队过多，调用方应走同步路径；
+  // 返回 true 时 cb 保证恰好被调用一次（在事件循环线程）
+  bool submit(StmtId id, std::vector<std::string> params, Callback cb);
+
+  // 主线程事件分发
+  bool owns(int fd) const {
+    return fd >= 0 && (fd == event_fd_ || fd == timer_fd_ || link_of(fd));
+  }
+  void handle_event(int fd, uint32_t events);
+  // 主线程定时调用: 断线重连
+  void tick();
+
+private:
+  AsyncMysql() = default;
+
+  struct Query {
+    StmtId id;
+    std::vector<std::string> params;
+    Callback cb;
+    int64_t queued_ms = 0;
+  };
+
+  // 一条连接；仅主线程访问
+  struct Link {
+    enum class State { CLOSED, CONNECTING, IDLE, QUERYING, STORING };
+    State state = State::CLOSED;
+    MYSQL *mysql = nullptr;
+    int fd = -1;
+    uint32_t events = 0;
+    std::unique_ptr<Query> query; // 在途查询
+    std::string sql;              // 在途查询的 SQL（非阻塞调用期间须保持不变）
+    int64_t deadline_ms = 0;      // 连接 / 查询超时（0 = 未设置）
+  };
+
+  bool connect(Link &link);
+  void close_link(Link &link);
+  Link *link_of(int fd) const;
+  void watch(Link &link, uint32_t events);
+  // 推进 link 上的非阻塞调用，直到需要等待 socket 或完成
+  void drive(Link &link);
+  void start_query(Link &link, std::unique_ptr<Query> q);
+  void finish_query(Link &link, MYSQL_RES *res);
+  void dispatch();
+  void drain_incoming();
+  void run_timers();
+  void arm_timer();
+
+  static int64_t now_ms();
+
+  static constexpr int MAX_QUEUED = 4096;
+  static constexpr int CONNECT_TIMEOUT_MS = 3000;
+  static constexpr int QUERY_TIMEOUT_MS = 5000; // 含排队时间
+
+  std::string host_, user_, password_, db_;
+  int port_ = 3306;
+
+  int epollfd_ = -1;
+  int event_fd_ = -1;
+  int timer_fd_ = -1;
+
+  // init() 后只读（Link 内容仅主线程访问）
+  std::vector<std::unique_ptr<Link>> links_;
+  // 以下仅主线程访问
+  std::deque<std::unique_ptr<Query>> pending_;
+  int64_t last_warn_ms_ = 0;
+
+  std::atomic<int> connected_{0};
+  std::atomic<int> queued_{0}; // 已提交未回调
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Query>> incoming_;
+};
+
+#endif
@@ -0,0 +1,405 @@
+#include "audit_log.h"
+#include "log/log.h"
+#include "mysql_pool.h"
+#include "prepared_stmt.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <mysql/errmsg.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char INSERT_HEAD[] =
+    "INSERT INTO audit_log (username, operation, target, detail) VALUES ";
+
+void append_quoted(std::string &sql, MYSQL *mysql, const std::string &v) {
+  size_t pos = sql.size();
+  sql.resize(pos + 2 * v.size() + 3);
+  sql[pos] = '\'';
+  unsigned long n =
+      mysql_real_escape_string(mysql, &sql[pos + 1], v.data(), v.size());
+  sql.resize(pos + 1 + n);
+  sql.push_back('\'');
+}
+
+// 溢出文件: 每行一条记录，四个字段以 \t 分隔，字段内的 \\ \t \n 转义
+void encode_field(std::string &out, const std::string &v) {
+  for (char c : v) {
+    if (c == '\\')
+      out += "\\\\";
+    else if (c == '\t')
+      out += "\\t";
+    else if (c == '\n')
+      out += "\\n";
+    else
+      out.push_back(c);
+  }
+}
+
+bool decode_line(const char *p, size_t len, std::string *fields[4]) {
+  int idx = 0;
+  fields[0]->clear();
+  for (size_t i = 0; i < len; ++i) {
+    char c = p[i];
+    if (c == '\t') {
+      if (++idx == 4)
+        return false;
+      fields[idx]->clear();
+    } else if (c == '\\' && i + 1 < len) {
+      char e = p[++i];
+      fields[idx]->push_back(e == 't' ? '\t' : e == 'n' ? '\n' : e);
+    } else {
+      fields[idx]->push_back(c);
+    }
+  }
+  return idx == 3;
+}
+
+} // namespace
+
+AuditLog *AuditLog::GetInstance() {
+  static AuditLog instance;
+  return &instance;
+}
+
+int64_t AuditLog::now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void AuditLog::start(const std::string &spill_path, bool durable) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_)
+    return;
+  spill_path_ = spill_path;
+  durable_ = durable;
+  struct stat st{};
+  spill_pending_ = stat(spill_path_.c_str(), &st) == 0 && st.st_size > 0;
+  if (spill_pending_)
+    LOG_INFO("Audit log: %s has %lld bytes of spilled records, replaying",
+             spill_path_.c_str(), static_cast<long long>(st.st_size));
+  retry_at_ms_ = 0;
+  stop_ = false;
+  running_ = true;
+  thread_ = std::thread(&AuditLog::run, this);
+}
+
+void AuditLog::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable())
+    thread_.join();
+}
+
+AuditLog::Stats AuditLog::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats st = stats_;
+  st.queued = queue_.size();
+  return st;
+}
+
+// ── 入队 ────────────────────────────────────────────────────────────────
+
+bool AuditLog::record(const std::string &username, const std::string &operation,
+                      const std::string &target, const std::string &detail) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!running_) {
+    lock.unlock();
+    return insert_one(Entry{username, operation, target, detail, 0});
+  }
+  if (queue_.size() >= MAX_QUEUED) {
+    uint64_t dropped = ++stats_.dropped;
+    lock.unlock();
+    // 1, 2, 4, 8 ... 条时各记一次，持续故障时不刷屏
+    if ((dropped & (dropped - 1)) == 0)
+      LOG_WARN("Audit log queue full (%zu), %llu records dropped", MAX_QUEUED,
+               static_cast<unsigned long long>(dropped));
+    return false;
+  }
+
+  queue_.push_back(Entry{username, operation, target, detail, now_ms()});
+  uint64_t seq = ++enqueued_seq_;
+  if (!durable_) {
+    // 队列由空变非空时后台线程需要开始计时，攒满一批时立即写
+    bool wake = queue_.size() == 1 || queue_.size() == BATCH_ROWS;
+    lock.unlock();
+    if (wake)
+      cv_.notify_one();
+    return true;
+  }
+
+  cv_.notify_one();
+  return ack_cv_.wait_for(lock, std::chrono::milliseconds(DURABLE_WAIT_MS),
+                          [&] { return durable_seq_ >= seq; });
+}
+
+bool AuditLog::insert_one(const Entry &e) {
+  MYSQL *mysql = nullptr;
+  connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
+  PreparedQuery query(mysql, StmtId::AUDIT_INSERT);
+  query.arg(e.username).arg(e.operation).arg(e.target).arg(e.detail);
+  return query.execute();
+}
+
+// ── 后台线程 ────────────────────────────────────────────────────────────
+
+void AuditLog::run() {
+  std::vector<Entry> batch; // 写失败时保留，下次重试（保持顺序）
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      for (;;) {
+        if (!batch.empty())
+          break;
+        int64_t now = now_ms();
+        if (!queue_.empty()) {
+          int64_t due = queue_.front().queued_ms + FLUSH_MS;
+          // durable 模式不攒批: 写入期间到达的记录自然成为下一批（组提交）
+          if (stop_ || durable_ || queue_.size() >= BATCH_ROWS || now >= due) {
+            size_t n = std::min(queue_.size(), BATCH_ROWS);
+            batch.assign(std::make_move_iterator(queue_.begin()),
+                         std::make_move_iterator(queue_.begin() + n));
+            queue_.erase(queue_.begin(), queue_.begin() + n);
+            break;
+          }
+          cv_.wait_for(lock, std::chrono::milliseconds(due - now));
+          continue;
+        }
+        if (stop_) {
+          running_ = false; // 此后 record() 同步写入
+          return;
+        }
+        // 空闲时按重试间隔回放溢出文件
+        if (spill_pending_) {
+          if (now >= retry_at_ms_)
+            break;
+          cv_.wait_for(lock, std::chrono::milliseconds(retry_at_ms_ - now));
+        } else {
+          cv_.wait(lock);
+        }
+      }
+    }
+
+    if (batch.empty()) {
+      MYSQL *mysql = nullptr;
+      connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
+      if (!mysql || !replay(mysql))
+        retry_at_ms_ = now_ms() + RETRY_MS;
+      continue;
+    }
+
+    if (persist(batch)) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        durable_seq_ += batch.size();
+      }
+      ack_cv_.notify_all();
+      batch.clear();
+      continue;
+    }
+
+    // MySQL 与溢出文件都写不进: 保留这一批，稍后重试
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stop_) {
+      LOG_ERROR("Audit log: %zu records lost on shutdown (MySQL and %s "
+                "unavailable)",
+                batch.size() + queue_.size(), spill_path_.c_str());
+      queue_.clear();
+      running_ = false;
+      return;
+    }
+    cv_.wait_for(lock, std::chrono::milliseconds(RETRY_MS),
+                 [this] { return stop_; });
+  }
+}
+
+bool AuditLog::persist(const std::vector<Entry> &batch) {
+  int64_t now = now_ms();
+  if (now >= retry_at_ms_) {
+    MYSQL *mysql = nullptr;
+    connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
+    // 先回放溢出文件，保证写入顺序与入队顺序一致
+    if (mysql && (!spill_pending_ || replay(mysql)) &&
+        insert_rows(mysql, batch)) {
+      retry_at_ms_ = 0;
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.written += batch.size();
+      return true;
+    }
+    retry_at_ms_ = now + RETRY_MS;
+    LOG_WARN("Audit log: MySQL unavailable (%s), spilling to %s",
+             mysql ? mysql_error(mysql) : "no connection", spill_path_.c_str());
+  }
+  return spill(batch);
+}
+
+// 多行 INSERT，超过 MAX_STMT_BYTES 时拆成多条。返回 false 仅表示连接级错误
+// （应溢出后重试）；服务端拒绝（如字段超长）时逐行重写，跳过被拒绝的行
+bool AuditLog::insert_rows(MYSQL *mysql, const std::vector<Entry> &rows) {
+  std::string sql;
+  sql.reserve(std::min<size_t>(rows.size() * 256, MAX_STMT_BYTES) +
+              sizeof(INSERT_HEAD));
+
+  auto exec = [&](size_t first, size_t end) -> bool {
+    if (mysql_real_query(mysql, sql.data(), sql.size()) == 0)
+      return true;
+    if (mysql_errno(mysql) >= CR_MIN_ERROR)
+      return false;
+    LOG_WARN("Audit log: batch insert rejected (%s), retrying row by row",
+             mysql_error(mysql));
+    for (size_t i = first; i < end; ++i) {
+      const Entry &e = rows[i];
+      PreparedQuery query(mysql, StmtId::AUDIT_INSERT);
+      query.arg(e.username).arg(e.operation).arg(e.target).arg(e.detail);
+      if (query.execute())
+        continue;
+      if (mysql_errno(mysql) >= CR_MIN_ERROR)
+        return false;
+      LOG_ERROR("Audit log: record dropped (%s %s by %s): %s",
+                e.operation.c_str(), e.target.c_str(), e.username.c_str(),
+                query.error());
+    }
+    return true;
+  };
+
+  size_t first = 0;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    size_t before = sql.size();
+    sql += sql.empty() ? INSERT_HEAD : ",";
+    const Entry &e = rows[i];
+    sql.push_back('(');
+    append_quoted(sql, mysql, e.username);
+    sql.push_back(',');
+    append_quoted(sql, mysql, e.operation);
+    sql.push_back(',');
+    append_quoted(sql, mysql, e.target);
+    sql.push_back(',');
+    append_quoted(sql, mysql, e.detail);
+    sql.push_back(')');
+    if (sql.size() > MAX_STMT_BYTES && i > first) {
+      // 本行留给下一条语句
+      sql.resize(before);
+      if (!exec(first, i))
+        return false;
+      sql.clear();
+      first = i--;
+    }
+  }
+  return sql.empty() || exec(first, rows.size());
+}
+
+// ── 溢出文件 ────────────────────────────────────────────────────────────
+
+bool AuditLog::spill(const std::vector<Entry> &batch) {
+  std::string buf;
+  for (const Entry &e : batch) {
+    encode_field(buf, e.username);
+    buf.push_back('\t');
+    encode_field(buf, e.operation);
+    buf.push_back('\t');
+    encode_field(buf, e.target);
+    buf.push_back('\t');
+    encode_field(buf, e.detail);
+    buf.push_back('\n');
+  }
+
+  int fd = open(spill_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                0600);
+  if (fd < 0) {
+    LOG_ERROR("Audit log: cannot open %s: %s", spill_path_.c_str(),
+              strerror(errno));
+    return false;
+  }
+  struct stat st{};
+  fstat(fd, &st);
+  size_t done = 0;
+  while (done < buf.size()) {
+    ssize_t n = write(fd, buf.data() + done, buf.size() - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += static_cast<size_t>(n);
+  }
+  bool ok = done == buf.size() && fsync(fd) == 0;
+  if (!ok) {
+    LOG_ERROR("Audit log: write %s failed: %s", spill_path_.c_str(),
+              strerror(errno));
+    // 去掉写了一半的行，下次追加不会与之拼接
+    if (ftruncate(fd, st.st_size) != 0)
+      LOG_ERROR("Audit log: truncate %s failed: %s", spill_path_.c_str(),
+                strerror(errno));
+  }
+  close(fd);
+  if (!ok)
+    return false;
+
+  spill_pending_ = true;
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.spilled += batch.size();
+  return true;
+}
+
+bool AuditLog::replay(MYSQL *mysql) {
+  FILE *fp = fopen(spill_path_.c_str(), "r");
+  if (!fp) {
+    spill_pending_ = errno != ENOENT;
+    return !spill_pending_;
+  }
+
+  std::vector<Entry> batch;
+  Entry e;
+  std::string *fields[4] = {&e.username, &e.operation, &e.target, &e.detail};
+  char *line = nullptr;
+  size_t cap = 0;
+  ssize_t len;
+  size_t replayed = 0, skipped = 0;
+  bool ok = true;
+  while (ok && (len = getline(&line, &cap, fp)) > 0) {
+    // 没有换行的尾行是崩溃时写了一半的记录
+    if (line[len - 1] != '\n' || !decode_line(line, len - 1, fields)) {
+      ++skipped;
+      continue;
+    }
+    batch.push_back(e);
+    if (batch.size() >= BATCH_ROWS) {
+      ok = insert_rows(mysql, batch);
+      replayed += ok ? batch.size() : 0;
+      batch.clear();
+    }
+  }
+  if (ok && !batch.empty()) {
+    ok = insert_rows(mysql, batch);
+    replayed += ok ? batch.size() : 0;
+  }
+  free(line);
+  fclose(fp);
+
+  if (!ok) {
+    // 已写入的前缀会在下次回放时重复（至少一次）
+    LOG_WARN("Audit log: replay of %s interrupted after %zu records: %s",
+             spill_path_.c_str(), replayed, mysql_error(mysql));
+    return false;
+  }
+  if (truncate(spill_path_.c_str(), 0) != 0)
+    LOG_ERROR("Audit log: truncate %s failed: %s", spill_path_.c_str(),
+              strerror(errno));
+  spill_pending_ = false;
+  LOG_INFO("Audit log: replayed %zu spilled records from %s%s", replayed,
+           spill_path_.c_str(), skipped ? " (malformed lines skipped)" : "");
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.replayed += replayed;
+  stats_.written += replayed;
+  return true;
+}
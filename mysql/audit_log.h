@@ -0,0 +1,100 @@
+#ifndef AUDIT_LOG_H
+#define AUDIT_LOG_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mysql/mysql.h>
+
+// 审计日志异步批量写入 —— 增删改请求不再为审计多一次数据库往返
+//
+// worker 调用 record() 把记录放入内存队列即返回；后台线程攒够 BATCH_ROWS 行
+// 或最早一条等待超过 FLUSH_MS 时，用一条多行 INSERT 写入 audit_log。
+//
+// MySQL 不可用时整批追加到本地溢出文件（每行一条记录，write 后 fsync），
+// 之后每 RETRY_MS 探测一次；恢复后先按原顺序回放溢出文件再写新记录，回放完截断。
+// 回放中途崩溃会在重启后重放整个文件（至少一次，可能重复）。
+//
+// 队列上限 MAX_QUEUED 条，满时 record() 丢弃并返回 false（数据库与磁盘都写不进时
+// 不拖垮请求线程）。durable 模式下 record() 等到该条写入 MySQL 或溢出文件
+// fsync 完成才返回（组提交: 等待期间到达的记录同批落盘），超时返回 false。
+//
+// 未 start() 时 record() 退化为同步单行写入。
+class AuditLog {
+public:
+  static AuditLog *GetInstance();
+
+  // spill_path: 溢出文件；启动时若有遗留记录先回放
+  void start(const std::string &spill_path, bool durable);
+  void stop(); // 写完（或溢出）队列中的记录后停止后台线程
+
+  // 任意线程调用；返回 false 表示记录被丢弃（或 durable 模式下未确认落盘）
+  bool record(const std::string &username, const std::string &operation,
+              const std::string &target, const std::string &detail);
+
+  // start() 时选定，之后只读
+  bool durable() const { return durable_; }
+
+  struct Stats {
+    uint64_t written = 0;  // 已写入 MySQL（含回放）
+    uint64_t spilled = 0;  // 写入溢出文件
+    uint64_t replayed = 0; // 从溢出文件回放
+    uint64_t dropped = 0;  // 队列满丢弃
+    size_t queued = 0;
+  };
+  Stats stats();
+
+private:
+  AuditLog() = default;
+  ~AuditLog() { stop(); }
+
+  struct Entry {
+    std::string username, operation, target, detail;
+    int64_t queued_ms;
+  };
+
+  void run();
+  // 写一批（MySQL 不可用则溢出），返回是否已持久化（写入 MySQL 或溢出文件）
+  bool persist(const std::vector<Entry> &batch);
+  bool insert_rows(MYSQL *mysql, const std::vector<Entry> &batch);
+  bool spill(const std::vector<Entry> &batch);
+  // 溢出文件全部写回 MySQL 后截断；失败时文件保持不变
+  bool replay(MYSQL *mysql);
+  static bool insert_one(const Entry &e);
+
+  static int64_t now_ms();
+
+  static constexpr size_t BATCH_ROWS = 200;
+  static constexpr int FLUSH_MS = 100;
+  static constexpr size_t MAX_QUEUED = 10000;
+  static constexpr size_t MAX_STMT_BYTES = 1 << 20; // 单条 INSERT 上限（远小于 max_allowed_packet）
+  static constexpr int RETRY_MS = 5000;
+  static constexpr int DURABLE_WAIT_MS = 3000;
+
+  std::string spill_path_;
+  bool durable_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;      // 唤醒后台线程
+  std::condition_variable ack_cv_;  // durable 模式: 唤醒等待落盘的 record()
+  std::deque<Entry> queue_;
+  int64_t oldest_ms_ = 0;           // 队首入队时间
+  uint64_t enqueued_seq_ = 0;       // 已入队条数
+  uint64_t durable_seq_ = 0;        // 已持久化条数（队列按序处理）
+  bool running_ = false;
+  bool stop_ = false;
+  Stats stats_;
+
+  // 以下仅后台线程访问
+  bool spill_pending_ = false; // 溢出文件中有未回放的记录
+  int64_t retry_at_ms_ = 0;    // MySQL 失败后下次尝试的时间
+
+  std::thread thread_;
+};
+
+#endif
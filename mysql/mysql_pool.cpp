@@ -1,207 +1,303 @@
-#include "mysql_pool.h"
-#include "log/log.h"
-#include <deque>
-#include <mutex>
-#include <mysql/mysql.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <string>
-#include <thread>
-
-using namespace std;
-
-connection_pool::connection_pool()
-    : m_CurConn(0) // 初始化列表初始化成员变量
-      ,
-      m_FreeConn(0) {}
-
-connection_pool *connection_pool::GetInstance() {
-  static connection_pool connPool;
-  return &connPool;
-}
-
-// 构造初始化
-void connection_pool::init(const string &url, const string &User,
-                           const string &PassWord, const string &DBName,
-                           int Port, int MaxConn) {
-  m_url = url;
-  m_Port = std::to_string(Port);
-  m_User = User;
-  m_PassWord = PassWord;
-  m_DatabaseName = DBName;
-
-  void *ssl_session_data = nullptr;
-  unsigned int ssl_session_len = 0;
-
-  for (int i = 0; i < MaxConn; ++i) {
-    // 1. 初始化MySQL连接句柄
-    MYSQL *mysql_conn = mysql_init(NULL);
-    if (!mysql_conn) { // 必须检查返回值是否为NULL
-      exit(1);
-    }
-
-    // 连接超时 3 秒，防止远端主机不可达时阻塞整个启动流程
-    unsigned int connect_timeout = 3;
-    mysql_options(mysql_conn, MYSQL_OPT_CONNECT_TIMEOUT, &connect_timeout);
-    // 读写超时 10 秒，防止查询挂起
-    unsigned int rw_timeout = 10;
-    mysql_options(mysql_conn, MYSQL_OPT_READ_TIMEOUT, &rw_timeout);
-    mysql_options(mysql_conn, MYSQL_OPT_WRITE_TIMEOUT, &rw_timeout);
-
-    // 复用首次连接缓存的 SSL session，后续连接使用 TLS session resumption
-    // 避免完整的 TLS 握手，仅做 abbreviated handshake
-    if (ssl_session_data) {
-      mysql_options(mysql_conn, MYSQL_OPT_SSL_SESSION_DATA, ssl_session_data);
-    }
-
-    // 2. 用初始化后的句柄连接数据库（依赖mysql_init的返回值）
-    if (!mysql_real_connect(mysql_conn,       // 传入mysql_init返回的句柄
-                            url.c_str(),      // MySQL服务器地址
-                            User.c_str(),     // 用户名
-                            PassWord.c_str(), // 密码
-                            DBName.c_str(),   // 要连接的数据库名
-                            Port,             // 端口
-                            NULL,             // 套接字（通常为NULL）
-                            0                 // 连接标志
-                            )) {
-      mysql_close(mysql_conn); // 失败时也需要关闭句柄释放资源
-      exit(1);
-    }
-
-    // 缓存第一个连接的 SSL session 数据，供后续连接复用
-    if (i == 0) {
-      ssl_session_data =
-          mysql_get_ssl_session_data(mysql_conn, 0, &ssl_session_len);
-    }
-
-    connList.emplace_back(mysql_conn);
-    ++m_FreeConn;
-  }
-
-  // 释放本地 SSL session 引用（每个连接内部已持有独立拷贝）
-  if (ssl_session_data) {
-    mysql_free_ssl_session_data(connList.front(), ssl_session_data);
-  }
-
-  semaphore_.release(m_FreeConn);
-
-  m_MaxConn = m_FreeConn;
-  LOG_INFO("MySQL pool initialized: %d connections (host=%s)", m_FreeConn, m_url.c_str());
-}
-
-// 当有请求时，从数据库连接池中返回一个可用连接，更新使用和空闲连接数
-MYSQL *connection_pool::GetConnection() {
-  /*
-  依赖信号量来保证只有在有可用连接时执行，
-  否则阻塞等待，不需要自己判断 connList.empty()
-  */
-  semaphore_.acquire();
-
-  MYSQL *mysql_conn = nullptr;
-  {
-    std::lock_guard<std::mutex> lockGuard(lock);
-    mysql_conn = connList.front();
-    connList.pop_front();
-
-    --m_FreeConn;
-    ++m_CurConn;
-  }
-
-  // 连接健康检查（带冷却时间，避免每次获取都 ping 造成 RTT 开销）
-  time_t now = time(NULL);
-  bool need_check = false;
-  {
-    std::lock_guard<std::mutex> health_lock(m_health_mutex);
-    auto it = m_last_health_check.find(mysql_conn);
-    if (it == m_last_health_check.end() || now - it->second > 60) {
-      need_check = true;
-    }
-  }
-
-  if (need_check && mysql_ping(mysql_conn) != 0) {
-    // 连接已失效，清理旧连接并重连
-    {
-      std::lock_guard<std::mutex> health_lock(m_health_mutex);
-      m_last_health_check.erase(mysql_conn);
-    }
-    mysql_close(mysql_conn);
-    mysql_conn = mysql_init(NULL);
-    if (mysql_conn) {
-      unsigned int connect_timeout = 3;
-      mysql_options(mysql_conn, MYSQL_OPT_CONNECT_TIMEOUT, &connect_timeout);
-      unsigned int rw_timeout = 10;
-      mysql_options(mysql_conn, MYSQL_OPT_READ_TIMEOUT, &rw_timeout);
-      mysql_options(mysql_conn, MYSQL_OPT_WRITE_TIMEOUT, &rw_timeout);
-
-      if (!mysql_real_connect(mysql_conn, m_url.c_str(), m_User.c_str(),
-                              m_PassWord.c_str(), m_DatabaseName.c_str(),
-                              std::stoi(m_Port), NULL, 0)) {
-        mysql_close(mysql_conn);
-        mysql_conn = nullptr;
-      }
-    }
-
-    // 重连失败：归还信号量，避免线程池永久少一个槽位
-    if (!mysql_conn) {
-      {
-        std::lock_guard<std::mutex> lockGuard(lock);
-        --m_CurConn;
-      }
-      semaphore_.release();
-      return mysql_conn;
-    }
-  }
-
-  if (mysql_conn) {
-    std::lock_guard<std::mutex> health_lock(m_health_mutex);
-    m_last_health_check[mysql_conn] = now;
-  }
-
-  return mysql_conn;
-}
-
-// 释放当前使用的连接
-bool connection_pool::ReleaseConnection(MYSQL *mysql_conn) {
-  if (!mysql_conn) {
-    return false;
-  }
-
-  {
-    std::lock_guard<std::mutex> lockGuard(lock);
-    connList.emplace_back(mysql_conn);
-    ++m_FreeConn;
-    --m_CurConn;
-  }
-  /*
-  无论当前计数是多少，都会强制加 1（表示空闲连接数增加），
-  若有线程因计数为 0 而阻塞等待，会被唤醒并尝试获取连接。
-  */
-  semaphore_.release();
-
-  return true;
-}
-
-connection_pool::~connection_pool() {
-  {
-    std::lock_guard<std::mutex> lockGuard(lock);
-    if (!connList.empty()) {
-      for (MYSQL *mysql_conn : connList) {
-        mysql_close(mysql_conn);
-      }
-      m_CurConn = 0;
-      m_FreeConn = 0;
-      connList.clear();
-    }
-  }
-  m_last_health_check.clear();
-}
-
-connectionRAII::connectionRAII(MYSQL **SQL, connection_pool *connPool) {
-  *SQL = connPool->GetConnection();
-
-  conRAII = *SQL;
-  poolRAII = connPool;
-}
-
-connectionRAII::~connectionRAII() { poolRAII->ReleaseConnection(conRAII); }
\ No newline at end of file
+#include "mysql_pool.h"
+#include "log/log.h"
+#include "prepared_stmt.h"
+#include <chrono>
+#include <mysql/errmsg.h>
+#include <mysql/mysql.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+connection_pool::connection_pool() : m_MaxConn(0) {}
+
+connection_pool *connection_pool::GetInstance() {
+  static connection_pool connPool;
+  return &connPool;
+}
+
+// 新建连接句柄并设置选项（不连网）。ssl_session 非空时复用该 TLS session
+static MYSQL *new_handle(void *ssl_session) {
+  // 附带该连接的预编译语句缓存
+  MYSQL *mysql_conn = pooled_mysql_init();
+  if (!mysql_conn)
+    return nullptr;
+
+  // 连接超时 3 秒，防止远端主机不可达时阻塞整个启动流程
+  unsigned int connect_timeout = 3;
+  mysql_options(mysql_conn, MYSQL_OPT_CONNECT_TIMEOUT, &connect_timeout);
+  // 读写超时 10 秒，防止查询挂起
+  unsigned int rw_timeout = 10;
+  mysql_options(mysql_conn, MYSQL_OPT_READ_TIMEOUT, &rw_timeout);
+  mysql_options(mysql_conn, MYSQL_OPT_WRITE_TIMEOUT, &rw_timeout);
+
+  // 复用首次连接缓存的 SSL session，后续连接使用 TLS session resumption
+  // 避免完整的 TLS 握手，仅做 abbreviated handshake
+  if (ssl_session)
+    mysql_options(mysql_conn, MYSQL_OPT_SSL_SESSION_DATA, ssl_session);
+  return mysql_conn;
+}
+
+static int64_t elapsed_ms(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - since)
+      .count();
+}
+
+// 构造初始化
+//
+// 阶段 1: 首条连接单独建立 —— 数据库不可达时 3 秒内失败退出，并取得 SSL session。
+// 阶段 2: 其余句柄在本线程设好选项（复用 SSL session）后，由 INIT_CONCURRENCY 个
+//   线程并发握手，连上一条就放入池中。就绪数达到 MinReady 即返回，服务开始接收
+//   请求，剩余连接在后台继续建立；建立失败的作为坏槽放入，借到时再重连。
+void connection_pool::init(const string &url, const string &User,
+                           const string &PassWord, const string &DBName,
+                           int Port, int MaxConn, int MinReady) {
+  m_url = url;
+  m_Port = std::to_string(Port);
+  m_User = User;
+  m_PassWord = PassWord;
+  m_DatabaseName = DBName;
+
+  auto start = std::chrono::steady_clock::now();
+  m_conns.init(MaxConn);
+  MaxConn = static_cast<int>(m_conns.capacity());
+  if (MaxConn <= 0)
+    return;
+  if (MinReady <= 0)
+    MinReady = INIT_MIN_READY;
+  MinReady = std::min(MinReady, MaxConn);
+
+  MYSQL *first_conn = connect();
+  if (!first_conn) {
+    LOG_ERROR("MySQL pool: cannot connect to %s:%d", url.c_str(), Port);
+    exit(1);
+  }
+  LOG_INFO("MySQL pool: first connection in %lld ms",
+           static_cast<long long>(elapsed_ms(start)));
+
+  // 句柄的选项在建连前设好，SSL session 数据随即可以释放
+  unsigned int ssl_session_len = 0;
+  void *ssl_session_data =
+      mysql_get_ssl_session_data(first_conn, 0, &ssl_session_len);
+  auto warmup = std::make_shared<Warmup>();
+  warmup->handles.reserve(MaxConn - 1);
+  for (int i = 1; i < MaxConn; ++i) {
+    MYSQL *mysql_conn = new_handle(ssl_session_data);
+    if (!mysql_conn) // 必须检查返回值是否为NULL
+      exit(1);
+    warmup->handles.push_back(mysql_conn);
+  }
+  // 释放本地 SSL session 引用（每个连接内部已持有独立拷贝）
+  if (ssl_session_data)
+    mysql_free_ssl_session_data(first_conn, ssl_session_data);
+
+  m_conns.add(first_conn);
+  m_MaxConn = MaxConn;
+  warmup->ready = 1;
+
+  int threads = std::min<int>(INIT_CONCURRENCY, warmup->handles.size());
+  warmup->threads_left = threads;
+  for (int t = 0; t < threads; ++t)
+    m_warmers.emplace_back(&connection_pool::warm_up, this, warmup, start);
+
+  std::unique_lock<std::mutex> lock(warmup->mutex);
+  warmup->cv.wait(lock, [&] {
+    return warmup->ready >= MinReady ||
+           warmup->ready + warmup->failed == MaxConn;
+  });
+  if (warmup->ready < MinReady)
+    LOG_WARN("MySQL pool: only %d/%d connections could be opened, the rest "
+             "reconnect on checkout",
+             warmup->ready, MaxConn);
+  LOG_INFO("MySQL pool: %d/%d connections ready in %lld ms (host=%s), "
+           "%d more warming up in background",
+           warmup->ready, MaxConn, static_cast<long long>(elapsed_ms(start)),
+           m_url.c_str(), MaxConn - warmup->ready - warmup->failed);
+}
+
+// 预热线程: 领取句柄并建连，成败都放入池中（失败为坏槽）
+void connection_pool::warm_up(std::shared_ptr<Warmup> warmup,
+                              std::chrono::steady_clock::time_point start) {
+  int port = std::stoi(m_Port);
+  for (size_t i; (i = warmup->next.fetch_add(1)) < warmup->handles.size();) {
+    MYSQL *mysql_conn = warmup->handles[i];
+    bool ok = mysql_real_connect(mysql_conn, m_url.c_str(), m_User.c_str(),
+                                 m_PassWord.c_str(), m_DatabaseName.c_str(),
+                                 port, NULL, 0) != nullptr;
+    if (!ok) {
+      // 数据库退化时可能大量失败，只记第一条，汇总见预热完成日志
+      if (warmup->failed_logged.exchange(true) == false)
+        LOG_WARN("MySQL pool: warm-up connection failed: %s",
+                 mysql_error(mysql_conn));
+      pooled_mysql_close(mysql_conn);
+      mysql_conn = nullptr;
+    }
+    m_conns.add(mysql_conn);
+    {
+      std::lock_guard<std::mutex> lock(warmup->mutex);
+      ++(ok ? warmup->ready : warmup->failed);
+    }
+    warmup->cv.notify_all();
+  }
+
+  std::lock_guard<std::mutex> lock(warmup->mutex);
+  if (--warmup->threads_left == 0)
+    LOG_INFO("MySQL pool: warm-up complete in %lld ms (%d connected, %d "
+             "failed)",
+             static_cast<long long>(elapsed_ms(start)), warmup->ready,
+             warmup->failed);
+}
+
+MYSQL *connection_pool::connect() const {
+  MYSQL *mysql_conn = new_handle(nullptr);
+  if (!mysql_conn)
+    return nullptr;
+  if (!mysql_real_connect(mysql_conn, m_url.c_str(), m_User.c_str(),
+                          m_PassWord.c_str(), m_DatabaseName.c_str(),
+                          std::stoi(m_Port), NULL, 0)) {
+    pooled_mysql_close(mysql_conn);
+    return nullptr;
+  }
+  return mysql_conn;
+}
+
+// 上一次调用已报告连接断开
+static bool connection_lost(MYSQL *mysql_conn) {
+  unsigned int err = mysql_errno(mysql_conn);
+  return err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST;
+}
+
+// 当有请求时，从数据库连接池中返回一个可用连接
+MYSQL *connection_pool::GetConnection() {
+  // 只统计不拒绝: 调用仅为推进 OPEN → HALF_OPEN，rejected 计数即"本应拒绝"的次数
+  (void)m_pool_breaker.allow_request();
+
+  // 有空闲连接时只有几次原子操作；池耗尽才阻塞
+  LockFreePool<MYSQL>::Lease lease;
+  m_conns.acquire(lease);
+  MYSQL *mysql_conn = lease.conn;
+
+  // 健康检查: 只对空闲过久或上次已报告断开的连接 ping，热连接不付 RTT
+  bool need_check = !mysql_conn || lease.idle_ms > HEALTH_CHECK_IDLE_MS ||
+                    connection_lost(mysql_conn);
+  if (need_check && (!mysql_conn || mysql_ping(mysql_conn) != 0)) {
+    // 连接已失效（或是上次重连失败留下的坏槽），重连；
+    // 旧连接上的预编译语句随之释放，新连接按需重新 prepare
+    pooled_mysql_close(mysql_conn);
+    mysql_conn = connect();
+
+    // 重连失败：放回坏槽，名额不丢，下一个借到它的调用方再重连
+    if (!mysql_conn) {
+      m_conns.release(nullptr);
+      m_pool_breaker.on_failure();
+      return nullptr;
+    }
+  }
+
+  m_pool_breaker.on_checkout(lease.waited);
+  return mysql_conn;
+}
+
+// 释放当前使用的连接
+bool connection_pool::ReleaseConnection(MYSQL *mysql_conn) {
+  if (!mysql_conn) {
+    return false;
+  }
+  // 优先放回本线程缓存槽，唤醒可能在等待的线程
+  m_conns.release(mysql_conn);
+  return true;
+}
+
+// ── 线程亲和 ────────────────────────────────────────────────────────────
+
+static int64_t steady_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+namespace {
+// 本线程绑定的连接: REQUEST 模式在作用域结束时归还，THREAD 模式随线程退出归还
+struct ThreadBinding {
+  connection_pool *pool = nullptr;
+  MYSQL *conn = nullptr;
+  int depth = 0;             // 嵌套的 RequestScope 层数
+  int64_t last_used_ms = 0;
+
+  ~ThreadBinding() {
+    if (conn)
+      pool->ReleaseConnection(conn);
+  }
+};
+thread_local ThreadBinding t_binding;
+} // namespace
+
+bool connection_pool::parse_affinity(const string &name, Affinity &out) {
+  if (name == "query")
+    out = Affinity::QUERY;
+  else if (name == "request")
+    out = Affinity::REQUEST;
+  else if (name == "thread")
+    out = Affinity::THREAD;
+  else
+    return false;
+  return true;
+}
+
+MYSQL *connection_pool::AcquireScoped(bool &bound) {
+  ThreadBinding &b = t_binding;
+  bound = m_affinity != Affinity::QUERY && b.depth > 0;
+  if (!bound)
+    return GetConnection();
+
+  int64_t now = steady_ms();
+  // THREAD 模式下连接可能在线程手里闲置很久: 与池内连接同样的健康检查。
+  // 失效的连接还回池里，池在再次借出时发现断开并重连
+  if (b.conn && (connection_lost(b.conn) ||
+                 (now - b.last_used_ms > HEALTH_CHECK_IDLE_MS &&
+                  mysql_ping(b.conn) != 0))) {
+    ReleaseConnection(b.conn);
+    b.conn = nullptr;
+  }
+  if (!b.conn) {
+    b.conn = GetConnection();
+    b.pool = this;
+  }
+  b.last_used_ms = now;
+  return b.conn;
+}
+
+connection_pool::RequestScope::RequestScope(connection_pool *pool)
+    : m_pool(pool) {
+  ++t_binding.depth;
+}
+
+connection_pool::RequestScope::~RequestScope() {
+  ThreadBinding &b = t_binding;
+  if (--b.depth == 0 && b.conn && m_pool->affinity() != Affinity::THREAD) {
+    m_pool->ReleaseConnection(b.conn);
+    b.conn = nullptr;
+  }
+}
+
+connection_pool::~connection_pool() {
+  for (std::thread &t : m_warmers)
+    t.join();
+  m_conns.drain([](MYSQL *mysql_conn) { pooled_mysql_close(mysql_conn); });
+}
+
+connectionRAII::connectionRAII(MYSQL **SQL, connection_pool *connPool) {
+  *SQL = connPool->AcquireScoped(boundRAII);
+
+  conRAII = *SQL;
+  poolRAII = connPool;
+}
+
+connectionRAII::~connectionRAII() {
+  if (!boundRAII)
+    poolRAII->ReleaseConnection(conRAII);
+}
\ No newline at end of file
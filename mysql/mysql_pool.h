@@ -1,44 +1,112 @@
 #ifndef _CONNECTION_POOL_
 #define _CONNECTION_POOL_
 
-#include <deque>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <error.h>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <mysql/mysql.h>
-#include <semaphore>
 #include <stdio.h>
 #include <string.h>
 #include <string>
-#include <unordered_map>
+#include <thread>
+#include <vector>
 
-using namespace std;
+#include "pool/lockfree_pool.h"
+#include "redis/circuit_breaker.h"
 
-const int MAX_CONN = 10000; // 最大信号量值
+using namespace std;
 
 class connection_pool {
 public:
   MYSQL *GetConnection();              // 获取数据库连接
   bool ReleaseConnection(MYSQL *conn); // 释放连接
 
+  // 连接与 worker 线程的绑定方式（作用于 RequestScope 内的 connectionRAII）
+  enum class Affinity {
+    QUERY,   // 每个 connectionRAII 各借各还
+    REQUEST, // 一个请求内复用首次借到的连接，请求结束归还（默认）
+    THREAD   // worker 首次借到后一直持有，池大小须不小于 worker 数
+  };
+  void set_affinity(Affinity a) { m_affinity = a; }
+  Affinity affinity() const { return m_affinity; }
+  // "query" / "request" / "thread"，无法识别返回 false
+  static bool parse_affinity(const string &name, Affinity &out);
+
+  // worker 处理一个请求的作用域（thread_pool 在 process() 外构造）。
+  // 作用域内所有 connectionRAII 共用一条按需借出的连接: /4 未命中、
+  // 增删改与其审计日志不再各自借还，连接在请求中途也不会切换
+  class RequestScope {
+  public:
+    explicit RequestScope(connection_pool *pool);
+    ~RequestScope();
+    RequestScope(const RequestScope &) = delete;
+    RequestScope &operator=(const RequestScope &) = delete;
+
+  private:
+    connection_pool *m_pool;
+  };
+
+  // 供 connectionRAII 使用: 作用域内返回本线程绑定的连接并置 bound = true
+  // （由作用域负责归还），否则等同 GetConnection()
+  MYSQL *AcquireScoped(bool &bound);
+
   // 单例模式
   static connection_pool *GetInstance();
 
+  // 并发建连，MinReady 条就绪即返回（<= 0 取 INIT_MIN_READY），其余在后台补齐
   void init(const string &url, const string &User, const string &PassWord,
-            const string &DBName, int Port, int MaxConn);
+            const string &DBName, int Port, int MaxConn, int MinReady = 0);
+
+  // MySQL 查询熔断器: 由查询方上报结果与耗时（见 http_conn::load_score），
+  // 熔断期间缓存未命中直接失败，不再排队压垮数据库
+  CircuitBreaker &query_breaker() { return m_query_breaker; }
+  // 连接池熔断器: 借连接等待时长 / 重连失败。调用方普遍假定连接非空，
+  // 这里只做健康统计，不拒绝借用
+  CircuitBreaker &pool_breaker() { return m_pool_breaker; }
+
+  // 借连接统计: 次数、线程缓存命中、阻塞等待直方图
+  LockFreePool<MYSQL>::Stats checkout_stats() const { return m_conns.stats(); }
 
 private:
   connection_pool();
   ~connection_pool();
 
+  // 新建一条连接（设置超时），失败返回 nullptr
+  MYSQL *connect() const;
+
+  // 启动预热: init() 与预热线程共享，最后一个预热线程退出后释放
+  struct Warmup {
+    std::vector<MYSQL *> handles; // 已设好选项、尚未建连的句柄
+    std::atomic<size_t> next{0};  // 下一个待领取的句柄
+    std::atomic<bool> failed_logged{false};
+    std::mutex mutex;
+    std::condition_variable cv;
+    int ready = 0;
+    int failed = 0;
+    int threads_left = 0;
+  };
+  void warm_up(std::shared_ptr<Warmup> warmup,
+               std::chrono::steady_clock::time_point start);
+
+  static constexpr int INIT_CONCURRENCY = 8; // 并发握手数
+  static constexpr int INIT_MIN_READY = 16;  // MinReady 缺省: 就绪这么多条即开始服务
+
+  // 空闲超过该时长（可能已被服务端 wait_timeout 断开）才在借出时 ping
+  static constexpr int64_t HEALTH_CHECK_IDLE_MS = 60 * 1000;
+
   int m_MaxConn;  // 最大连接数
-  int m_CurConn;  // 当前已使用的连接数
-  int m_FreeConn; // 当前空闲的连接数
-  std::mutex lock;
-  std::deque<MYSQL *> connList; // 连接池
-  std::counting_semaphore<MAX_CONN> semaphore_{0};
-  std::mutex m_health_mutex;
-  std::unordered_map<MYSQL *, time_t> m_last_health_check;
+  LockFreePool<MYSQL> m_conns; // 空闲连接（线程缓存槽 + 无锁栈）
+  std::vector<std::thread> m_warmers; // 启动预热线程（建连完成即退出）
+  Affinity m_affinity = Affinity::REQUEST;
+
+  CircuitBreaker m_query_breaker{
+      "mysql", CircuitBreaker::Options{.slow_call_ms = 1000, .slow_rate = 0.8}};
+  CircuitBreaker m_pool_breaker{
+      "mysql_pool", CircuitBreaker::Options{.slow_call_ms = 200, .slow_rate = 0.5}};
 
 public:
   string m_url;          // 主机地址
@@ -57,6 +125,7 @@ public:
 private:
   MYSQL *conRAII;
   connection_pool *poolRAII;
+  bool boundRAII; // 连接属于 RequestScope，析构时不归还
 };
 
 #endif
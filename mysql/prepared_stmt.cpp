@@ -0,0 +1,258 @@
+#include "prepared_stmt.h"
+#include "log/log.h"
+#include <array>
+#include <mysql/mysqld_error.h>
+#include <string.h>
+#include <type_traits>
+
+namespace {
+
+constexpr size_t STMT_COUNT = static_cast<size_t>(StmtId::COUNT);
+
+// 下标与 StmtId 一一对应
+constexpr std::array<const char *, STMT_COUNT> STMT_SQL = {
+    // SCORE_LOOKUP
+    "SELECT s.student_id, s.name, s.id_card, s.gender, "
+    "s.province, s.school, "
+    "subj.subject_name, sc.score "
+    "FROM student s "
+    "JOIN score sc ON sc.student_id = s.student_id "
+    "JOIN subject subj ON subj.subject_id = sc.subject_id "
+    "WHERE s.name=? AND s.id_card=?",
+    // USER_EXISTS
+    "SELECT id FROM server_users WHERE username=?",
+    // USER_INSERT
+    "INSERT INTO server_users (username, password_hash, role) "
+    "VALUES (?, ?, 'user')",
+    // USER_LOGIN
+    "SELECT id, password_hash, role FROM server_users "
+    "WHERE username=? LIMIT 1",
+    // AUDIT_INSERT
+    "INSERT INTO audit_log (username, operation, target, detail) "
+    "VALUES (?,?,?,?)",
+    // STUDENT_INSERT
+    "INSERT INTO student (name, id_card, gender, province, school) "
+    "VALUES (?,?,?,?,?)",
+    // STUDENT_KEY
+    "SELECT name, id_card FROM student WHERE student_id=?",
+    // STUDENT_UPDATE
+    "UPDATE student SET name=COALESCE(?, name), "
+    "id_card=COALESCE(?, id_card), gender=COALESCE(?, gender), "
+    "province=COALESCE(?, province), school=COALESCE(?, school) "
+    "WHERE student_id=?",
+    // STUDENT_DELETE
+    "DELETE FROM student WHERE student_id=?",
+};
+
+// 池内连接: MYSQL 句柄为首成员，MYSQL* 与 PooledMysql* 可互相转换
+struct PooledMysql {
+  MYSQL mysql;
+  std::array<MYSQL_STMT *, STMT_COUNT> stmts{};
+};
+static_assert(std::is_standard_layout_v<PooledMysql>);
+
+PooledMysql *pooled(MYSQL *mysql) {
+  return reinterpret_cast<PooledMysql *>(mysql);
+}
+
+// 取该连接上缓存的语句，没有则 prepare
+MYSQL_STMT *prepare(MYSQL *mysql, StmtId id) {
+  size_t idx = static_cast<size_t>(id);
+  MYSQL_STMT *&slot = pooled(mysql)->stmts[idx];
+  if (slot)
+    return slot;
+
+  MYSQL_STMT *stmt = mysql_stmt_init(mysql);
+  if (!stmt)
+    return nullptr;
+  if (mysql_stmt_prepare(stmt, STMT_SQL[idx], strlen(STMT_SQL[idx]))) {
+    LOG_WARN("MySQL prepare failed (stmt %zu): %s", idx,
+             mysql_stmt_error(stmt));
+    mysql_stmt_close(stmt);
+    return nullptr;
+  }
+  slot = stmt;
+  return stmt;
+}
+
+void discard(MYSQL *mysql, StmtId id) {
+  MYSQL_STMT *&slot = pooled(mysql)->stmts[static_cast<size_t>(id)];
+  if (slot)
+    mysql_stmt_close(slot);
+  slot = nullptr;
+}
+
+// 服务端已不认识该语句句柄，需要重新 prepare
+bool stale(MYSQL_STMT *stmt) {
+  unsigned int err = mysql_stmt_errno(stmt);
+  return err == ER_UNKNOWN_STMT_HANDLER || err == ER_NEED_REPREPARE;
+}
+
+// 结果列的初始缓冲区，更长的列按实际长度重新读取
+constexpr size_t INITIAL_COL_BYTES = 256;
+
+} // namespace
+
+const char *stmt_sql(StmtId id) { return STMT_SQL[static_cast<size_t>(id)]; }
+
+MYSQL *pooled_mysql_init() {
+  PooledMysql *p = new PooledMysql();
+  if (!mysql_init(&p->mysql)) {
+    delete p;
+    return nullptr;
+  }
+  return &p->mysql;
+}
+
+void pooled_mysql_close(MYSQL *mysql) {
+  if (!mysql)
+    return;
+  PooledMysql *p = pooled(mysql);
+  for (MYSQL_STMT *stmt : p->stmts) {
+    if (stmt)
+      mysql_stmt_close(stmt);
+  }
+  mysql_close(mysql);
+  delete p;
+}
+
+PreparedQuery::PreparedQuery(MYSQL *mysql, StmtId id)
+    : m_mysql(mysql), m_id(id), m_stmt(mysql ? prepare(mysql, id) : nullptr) {
+  m_params.reserve(6);
+}
+
+PreparedQuery::~PreparedQuery() {
+  if (m_has_result)
+    mysql_stmt_free_result(m_stmt);
+}
+
+PreparedQuery &PreparedQuery::arg(std::string_view s) {
+  m_params.push_back(Param{MYSQL_TYPE_STRING, s});
+  return *this;
+}
+
+PreparedQuery &PreparedQuery::arg_or_null(std::string_view s) {
+  m_params.push_back(Param{MYSQL_TYPE_STRING, s, 0, 0, s.empty()});
+  return *this;
+}
+
+PreparedQuery &PreparedQuery::arg(long long v) {
+  m_params.push_back(Param{MYSQL_TYPE_LONGLONG, {}, v});
+  return *this;
+}
+
+bool PreparedQuery::bind_and_execute() {
+  if (m_params.size() != mysql_stmt_param_count(m_stmt)) {
+    LOG_ERROR("MySQL stmt %d: %zu params bound, %lu expected",
+              static_cast<int>(m_id), m_params.size(),
+              mysql_stmt_param_count(m_stmt));
+    return false;
+  }
+
+  // mysql_stmt_bind_param 会拷贝 MYSQL_BIND，长度字段仍指向 m_params
+  std::vector<MYSQL_BIND> binds(m_params.size());
+  for (size_t i = 0; i < m_params.size(); ++i) {
+    Param &p = m_params[i];
+    MYSQL_BIND &b = binds[i];
+    if (p.null) {
+      b.buffer_type = MYSQL_TYPE_NULL;
+    } else if (p.type == MYSQL_TYPE_STRING) {
+      p.length = p.str.size();
+      b.buffer_type = MYSQL_TYPE_STRING;
+      b.buffer = const_cast<char *>(p.str.empty() ? "" : p.str.data());
+      b.buffer_length = p.length;
+      b.length = &p.length;
+    } else {
+      b.buffer_type = MYSQL_TYPE_LONGLONG;
+      b.buffer = &p.num;
+    }
+  }
+  if (!binds.empty() && mysql_stmt_bind_param(m_stmt, binds.data()))
+    return false;
+  return mysql_stmt_execute(m_stmt) == 0;
+}
+
+bool PreparedQuery::execute() {
+  if (!m_stmt)
+    return false;
+
+  bool ok = bind_and_execute();
+  if (!ok && stale(m_stmt)) {
+    // 服务端丢弃了语句（如表结构变更后重准备失败），重新 prepare 后重试一次
+    discard(m_mysql, m_id);
+    m_stmt = prepare(m_mysql, m_id);
+    ok = m_stmt && bind_and_execute();
+  }
+  if (!ok)
+    return false;
+
+  if (mysql_stmt_field_count(m_stmt) == 0)
+    return true;
+  if (mysql_stmt_store_result(m_stmt))
+    return false;
+  m_has_result = true;
+  return bind_result();
+}
+
+bool PreparedQuery::bind_result() {
+  unsigned int n = mysql_stmt_field_count(m_stmt);
+  m_cols.resize(n);
+  m_result_binds.assign(n, MYSQL_BIND{});
+  for (unsigned int i = 0; i < n; ++i) {
+    Column &c = m_cols[i];
+    c.buf.resize(INITIAL_COL_BYTES);
+    MYSQL_BIND &b = m_result_binds[i];
+    b.buffer_type = MYSQL_TYPE_STRING;
+    b.buffer = c.buf.data();
+    b.buffer_length = c.buf.size();
+    b.length = &c.length;
+    b.is_null = &c.null;
+    b.error = &c.error;
+  }
+  return !mysql_stmt_bind_result(m_stmt, m_result_binds.data());
+}
+
+bool PreparedQuery::fetch() {
+  if (!m_has_result)
+    return false;
+  int rc = mysql_stmt_fetch(m_stmt);
+  if (rc != 0 && rc != MYSQL_DATA_TRUNCATED)
+    return false;
+
+  bool rebind = false;
+  for (unsigned int i = 0; i < m_cols.size(); ++i) {
+    Column &c = m_cols[i];
+    if (c.null) {
+      c.value.clear();
+      continue;
+    }
+    if (c.length > c.buf.size()) {
+      // 列比缓冲区长: 按实际长度单独读取该列，并放大缓冲区供后续行使用
+      c.buf.resize(c.length);
+      MYSQL_BIND &b = m_result_binds[i];
+      b.buffer = c.buf.data();
+      b.buffer_length = c.buf.size();
+      if (mysql_stmt_fetch_column(m_stmt, &b, i, 0))
+        return false;
+      rebind = true;
+    }
+    c.value.assign(c.buf.data(), c.length);
+  }
+  if (rebind && mysql_stmt_bind_result(m_stmt, m_result_binds.data()))
+    return false;
+  return true;
+}
+
+uint64_t PreparedQuery::affected_rows() const {
+  return m_stmt ? mysql_stmt_affected_rows(m_stmt) : 0;
+}
+
+uint64_t PreparedQuery::insert_id() const {
+  return m_stmt ? mysql_stmt_insert_id(m_stmt) : 0;
+}
+
+const char *PreparedQuery::error() const {
+  if (m_stmt)
+    return mysql_stmt_error(m_stmt);
+  return m_mysql ? mysql_error(m_mysql) : "no connection";
+}
@@ -0,0 +1,99 @@
+#ifndef PREPARED_STMT_H
+#define PREPARED_STMT_H
+
+#include <cstdint>
+#include <mysql/mysql.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 服务端预编译语句缓存 —— 热路径 SQL（查分、登录、注册、审计、学生增删改）
+//
+// 原先每次请求都 mysql_real_escape_string + snprintf 拼出文本 SQL，服务端每次
+// 重新解析、生成执行计划。这里每条连接按语句编号缓存 MYSQL_STMT: 首次使用时
+// prepare，之后只发送二进制协议的参数、按绑定缓冲区取回结果，客户端不再转义。
+//
+// 缓存随连接存放（池内 MYSQL 句柄分配在 PooledMysql 里），由 MYSQL* 直接找到，
+// 不查表不加锁；连接被池关闭重连时语句一并释放，新连接上按需重新 prepare。
+// 服务端报告语句句柄失效（ER_UNKNOWN_STMT_HANDLER / ER_NEED_REPREPARE）时
+// 重新 prepare 并重试一次。
+
+// 语句编号（SQL 见 prepared_stmt.cpp 中的 STMT_SQL）
+enum class StmtId : uint8_t {
+  SCORE_LOOKUP,   // /4 按姓名 + 身份证号查成绩
+  USER_EXISTS,    // 注册: 用户名查重
+  USER_INSERT,    // 注册: 新建用户
+  USER_LOGIN,     // 登录: 取密码哈希与角色
+  AUDIT_INSERT,   // 审计日志
+  STUDENT_INSERT,
+  STUDENT_KEY,    // 按学号取 name, id_card（成绩缓存键）
+  STUDENT_UPDATE, // 参数为 NULL 的字段保持原值
+  STUDENT_DELETE,
+  COUNT
+};
+
+// 语句的 SQL 文本（参数占位符为 ?）
+const char *stmt_sql(StmtId id);
+
+// 池内连接句柄的分配 / 关闭（关闭时一并释放该连接上已准备的语句）。
+// connection_pool 的连接都经由这两个函数创建和销毁
+MYSQL *pooled_mysql_init();
+void pooled_mysql_close(MYSQL *mysql);
+
+// 一次预编译语句的执行: 构造时取出（必要时 prepare）缓存的语句，依次绑定参数
+// 后 execute()，SELECT 再逐行 fetch()。析构时释放结果集，语句留在连接上复用。
+// 结果列一律以字符串取出（与文本协议的 MYSQL_ROW 一致），超出缓冲区的列按实际
+// 长度重新读取，不会截断。
+class PreparedQuery {
+public:
+  PreparedQuery(MYSQL *mysql, StmtId id);
+  ~PreparedQuery();
+  PreparedQuery(const PreparedQuery &) = delete;
+  PreparedQuery &operator=(const PreparedQuery &) = delete;
+
+  // 依次绑定参数，个数须与语句中的 ? 一致；string_view 须存活到 execute()
+  PreparedQuery &arg(std::string_view s);
+  PreparedQuery &arg_or_null(std::string_view s); // 空串绑定为 NULL
+  PreparedQuery &arg(long long v);
+
+  // 执行；有结果集时整体取回客户端（同 mysql_store_result）
+  bool execute();
+  // 取下一行，无更多行或出错返回 false
+  bool fetch();
+  // 当前行第 i 列（NULL 为空串）
+  const std::string &col(size_t i) const { return m_cols[i].value; }
+  bool is_null(size_t i) const { return m_cols[i].null; }
+
+  uint64_t affected_rows() const;
+  uint64_t insert_id() const;
+  const char *error() const;
+
+private:
+  struct Param {
+    enum_field_types type;
+    std::string_view str;
+    long long num = 0;
+    unsigned long length = 0;
+    bool null = false;
+  };
+  struct Column {
+    std::vector<char> buf; // 绑定的结果缓冲区
+    std::string value;
+    unsigned long length = 0;
+    bool null = false;
+    bool error = false;
+  };
+
+  bool bind_and_execute();
+  bool bind_result();
+
+  MYSQL *m_mysql;
+  StmtId m_id;
+  MYSQL_STMT *m_stmt;
+  std::vector<Param> m_params;
+  std::vector<Column> m_cols;
+  std::vector<MYSQL_BIND> m_result_binds;
+  bool m_has_result = false;
+};
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef LOCKFREE_POOL_H
+#define LOCKFREE_POOL_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <semaphore>
+#include <thread>
+
+// 无锁连接池核心 —— connection_pool（MySQL）与 redis_pool 的每个分片共用
+//
+// 原实现每次借 / 还都是 信号量 + std::mutex + std::deque，MySQL 另有健康检查
+// 互斥锁 + map 查找，几十个 worker 同时借连接时在锁上排队。这里借出空闲连接只需
+// 几次原子操作:
+//   1. 信号量 try_acquire（计数 = 空闲连接数，只有池耗尽时才真正阻塞）
+//   2. 本线程缓存槽 exchange: 同一线程多半刚归还又借出同一条连接，不碰共享状态
+//   3. 缓存槽为空时从共享 Treiber 栈弹出；栈也空（连接停在其他线程的缓存槽里）
+//      时逐个窃取
+// 节点为定长数组，栈里只存下标，栈顶带版本号防 ABA。连接与其空闲起始时间随节点
+// 保存，借出时一并返回，调用方据此决定是否做健康检查，无需按连接查表。
+//
+// 连接可以为 nullptr（"坏槽"）: 重连失败时放回坏槽而不是丢弃名额，
+// 下一个借到它的调用方负责重连，池的容量因此不会随故障逐渐缩小。
+//
+// 只有必须阻塞时才计时，等待时长记入 log2 直方图（微秒）。
+template <typename Conn> class LockFreePool {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Lease {
+    Conn *conn = nullptr;  // 可能为 nullptr（坏槽，需重连）
+    int64_t idle_ms = 0;   // 在池中空闲了多久
+    Clock::duration waited{}; // 阻塞等待时长（快路径为 0）
+  };
+
+  struct Stats {
+    size_t capacity = 0;
+    uint64_t checkouts = 0;
+    uint64_t cache_hits = 0;  // 直接从本线程缓存槽取得
+    uint64_t waits = 0;       // 池耗尽、阻塞等待的次数
+    uint64_t wait_p50_us = 0; // 以下只统计阻塞等待（直方图桶上界）
+    uint64_t wait_p99_us = 0;
+    uint64_t wait_max_us = 0;
+  };
+
+  static constexpr size_t MAX_CONNS = 10000;
+  static constexpr size_t CACHE_SLOTS = 64; // 线程按序号取模共用，冲突只是少命中
+
+  LockFreePool() = default;
+  LockFreePool(const LockFreePool &) = delete;
+  LockFreePool &operator=(const LockFreePool &) = delete;
+
+  // 分配节点，须在 add() / acquire() 之前调用一次
+  void init(size_t capacity) {
+    capacity_ = std::min(capacity, MAX_CONNS);
+    nodes_ = std::make_unique<Node[]>(capacity_);
+    for (uint32_t i = 0; i < capacity_; ++i)
+      push(empty_, i);
+  }
+
+  // 初始化阶段放入一条连接（nullptr = 坏槽），超过容量返回 false
+  bool add(Conn *conn) {
+    uint32_t idx = pop(empty_);
+    if (idx == NONE)
+      return false;
+    nodes_[idx].conn = conn;
+    nodes_[idx].idle_since_ms = now_ms();
+    push(free_, idx);
+    sem_.release();
+    return true;
+  }
+
+  // wait = false 时池耗尽立即返回 false
+  bool acquire(Lease &out, bool wait = true) {
+    if (!capacity_)
+      return false;
+    if (!sem_.try_acquire()) {
+      if (!wait)
+        return false;
+      Clock::time_point start = Clock::now();
+      sem_.acquire();
+      out.waited = Clock::now() - start;
+      record_wait(out.waited);
+    } else {
+      out.waited = Clock::duration::zero();
+    }
+
+    CacheSlot &slot = caches_[thread_slot()];
+    slot.checkouts.fetch_add(1, std::memory_order_relaxed);
+    uint32_t idx = slot.node.exchange(NONE, std::memory_order_acq_rel);
+    if (idx != NONE)
+      slot.cache_hits.fetch_add(1, std::memory_order_relaxed);
+    else
+      idx = take_shared();
+
+    Node &n = nodes_[idx];
+    out.conn = n.conn;
+    out.idle_ms = now_ms() - n.idle_since_ms;
+    n.conn = nullptr;
+    push(empty_, idx);
+    return true;
+  }
+
+  // 归还借出的连接（nullptr = 重连失败的坏槽）
+  void release(Conn *conn) {
+    // 借出中的连接数 = 空节点数，借出过就一定有空节点
+    uint32_t idx = pop(empty_);
+    assert(idx != NONE);
+    nodes_[idx].conn = conn;
+    nodes_[idx].idle_since_ms = now_ms();
+
+    // 优先放进本线程缓存槽，槽被占用（同槽的其他线程）时入共享栈
+    CacheSlot &slot = caches_[thread_slot()];
+    uint32_t expected = NONE;
+    if (!slot.node.compare_exchange_strong(expected, idx,
+                                           std::memory_order_acq_rel))
+      push(free_, idx);
+    sem_.release();
+  }
+
+  // 析构时取出全部空闲连接（调用方关闭），借出未还的连接不在其中
+  template <typename F> void drain(F &&close) {
+    for (CacheSlot &slot : caches_) {
+      uint32_t idx = slot.node.exchange(NONE);
+      if (idx != NONE)
+        push(free_, idx);
+    }
+    for (uint32_t idx; (idx = pop(free_)) != NONE;) {
+      if (nodes_[idx].conn)
+        close(nodes_[idx].conn);
+      nodes_[idx].conn = nullptr;
+      push(empty_, idx);
+    }
+  }
+
+  size_t capacity() const { return capacity_; }
+
+  Stats stats() const {
+    Stats s;
+    s.capacity = capacity_;
+    for (const CacheSlot &slot : caches_) {
+      s.checkouts += slot.checkouts.load(std::memory_order_relaxed);
+      s.cache_hits += slot.cache_hits.load(std::memory_order_relaxed);
+    }
+    std::array<uint64_t, WAIT_BUCKETS> h;
+    for (size_t b = 0; b < WAIT_BUCKETS; ++b) {
+      h[b] = wait_hist_[b].load(std::memory_order_relaxed);
+      s.waits += h[b];
+    }
+    s.wait_p50_us = percentile(h, s.waits, 0.50);
+    s.wait_p99_us = percentile(h, s.waits, 0.99);
+    s.wait_max_us = wait_max_us_.load(std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  static constexpr uint32_t NONE = UINT32_MAX;
+  static constexpr size_t WAIT_BUCKETS = 32; // 桶 b: [2^(b-1), 2^b) 微秒
+
+  struct Node {
+    Conn *conn = nullptr;
+    int64_t idle_since_ms = 0;
+    std::atomic<uint32_t> next{NONE};
+  };
+
+  // 栈顶: 高 32 位版本号 + 低 32 位节点下标
+  struct alignas(64) Stack {
+    std::atomic<uint64_t> head{NONE};
+  };
+
+  struct alignas(64) CacheSlot {
+    std::atomic<uint32_t> node{NONE};
+    std::atomic<uint64_t> checkouts{0};
+    std::atomic<uint64_t> cache_hits{0};
+  };
+
+  void push(Stack &s, uint32_t idx) {
+    uint64_t head = s.head.load(std::memory_order_relaxed);
+    do {
+      nodes_[idx].next.store(static_cast<uint32_t>(head),
+                             std::memory_order_relaxed);
+    } while (!s.head.compare_exchange_weak(
+        head, ((head >> 32) + 1) << 32 | idx, std::memory_order_release,
+        std::memory_order_relaxed));
+  }
+
+  uint32_t pop(Stack &s) {
+    uint64_t head = s.head.load(std::memory_order_acquire);
+    for (;;) {
+      uint32_t idx = static_cast<uint32_t>(head);
+      if (idx == NONE)
+        return NONE;
+      // 节点可能已被他人弹出再压回: next 读到旧值时版本号不同，CAS 失败重试
+      uint32_t next = nodes_[idx].next.load(std::memory_order_relaxed);
+      if (s.head.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | next,
+                                       std::memory_order_acquire,
+                                       std::memory_order_acquire))
+        return idx;
+    }
+  }
+
+  // 已取得信号量: 共享栈或某个线程的缓存槽里必有一条为本线程保留的连接
+  uint32_t take_shared() {
+    for (;;) {
+      uint32_t idx = pop(free_);
+      if (idx != NONE)
+        return idx;
+      for (CacheSlot &slot : caches_) {
+        if (slot.node.load(std::memory_order_relaxed) == NONE)
+          continue;
+        idx = slot.node.exchange(NONE, std::memory_order_acq_rel);
+        if (idx != NONE)
+          return idx;
+      }
+      // 扫描期间其他线程的归还落进了已扫过的槽，再来一轮
+      std::this_thread::yield();
+    }
+  }
+
+  void record_wait(Clock::duration waited) {
+    uint64_t us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(waited).count());
+    size_t b = std::min<size_t>(std::bit_width(us), WAIT_BUCKETS - 1);
+    wait_hist_[b].fetch_add(1, std::memory_order_relaxed);
+    uint64_t prev = wait_max_us_.load(std::memory_order_relaxed);
+    while (us > prev && !wait_max_us_.compare_exchange_weak(
+                            prev, us, std::memory_order_relaxed)) {
+    }
+  }
+
+  static uint64_t percentile(const std::array<uint64_t, WAIT_BUCKETS> &h,
+                             uint64_t total, double q) {
+    if (!total)
+      return 0;
+    uint64_t rank = static_cast<uint64_t>(q * (total - 1)) + 1, seen = 0;
+    for (size_t b = 0; b < WAIT_BUCKETS; ++b) {
+      seen += h[b];
+      if (seen >= rank)
+        return b ? (uint64_t{1} << b) - 1 : 0;
+    }
+    return 0;
+  }
+
+  static size_t thread_slot() {
+    static std::atomic<size_t> next_id{0};
+    thread_local size_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+    return id % CACHE_SLOTS;
+  }
+
+  static int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               Clock::now().time_since_epoch())
+        .count();
+  }
+
+  size_t capacity_ = 0;
+  std::unique_ptr<Node[]> nodes_;
+  Stack free_;  // 空闲连接
+  Stack empty_; // 未装连接的节点（数量 = 借出中的连接数）
+  std::counting_semaphore<MAX_CONNS> sem_{0};
+  std::array<CacheSlot, CACHE_SLOTS> caches_{};
+  std::array<std::atomic<uint64_t>, WAIT_BUCKETS> wait_hist_{};
+  std::atomic<uint64_t> wait_max_us_{0};
+};
+
+#endif
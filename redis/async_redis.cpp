@@ -0,0 +1,414 @@
+#include "async_redis.h"
+#include "log/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+AsyncRedis *AsyncRedis::GetInstance() {
+  static AsyncRedis instance;
+  return &instance;
+}
+
+int64_t AsyncRedis::now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool AsyncRedis::init(int epollfd, const std::vector<RedisEndpoint> &endpoints,
+                      const std::string &password, int db_index) {
+  epollfd_ = epollfd;
+  password_ = password;
+  db_index_ = db_index;
+
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (event_fd_ < 0 || timer_fd_ < 0) {
+    LOG_ERROR("AsyncRedis: eventfd/timerfd failed: %s", strerror(errno));
+    return false;
+  }
+  for (int fd : {event_fd_, timer_fd_}) {
+    epoll_event ev{};
+    ev.data.fd = fd;
+    ev.events = EPOLLIN;
+    epoll_ctl(epollfd_, EPOLL_CTL_ADD, fd, &ev);
+  }
+  add_shards(endpoints);
+  return true;
+}
+
+void AsyncRedis::add_shards(const std::vector<RedisEndpoint> &endpoints) {
+  if (epollfd_ < 0)
+    return;
+  size_t n = std::min(endpoints.size(), links_.size());
+  for (size_t i = link_count(); i < n; ++i) {
+    auto link = std::make_unique<Link>();
+    link->owner = this;
+    link->endpoint = endpoints[i];
+    links_[i] = std::move(link);
+    link_count_.store(i + 1, std::memory_order_release);
+    // 首次连接失败不影响启用，tick() 会持续重连
+    connect(*links_[i]);
+  }
+}
+
+AsyncRedis::Link *AsyncRedis::link_of(int fd) const {
+  for (size_t i = 0, n = link_count(); i < n; ++i)
+    if (links_[i]->fd == fd)
+      return links_[i].get();
+  return nullptr;
+}
+
+// ── 连接管理 ────────────────────────────────────────────────────────────
+
+bool AsyncRedis::connect(Link &link) {
+  struct timeval connect_tv = {CONNECT_TIMEOUT_MS / 1000,
+                               (CONNECT_TIMEOUT_MS % 1000) * 1000};
+  struct timeval command_tv = {COMMAND_TIMEOUT_MS / 1000,
+                               (COMMAND_TIMEOUT_MS % 1000) * 1000};
+  redisOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  REDIS_OPTIONS_SET_TCP(&opts, link.endpoint.host.c_str(), link.endpoint.port);
+  opts.connect_timeout = &connect_tv;
+  opts.command_timeout = &command_tv;
+  // 回复由 on_reply 收集，整组命令完成后统一回调再释放
+  opts.options |= REDIS_OPT_NOAUTOFREEREPLIES;
+
+  redisAsyncContext *ac = redisAsyncConnectWithOptions(&opts);
+  if (!ac || ac->err) {
+    LOG_WARN("AsyncRedis: connect to %s:%d failed: %s",
+             link.endpoint.host.c_str(), link.endpoint.port,
+             ac ? ac->errstr : "out of memory");
+    if (ac)
+      redisAsyncFree(ac);
+    return false;
+  }
+
+  link.ac = ac;
+  link.fd = ac->c.fd;
+  link.events = 0;
+  link.registered = false;
+
+  ac->ev.data = &link;
+  ac->ev.addRead = ev_add_read;
+  ac->ev.delRead = ev_del_read;
+  ac->ev.addWrite = ev_add_write;
+  ac->ev.delWrite = ev_del_write;
+  ac->ev.cleanup = ev_cleanup;
+  ac->ev.scheduleTimer = ev_schedule_timer;
+  // 设置连接回调会注册写事件，socket 可写即连接建立
+  redisAsyncSetConnectCallback(ac, on_connect);
+  redisAsyncSetDisconnectCallback(ac, on_disconnect);
+
+  // 认证 / 选库随连接一起排队，先于业务命令发出
+  if (!password_.empty()) {
+    const char *argv[] = {"AUTH", password_.c_str()};
+    size_t argvlen[] = {4, password_.size()};
+    redisAsyncCommandArgv(ac, on_setup_reply, nullptr, 2, argv, argvlen);
+  }
+  if (db_index_ != 0) {
+    std::string db = std::to_string(db_index_);
+    const char *argv[] = {"SELECT", db.c_str()};
+    size_t argvlen[] = {6, db.size()};
+    redisAsyncCommandArgv(ac, on_setup_reply, nullptr, 2, argv, argvlen);
+  }
+  return true;
+}
+
+void AsyncRedis::tick() {
+  if (epollfd_ < 0)
+    return;
+  for (size_t i = 0, n = link_count(); i < n; ++i)
+    if (!links_[i]->ac)
+      connect(*links_[i]);
+}
+
+void AsyncRedis::on_connect(const redisAsyncContext *ac, int status) {
+  Link *link = static_cast<Link *>(ac->ev.data);
+  if (status != REDIS_OK) {
+    // 连接失败后 hiredis 自行释放上下文
+    LOG_WARN("AsyncRedis: connect to %s:%d failed: %s",
+             link->endpoint.host.c_str(), link->endpoint.port, ac->errstr);
+    link->ac = nullptr;
+    link->connected.store(false, std::memory_order_release);
+    return;
+  }
+  link->connected.store(true, std::memory_order_release);
+  LOG_INFO("AsyncRedis: connected to %s:%d", link->endpoint.host.c_str(),
+           link->endpoint.port);
+}
+
+void AsyncRedis::on_disconnect(const redisAsyncContext *ac, int status) {
+  Link *link = static_cast<Link *>(ac->ev.data);
+  if (status != REDIS_OK)
+    LOG_WARN("AsyncRedis: %s:%d disconnected: %s", link->endpoint.host.c_str(),
+             link->endpoint.port, ac->errstr);
+  link->ac = nullptr;
+  link->connected.store(false, std::memory_order_release);
+}
+
+void AsyncRedis::on_setup_reply(redisAsyncContext *, void *reply, void *) {
+  redisReply *r = static_cast<redisReply *>(reply);
+  if (r && r->type == REDIS_REPLY_ERROR)
+    LOG_WARN("AsyncRedis: %s", r->str);
+  freeReplyObject(r);
+}
+
+// ── 提交 / 发送 ─────────────────────────────────────────────────────────
+
+bool AsyncRedis::submit(std::vector<Command> cmds, Callback cb, int delay_ms,
+                        size_t shard) {
+  if (!connected(shard) || cmds.empty())
+    return false;
+  if (inflight_.fetch_add(1, std::memory_order_relaxed) >= MAX_INFLIGHT) {
+    inflight_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  auto req = std::make_unique<Request>();
+  req->cmds = std::move(cmds);
+  req->cb = std::move(cb);
+  req->due_ms = delay_ms > 0 ? now_ms() + delay_ms : 0;
+  req->shard = shard;
+  enqueue(std::move(req));
+  return true;
+}
+
+void AsyncRedis::post(std::function<void()> fn) {
+  if (event_fd_ < 0) { // 未 init: 没有事件循环可投递，就地执行
+    fn();
+    return;
+  }
+  inflight_.fetch_add(1, std::memory_order_relaxed);
+  auto req = std::make_unique<Request>();
+  // 空命令组在 send() 中直接 complete()，回调即在主线程执行
+  req->cb = [fn = std::move(fn)](const std::vector<redisReply *> &) { fn(); };
+  enqueue(std::move(req));
+}
+
+void AsyncRedis::enqueue(std::unique_ptr<Request> req) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    incoming_.push_back(std::move(req));
+  }
+  uint64_t one = 1;
+  ssize_t n = write(event_fd_, &one, sizeof(one));
+  (void)n; // 计数器溢出时写失败也无妨，主线程仍会被已有计数唤醒
+}
+
+void AsyncRedis::send(std::unique_ptr<Request> req) {
+  req->replies.assign(req->cmds.size(), nullptr);
+  Request *r = req.release();
+
+  // post() 的空命令组不涉及任何连接
+  Link *link = r->cmds.empty() ? nullptr : links_[r->shard].get();
+  if (link && link->ac && link->connected.load(std::memory_order_acquire)) {
+    std::vector<const char *> argv;
+    std::vector<size_t> argvlen;
+    for (const Command &cmd : r->cmds) {
+      argv.clear();
+      argvlen.clear();
+      for (const std::string &a : cmd) {
+        argv.push_back(a.data());
+        argvlen.push_back(a.size());
+      }
+      // 失败只会发生在连接正在断开时，其后的命令也必然失败，
+      // 因此已排队的命令总是前缀，回复按序填入 replies
+      if (redisAsyncCommandArgv(link->ac, on_reply, r, static_cast<int>(argv.size()),
+                                argv.data(), argvlen.data()) != REDIS_OK)
+        break;
+      ++r->expected;
+    }
+  }
+  if (r->expected == 0) {
+    complete(r);
+    return;
+  }
+  bool idle = link->inflight.empty();
+  r->sent_ms = now_ms();
+  link->inflight.push_back(r);
+  if (idle) // 只有最早的在途请求决定超时时刻，其后的请求不必重设定时器
+    arm_timer();
+}
+
+void AsyncRedis::on_reply(redisAsyncContext *, void *reply, void *privdata) {
+  Request *r = static_cast<Request *>(privdata);
+  r->replies[r->received++] = static_cast<redisReply *>(reply);
+  if (r->received == r->expected)
+    GetInstance()->complete(r);
+}
+
+void AsyncRedis::complete(Request *r) {
+  if (r->expected > 0) {
+    // 回复按发送顺序到达，通常就是队首
+    std::deque<Request *> &q = links_[r->shard]->inflight;
+    auto it = std::find(q.begin(), q.end(), r);
+    if (it != q.end())
+      q.erase(it);
+  }
+  r->cb(r->replies);
+  for (redisReply *reply : r->replies)
+    freeReplyObject(reply);
+  delete r;
+  inflight_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// ── 事件循环 ────────────────────────────────────────────────────────────
+
+void AsyncRedis::handle_event(int fd, uint32_t events) {
+  if (fd == event_fd_) {
+    uint64_t cnt;
+    while (read(event_fd_, &cnt, sizeof(cnt)) > 0) {
+    }
+    drain_incoming();
+  } else if (fd == timer_fd_) {
+    uint64_t cnt;
+    while (read(timer_fd_, &cnt, sizeof(cnt)) > 0) {
+    }
+    run_timers();
+  } else if (Link *link = link_of(fd)) {
+    // HandleRead 可能因出错释放上下文（on_disconnect 置空 ac），之后不再触碰
+    if (link->ac && (events & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP)))
+      redisAsyncHandleRead(link->ac);
+    if (link->ac && (events & EPOLLOUT))
+      redisAsyncHandleWrite(link->ac);
+  }
+}
+
+void AsyncRedis::drain_incoming() {
+  std::vector<std::unique_ptr<Request>> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch.swap(incoming_);
+  }
+  int64_t now = now_ms();
+  bool delayed = false;
+  for (auto &req : batch) {
+    if (req->due_ms > now) {
+      int64_t due = req->due_ms;
+      delayed_.emplace(due, std::move(req));
+      delayed = true;
+    } else {
+      send(std::move(req));
+    }
+  }
+  if (delayed)
+    arm_timer();
+}
+
+void AsyncRedis::run_timers() {
+  int64_t now = now_ms();
+  while (!delayed_.empty() && delayed_.begin()->first <= now) {
+    std::unique_ptr<Request> req = std::move(delayed_.begin()->second);
+    delayed_.erase(delayed_.begin());
+    send(std::move(req));
+  }
+  for (size_t i = 0, n = link_count(); i < n; ++i) {
+    Link *link = links_[i].get();
+    if (link->deadline_ms && link->deadline_ms <= now) {
+      link->deadline_ms = 0;
+      // 连接超时，或有在途命令时 hiredis 判定超时并断开
+      if (link->ac)
+        redisAsyncHandleTimeout(link->ac);
+    }
+  }
+  expire_links(now);
+  arm_timer();
+}
+
+// 最早的在途请求超过 COMMAND_TIMEOUT_MS 仍未完成: Redis 已不再应答，
+// 断开连接使所有在途回调以 nullptr 返回（调用方记熔断失败并回退），tick() 负责重连
+void AsyncRedis::expire_links(int64_t now) {
+  for (size_t i = 0, n = link_count(); i < n; ++i) {
+    Link *link = links_[i].get();
+    if (!link->ac || link->inflight.empty() ||
+        link->inflight.front()->sent_ms + COMMAND_TIMEOUT_MS > now)
+      continue;
+    LOG_WARN("AsyncRedis: %s:%d: %zu command(s) timed out after %dms",
+             link->endpoint.host.c_str(), link->endpoint.port,
+             link->inflight.size(), COMMAND_TIMEOUT_MS);
+    redisAsyncHandleTimeout(link->ac);
+  }
+}
+
+void AsyncRedis::arm_timer() {
+  int64_t next = 0;
+  if (!delayed_.empty())
+    next = delayed_.begin()->first;
+  for (size_t i = 0, n = link_count(); i < n; ++i) {
+    const Link *link = links_[i].get();
+    if (link->deadline_ms && (!next || link->deadline_ms < next))
+      next = link->deadline_ms;
+    if (link->ac && !link->inflight.empty()) {
+      int64_t due = link->inflight.front()->sent_ms + COMMAND_TIMEOUT_MS;
+      if (!next || due < next)
+        next = due;
+    }
+  }
+
+  struct itimerspec its {};
+  if (next) {
+    int64_t delta = std::max<int64_t>(next - now_ms(), 1);
+    its.it_value.tv_sec = delta / 1000;
+    its.it_value.tv_nsec = (delta % 1000) * 1000000;
+  }
+  timerfd_settime(timer_fd_, 0, &its, nullptr);
+}
+
+// ── hiredis 事件适配器: 读写兴趣映射到 epoll（LT，不用 ONESHOT） ─────────
+
+void AsyncRedis::update_events(Link &link) {
+  if (link.fd < 0)
+    return;
+  epoll_event ev{};
+  ev.data.fd = link.fd;
+  ev.events = link.events;
+  epoll_ctl(epollfd_, link.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, link.fd,
+            &ev);
+  link.registered = true;
+}
+
+void AsyncRedis::ev_add_read(void *privdata) {
+  Link *link = static_cast<Link *>(privdata);
+  link->events |= EPOLLIN;
+  link->owner->update_events(*link);
+}
+
+void AsyncRedis::ev_del_read(void *privdata) {
+  Link *link = static_cast<Link *>(privdata);
+  link->events &= ~EPOLLIN;
+  link->owner->update_events(*link);
+}
+
+void AsyncRedis::ev_add_write(void *privdata) {
+  Link *link = static_cast<Link *>(privdata);
+  link->events |= EPOLLOUT;
+  link->owner->update_events(*link);
+}
+
+void AsyncRedis::ev_del_write(void *privdata) {
+  Link *link = static_cast<Link *>(privdata);
+  link->events &= ~EPOLLOUT;
+  link->owner->update_events(*link);
+}
+
+void AsyncRedis::ev_cleanup(void *privdata) {
+  Link *link = static_cast<Link *>(privdata);
+  if (link->registered)
+    epoll_ctl(link->owner->epollfd_, EPOLL_CTL_DEL, link->fd, nullptr);
+  link->fd = -1;
+  link->events = 0;
+  link->registered = false;
+  link->deadline_ms = 0;
+}
+
+void AsyncRedis::ev_schedule_timer(void *privdata, struct timeval tv) {
+  Link *link = static_cast<Link *>(privdata);
+  link->deadline_ms = now_ms() + tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  link->owner->arm_timer();
+}
@@ -0,0 +1,150 @@
+#ifndef ASYNC_REDIS_H
+#define ASYNC_REDIS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <hiredis/async.h>
+#include <hiredis/hiredis.h>
+
+#include "redis_pool.h" // RedisEndpoint
+
+// 非阻塞 Redis 客户端 —— hiredis async 挂在主线程的 epoll 上
+//
+// redis_pool 的同步连接在每次往返期间都占着一个 worker；这里改为:
+//   worker 调用 submit() 把命令放入队列，写 eventfd 唤醒主线程后立即返回
+//   主线程把命令写入 socket，回复到达后在主线程执行回调
+//   回调只做轻量工作（解析回复、重新投递到线程池），不做阻塞 I/O
+// 单连接上可同时在途任意多条命令（hiredis 按序匹配回复），
+// 少量 worker 即可支撑数千个并发缓存查询。
+//
+// 延迟发送（锁竞争时的重试）由 timerfd 驱动，不再 sleep 占用 worker。
+// 连接断开 / 命令超时时在途命令以 nullptr 回复回调，调用方回退到同步路径；
+// 主线程定时 tick() 重连。命令超时按每条连接最早的在途请求计时 ——
+// hiredis 自带的超时在每次发送时顺延，持续有流量时永远不会触发。
+//
+// 分片部署时每个 Redis 实例一条连接（与 redis_pool 的分片号一致），
+// 命令按 key 所在分片提交，各分片独立断线 / 重连。启动时连不上的分片同样建连接
+// 并由 tick() 重连；集群启动后新发现的主节点经 add_shards() 追加。
+class AsyncRedis {
+public:
+  using Command = std::vector<std::string>;
+  // replies 与提交的命令一一对应，失败（断线 / 超时）时对应项为 nullptr；
+  // 回复对象在回调返回后由 AsyncRedis 释放
+  using Callback = std::function<void(const std::vector<redisReply *> &replies)>;
+
+  static AsyncRedis *GetInstance();
+
+  // 主线程调用: 注册 eventfd / timerfd 并向每个分片发起连接（连接结果异步确定）
+  bool init(int epollfd, const std::vector<RedisEndpoint> &endpoints,
+            const std::string &password, int db_index = 0);
+  // 主线程调用: endpoints 按分片号排列，为其中尚无连接的新分片建连接（只追加）
+  void add_shards(const std::vector<RedisEndpoint> &endpoints);
+
+  bool connected(size_t shard = 0) const {
+    return shard < link_count() &&
+           links_[shard]->connected.load(std::memory_order_acquire);
+  }
+
+  // 任意线程: 向 shard 提交一组命令（同一流水线发送），delay_ms > 0 时延迟发送
+  // 返回 false 表示未连接或在途过多，调用方应走同步路径
+  bool submit(std::vector<Command> cmds, Callback cb, int delay_ms = 0,
+              size_t shard = 0);
+
+  // 任意线程: 把 fn 投递到事件循环线程执行（不发送命令，不要求已连接）
+  void post(std::function<void()> fn);
+
+  // 主线程事件分发
+  bool owns(int fd) const {
+    return fd >= 0 && (fd == event_fd_ || fd == timer_fd_ || link_of(fd));
+  }
+  void handle_event(int fd, uint32_t events);
+  // 主线程定时调用: 断线重连
+  void tick();
+
+private:
+  AsyncRedis() = default;
+
+  struct Request {
+    std::vector<Command> cmds;
+    Callback cb;
+    std::vector<redisReply *> replies;
+    size_t expected = 0;
+    size_t received = 0;
+    int64_t due_ms = 0;
+    int64_t sent_ms = 0; // 写入连接的时刻，超时以此起算
+    size_t shard = 0;
+  };
+
+  // 一个分片的连接；除 connected 外仅主线程访问
+  struct Link {
+    AsyncRedis *owner = nullptr;
+    RedisEndpoint endpoint;
+    redisAsyncContext *ac = nullptr;
+    int fd = -1;
+    uint32_t events = 0;
+    bool registered = false;
+    int64_t deadline_ms = 0; // hiredis 连接 / 命令超时（0 = 未设置）
+    std::deque<Request *> inflight; // 已发送未完成的请求，按发送顺序（即回复顺序）
+    std::atomic<bool> connected{false};
+  };
+
+  bool connect(Link &link);
+  Link *link_of(int fd) const;
+  size_t link_count() const {
+    return link_count_.load(std::memory_order_acquire);
+  }
+  void update_events(Link &link);
+  void enqueue(std::unique_ptr<Request> req);
+  void send(std::unique_ptr<Request> req);
+  void complete(Request *req);
+  void drain_incoming();
+  void run_timers();
+  void arm_timer();
+  void expire_links(int64_t now);
+
+  static int64_t now_ms();
+
+  // hiredis 回调与事件适配器（事件 privdata 为 Link，回复 privdata 为 Request）
+  static void on_reply(redisAsyncContext *ac, void *reply, void *privdata);
+  static void on_setup_reply(redisAsyncContext *ac, void *reply, void *privdata);
+  static void on_connect(const redisAsyncContext *ac, int status);
+  static void on_disconnect(const redisAsyncContext *ac, int status);
+  static void ev_add_read(void *privdata);
+  static void ev_del_read(void *privdata);
+  static void ev_add_write(void *privdata);
+  static void ev_del_write(void *privdata);
+  static void ev_cleanup(void *privdata);
+  static void ev_schedule_timer(void *privdata, struct timeval tv);
+
+  static constexpr int MAX_INFLIGHT = 65536;  // 与最大连接数同量级
+  static constexpr int CONNECT_TIMEOUT_MS = 1000;
+  static constexpr int COMMAND_TIMEOUT_MS = 1000;
+
+  std::string password_;
+  int db_index_ = 0;
+
+  int epollfd_ = -1;
+  int event_fd_ = -1;
+  int timer_fd_ = -1;
+
+  // 连接只追加（主线程）: 先写入 links_[i] 再发布 link_count_，其他线程不加锁读
+  std::array<std::unique_ptr<Link>, redis_pool::MAX_SHARDS> links_;
+  std::atomic<size_t> link_count_{0};
+  // 以下仅主线程访问
+  std::multimap<int64_t, std::unique_ptr<Request>> delayed_;
+
+  std::atomic<int> inflight_{0};
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Request>> incoming_;
+};
+
+#endif
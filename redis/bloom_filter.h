@@ -1,98 +1,407 @@
 #ifndef BLOOM_FILTER_H
 #define BLOOM_FILTER_H
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "key_filter.h"
+#include "read_epoch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BLOOM_HAVE_X86 1
+#endif
+
 // 布隆过滤器 —— 防缓存穿透
-// 使用双哈希技术生成 k 个哈希函数: g_i(x) = (h1(x) + i * h2(x)) % m
-class BloomFilter {
+//
+// 分块布隆（split block bloom filter，Parquet / Impala 同款布局）:
+//   - 位数组切成 32 字节的块，每个 key 的全部 k = 8 位落在同一块内
+//     （块按 32 字节对齐，不会跨越 64 字节缓存行），一次查询只有一次缓存未命中
+//   - 块内 8 个 32 位位段各置 1 位，位号 = (h * SALT[i]) >> 27
+//   - 选块用乘法-移位 (h * blocks) >> 64 代替取模
+//   - 哈希用 wyhash（8 字节一次吸收），代替逐字节 FNV-1a + std::hash
+//   - CPU 支持 AVX2 时 8 个位号一条指令算出（运行时分派，无需 -mavx2）
+// 代价是同等位数下误判率略高于经典布隆，构造时按 BLOCK_OVERSIZE 多分配位数补偿。
+//
+// 并发: 无锁读写
+//   - 位数组由 std::atomic<uint64_t> 组成，insert 用 fetch_or（位已置则跳过），
+//     contains 用 relaxed load；布隆只会"多置位"，无需更强的内存序
+//   - 位数组整体挂在原子指针上（RCU 式）: reset() / rebuild() 在新表上离线构建，
+//     完成后一次指针交换发布，读者从不阻塞；读者访问表期间登记在 ReadEpoch 中，
+//     发布方等所有可能持有旧表的读者退出后立即释放旧表（见 read_epoch.h）
+//   - rebuild() 期间并发 insert() 的 key 记入日志，发布前重放进新表，不会丢失
+// 不支持删除: 已删除的键仍会通过过滤器，需要删除时用 CuckooFilter。
+class BloomFilter : public KeyFilter {
 public:
   // n: 预估元素数量, p: 期望误判率 (默认 0.01 = 1%)
   BloomFilter(size_t expected_elements = 1000000, double false_positive_rate = 0.01);
+  ~BloomFilter() override;
 
-  void insert(const std::string &key);
-  bool contains(const std::string &key) const;
+  BloomFilter(const BloomFilter &) = delete;
+  BloomFilter &operator=(const BloomFilter &) = delete;
+
+  void insert(const std::string &key) override;
+  bool contains(const std::string &key) const override;
   void clear();
 
   // 按新的预期元素数量重新分配位数组（清空已有数据）
   void reset(size_t expected_elements, double false_positive_rate = 0.01);
 
-  size_t size() const { return bit_count_ / 64; }
+  void rebuild_with(size_t expected_elements, double false_positive_rate,
+                    const Fill &fill) override;
+
+  // ── 快照（见 bloom_warmer.h） ──
+  // 位布局 / 哈希算法变化时递增，旧快照随之作废
+  static constexpr uint32_t LAYOUT_VERSION = 1;
+  uint32_t layout_version() const override { return LAYOUT_VERSION; }
+  // 导出当前位数组（与并发插入无锁竞争，导出前已完成的插入必然包含在内）
+  std::vector<uint64_t> export_words() const override;
+  // 以给定位数组替换当前表（n 须为 4 的倍数且非 0），并发插入不丢失
+  bool import_words(const uint64_t *words, size_t n) override;
+
+  // 误判率按全局置位率 f 估算为 f^8（块间置位不均时实际略高）
+  Stats stats() const override;
+
+  // 位数组大小（64 位字个数）
+  size_t size() const {
+    auto guard = epoch_.read();
+    return table_.load()->num_blocks * WORDS64;
+  }
 
 private:
-  // FNV-1a hash
-  static uint64_t fnv1a(const std::string &key);
-  // std::hash wrapper
-  static uint64_t hash2(const std::string &key);
-
-  size_t num_hashes_;  // k: 哈希函数个数
-  size_t bit_count_;   // m: 位数组大小
-  std::vector<uint64_t> bits_;  // 位数组
+  static constexpr int WORDS64 = 4;  // 每块 4 个 64 位字 = 256 位
+  static constexpr double BLOCK_OVERSIZE = 1.1;
+
+  struct alignas(32) Block {
+    std::atomic<uint64_t> w[WORDS64]; // C++20 起默认值初始化为 0
+  };
+  struct Table {
+    explicit Table(size_t n) : num_blocks(n), blocks(new Block[n]) {}
+    size_t num_blocks;
+    std::unique_ptr<Block[]> blocks;
+    std::atomic<size_t> ones{0}; // 已置位数，只在位由 0 变 1 时累加
+  };
+  // 8 个位段的掩码，按 64 位字打包
+  struct alignas(32) Mask {
+    uint64_t w[WORDS64];
+  };
+
+  static uint64_t hash(std::string_view key);
+  static size_t blocks_for(size_t expected_elements, double false_positive_rate);
+  static Block &block(const Table &t, uint64_t h) {
+    return t.blocks[static_cast<size_t>(
+        (static_cast<unsigned __int128>(h) * t.num_blocks) >> 64)];
+  }
+  static void set_bits(Table &t, uint64_t h);
+  static bool test_bits(const Table &t, uint64_t h);
+
+  static void mask_scalar(uint32_t h, Mask &m);
+#ifdef BLOOM_HAVE_X86
+  __attribute__((target("avx2"))) static void mask_avx2(uint32_t h, Mask &m);
+  static bool has_avx2() {
+    static const bool yes = __builtin_cpu_supports("avx2");
+    return yes;
+  }
+#endif
+  static void make_mask(uint32_t h, Mask &m) {
+#ifdef BLOOM_HAVE_X86
+    if (has_avx2()) {
+      mask_avx2(h, m);
+      return;
+    }
+#endif
+    mask_scalar(h, m);
+  }
+
+  // 发布新表并返回旧表（调用方持有 writer_mutex_）；旧表交给 retire() 释放
+  std::unique_ptr<Table> publish(std::unique_ptr<Table> next) {
+    return std::unique_ptr<Table>(table_.exchange(next.release()));
+  }
+  // 等待仍持有旧表的读者退出后释放；不能持有 journal_mutex_（insert 持读者登记等它）
+  void retire(std::unique_ptr<Table> old) {
+    epoch_.synchronize();
+    old.reset();
+  }
+  // 在新表上执行 fill，重放并发插入日志后发布
+  template <typename Build>
+  void swap_in(std::unique_ptr<Table> next, Build &&build);
+
+  static constexpr uint32_t SALT[8] = {
+      0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+      0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+  // 读者在 epoch_ 登记期间以 seq_cst 读取 table_（见 read_epoch.h）
+  std::atomic<Table *> table_{nullptr};
+  ReadEpoch epoch_;
+
+  // 以下只在发布 / 重建时使用，不在读写热路径上
+  std::mutex writer_mutex_;
+  std::atomic<bool> rebuilding_{false};
+  std::mutex journal_mutex_;
+  std::vector<std::string> journal_;
 };
 
 inline BloomFilter::BloomFilter(size_t expected_elements,
                                 double false_positive_rate) {
-  // m = -n * ln(p) / (ln(2))^2   — 最优位数组大小
-  // k = (m / n) * ln(2)          — 最优哈希函数个数
-  double m = -static_cast<double>(expected_elements) *
-             std::log(false_positive_rate) / (std::log(2.0) * std::log(2.0));
-  double k = (m / static_cast<double>(expected_elements)) * std::log(2.0);
-
-  bit_count_ = static_cast<size_t>(m) + 1;
-  num_hashes_ = static_cast<size_t>(k) + 1;
-  bits_.resize((bit_count_ + 63) / 64, 0);
-}
-
-inline uint64_t BloomFilter::fnv1a(const std::string &key) {
-  uint64_t hash = 14695981039346656037ULL;
-  for (char c : key) {
-    hash ^= static_cast<uint64_t>(c);
-    hash *= 1099511628211ULL;
+  table_.store(new Table(blocks_for(expected_elements, false_positive_rate)),
+               std::memory_order_release);
+}
+
+inline BloomFilter::~BloomFilter() { delete table_.load(); }
+
+// ── wyhash（final 版本的精简移植） ────────────────────────────────────
+
+namespace bloom_detail {
+
+inline void wymum(uint64_t &a, uint64_t &b) {
+  unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+  a = static_cast<uint64_t>(r);
+  b = static_cast<uint64_t>(r >> 64);
+}
+inline uint64_t wymix(uint64_t a, uint64_t b) {
+  wymum(a, b);
+  return a ^ b;
+}
+inline uint64_t wyr8(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+inline uint64_t wyr4(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+inline uint64_t wyr3(const uint8_t *p, size_t k) {
+  return (static_cast<uint64_t>(p[0]) << 16) |
+         (static_cast<uint64_t>(p[k >> 1]) << 8) | p[k - 1];
+}
+
+inline constexpr uint64_t WYP[4] = {0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+                                    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL};
+
+inline uint64_t wyhash(const void *key, size_t len, uint64_t seed) {
+  const uint8_t *p = static_cast<const uint8_t *>(key);
+  seed ^= wymix(seed ^ WYP[0], WYP[1]);
+  uint64_t a, b;
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+      b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = wyr3(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = wymix(wyr8(p) ^ WYP[1], wyr8(p + 8) ^ seed);
+        see1 = wymix(wyr8(p + 16) ^ WYP[2], wyr8(p + 24) ^ see1);
+        see2 = wymix(wyr8(p + 32) ^ WYP[3], wyr8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = wymix(wyr8(p) ^ WYP[1], wyr8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = wyr8(p + i - 16);
+    b = wyr8(p + i - 8);
   }
-  return hash;
+  a ^= WYP[1];
+  b ^= seed;
+  wymum(a, b);
+  return wymix(a ^ WYP[0] ^ len, b ^ WYP[1]);
 }
 
-inline uint64_t BloomFilter::hash2(const std::string &key) {
-  return std::hash<std::string>{}(key);
+} // namespace bloom_detail
+
+inline uint64_t BloomFilter::hash(std::string_view key) {
+  return bloom_detail::wyhash(key.data(), key.size(), 0);
 }
 
-inline void BloomFilter::insert(const std::string &key) {
-  uint64_t h1 = fnv1a(key);
-  uint64_t h2 = hash2(key);
-  for (size_t i = 0; i < num_hashes_; ++i) {
-    uint64_t idx = (h1 + i * h2) % bit_count_;
-    bits_[idx / 64] |= (1ULL << (idx % 64));
+// ── 块内探测 ──────────────────────────────────────────────────────────
+// 高位（经乘法-移位）选块，低 32 位生成块内 8 个位号
+
+inline void BloomFilter::mask_scalar(uint32_t h, Mask &m) {
+  for (int i = 0; i < WORDS64; ++i) {
+    uint64_t lo = 1U << ((h * SALT[2 * i]) >> 27);
+    uint64_t hi = 1U << ((h * SALT[2 * i + 1]) >> 27);
+    m.w[i] = lo | (hi << 32);
   }
 }
 
-inline bool BloomFilter::contains(const std::string &key) const {
-  uint64_t h1 = fnv1a(key);
-  uint64_t h2 = hash2(key);
-  for (size_t i = 0; i < num_hashes_; ++i) {
-    uint64_t idx = (h1 + i * h2) % bit_count_;
-    if (!(bits_[idx / 64] & (1ULL << (idx % 64)))) {
-      return false;
+#ifdef BLOOM_HAVE_X86
+inline void BloomFilter::mask_avx2(uint32_t h, Mask &m) {
+  const __m256i salt = _mm256_setr_epi32(
+      SALT[0], SALT[1], SALT[2], SALT[3], SALT[4], SALT[5], SALT[6], SALT[7]);
+  __m256i bits = _mm256_mullo_epi32(_mm256_set1_epi32(h), salt);
+  bits = _mm256_srli_epi32(bits, 27);
+  // 小端: 32 位通道 2i / 2i+1 恰好是 64 位字 i 的低 / 高半
+  _mm256_store_si256(reinterpret_cast<__m256i *>(m.w),
+                     _mm256_sllv_epi32(_mm256_set1_epi32(1), bits));
+}
+#endif
+
+inline void BloomFilter::set_bits(Table &t, uint64_t h) {
+  Mask m;
+  make_mask(static_cast<uint32_t>(h), m);
+  Block &b = block(t, h);
+  for (int i = 0; i < WORDS64; ++i) {
+    // 已置位时不发带锁的 RMW，热 key 重复插入不争抢缓存行
+    if ((b.w[i].load(std::memory_order_relaxed) & m.w[i]) != m.w[i]) {
+      uint64_t old = b.w[i].fetch_or(m.w[i], std::memory_order_relaxed);
+      t.ones.fetch_add(__builtin_popcountll(m.w[i] & ~old),
+                       std::memory_order_relaxed);
     }
   }
+}
+
+inline bool BloomFilter::test_bits(const Table &t, uint64_t h) {
+  Mask m;
+  make_mask(static_cast<uint32_t>(h), m);
+  const Block &b = block(t, h);
+  for (int i = 0; i < WORDS64; ++i)
+    if ((b.w[i].load(std::memory_order_relaxed) & m.w[i]) != m.w[i])
+      return false;
   return true;
 }
 
+inline void BloomFilter::insert(const std::string &key) {
+  uint64_t h = hash(key);
+  auto guard = epoch_.read();
+  Table *t = table_.load();
+  set_bits(*t, h);
+  if (rebuilding_.load()) {
+    std::lock_guard<std::mutex> lock(journal_mutex_);
+    if (rebuilding_.load())
+      journal_.push_back(key);
+  }
+  // 写入期间表被替换（reset / rebuild 已发布）: 补写到新表
+  Table *now = table_.load();
+  if (now != t)
+    set_bits(*now, h);
+}
+
+inline bool BloomFilter::contains(const std::string &key) const {
+  uint64_t h = hash(key);
+  auto guard = epoch_.read();
+  return test_bits(*table_.load(), h);
+}
+
 inline void BloomFilter::clear() {
-  std::fill(bits_.begin(), bits_.end(), 0);
+  auto guard = epoch_.read();
+  Table *t = table_.load();
+  for (size_t i = 0; i < t->num_blocks; ++i)
+    for (auto &w : t->blocks[i].w)
+      w.store(0, std::memory_order_relaxed);
+  t->ones.store(0, std::memory_order_relaxed);
+}
+
+inline size_t BloomFilter::blocks_for(size_t expected_elements,
+                                      double false_positive_rate) {
+  // m = -n * ln(p) / (ln(2))^2   — 经典布隆的最优位数，分块布局再乘 BLOCK_OVERSIZE
+  double n = static_cast<double>(std::max<size_t>(expected_elements, 1));
+  double m = -n * std::log(false_positive_rate) /
+             (std::log(2.0) * std::log(2.0)) * BLOCK_OVERSIZE;
+  return static_cast<size_t>(m / (sizeof(Block) * 8)) + 1;
 }
 
 inline void BloomFilter::reset(size_t expected_elements,
                                double false_positive_rate) {
-  double m = -static_cast<double>(expected_elements) *
-             std::log(false_positive_rate) / (std::log(2.0) * std::log(2.0));
-  double k = (m / static_cast<double>(expected_elements)) * std::log(2.0);
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  retire(publish(std::make_unique<Table>(
+      blocks_for(expected_elements, false_positive_rate))));
+}
+
+template <typename Build>
+void BloomFilter::swap_in(std::unique_ptr<Table> next, Build &&build) {
+  rebuilding_.store(true);
+  build(*next);
+
+  // 持日志锁发布: 此前的并发 insert 已入日志（重放），此后的会看到新表
+  std::unique_ptr<Table> old;
+  {
+    std::lock_guard<std::mutex> jlock(journal_mutex_);
+    for (const auto &key : journal_)
+      set_bits(*next, hash(key));
+    journal_.clear();
+    old = publish(std::move(next));
+    rebuilding_.store(false);
+  }
+  retire(std::move(old));
+}
+
+inline void BloomFilter::rebuild_with(size_t expected_elements,
+                                      double false_positive_rate,
+                                      const Fill &fill) {
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  size_t blocks = expected_elements > 0
+                      ? blocks_for(expected_elements, false_positive_rate)
+                      : table_.load()->num_blocks;
+  swap_in(std::make_unique<Table>(blocks), [&fill](Table &t) {
+    fill([&t](const std::string &key) { set_bits(t, hash(key)); });
+  });
+}
+
+inline std::vector<uint64_t> BloomFilter::export_words() const {
+  auto guard = epoch_.read();
+  const Table *t = table_.load();
+  std::vector<uint64_t> out;
+  out.reserve(t->num_blocks * WORDS64);
+  for (size_t i = 0; i < t->num_blocks; ++i)
+    for (const auto &w : t->blocks[i].w)
+      out.push_back(w.load(std::memory_order_relaxed));
+  return out;
+}
+
+inline bool BloomFilter::import_words(const uint64_t *words, size_t n) {
+  if (n == 0 || n % WORDS64 != 0)
+    return false;
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  swap_in(std::make_unique<Table>(n / WORDS64), [words](Table &t) {
+    size_t ones = 0;
+    for (size_t i = 0; i < t.num_blocks; ++i)
+      for (int j = 0; j < WORDS64; ++j) {
+        uint64_t w = words[i * WORDS64 + j];
+        t.blocks[i].w[j].store(w, std::memory_order_relaxed);
+        ones += __builtin_popcountll(w);
+      }
+    t.ones.fetch_add(ones, std::memory_order_relaxed);
+  });
+  return true;
+}
 
-  bit_count_ = static_cast<size_t>(m) + 1;
-  num_hashes_ = static_cast<size_t>(k) + 1;
-  bits_.assign((bit_count_ + 63) / 64, 0);
+inline KeyFilter::Stats BloomFilter::stats() const {
+  auto guard = epoch_.read();
+  const Table *t = table_.load();
+  Stats s;
+  s.kind = "bloom";
+  s.bytes = t->num_blocks * sizeof(Block);
+  double m = static_cast<double>(t->num_blocks) * sizeof(Block) * 8;
+  s.occupancy = static_cast<double>(t->ones.load(std::memory_order_relaxed)) / m;
+  // 元素数估计 n ≈ -(m/k)·ln(1 - f)，k = 8
+  s.items = s.occupancy < 1.0
+                ? static_cast<size_t>(-m / 8 * std::log(1.0 - s.occupancy))
+                : 0;
+  s.est_fpr = std::pow(s.occupancy, 8);
+  return s;
 }
 
 #endif
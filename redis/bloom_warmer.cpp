@@ -0,0 +1,442 @@
+#include "bloom_warmer.h"
+#include "log/log.h"
+#include "mysql/mysql_pool.h"
+#include "redis_cache.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static constexpr char SNAPSHOT_MAGIC[8] = {'T', 'W', 'S', 'B', 'L', 'O', 'O', 'M'};
+
+int64_t BloomWarmer::now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+const std::string &BloomWarmer::node_id() {
+  static const std::string id = [] {
+    std::random_device rd;
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%08x%08x", rd(), rd());
+    return std::string(buf);
+  }();
+  return id;
+}
+
+// 流 ID "<ms>-<seq>" 比较
+static bool stream_id_less(const std::string &a, const std::string &b) {
+  unsigned long long ams = 0, aseq = 0, bms = 0, bseq = 0;
+  sscanf(a.c_str(), "%llu-%llu", &ams, &aseq);
+  sscanf(b.c_str(), "%llu-%llu", &bms, &bseq);
+  return ams != bms ? ams < bms : aseq < bseq;
+}
+
+// 流 ID 的直接后继（不存在介于两者之间的 ID）
+static std::string stream_id_next(const std::string &id) {
+  unsigned long long ms = 0, seq = 0;
+  sscanf(id.c_str(), "%llu-%llu", &ms, &seq);
+  if (seq == ULLONG_MAX) {
+    ++ms;
+    seq = 0;
+  } else {
+    ++seq;
+  }
+  return std::to_string(ms) + "-" + std::to_string(seq);
+}
+
+void BloomWarmer::start() {
+  if (thread_.joinable())
+    return;
+  if (load_snapshot()) {
+    loaded_ = true;
+    on_warmed_();
+  }
+  stop_ = false;
+  thread_ = std::thread(&BloomWarmer::run, this);
+}
+
+void BloomWarmer::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  caught_up_cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+    if (dirty_)
+      save_snapshot();
+  }
+}
+
+bool BloomWarmer::wait_caught_up(uint64_t student_id, int timeout_ms) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (caught_up_ >= student_id)
+    return true;
+  wake_ = true;
+  cv_.notify_all();
+  return caught_up_cv_.wait_for(
+      lock, std::chrono::milliseconds(timeout_ms),
+      [&] { return stop_ || caught_up_ >= student_id; }) &&
+         caught_up_ >= student_id;
+}
+
+// ── 快照文件 ────────────────────────────────────────────────────────────
+
+bool BloomWarmer::load_snapshot() {
+  int64_t start = now_ms();
+  int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG_INFO("Bloom snapshot %s not found, full load from MySQL",
+             path_.c_str());
+    return false;
+  }
+  struct stat st{};
+  if (fstat(fd, &st) < 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+    close(fd);
+    LOG_WARN("Bloom snapshot %s truncated, ignored", path_.c_str());
+    return false;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    LOG_WARN("Bloom snapshot mmap failed: %s", strerror(errno));
+    return false;
+  }
+
+  bool ok = false;
+  SnapshotHeader h;
+  memcpy(&h, map, sizeof(h));
+  const uint8_t *payload = static_cast<const uint8_t *>(map) + h.header_size;
+  if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 ||
+      h.version != bloom_.layout_version() ||
+      h.header_size < sizeof(SnapshotHeader) || h.header_size > size ||
+      h.header_size % 8 != 0 ||
+      (size - h.header_size) / 8 != h.num_words ||
+      (size - h.header_size) % 8 != 0) {
+    LOG_WARN("Bloom snapshot %s has wrong format/version, ignored",
+             path_.c_str());
+  } else if (bloom_detail::wyhash(payload, h.num_words * 8, 0) != h.checksum) {
+    LOG_WARN("Bloom snapshot %s checksum mismatch, ignored", path_.c_str());
+  } else {
+    // 映射按页对齐、header_size 为 8 的倍数: 直接从映射导入，不经中间拷贝
+    ok = bloom_.import_words(reinterpret_cast<const uint64_t *>(payload),
+                             h.num_words);
+    if (ok) {
+      watermark_ = h.watermark;
+      h.stream_id[sizeof(h.stream_id) - 1] = '\0';
+      stream_id_ = h.stream_id;
+      last_save_ms_ = now_ms();
+      last_full_ms_ = static_cast<int64_t>(h.created_ms);
+      LOG_INFO("Bloom snapshot loaded in %lld ms: %.1f MB, watermark=%llu, "
+               "age=%llds",
+               static_cast<long long>(now_ms() - start),
+               h.num_words * 8 / 1048576.0,
+               static_cast<unsigned long long>(watermark_),
+               static_cast<long long>((now_ms() - h.created_ms) / 1000));
+    }
+  }
+  munmap(map, size);
+  return ok;
+}
+
+bool BloomWarmer::save_snapshot() {
+  std::vector<uint64_t> words = bloom_.export_words();
+
+  SnapshotHeader h{};
+  memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+  h.version = bloom_.layout_version();
+  h.header_size = sizeof(SnapshotHeader);
+  h.num_words = words.size();
+  h.watermark = watermark_;
+  h.created_ms = static_cast<uint64_t>(last_full_ms_);
+  h.checksum = bloom_detail::wyhash(words.data(), words.size() * 8, 0);
+  snprintf(h.stream_id, sizeof(h.stream_id), "%s", stream_id_.c_str());
+
+  // 写临时文件 + fsync + rename: 崩溃时要么是旧快照，要么是完整的新快照
+  std::string tmp = path_ + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "wb");
+  if (!fp) {
+    LOG_WARN("Bloom snapshot: cannot write %s: %s", tmp.c_str(),
+             strerror(errno));
+    return false;
+  }
+  bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+            fwrite(words.data(), 8, words.size(), fp) == words.size() &&
+            fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+  ok = (fclose(fp) == 0) && ok;
+  if (!ok || rename(tmp.c_str(), path_.c_str()) != 0) {
+    LOG_WARN("Bloom snapshot: write %s failed: %s", path_.c_str(),
+             strerror(errno));
+    unlink(tmp.c_str());
+    return false;
+  }
+  dirty_ = false;
+  last_save_ms_ = now_ms();
+  LOG_INFO("Bloom snapshot saved: %s (%.1f MB, watermark=%llu, stream=%s)",
+           path_.c_str(), words.size() * 8 / 1048576.0,
+           static_cast<unsigned long long>(watermark_), stream_id_.c_str());
+  return true;
+}
+
+// ── MySQL ───────────────────────────────────────────────────────────────
+
+bool BloomWarmer::full_load() {
+  int64_t start = now_ms();
+
+  // 先记下流的末尾: 全量扫描期间的增改由流补上
+  {
+    redisContext *ctx = nullptr;
+    redisConnectionRAII conn(&ctx, redis_, redis_->shard_of(JOURNAL_KEY));
+    if (ctx) {
+      redisReply *reply =
+          redis_->exec(ctx, "XREVRANGE %s + - COUNT 1", JOURNAL_KEY);
+      if (reply && reply->type == REDIS_REPLY_ARRAY && reply->elements == 1 &&
+          reply->element[0]->type == REDIS_REPLY_ARRAY &&
+          reply->element[0]->elements >= 1)
+        stream_id_.assign(reply->element[0]->element[0]->str,
+                          reply->element[0]->element[0]->len);
+      freeReplyObject(reply);
+    }
+  }
+
+  MYSQL *mysql = nullptr;
+  connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
+  if (!mysql)
+    return false;
+
+  size_t count = 0;
+  uint64_t max_id = 0;
+  if (mysql_query(mysql,
+                  "SELECT COUNT(*), COALESCE(MAX(student_id), 0) FROM student")) {
+    LOG_WARN("Bloom full load: count failed: %s", mysql_error(mysql));
+    return false;
+  }
+  if (MYSQL_RES *res = mysql_store_result(mysql)) {
+    if (MYSQL_ROW row = mysql_fetch_row(res)) {
+      count = row[0] ? strtoull(row[0], nullptr, 10) : 0;
+      max_id = row[1] ? strtoull(row[1], nullptr, 10) : 0;
+    }
+    mysql_free_result(res);
+  }
+
+  // 只扫到 max_id: 之后插入的行由增量追赶处理
+  char sql[128];
+  snprintf(sql, sizeof(sql),
+           "SELECT name, id_card FROM student WHERE student_id <= %" PRIu64,
+           max_id);
+  if (mysql_query(mysql, sql)) {
+    LOG_WARN("Bloom full load: scan failed: %s", mysql_error(mysql));
+    return false;
+  }
+  MYSQL_RES *res = mysql_use_result(mysql); // 流式读取，不缓存整个结果集
+  if (!res)
+    return false;
+  size_t added = 0;
+  bloom_.rebuild_with(
+      static_cast<size_t>(count * GROWTH_HEADROOM) + 1, 0.01,
+      [&](const KeyFilter::Add &add) {
+        while (MYSQL_ROW row = mysql_fetch_row(res)) {
+          if (!row[0] || !row[1])
+            continue;
+          add(RedisCache::score_key(row[0], row[1]));
+          ++added;
+        }
+      });
+  mysql_free_result(res);
+
+  watermark_ = max_id;
+  last_full_ms_ = now_ms();
+  dirty_ = true;
+  LOG_INFO("Bloom full load: %zu keys in %lld ms (watermark=%llu)", added,
+           static_cast<long long>(now_ms() - start),
+           static_cast<unsigned long long>(max_id));
+  return true;
+}
+
+bool BloomWarmer::catch_up_mysql() {
+  MYSQL *mysql = nullptr;
+  connectionRAII mysqlcon(&mysql, connection_pool::GetInstance());
+  if (!mysql)
+    return false;
+
+  for (;;) {
+    char sql[160];
+    snprintf(sql, sizeof(sql),
+             "SELECT student_id, name, id_card FROM student "
+             "WHERE student_id > %" PRIu64 " ORDER BY student_id LIMIT %d",
+             watermark_, MYSQL_BATCH);
+    if (mysql_query(mysql, sql))
+      return false;
+    MYSQL_RES *res = mysql_store_result(mysql);
+    if (!res)
+      return false;
+    size_t rows = 0;
+    while (MYSQL_ROW row = mysql_fetch_row(res)) {
+      ++rows;
+      if (row[0])
+        watermark_ = std::max<uint64_t>(watermark_, strtoull(row[0], nullptr, 10));
+      if (row[1] && row[2])
+        bloom_.insert(RedisCache::score_key(row[1], row[2]));
+    }
+    mysql_free_result(res);
+    if (rows > 0)
+      dirty_ = true;
+    if (rows < static_cast<size_t>(MYSQL_BATCH))
+      return true;
+  }
+}
+
+// ── Redis 流 ────────────────────────────────────────────────────────────
+
+bool BloomWarmer::catch_up_journal() {
+  redisContext *ctx = nullptr;
+  redisConnectionRAII conn(&ctx, redis_, redis_->shard_of(JOURNAL_KEY));
+  if (!ctx)
+    return false;
+
+  for (;;) {
+    redisReply *reply = redis_->exec(ctx, "XREAD COUNT 1000 STREAMS %s %s",
+                                     JOURNAL_KEY, stream_id_.c_str());
+    if (!reply)
+      return false;
+    // [[key, [[id, [field, value, ...]], ...]]]，无新条目时为 nil
+    size_t n = 0;
+    if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 1 &&
+        reply->element[0]->type == REDIS_REPLY_ARRAY &&
+        reply->element[0]->elements == 2) {
+      redisReply *entries = reply->element[0]->element[1];
+      n = entries->elements;
+      for (size_t i = 0; i < n; ++i) {
+        redisReply *e = entries->element[i];
+        if (e->type != REDIS_REPLY_ARRAY || e->elements != 2)
+          continue;
+        stream_id_.assign(e->element[0]->str, e->element[0]->len);
+        // 字段: {k | d} <key> src <node_id>
+        redisReply *fields = e->element[1];
+        std::string key, src;
+        bool remove = false;
+        for (size_t j = 0; j + 1 < fields->elements; j += 2) {
+          std::string name(fields->element[j]->str, fields->element[j]->len);
+          std::string value(fields->element[j + 1]->str,
+                            fields->element[j + 1]->len);
+          if (name == "src") {
+            src = std::move(value);
+          } else {
+            remove = name == "d";
+            key = std::move(value);
+          }
+        }
+        if (key.empty() || src == node_id())
+          continue;
+        if (remove)
+          bloom_.remove(key);
+        else
+          bloom_.insert(key);
+      }
+    }
+    freeReplyObject(reply);
+    if (n > 0)
+      dirty_ = true;
+    if (n < 1000)
+      return true;
+  }
+}
+
+// ── 后台线程 ────────────────────────────────────────────────────────────
+
+// 流中是否有未消费（ID 大于 stream_id_）的条目已被裁剪:
+//   Redis >= 7: XINFO STREAM 的 max-deleted-entry-id 是被裁剪的最大 ID，精确判断
+//   更早版本: 只能看最早的留存条目，它晚于 stream_id_ 的直接后继时
+//             无法排除中间有条目被裁剪，保守地按已裁剪处理
+bool BloomWarmer::journal_trimmed() {
+  redisContext *ctx = nullptr;
+  redisConnectionRAII conn(&ctx, redis_, redis_->shard_of(JOURNAL_KEY));
+  if (!ctx)
+    return false;
+  std::string max_deleted, first;
+  redisReply *reply = redis_->exec(ctx, "XINFO STREAM %s", JOURNAL_KEY);
+  if (reply &&
+      (reply->type == REDIS_REPLY_ARRAY || reply->type == REDIS_REPLY_MAP)) {
+    for (size_t i = 0; i + 1 < reply->elements; i += 2) {
+      const redisReply *k = reply->element[i];
+      const redisReply *v = reply->element[i + 1];
+      if (k->type != REDIS_REPLY_STRING && k->type != REDIS_REPLY_STATUS)
+        continue;
+      std::string name(k->str, k->len);
+      if (name == "max-deleted-entry-id" && v->type == REDIS_REPLY_STRING)
+        max_deleted.assign(v->str, v->len);
+      else if (name == "first-entry" && v->type == REDIS_REPLY_ARRAY &&
+               v->elements >= 1 && v->element[0]->type == REDIS_REPLY_STRING)
+        first.assign(v->element[0]->str, v->element[0]->len);
+    }
+  }
+  freeReplyObject(reply); // 流不存在时为错误回复: 没有可裁剪的条目
+
+  if (!max_deleted.empty()) {
+    if (!stream_id_less(stream_id_, max_deleted))
+      return false;
+    LOG_WARN("Bloom journal trimmed past snapshot (%s < deleted %s), "
+             "full reload",
+             stream_id_.c_str(), max_deleted.c_str());
+    return true;
+  }
+  if (first.empty() || !stream_id_less(stream_id_next(stream_id_), first))
+    return false;
+  LOG_WARN("Bloom journal may be trimmed past snapshot (%s, first %s), "
+           "full reload",
+           stream_id_.c_str(), first.c_str());
+  return true;
+}
+
+void BloomWarmer::run() {
+  // 快照之后流被裁剪过（离线太久）: 中间的改名 / 改证件号已无从追赶，重新全量
+  if (loaded_ && stream_id_ != "0-0" && journal_trimmed())
+    last_full_ms_ = 0;
+
+  for (;;) {
+    bool saturated = loaded_ && bloom_.stats().saturated;
+    if (saturated)
+      LOG_WARN("Key filter saturated, rebuilding with more capacity");
+    if (!loaded_ || saturated ||
+        now_ms() - last_full_ms_ > FULL_REBUILD_S * 1000LL) {
+      if (full_load()) {
+        if (!loaded_) {
+          loaded_ = true;
+          on_warmed_();
+        }
+      }
+    }
+    if (loaded_) {
+      catch_up_mysql();
+      catch_up_journal();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        caught_up_ = watermark_;
+      }
+      caught_up_cv_.notify_all();
+      if (dirty_ && now_ms() - last_save_ms_ > SAVE_INTERVAL_S * 1000LL)
+        save_snapshot();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (cv_.wait_for(lock, std::chrono::seconds(POLL_S),
+                     [this] { return stop_ || wake_; }) &&
+        stop_)
+      return;
+    wake_ = false;
+  }
+}
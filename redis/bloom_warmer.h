@@ -0,0 +1,99 @@
+#ifndef BLOOM_WARMER_H
+#define BLOOM_WARMER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "key_filter.h"
+#include "redis_pool.h"
+
+// 键过滤器（布隆 / 布谷鸟）的持久化与后台追赶 —— 重启后毫秒级恢复防穿透能力
+//
+// 启动:
+//   start() 同步 mmap 读取本地快照（带版本与校验和），校验通过即导入并回调 on_warmed，
+//   不查 MySQL；快照缺失 / 损坏 / 布局版本不符时由后台线程做一次流式全量加载
+//   （mysql_use_result 逐行插入新表，不把全部键攒进内存）。
+// 追赶（后台线程，每 POLL_S 秒）:
+//   - MySQL: student_id > 水位线 的新行 —— 新行进入过滤器的唯一途径（API 新增后
+//     经 wait_caught_up() 立即追赶；也覆盖绕过 API 的直接导入）。全量加载只扫到
+//     max_id 并以之为水位线，两者不重叠，每行恰好插入一次（布谷鸟按次计数）
+//   - Redis 流 JOURNAL_KEY: 各节点改名 / 改证件号 / 删除学生时 XADD 的键
+//     （字段 k = 插入，d = 删除），快照记录已消费到的流 ID
+//   有变化且距上次落盘超过 SAVE_INTERVAL_S 时重写快照（临时文件 + rename，原子替换）。
+// 每 FULL_REBUILD_S 做一次全量重建，清掉已删除学生残留的位（布隆不支持删除），
+// 控制误判率漂移；布谷鸟过滤器装满（saturated）时提前按当前行数扩容重建。
+class BloomWarmer {
+public:
+  static constexpr const char *JOURNAL_KEY = "exam:bloom:journal";
+  static constexpr long JOURNAL_MAXLEN = 100000;
+  // 本进程写入流的来源标识（字段 src），追赶时跳过自己写的条目，删除不会被重放两次
+  static const std::string &node_id();
+
+  BloomWarmer(std::string snapshot_path, KeyFilter &bloom,
+              redis_pool *redis, std::function<void()> on_warmed)
+      : path_(std::move(snapshot_path)), bloom_(bloom), redis_(redis),
+        on_warmed_(std::move(on_warmed)) {}
+  ~BloomWarmer() { stop(); }
+
+  void start();
+  void stop(); // 停止后台线程并落盘一次
+
+  // 唤醒后台线程立即追赶 MySQL，等待水位线越过 student_id，超时返回 false
+  bool wait_caught_up(uint64_t student_id, int timeout_ms);
+
+private:
+  struct SnapshotHeader {
+    char magic[8];         // "TWSBLOOM"
+    uint32_t version;      // KeyFilter::layout_version()
+    uint32_t header_size;  // sizeof(SnapshotHeader)，便于以后追加字段
+    uint64_t num_words;    // 位数组 64 位字个数
+    uint64_t watermark;    // 已并入的最大 student_id
+    uint64_t created_ms;   // 写入时间（Unix 毫秒）
+    uint64_t checksum;     // 位数组的 wyhash
+    char stream_id[32];    // 已消费到的 JOURNAL_KEY 流 ID
+  };
+
+  bool load_snapshot();
+  bool save_snapshot();
+  bool full_load();
+  bool catch_up_mysql();
+  bool catch_up_journal();
+  bool journal_trimmed(); // 快照之后未消费的流条目是否已被裁剪
+  void run();
+
+  static int64_t now_ms();
+
+  static constexpr int POLL_S = 10;
+  static constexpr int SAVE_INTERVAL_S = 300;
+  static constexpr int FULL_REBUILD_S = 24 * 3600;
+  static constexpr int MYSQL_BATCH = 10000;
+  static constexpr double GROWTH_HEADROOM = 1.25; // 全量加载时为新增预留的容量
+
+  std::string path_;
+  KeyFilter &bloom_;
+  redis_pool *redis_;
+  std::function<void()> on_warmed_;
+
+  // 以下仅后台线程（及 start / stop）访问
+  uint64_t watermark_ = 0;
+  std::string stream_id_ = "0-0";
+  bool loaded_ = false;  // 是否已有完整数据（快照或全量）
+  bool dirty_ = false;
+  int64_t last_save_ms_ = 0;
+  int64_t last_full_ms_ = 0;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable caught_up_cv_;
+  bool stop_ = false;
+  bool wake_ = false;       // mutex_ 保护
+  uint64_t caught_up_ = 0;  // mutex_ 保护: 最近一次追赶后的水位线
+};
+
+#endif
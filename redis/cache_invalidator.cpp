@@ -0,0 +1,146 @@
+#include "cache_invalidator.h"
+#include "log/log.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+
+void CacheInvalidator::start(const std::string &host, int port,
+                             const std::string &password) {
+  host_ = host;
+  port_ = port;
+  password_ = password;
+  stop_.store(false);
+  thread_ = std::thread(&CacheInvalidator::run, this);
+}
+
+void CacheInvalidator::stop() {
+  stop_.store(true);
+  if (thread_.joinable())
+    thread_.join();
+}
+
+redisContext *CacheInvalidator::connect_and_track() {
+  struct timeval timeout = {1, 500000};
+  redisContext *ctx = redisConnectWithTimeout(host_.c_str(), port_, timeout);
+  if (!ctx || ctx->err) {
+    if (ctx)
+      redisFree(ctx);
+    return nullptr;
+  }
+
+  auto command_ok = [&](redisReply *reply) {
+    bool ok = reply && reply->type != REDIS_REPLY_ERROR;
+    if (reply && reply->type == REDIS_REPLY_ERROR)
+      LOG_WARN("Cache invalidator: %s", reply->str);
+    freeReplyObject(reply);
+    return ok;
+  };
+
+  if (!password_.empty() &&
+      !command_ok(static_cast<redisReply *>(
+          redisCommand(ctx, "AUTH %s", password_.c_str())))) {
+    redisFree(ctx);
+    return nullptr;
+  }
+  // RESP3 才能在同一连接上接收推送（Redis >= 6）
+  if (!command_ok(static_cast<redisReply *>(redisCommand(ctx, "HELLO 3"))) ||
+      !command_ok(static_cast<redisReply *>(
+          redisCommand(ctx, "CLIENT TRACKING ON BCAST PREFIX %s",
+                       prefix_.c_str())))) {
+    redisFree(ctx);
+    return nullptr;
+  }
+  return ctx;
+}
+
+bool CacheInvalidator::handle_reply(redisReply *reply) {
+  if (reply->type != REDIS_REPLY_PUSH)
+    return reply->type != REDIS_REPLY_ERROR; // PING 的 PONG 等带内回复
+
+  if (reply->elements < 2 || reply->element[0]->type != REDIS_REPLY_STRING ||
+      strcmp(reply->element[0]->str, "invalidate") != 0)
+    return true; // 其他推送类型忽略
+
+  redisReply *keys = reply->element[1];
+  if (keys->type == REDIS_REPLY_NIL) {
+    on_flush_();
+  } else if (keys->type == REDIS_REPLY_ARRAY) {
+    for (size_t i = 0; i < keys->elements; ++i) {
+      redisReply *k = keys->element[i];
+      if (k->type == REDIS_REPLY_STRING)
+        on_key_(std::string_view(k->str, k->len));
+    }
+  }
+  return true;
+}
+
+void CacheInvalidator::run() {
+  using clock = std::chrono::steady_clock;
+  bool warned = false;
+
+  while (!stop_.load()) {
+    redisContext *ctx = connect_and_track();
+    if (!ctx) {
+      if (!warned) {
+        LOG_WARN("Cache invalidator: cannot enable CLIENT TRACKING on %s:%d, "
+                 "L1 falls back to short TTL",
+                 host_.c_str(), port_);
+        warned = true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(RECONNECT_MS));
+      continue;
+    }
+    warned = false;
+
+    // 断线期间的写入无从得知，先清空本地层再声明跟踪生效
+    on_flush_();
+    on_state_(true);
+    LOG_INFO("Cache invalidator: tracking prefix '%s' on %s:%d",
+             prefix_.c_str(), host_.c_str(), port_);
+
+    auto last_rx = clock::now();
+    auto last_ping = last_rx;
+    bool healthy = true;
+    while (healthy && !stop_.load()) {
+      struct pollfd pfd = {ctx->fd, POLLIN, 0};
+      int n = poll(&pfd, 1, POLL_MS);
+      auto now = clock::now();
+
+      if (n > 0) {
+        if (redisBufferRead(ctx) != REDIS_OK) {
+          healthy = false;
+          break;
+        }
+        last_rx = now;
+        void *r = nullptr;
+        while (healthy && redisGetReplyFromReader(ctx, &r) == REDIS_OK && r) {
+          healthy = handle_reply(static_cast<redisReply *>(r));
+          freeReplyObject(r);
+          r = nullptr;
+        }
+        if (ctx->err)
+          healthy = false;
+      } else if (n < 0 && errno != EINTR) {
+        healthy = false;
+      }
+
+      if (now - last_rx > std::chrono::seconds(DEAD_AFTER_S)) {
+        healthy = false;
+      } else if (healthy && now - last_ping > std::chrono::seconds(PING_INTERVAL_S) &&
+                 now - last_rx > std::chrono::seconds(PING_INTERVAL_S)) {
+        int done = 0;
+        redisAppendCommand(ctx, "PING");
+        while (!done && redisBufferWrite(ctx, &done) == REDIS_OK) {
+        }
+        last_ping = now;
+      }
+    }
+
+    on_state_(false);
+    redisFree(ctx);
+    if (!stop_.load())
+      LOG_WARN("Cache invalidator: connection lost, reconnecting");
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef CACHE_INVALIDATOR_H
+#define CACHE_INVALIDATOR_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <hiredis/hiredis.h>
+
+// 跨节点 L1 失效 —— RESP3 客户端缓存跟踪（CLIENT TRACKING BCAST）
+//
+// 后台线程持有一条独立的 Redis 连接（不占用连接池）:
+//   HELLO 3
+//   CLIENT TRACKING ON BCAST PREFIX <prefix>
+// 之后任意节点（或 redis-cli）对该前缀下 key 的写入 / 删除 / 过期，Redis 都会
+// 向本连接推送 ["invalidate", [key, ...]]；FLUSHALL / FLUSHDB 推送 ["invalidate", nil]。
+// 线程以 poll() 等待推送，收到后立即回调，失效延迟约为一次网络单程。
+//
+// 断线期间可能漏掉失效消息: 回调 on_state(false)，重连成功后先 on_flush()
+// 清空本地层再 on_state(true)，调用方据此决定 L1 可用的最长 TTL。
+class CacheInvalidator {
+public:
+  using KeyFn = std::function<void(std::string_view key)>;
+  using FlushFn = std::function<void()>;
+  using StateFn = std::function<void(bool tracking)>;
+
+  CacheInvalidator(std::string prefix, KeyFn on_key, FlushFn on_flush,
+                   StateFn on_state)
+      : prefix_(std::move(prefix)), on_key_(std::move(on_key)),
+        on_flush_(std::move(on_flush)), on_state_(std::move(on_state)) {}
+  ~CacheInvalidator() { stop(); }
+
+  void start(const std::string &host, int port, const std::string &password);
+  void stop();
+
+private:
+  void run();
+  redisContext *connect_and_track();
+  // 处理一条回复，返回 false 表示协议异常需重连
+  bool handle_reply(redisReply *reply);
+
+  static constexpr int POLL_MS = 1000;
+  static constexpr int PING_INTERVAL_S = 10; // 空闲时发 PING 探活
+  static constexpr int DEAD_AFTER_S = 30;    // 超过此时间无任何数据视为断线
+  static constexpr int RECONNECT_MS = 1000;
+
+  std::string prefix_;
+  KeyFn on_key_;
+  FlushFn on_flush_;
+  StateFn on_state_;
+
+  std::string host_;
+  int port_ = 0;
+  std::string password_;
+
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include "circuit_breaker.h"
+#include "log/log.h"
+
+#include <algorithm>
+
+// ── 全局登记表（统计输出用） ────────────────────────────────────────────
+
+static std::mutex &registry_mutex() {
+  static std::mutex m;
+  return m;
+}
+static std::vector<CircuitBreaker *> &registry() {
+  static std::vector<CircuitBreaker *> r;
+  return r;
+}
+
+CircuitBreaker::CircuitBreaker(std::string name)
+    : CircuitBreaker(std::move(name), Options()) {}
+
+CircuitBreaker::CircuitBreaker(std::string name, Options opts)
+    : name_(std::move(name)), opts_(opts) {
+  opts_.window_s = std::clamp(opts_.window_s, 1, MAX_WINDOW_S);
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  registry().push_back(this);
+}
+
+CircuitBreaker::~CircuitBreaker() {
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  auto &r = registry();
+  r.erase(std::remove(r.begin(), r.end(), this), r.end());
+}
+
+std::vector<CircuitBreaker::Snapshot> CircuitBreaker::snapshot_all() {
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  std::vector<Snapshot> out;
+  out.reserve(registry().size());
+  for (const CircuitBreaker *b : registry())
+    out.push_back(b->snapshot());
+  return out;
+}
+
+const char *CircuitBreaker::state_name(CircuitState s) {
+  switch (s) {
+  case CircuitState::CLOSED: return "CLOSED";
+  case CircuitState::OPEN: return "OPEN";
+  case CircuitState::HALF_OPEN: return "HALF_OPEN";
+  }
+  return "?";
+}
+
+// ── 状态机 ──────────────────────────────────────────────────────────────
+
+bool CircuitBreaker::allow_request() {
+  // CLOSED 是常态，不加锁
+  if (state_.load() == CircuitState::CLOSED)
+    return true;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Clock::time_point now = Clock::now();
+  switch (state_.load()) {
+  case CircuitState::CLOSED:
+    return true;
+
+  case CircuitState::OPEN:
+    if (now - opened_at_ >= std::chrono::milliseconds(opts_.recovery_timeout_ms)) {
+      transition(CircuitState::HALF_OPEN, "recovery timeout");
+      ++half_open_permits_;
+      return true;
+    }
+    break;
+
+  case CircuitState::HALF_OPEN:
+    // 探测请求可能没有上报结果（调用方提前返回）: 超时后放行新一批，避免卡在半开
+    if (half_open_permits_ >= opts_.half_open_max &&
+        now - half_open_at_ >= std::chrono::milliseconds(opts_.recovery_timeout_ms)) {
+      half_open_at_ = now;
+      half_open_permits_ = 0;
+      half_open_successes_ = 0;
+    }
+    if (half_open_permits_ < opts_.half_open_max) {
+      ++half_open_permits_;
+      return true;
+    }
+    break;
+  }
+  rejected_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void CircuitBreaker::on_success(Clock::duration latency) {
+  bool slow = latency > std::chrono::milliseconds(opts_.slow_call_ms);
+  std::lock_guard<std::mutex> lock(mutex_);
+  record(true, slow);
+}
+
+void CircuitBreaker::on_failure() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  record(false, false);
+}
+
+void CircuitBreaker::on_fast_success() {
+  int64_t sec = now_s();
+  FastBucket &f = fast_[static_cast<size_t>(sec % MAX_WINDOW_S)];
+  int64_t seen = f.sec.load(std::memory_order_relaxed);
+  // 进入新的一秒: 抢到换桶的线程清零（与并发累加的竞争至多丢几次计数）
+  if (seen != sec &&
+      f.sec.compare_exchange_strong(seen, sec, std::memory_order_relaxed))
+    f.calls.store(0, std::memory_order_relaxed);
+  f.calls.fetch_add(1, std::memory_order_relaxed);
+  // 先读后写: 标志已置位时不再写这条缓存行
+  if (!fast_success_.load(std::memory_order_relaxed))
+    fast_success_.store(true, std::memory_order_relaxed);
+}
+
+void CircuitBreaker::on_checkout(Clock::duration waited) {
+  if (waited != Clock::duration::zero() || state() != CircuitState::CLOSED)
+    on_success(waited);
+  else
+    on_fast_success();
+}
+
+void CircuitBreaker::record(bool ok, bool slow) {
+  int64_t sec = now_s();
+  Bucket &b = buckets_[static_cast<size_t>(sec % opts_.window_s)];
+  if (b.sec != sec)
+    b = Bucket{sec, 0, 0, 0};
+  ++b.calls;
+  b.failures += !ok;
+  b.slow += slow;
+  // 两次加锁上报之间有快路径成功: 连续失败已被打断
+  if (fast_success_.load(std::memory_order_relaxed)) {
+    fast_success_.store(false, std::memory_order_relaxed);
+    consecutive_failures_ = 0;
+  }
+  consecutive_failures_ = ok ? 0 : consecutive_failures_ + 1;
+
+  switch (state_.load()) {
+  case CircuitState::OPEN:
+    return; // 熔断前已发出的调用迟到的结果
+
+  case CircuitState::HALF_OPEN:
+    if (!ok || slow) {
+      transition(CircuitState::OPEN, !ok ? "probe failed" : "probe slow");
+    } else if (++half_open_successes_ >= opts_.half_open_max) {
+      transition(CircuitState::CLOSED, "probes succeeded");
+    }
+    return;
+
+  case CircuitState::CLOSED:
+    break;
+  }
+
+  if (!ok && opts_.consecutive_failures > 0 &&
+      consecutive_failures_ >= opts_.consecutive_failures) {
+    transition(CircuitState::OPEN, "consecutive failures");
+    return;
+  }
+  if (ok && !slow)
+    return; // 成功且不慢不会让比例上升
+  uint32_t calls, failures, slow_calls;
+  totals(sec, calls, failures, slow_calls);
+  if (calls < static_cast<uint32_t>(opts_.min_calls))
+    return;
+  if (failures >= opts_.failure_rate * calls)
+    transition(CircuitState::OPEN, "failure rate");
+  else if (slow_calls >= opts_.slow_rate * calls)
+    transition(CircuitState::OPEN, "slow call rate");
+}
+
+void CircuitBreaker::totals(int64_t now_s, uint32_t &calls, uint32_t &failures,
+                            uint32_t &slow) const {
+  calls = failures = slow = 0;
+  for (int i = 0; i < opts_.window_s; ++i) {
+    const Bucket &b = buckets_[i];
+    if (b.sec > now_s - opts_.window_s) {
+      calls += b.calls;
+      failures += b.failures;
+      slow += b.slow;
+    }
+  }
+  for (const FastBucket &f : fast_) {
+    int64_t sec = f.sec.load(std::memory_order_relaxed);
+    if (sec > now_s - opts_.window_s && sec <= now_s)
+      calls += f.calls.load(std::memory_order_relaxed);
+  }
+}
+
+void CircuitBreaker::transition(CircuitState to, const char *reason) {
+  CircuitState from = state_.load();
+  if (from == to)
+    return;
+  uint32_t calls, failures, slow;
+  totals(now_s(), calls, failures, slow);
+
+  Clock::time_point now = Clock::now();
+  if (to == CircuitState::OPEN) {
+    opened_at_ = now;
+    trips_.fetch_add(1, std::memory_order_relaxed);
+  } else if (to == CircuitState::HALF_OPEN) {
+    half_open_at_ = now;
+    half_open_permits_ = 0;
+    half_open_successes_ = 0;
+  } else {
+    clear_window(); // 恢复后从干净的窗口重新统计
+  }
+  state_.store(to);
+
+  if (to == CircuitState::OPEN)
+    LOG_WARN("Circuit breaker [%s]: %s -> OPEN (%s; window calls=%u "
+             "failures=%u slow=%u)",
+             name_.c_str(), state_name(from), reason, calls, failures, slow);
+  else
+    LOG_INFO("Circuit breaker [%s]: %s -> %s (%s)", name_.c_str(),
+             state_name(from), state_name(to), reason);
+}
+
+void CircuitBreaker::clear_window() {
+  buckets_.fill(Bucket{});
+  for (FastBucket &f : fast_) {
+    f.sec.store(-1, std::memory_order_relaxed);
+    f.calls.store(0, std::memory_order_relaxed);
+  }
+  fast_success_.store(false, std::memory_order_relaxed);
+  consecutive_failures_ = 0;
+}
+
+void CircuitBreaker::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  clear_window();
+  half_open_permits_ = 0;
+  half_open_successes_ = 0;
+  if (state_.load() != CircuitState::CLOSED)
+    transition(CircuitState::CLOSED, "manual reset");
+}
+
+void CircuitBreaker::configure(const Options &opts) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  opts_ = opts;
+  opts_.window_s = std::clamp(opts_.window_s, 1, MAX_WINDOW_S);
+  clear_window();
+}
+
+CircuitBreaker::Snapshot CircuitBreaker::snapshot() const {
+  Snapshot s;
+  s.name = name_;
+  s.state = state_.load();
+  s.trips = trips_.load(std::memory_order_relaxed);
+  s.rejected = rejected_.load(std::memory_order_relaxed);
+  uint32_t failures, slow;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    totals(now_s(), s.calls, failures, slow);
+  }
+  if (s.calls) {
+    s.failure_rate = static_cast<double>(failures) / s.calls;
+    s.slow_rate = static_cast<double>(slow) / s.calls;
+  }
+  return s;
+}
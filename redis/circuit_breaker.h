@@ -1,16 +1,32 @@
 #ifndef CIRCUIT_BREAKER_H
 #define CIRCUIT_BREAKER_H
 
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <mutex>
+#include <string>
+#include <vector>
 
-// 熔断器 —— 缓存服务不可用时自动降级，防止服务雪崩
+// 熔断器 —— 依赖不可用或变慢时自动降级，防止服务雪崩
 //
 // 三态状态机:
-//   CLOSED    → 正常请求，连续失败达阈值则 → OPEN
-//   OPEN      → 快速失败（不访问 Redis），超时后 → HALF_OPEN
-//   HALF_OPEN → 放行少量探测请求，成功则 → CLOSED，失败则 → OPEN
+//   CLOSED    → 正常请求，滑动窗口内失败率 / 慢调用率超阈值（或连续失败达阈值）则 → OPEN
+//   OPEN      → 快速失败（不访问依赖），超时后 → HALF_OPEN
+//   HALF_OPEN → 放行少量探测请求，全部成功且不慢则 → CLOSED，任一失败 / 慢调用则 → OPEN
+//
+// 滑动窗口按秒分桶（环形数组，window_s 个桶），每桶记调用数 / 失败数 / 慢调用数。
+// 只看连续失败时，50% 失败或每次 800ms 的依赖永远不会熔断，每个请求都走慢路径；
+// 窗口内调用数不足 min_calls 时不按比例判定（避免低流量时一次失败就熔断），
+// 此时仍由连续失败阈值兜底（依赖彻底宕机时快速熔断）。
+//
+// 连接池借用经 on_checkout() 上报: 未排队且 CLOSED 时走 on_fast_success()
+// （不加锁，只累加按秒分桶的原子计数），同样计入窗口调用数并打断连续失败，
+// 热路径上不进 mutex_。
+//
+// 每个依赖一个实例（Redis、MySQL、各连接池），构造时登记到全局表，
+// snapshot_all() 供定时统计输出；状态切换写日志并计数。
 
 enum class CircuitState {
   CLOSED,     // 正常
@@ -20,76 +36,114 @@ enum class CircuitState {
 
 class CircuitBreaker {
 public:
-  // fail_threshold: 连续失败多少次后熔断
-  // recovery_timeout_ms: 熔断多久后进入半开尝试恢复
-  // half_open_max: 半开状态最多放行多少个探测请求
-  CircuitBreaker(int fail_threshold = 5,
-                 int recovery_timeout_ms = 30000,
-                 int half_open_max = 3)
-      : fail_threshold_(fail_threshold),
-        recovery_timeout_ms_(recovery_timeout_ms),
-        half_open_max_(half_open_max) {}
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    int window_s = 10;             // 滑动窗口长度（秒），上限 MAX_WINDOW_S
+    int min_calls = 20;            // 窗口内至少这么多调用才按比例判定
+    double failure_rate = 0.5;     // 失败率阈值
+    int slow_call_ms = 500;        // 超过即记为慢调用
+    double slow_rate = 0.8;        // 慢调用率阈值
+    int consecutive_failures = 5;  // 连续失败阈值（0 = 不启用）
+    int recovery_timeout_ms = 30000; // 熔断多久后进入半开
+    int half_open_max = 3;         // 半开状态放行的探测请求数（全部成功才恢复）
+  };
+
+  struct Snapshot {
+    std::string name;
+    CircuitState state = CircuitState::CLOSED;
+    uint32_t calls = 0;            // 窗口内
+    double failure_rate = 0;
+    double slow_rate = 0;
+    uint64_t trips = 0;            // 累计熔断次数
+    uint64_t rejected = 0;         // 累计被快速失败的请求
+  };
+
+  explicit CircuitBreaker(std::string name);
+  CircuitBreaker(std::string name, Options opts);
+  ~CircuitBreaker();
+
+  CircuitBreaker(const CircuitBreaker &) = delete;
+  CircuitBreaker &operator=(const CircuitBreaker &) = delete;
 
   // 检查是否允许通过，返回 true 表示可以尝试调用
-  bool allow_request() {
-    switch (state_.load()) {
-    case CircuitState::CLOSED:
-      return true;
-
-    case CircuitState::OPEN: {
-      auto elapsed = std::chrono::steady_clock::now() - opened_at_;
-      if (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()
-          >= recovery_timeout_ms_) {
-        state_.store(CircuitState::HALF_OPEN);
-        half_open_count_.store(0);
-        return true;
-      }
-      return false;
-    }
-
-    case CircuitState::HALF_OPEN:
-      return half_open_count_.fetch_add(1) < half_open_max_;
-    }
-    return false;
-  }
+  bool allow_request();
 
-  // 调用成功时上报
-  void on_success() {
-    fail_count_.store(0);
-    if (state_.load() == CircuitState::HALF_OPEN) {
-      state_.store(CircuitState::CLOSED);
-    }
-  }
+  // 调用成功时上报；latency 超过 slow_call_ms 记为慢调用（0 = 未计时）
+  void on_success(Clock::duration latency = Clock::duration::zero());
 
   // 调用失败时上报
-  void on_failure() {
-    int count = fail_count_.fetch_add(1) + 1;
-    if (state_.load() == CircuitState::HALF_OPEN ||
-        count >= fail_threshold_) {
-      state_.store(CircuitState::OPEN);
-      opened_at_ = std::chrono::steady_clock::now();
-    }
-  }
+  void on_failure();
+
+  // 不计时的成功上报，不加锁（仅用于 CLOSED 状态下的热路径）:
+  // 计入窗口调用数，并在下一次加锁上报时清零连续失败计数
+  void on_fast_success();
+
+  // 连接池借到连接时上报: 排队过的借用（以及半开探测）计时走 on_success()，
+  // 其余走 on_fast_success()
+  void on_checkout(Clock::duration waited);
 
   bool is_open() const { return state_.load() == CircuitState::OPEN; }
 
   CircuitState state() const { return state_.load(); }
 
-  void reset() {
-    state_.store(CircuitState::CLOSED);
-    fail_count_.store(0);
-    half_open_count_.store(0);
-  }
+  void reset();
+
+  // 运行时调整阈值（清空窗口）
+  void configure(const Options &opts);
+
+  const std::string &name() const { return name_; }
+  Snapshot snapshot() const;
+
+  // 所有已登记实例的快照
+  static std::vector<Snapshot> snapshot_all();
+
+  static const char *state_name(CircuitState s);
+
+  static constexpr int MAX_WINDOW_S = 60;
 
 private:
-  int fail_threshold_;
-  int recovery_timeout_ms_;
-  int half_open_max_;
+  struct Bucket {
+    int64_t sec = -1;
+    uint32_t calls = 0;
+    uint32_t failures = 0;
+    uint32_t slow = 0;
+  };
+  // on_fast_success() 的计数，按 MAX_WINDOW_S 取模分桶，与 window_s 的修改无关
+  struct FastBucket {
+    std::atomic<int64_t> sec{-1};
+    std::atomic<uint32_t> calls{0};
+  };
+
+  // 以下调用方持有 mutex_
+  void record(bool ok, bool slow);
+  void totals(int64_t now_s, uint32_t &calls, uint32_t &failures,
+              uint32_t &slow) const;
+  void transition(CircuitState to, const char *reason);
+  void clear_window();
+
+  static int64_t now_s() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               Clock::now().time_since_epoch())
+        .count();
+  }
+
+  const std::string name_;
+  Options opts_;
 
   std::atomic<CircuitState> state_{CircuitState::CLOSED};
-  std::atomic<int> fail_count_{0};
-  std::atomic<int> half_open_count_{0};
-  std::chrono::steady_clock::time_point opened_at_;
+  std::atomic<uint64_t> trips_{0};
+  std::atomic<uint64_t> rejected_{0};
+
+  mutable std::mutex mutex_;
+  std::array<Bucket, MAX_WINDOW_S> buckets_{};
+  int consecutive_failures_ = 0;
+  std::array<FastBucket, MAX_WINDOW_S> fast_{};
+  std::atomic<bool> fast_success_{false}; // 上次加锁上报以来有过快路径成功
+  Clock::time_point opened_at_;
+  Clock::time_point half_open_at_;
+  int half_open_permits_ = 0;   // 半开状态已放行的探测数
+  int half_open_successes_ = 0;
 };
 
 #endif
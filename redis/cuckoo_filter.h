@@ -0,0 +1,387 @@
+#ifndef CUCKOO_FILTER_H
+#define CUCKOO_FILTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "bloom_filter.h" // bloom_detail::wyhash
+#include "key_filter.h"
+#include "read_epoch.h"
+
+// 布谷鸟过滤器 —— 支持删除的防穿透过滤器
+//
+// 布局: 每桶 4 槽、每槽 16 位指纹（0 表示空），一个桶恰好是一个 64 位原子字
+//   - key 的 wyhash: 乘法-移位选主桶 i1，低 16 位为指纹 f（0 映射为 1）
+//   - 备用桶 i2 = (H(f) - i1) mod n，再算一次即回到 i1，桶数不必是 2 的幂
+//   - 查询只读 2 个字（SWAR 一次比较 4 个槽）；误判率 ≈ 8·装载率 / 65535（≤ 0.012%）
+//   每元素约 16 / 装载率 位，约为 1% 布隆的两倍，换来删除与更低的误判率。
+//
+// 并发:
+//   - 读无锁；写（insert / remove）串行于 writer_mutex_
+//   - 踢出（kick）时被挤出的指纹短暂不在任何桶中，用顺序锁 seq_（奇数 = 踢出中）兜底:
+//     读者未命中时若 seq_ 为奇数或前后变化则重读；命中总是可信的
+//   - 表挂在原子指针上，rebuild / import 离线构建后一次交换发布（同 BloomFilter），
+//     构建期间并发的增删记入日志，发布前按顺序重放；旧表等读者退出后释放（read_epoch.h）
+//
+// 语义（多重集合）:
+//   - insert 每次都存一份指纹，remove 删去一份。两个键恰好同桶对同指纹时各占一槽，
+//     删除其一不影响另一个；同一桶对最多存 2 × SLOTS 份同指纹，再多则标记 overflow
+//   - 因此调用方须让每个键的插入次数与删除次数对应: 每个 DB 行只插入一次，
+//     缓存回填不插入（见 RedisCache::bloom_sync()）；多插只会多一个残留误判，
+//     多删才会漏判
+//   - 踢出 MAX_KICKS 次仍无空槽时，最后的指纹放进 victim 暂存位（saturated）；
+//     暂存位已占用时再需要踢出则标记 overflow，contains 一律返回 true
+//     （退化为不过滤，绝不漏判），直到扩容重建
+class CuckooFilter : public KeyFilter {
+public:
+  CuckooFilter(size_t expected_elements = 1000000);
+  ~CuckooFilter() override;
+
+  CuckooFilter(const CuckooFilter &) = delete;
+  CuckooFilter &operator=(const CuckooFilter &) = delete;
+
+  void insert(const std::string &key) override;
+  bool contains(const std::string &key) const override;
+  bool remove(const std::string &key) override;
+  bool supports_remove() const override { return true; }
+
+  // 误判率由指纹位数决定，false_positive_rate 参数不起作用
+  void rebuild_with(size_t expected_elements, double false_positive_rate,
+                    const Fill &fill) override;
+
+  static constexpr uint32_t LAYOUT_VERSION = (1u << 16) | 1;
+  uint32_t layout_version() const override { return LAYOUT_VERSION; }
+  // 布局: [victim, 桶 0, 桶 1, ...]
+  std::vector<uint64_t> export_words() const override;
+  bool import_words(const uint64_t *words, size_t n) override;
+
+  Stats stats() const override;
+
+private:
+  static constexpr int SLOTS = 4;
+  static constexpr double TARGET_LOAD = 0.85; // 按预期元素数定容时的装载率
+  static constexpr int MAX_KICKS = 500;
+  static constexpr uint64_t LANE_LO = 0x0001000100010001ULL;
+  static constexpr uint64_t LANE_HI = 0x8000800080008000ULL;
+
+  struct Table {
+    explicit Table(size_t n)
+        : num_buckets(n), buckets(new std::atomic<uint64_t>[n]) {}
+    size_t num_buckets;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets; // C++20 起值初始化为 0
+    std::atomic<uint64_t> victim{0};     // (桶号 << 16) | 指纹，0 = 空
+    std::atomic<bool> overflow{false};
+    std::atomic<size_t> items{0};
+  };
+
+  static uint64_t hash(std::string_view key) {
+    return bloom_detail::wyhash(key.data(), key.size(), 0);
+  }
+  static uint16_t fingerprint(uint64_t h) {
+    uint16_t f = static_cast<uint16_t>(h);
+    return f ? f : 1;
+  }
+  static size_t index(const Table &t, uint64_t h) {
+    return static_cast<size_t>(
+        (static_cast<unsigned __int128>(h) * t.num_buckets) >> 64);
+  }
+  static size_t alt_index(const Table &t, size_t i, uint16_t f) {
+    size_t hf = index(t, f * 0xc6a4a7935bd1e995ULL);
+    return hf >= i ? hf - i : hf + t.num_buckets - i;
+  }
+  // 桶内是否有指纹 f（SWAR: 4 个 16 位槽中是否有与 f 相等者）
+  static bool has(uint64_t bucket, uint16_t f) {
+    uint64_t x = bucket ^ (LANE_LO * f);
+    return ((x - LANE_LO) & ~x & LANE_HI) != 0;
+  }
+  static bool victim_is(const Table &t, size_t i1, size_t i2, uint16_t f) {
+    uint64_t v = t.victim.load(std::memory_order_relaxed);
+    return v && static_cast<uint16_t>(v) == f &&
+           ((v >> 16) == i1 || (v >> 16) == i2);
+  }
+  static size_t buckets_for(size_t expected_elements) {
+    double n = static_cast<double>(std::max<size_t>(expected_elements, 1));
+    return static_cast<size_t>(n / (SLOTS * TARGET_LOAD)) + 1;
+  }
+
+  // 以下在 writer_mutex_ 下（或对尚未发布的表）调用；live = 表已发布，踢出需走顺序锁
+  static int count(uint64_t bucket, uint16_t f);
+  bool try_put(Table &t, size_t i, uint16_t f);
+  bool add(Table &t, uint64_t h, bool live);
+  bool erase(Table &t, uint64_t h);
+
+  // 在新表上执行 build，重放并发增删日志后发布，等读者退出后释放旧表
+  template <typename Build>
+  void swap_in(std::unique_ptr<Table> next, Build &&build);
+
+  // 读者在 epoch_ 登记期间以 seq_cst 读取 table_（见 read_epoch.h）；
+  // 持有 writer_mutex_ 时表不会被替换，可直接读取
+  std::atomic<Table *> table_{nullptr};
+  ReadEpoch epoch_;
+  std::atomic<uint64_t> seq_{0};
+
+  std::mutex writer_mutex_;
+  std::mutex rebuild_mutex_;
+  bool rebuilding_ = false; // writer_mutex_ 保护
+  std::vector<std::pair<bool, std::string>> journal_; // {是否插入, key}
+};
+
+inline CuckooFilter::CuckooFilter(size_t expected_elements) {
+  table_.store(new Table(buckets_for(expected_elements)),
+               std::memory_order_release);
+}
+
+inline CuckooFilter::~CuckooFilter() { delete table_.load(); }
+
+// ── 读 ────────────────────────────────────────────────────────────────
+
+inline bool CuckooFilter::contains(const std::string &key) const {
+  uint64_t h = hash(key);
+  auto guard = epoch_.read();
+  const Table *t = table_.load();
+  if (t->overflow.load(std::memory_order_relaxed))
+    return true;
+  uint16_t f = fingerprint(h);
+  size_t i1 = index(*t, h);
+  size_t i2 = alt_index(*t, i1, f);
+  for (;;) {
+    uint64_t s = seq_.load(std::memory_order_acquire);
+    if (has(t->buckets[i1].load(std::memory_order_relaxed), f) ||
+        has(t->buckets[i2].load(std::memory_order_relaxed), f) ||
+        victim_is(*t, i1, i2, f))
+      return true;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!(s & 1) && seq_.load(std::memory_order_relaxed) == s)
+      return false;
+  }
+}
+
+// ── 写 ────────────────────────────────────────────────────────────────
+
+inline int CuckooFilter::count(uint64_t bucket, uint16_t f) {
+  int n = 0;
+  for (int lane = 0; lane < SLOTS; ++lane)
+    n += static_cast<uint16_t>(bucket >> (16 * lane)) == f;
+  return n;
+}
+
+inline bool CuckooFilter::try_put(Table &t, size_t i, uint16_t f) {
+  uint64_t b = t.buckets[i].load(std::memory_order_relaxed);
+  for (int lane = 0; lane < SLOTS; ++lane) {
+    if (((b >> (16 * lane)) & 0xFFFF) == 0) {
+      t.buckets[i].store(b | (static_cast<uint64_t>(f) << (16 * lane)),
+                         std::memory_order_relaxed);
+      t.items.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool CuckooFilter::add(Table &t, uint64_t h, bool live) {
+  uint16_t f = fingerprint(h);
+  size_t i1 = index(t, h);
+  size_t i2 = alt_index(t, i1, f);
+  // 两个桶已全是 f: 踢出只会让它们互换，直接退化为不过滤
+  if (count(t.buckets[i1].load(std::memory_order_relaxed), f) +
+          (i2 != i1 ? count(t.buckets[i2].load(std::memory_order_relaxed), f)
+                    : 0) >=
+      (i2 != i1 ? 2 : 1) * SLOTS) {
+    t.overflow.store(true, std::memory_order_relaxed);
+    return false;
+  }
+  if (try_put(t, i1, f) || try_put(t, i2, f))
+    return true;
+  if (t.victim.load(std::memory_order_relaxed)) {
+    t.overflow.store(true, std::memory_order_relaxed);
+    return false;
+  }
+
+  // 两个桶都满: 随机踢出一个指纹到它的备用桶，直到找到空槽
+  static thread_local uint64_t rng = reinterpret_cast<uintptr_t>(&rng) | 1;
+  auto next_rand = []() {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+  };
+  uint64_t s = 0;
+  if (live) {
+    s = seq_.load(std::memory_order_relaxed);
+    seq_.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  size_t i = (next_rand() & 1) ? i1 : i2;
+  bool placed = false;
+  for (int n = 0; n < MAX_KICKS && !placed; ++n) {
+    int lane = static_cast<int>(next_rand() & (SLOTS - 1));
+    uint64_t b = t.buckets[i].load(std::memory_order_relaxed);
+    uint16_t out = static_cast<uint16_t>(b >> (16 * lane));
+    b &= ~(0xFFFFULL << (16 * lane));
+    t.buckets[i].store(b | (static_cast<uint64_t>(f) << (16 * lane)),
+                       std::memory_order_relaxed);
+    f = out;
+    i = alt_index(t, i, f);
+    placed = try_put(t, i, f);
+  }
+  if (!placed) {
+    t.victim.store((static_cast<uint64_t>(i) << 16) | f,
+                   std::memory_order_relaxed);
+    t.items.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (live)
+    seq_.store(s + 2, std::memory_order_release);
+  return true;
+}
+
+inline bool CuckooFilter::erase(Table &t, uint64_t h) {
+  uint16_t f = fingerprint(h);
+  size_t i1 = index(t, h);
+  size_t i2 = alt_index(t, i1, f);
+  bool removed = false;
+  for (size_t i : {i1, i2}) {
+    uint64_t b = t.buckets[i].load(std::memory_order_relaxed);
+    for (int lane = 0; lane < SLOTS && !removed; ++lane) {
+      if (static_cast<uint16_t>(b >> (16 * lane)) == f) {
+        t.buckets[i].store(b & ~(0xFFFFULL << (16 * lane)),
+                           std::memory_order_relaxed);
+        removed = true;
+      }
+    }
+    if (removed)
+      break;
+  }
+  if (!removed && victim_is(t, i1, i2, f)) {
+    t.victim.store(0, std::memory_order_relaxed);
+    t.items.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  if (!removed)
+    return false;
+  t.items.fetch_sub(1, std::memory_order_relaxed);
+
+  // 腾出了空位: 暂存的 victim 尝试回到桶里（先放入再清暂存位，读者始终能看到它）
+  if (uint64_t v = t.victim.load(std::memory_order_relaxed)) {
+    uint16_t vf = static_cast<uint16_t>(v);
+    size_t vi = static_cast<size_t>(v >> 16);
+    if (try_put(t, vi, vf) || try_put(t, alt_index(t, vi, vf), vf)) {
+      t.victim.store(0, std::memory_order_relaxed);
+      t.items.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+  return true;
+}
+
+inline void CuckooFilter::insert(const std::string &key) {
+  uint64_t h = hash(key);
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  add(*table_.load(std::memory_order_relaxed), h, true);
+  if (rebuilding_)
+    journal_.emplace_back(true, key);
+}
+
+inline bool CuckooFilter::remove(const std::string &key) {
+  uint64_t h = hash(key);
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  bool removed = erase(*table_.load(std::memory_order_relaxed), h);
+  if (rebuilding_)
+    journal_.emplace_back(false, key);
+  return removed;
+}
+
+// ── 重建 / 快照 ──────────────────────────────────────────────────────
+
+template <typename Build>
+void CuckooFilter::swap_in(std::unique_ptr<Table> next, Build &&build) {
+  std::lock_guard<std::mutex> rlock(rebuild_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    rebuilding_ = true;
+  }
+  build(*next); // 新表尚未发布，不持写锁，并发增删照常进行并记入日志
+
+  std::unique_ptr<Table> old;
+  {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    for (const auto &[is_add, key] : journal_) {
+      if (is_add)
+        add(*next, hash(key), false);
+      else
+        erase(*next, hash(key));
+    }
+    journal_.clear();
+    old.reset(table_.exchange(next.release()));
+    rebuilding_ = false;
+  }
+  // 不持写锁等待: 读者无需写锁即可退出，期间增删照常进行
+  epoch_.synchronize();
+}
+
+inline void CuckooFilter::rebuild_with(size_t expected_elements,
+                                       double false_positive_rate,
+                                       const Fill &fill) {
+  (void)false_positive_rate;
+  size_t n = buckets_for(expected_elements);
+  if (expected_elements == 0) {
+    auto guard = epoch_.read();
+    n = table_.load()->num_buckets;
+  }
+  swap_in(std::make_unique<Table>(n), [this, &fill](Table &t) {
+    fill([this, &t](const std::string &key) { add(t, hash(key), false); });
+  });
+}
+
+inline std::vector<uint64_t> CuckooFilter::export_words() const {
+  auto guard = epoch_.read();
+  const Table *t = table_.load();
+  std::vector<uint64_t> out;
+  out.reserve(t->num_buckets + 1);
+  out.push_back(t->victim.load(std::memory_order_relaxed));
+  for (size_t i = 0; i < t->num_buckets; ++i)
+    out.push_back(t->buckets[i].load(std::memory_order_relaxed));
+  return out;
+}
+
+inline bool CuckooFilter::import_words(const uint64_t *words, size_t n) {
+  if (n < 2)
+    return false;
+  swap_in(std::make_unique<Table>(n - 1), [words](Table &t) {
+    size_t items = words[0] ? 1 : 0;
+    t.victim.store(words[0], std::memory_order_relaxed);
+    for (size_t i = 0; i < t.num_buckets; ++i) {
+      uint64_t b = words[i + 1];
+      t.buckets[i].store(b, std::memory_order_relaxed);
+      for (int lane = 0; lane < SLOTS; ++lane)
+        items += ((b >> (16 * lane)) & 0xFFFF) != 0;
+    }
+    t.items.store(items, std::memory_order_relaxed);
+  });
+  return true;
+}
+
+inline KeyFilter::Stats CuckooFilter::stats() const {
+  auto guard = epoch_.read();
+  const Table *t = table_.load();
+  Stats s;
+  s.kind = "cuckoo";
+  s.bytes = t->num_buckets * sizeof(uint64_t);
+  s.items = t->items.load(std::memory_order_relaxed);
+  s.occupancy = static_cast<double>(s.items) / (t->num_buckets * SLOTS);
+  // 查询比对 2 桶 × 4 槽，每个已占用槽以 1/65535 的概率指纹相同
+  s.est_fpr = 1.0 - std::pow(1.0 - 1.0 / 65535, 2 * SLOTS * s.occupancy);
+  s.saturated = t->victim.load(std::memory_order_relaxed) != 0 ||
+                t->overflow.load(std::memory_order_relaxed);
+  if (t->overflow.load(std::memory_order_relaxed))
+    s.est_fpr = 1.0;
+  return s;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef KEY_FILTER_H
+#define KEY_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 键存在性过滤器接口 —— 防缓存穿透
+//
+// 两种实现:
+//   - BloomFilter（bloom_filter.h）: 分块布隆，省内存，不支持删除
+//   - CuckooFilter（cuckoo_filter.h）: 布谷鸟过滤器，支持删除，
+//     学生被删除后其键不再通过过滤器，误判率不随增删累积而漂移
+// 两者都保证: contains() 返回 false 时键一定未插入过（或已删除）。
+class KeyFilter {
+public:
+  using Add = std::function<void(const std::string &)>;
+  using Fill = std::function<void(const Add &)>;
+
+  struct Stats {
+    const char *kind = "";
+    size_t bytes = 0;       // 占用内存
+    size_t items = 0;       // 元素数（布隆为按置位率的估计值）
+    double occupancy = 0;   // 布隆: 置位比例；布谷鸟: 槽位占用率
+    double est_fpr = 0;     // 按当前占用率估算的误判率
+    bool saturated = false; // 已满（布谷鸟插入失败），需扩容重建
+  };
+
+  virtual ~KeyFilter() = default;
+
+  // 布谷鸟按多重集合计数（插入几次就要删除几次），调用方每个 DB 行只插入一次
+  virtual void insert(const std::string &key) = 0;
+  virtual bool contains(const std::string &key) const = 0;
+  // 删除一个已插入的键；不支持删除的实现返回 false
+  virtual bool remove(const std::string &key) { (void)key; return false; }
+  virtual bool supports_remove() const { return false; }
+
+  // 离线构建只含 fill(add) 产出的键的新表（按 expected_elements 定容，
+  // 0 = 沿用当前容量）并原子发布；构建期间并发的增删不丢失
+  virtual void rebuild_with(size_t expected_elements,
+                            double false_positive_rate, const Fill &fill) = 0;
+  void rebuild(const std::vector<std::string> &keys, size_t expected_elements,
+               double false_positive_rate = 0.01) {
+    rebuild_with(expected_elements, false_positive_rate, [&keys](const Add &add) {
+      for (const auto &key : keys)
+        add(key);
+    });
+  }
+
+  // ── 快照（见 bloom_warmer.h） ──
+  // 高 16 位为实现类型，低 16 位为该实现的布局版本；不一致的快照作废
+  virtual uint32_t layout_version() const = 0;
+  virtual std::vector<uint64_t> export_words() const = 0;
+  virtual bool import_words(const uint64_t *words, size_t n) = 0;
+
+  virtual Stats stats() const = 0;
+};
+
+#endif
@@ -0,0 +1,335 @@
+#ifndef L1_CACHE_H
+#define L1_CACHE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 进程内 L1 缓存 —— RedisCache 之前的一层，热点 key 命中时无网络往返、无系统调用
+//
+// W-TinyLFU（Caffeine 同款策略），按字节预算而非条目数限容:
+//   - window  (1%):  小 LRU，新条目先进入这里，吸收突发流量
+//   - probation / protected (SLRU, 20% / 80%):  主区
+//   - 准入:  window 溢出的候选条目只有在访问频率高于主区淘汰者时才被接纳，
+//            频率由 4 行 Count-Min Sketch（计数上限 15，定期减半老化）估计
+//
+// 分片: key 哈希到 SHARDS 个分片，各自持锁，热点 key 不会串行化全部请求。
+// 过期: 每个条目带绝对过期时间（steady_clock，vDSO 读取不陷入内核），读取时惰性淘汰。
+class L1Cache {
+public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;  // 容量淘汰（不含过期与主动删除）
+    uint64_t rejections = 0; // 未通过 TinyLFU 准入的候选
+    size_t entries = 0;
+    size_t bytes = 0;
+  };
+
+  // capacity_bytes: 总字节预算（key + value + 固定开销）
+  explicit L1Cache(size_t capacity_bytes = 64 << 20) { reset(capacity_bytes); }
+
+  void reset(size_t capacity_bytes) {
+    for (auto &s : shards_)
+      s = std::make_unique<Shard>(capacity_bytes / SHARDS);
+  }
+
+  // 命中返回 true 并复制 value
+  bool get(std::string_view key, std::string &value) {
+    uint64_t h = hash(key);
+    return shard(h).get(key, h, value);
+  }
+
+  // ttl_ms: 本条目在 L1 的存活时间（调用方负责不超过 Redis 剩余 TTL）
+  void put(std::string_view key, std::string_view value, int64_t ttl_ms) {
+    if (ttl_ms <= 0)
+      return;
+    uint64_t h = hash(key);
+    shard(h).put(key, h, value, ttl_ms);
+  }
+
+  void erase(std::string_view key) {
+    uint64_t h = hash(key);
+    shard(h).erase(key);
+  }
+
+  // 清空全部条目（保留频率统计）
+  void clear() {
+    for (auto &s : shards_)
+      s->clear();
+  }
+
+  Stats stats() const {
+    Stats total;
+    for (const auto &s : shards_)
+      s->accumulate(total);
+    return total;
+  }
+
+private:
+  static constexpr size_t SHARDS = 16;
+  static constexpr size_t ENTRY_OVERHEAD = 96; // 链表节点 + 索引 + 字符串头的近似开销
+  static constexpr size_t AVG_ENTRY_BYTES = 512; // 估算条目数以确定 sketch 宽度
+
+  static int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // FNV-1a，高位选分片，低位供 sketch 派生行哈希
+  static uint64_t hash(std::string_view key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (char c : key)
+      h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    return h;
+  }
+
+  // ── 频率估计: 4 行 Count-Min Sketch，4 bit 语义（上限 15） ──────────
+  class FrequencySketch {
+  public:
+    explicit FrequencySketch(size_t expected_entries) {
+      size_t width = 64;
+      while (width < expected_entries)
+        width <<= 1;
+      mask_ = width - 1;
+      table_.assign(width * ROWS, 0);
+      sample_size_ = std::max<size_t>(10 * expected_entries, 64);
+    }
+
+    void increment(uint64_t h) {
+      bool added = false;
+      for (size_t r = 0; r < ROWS; ++r) {
+        uint8_t &c = table_[r * (mask_ + 1) + index(h, r)];
+        if (c < 15) {
+          ++c;
+          added = true;
+        }
+      }
+      if (added && ++additions_ >= sample_size_)
+        age();
+    }
+
+    uint8_t frequency(uint64_t h) const {
+      uint8_t f = 15;
+      for (size_t r = 0; r < ROWS; ++r)
+        f = std::min(f, table_[r * (mask_ + 1) + index(h, r)]);
+      return f;
+    }
+
+  private:
+    static constexpr size_t ROWS = 4;
+
+    size_t index(uint64_t h, size_t row) const {
+      // 每行用不同奇数种子重新混合
+      static constexpr uint64_t SEEDS[ROWS] = {
+          0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL,
+          0xd6e8feb86659fd93ULL};
+      uint64_t x = (h + SEEDS[row]) * SEEDS[(row + 1) % ROWS];
+      return static_cast<size_t>(x >> 32) & mask_;
+    }
+
+    // 老化: 全部计数减半，让历史热点逐渐让位
+    void age() {
+      for (auto &c : table_)
+        c >>= 1;
+      additions_ /= 2;
+    }
+
+    std::vector<uint8_t> table_;
+    size_t mask_ = 0;
+    size_t sample_size_ = 0;
+    size_t additions_ = 0;
+  };
+
+  enum class Region : uint8_t { WINDOW, PROBATION, PROTECTED };
+
+  struct Entry {
+    std::string key;
+    std::string value;
+    uint64_t hash;
+    int64_t expire_ms;
+    size_t charge;
+    Region region;
+  };
+  using List = std::list<Entry>;
+
+  class Shard {
+  public:
+    explicit Shard(size_t capacity)
+        : window_cap_(std::max<size_t>(capacity / 100, 1)),
+          main_cap_(capacity - window_cap_),
+          protected_cap_(main_cap_ * 4 / 5),
+          sketch_(capacity / AVG_ENTRY_BYTES) {}
+
+    bool get(std::string_view key, uint64_t h, std::string &value) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      sketch_.increment(h);
+      auto it = index_.find(key);
+      if (it == index_.end()) {
+        ++misses_;
+        return false;
+      }
+      List::iterator e = it->second;
+      if (e->expire_ms <= now_ms()) {
+        remove(e);
+        ++misses_;
+        return false;
+      }
+      touch(e);
+      value.assign(e->value);
+      ++hits_;
+      return true;
+    }
+
+    void put(std::string_view key, uint64_t h, std::string_view value,
+             int64_t ttl_ms) {
+      size_t charge = key.size() + value.size() + ENTRY_OVERHEAD;
+      std::lock_guard<std::mutex> lock(mutex_);
+      // 超过主区一半的大对象不进 L1，避免一次冲掉大量热点
+      if (charge > main_cap_ / 2)
+        return;
+      sketch_.increment(h);
+
+      int64_t expire = now_ms() + ttl_ms;
+      auto it = index_.find(key);
+      if (it != index_.end()) {
+        List::iterator e = it->second;
+        bytes(e->region) += charge - e->charge;
+        e->value.assign(value);
+        e->charge = charge;
+        e->expire_ms = expire;
+        touch(e);
+      } else {
+        window_.push_front(
+            Entry{std::string(key), std::string(value), h, expire, charge,
+                  Region::WINDOW});
+        index_.emplace(window_.front().key, window_.begin());
+        window_bytes_ += charge;
+      }
+      evict();
+    }
+
+    void erase(std::string_view key) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = index_.find(key);
+      if (it != index_.end())
+        remove(it->second);
+    }
+
+    void clear() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      index_.clear();
+      window_.clear();
+      probation_.clear();
+      protected_.clear();
+      window_bytes_ = probation_bytes_ = protected_bytes_ = 0;
+    }
+
+    void accumulate(Stats &s) const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      s.hits += hits_;
+      s.misses += misses_;
+      s.evictions += evictions_;
+      s.rejections += rejections_;
+      s.entries += index_.size();
+      s.bytes += window_bytes_ + probation_bytes_ + protected_bytes_;
+    }
+
+  private:
+    List &list(Region r) {
+      return r == Region::WINDOW      ? window_
+             : r == Region::PROBATION ? probation_
+                                      : protected_;
+    }
+    size_t &bytes(Region r) {
+      return r == Region::WINDOW      ? window_bytes_
+             : r == Region::PROBATION ? probation_bytes_
+                                      : protected_bytes_;
+    }
+
+    void move_to(List::iterator e, Region to) {
+      bytes(e->region) -= e->charge;
+      bytes(to) += e->charge;
+      list(to).splice(list(to).begin(), list(e->region), e);
+      e->region = to;
+    }
+
+    // 命中: window / protected 内部移到头部，probation 晋升 protected
+    void touch(List::iterator e) {
+      if (e->region == Region::PROBATION) {
+        move_to(e, Region::PROTECTED);
+        // protected 超额时把尾部降级回 probation
+        while (protected_bytes_ > protected_cap_ && protected_.size() > 1)
+          move_to(std::prev(protected_.end()), Region::PROBATION);
+      } else {
+        List &l = list(e->region);
+        l.splice(l.begin(), l, e);
+      }
+    }
+
+    void remove(List::iterator e) {
+      index_.erase(std::string_view(e->key));
+      bytes(e->region) -= e->charge;
+      list(e->region).erase(e);
+    }
+
+    void evict() {
+      // window 溢出: 尾部条目作为候选，与主区 LRU 尾部（victim）比较频率
+      while (window_bytes_ > window_cap_ && !window_.empty()) {
+        List::iterator cand = std::prev(window_.end());
+        bool admitted = true;
+        while (probation_bytes_ + protected_bytes_ + cand->charge > main_cap_) {
+          List::iterator victim = !probation_.empty()
+                                      ? std::prev(probation_.end())
+                                      : std::prev(protected_.end());
+          if (sketch_.frequency(cand->hash) > sketch_.frequency(victim->hash)) {
+            remove(victim);
+            ++evictions_;
+          } else {
+            admitted = false;
+            break;
+          }
+        }
+        if (admitted) {
+          move_to(cand, Region::PROBATION);
+        } else {
+          remove(cand);
+          ++rejections_;
+        }
+      }
+      // 主区条目原地更新变大时也可能超额
+      while (probation_bytes_ + protected_bytes_ > main_cap_) {
+        remove(!probation_.empty() ? std::prev(probation_.end())
+                                   : std::prev(protected_.end()));
+        ++evictions_;
+      }
+    }
+
+    mutable std::mutex mutex_;
+    size_t window_cap_;
+    size_t main_cap_;
+    size_t protected_cap_;
+    FrequencySketch sketch_;
+
+    List window_, probation_, protected_;
+    size_t window_bytes_ = 0, probation_bytes_ = 0, protected_bytes_ = 0;
+    // key 视图指向链表节点内的字符串，splice 不移动节点，视图始终有效
+    std::unordered_map<std::string_view, List::iterator> index_;
+
+    uint64_t hits_ = 0, misses_ = 0, evictions_ = 0, rejections_ = 0;
+  };
+
+  Shard &shard(uint64_t h) { return *shards_[h >> 60]; }
+
+  std::unique_ptr<Shard> shards_[SHARDS];
+};
+
+#endif
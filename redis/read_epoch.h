@@ -0,0 +1,69 @@
+#ifndef READ_EPOCH_H
+#define READ_EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+// 读者登记 —— 挂在原子指针上的表（BloomFilter / CuckooFilter）的安全回收
+//
+// 读者: 访问表前在所属槽的当前相位计数 +1，读完 -1（Guard 析构）。
+//   线程按登记顺序分散到 READER_SLOTS 条独立缓存行，读者之间不争抢同一行。
+// 写者: 交换表指针后调用 synchronize()，依次翻转相位并等待旧相位的计数归零；
+//   两个相位都排空后，任何可能读到旧指针的读者均已退出，旧表可立即释放。
+//   新读者总在翻转后的相位登记，持续的读流量不会让等待饿死。
+//
+// 正确性: 读者先登记再读指针，写者先交换指针再检查计数（均为 seq_cst）。
+// 读者的登记若晚于写者对该相位的检查，它读指针也晚于交换，只会看到新表；
+// 否则写者会等到它退出。因此读者的表指针须在 Guard 内以 seq_cst 读取，
+// synchronize() 须由调用方串行，且不能在读者可能等待的锁内调用。
+class ReadEpoch {
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> count[2]{};
+  };
+
+public:
+  static constexpr size_t READER_SLOTS = 32;
+
+  class Guard {
+  public:
+    explicit Guard(const ReadEpoch &e)
+        : slot_(&e.slots_[slot_index()]),
+          phase_(e.phase_.load(std::memory_order_relaxed) & 1) {
+      slot_->count[phase_].fetch_add(1, std::memory_order_seq_cst);
+    }
+    ~Guard() { slot_->count[phase_].fetch_sub(1, std::memory_order_release); }
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+  private:
+    Slot *slot_;
+    uint32_t phase_;
+  };
+
+  Guard read() const { return Guard(*this); }
+
+  // 返回时，调用前已交换出去的表不再被任何读者持有
+  void synchronize() {
+    for (int round = 0; round < 2; ++round) {
+      uint32_t old = phase_.fetch_add(1, std::memory_order_seq_cst) & 1;
+      for (const Slot &s : slots_)
+        while (s.count[old].load(std::memory_order_seq_cst) != 0)
+          std::this_thread::yield();
+    }
+  }
+
+private:
+  static size_t slot_index() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t idx =
+        next.fetch_add(1, std::memory_order_relaxed) % READER_SLOTS;
+    return idx;
+  }
+
+  mutable Slot slots_[READER_SLOTS];
+  std::atomic<uint32_t> phase_{0};
+};
+
+#endif
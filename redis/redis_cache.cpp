@@ -1,9 +1,12 @@
 #include "redis_cache.h"
 #include "log/log.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <random>
 #include <thread>
 
@@ -12,7 +15,72 @@ RedisCache *RedisCache::GetInstance() {
   return &instance;
 }
 
-void RedisCache::init(redis_pool *pool) { pool_ = pool; }
+void RedisCache::init(redis_pool *pool) {
+  pool_ = pool;
+  if (!refresher_.joinable())
+    refresher_ = std::thread(&RedisCache::refresh_loop, this);
+}
+
+RedisCache::~RedisCache() {
+  bloom_warmer_.reset(); // 先停追赶线程并落盘
+  {
+    std::lock_guard<std::mutex> lock(refresh_mutex_);
+    refresh_stop_ = true;
+  }
+  refresh_cv_.notify_all();
+  if (refresher_.joinable())
+    refresher_.join();
+}
+
+CircuitBreaker &RedisCache::breaker_for(size_t shard) {
+  if (pool_ && shard < pool_->shard_count())
+    return pool_->command_breaker(shard);
+  // 连接池尚无任何分片（未初始化 / 集群种子全部不可达）: 首次用到时才登记
+  static CircuitBreaker unrouted(
+      "redis:unrouted",
+      CircuitBreaker::Options{.slow_call_ms = 100, .slow_rate = 0.5});
+  return unrouted;
+}
+
+void RedisCache::reset_breaker() {
+  size_t n = pool_ ? pool_->shard_count() : 0;
+  for (size_t i = 0; i < n; ++i)
+    pool_->command_breaker(i).reset();
+}
+
+CircuitState RedisCache::breaker_state(size_t shard) {
+  return breaker_for(shard).state();
+}
+
+// 锁与数据同槽: 集群模式下 SETNX 直达数据所在节点，不多一次 MOVED
+static std::string lock_key_of(const std::string &key) {
+  if (key.find('{') != std::string::npos)
+    return "lock:" + key; // 已带 hash tag，沿用
+  return "lock:{" + key + "}";
+}
+
+void RedisCache::start_invalidation(const std::vector<RedisEndpoint> &endpoints,
+                                    const std::string &password) {
+  // 跟踪是逐实例的: 任一分片断线期间它上面的写入都可能漏掉失效，L1 回落到短 TTL
+  for (size_t i = invalidators_.size(); i < endpoints.size(); ++i) {
+    const RedisEndpoint &ep = endpoints[i];
+    auto inv = std::make_unique<CacheInvalidator>(
+        SCORE_KEY_PREFIX,
+        [this](std::string_view key) { l1_invalidate(key); },
+        [this]() { l1_flush(); },
+        [this](bool tracking) {
+          if (tracking)
+            l1_tracking_.store(l1_tracked_shards_.fetch_add(1) + 1 >=
+                               pool_->shard_count());
+          else {
+            l1_tracked_shards_.fetch_sub(1);
+            l1_tracking_.store(false);
+          }
+        });
+    inv->start(ep.host, ep.port, password);
+    invalidators_.push_back(std::move(inv));
+  }
+}
 
 // ── 随机 TTL ────────────────────────────────────────────────────────────
 
@@ -24,30 +92,241 @@ int RedisCache::random_ttl(int base_ttl) const {
   return std::max(10, base_ttl + dist(rng));
 }
 
+// ── 逻辑过期信封 ────────────────────────────────────────────────────────
+//
+// 格式: "\x1fS" <逻辑过期 Unix 毫秒> ":" <重建耗时毫秒> ":" <原始值>
+// 用墙上时钟而非 steady_clock: 过期时间要在多个节点间比较。
+// 空值标记与本格式之前写入的值没有信封，按"永不逻辑过期"处理，由物理 TTL 淘汰。
+
+static constexpr char ENTRY_MAGIC[] = "\x1fS";
+static constexpr size_t ENTRY_MAGIC_LEN = sizeof(ENTRY_MAGIC) - 1;
+
+long long RedisCache::wall_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string RedisCache::wrap_entry(const std::string &value, int ttl,
+                                   long long delta_ms) {
+  char head[64];
+  int n = snprintf(head, sizeof(head), "%s%lld:%lld:", ENTRY_MAGIC,
+                   wall_ms() + ttl * 1000LL, delta_ms);
+  std::string out;
+  out.reserve(n + value.size());
+  out.append(head, n);
+  out.append(value);
+  return out;
+}
+
+RedisCache::CachedEntry RedisCache::unwrap_entry(std::string raw) {
+  CachedEntry e;
+  if (raw.compare(0, ENTRY_MAGIC_LEN, ENTRY_MAGIC) == 0) {
+    const char *p = raw.c_str() + ENTRY_MAGIC_LEN;
+    char *end = nullptr;
+    long long expire = strtoll(p, &end, 10);
+    if (*end == ':') {
+      long long delta = strtoll(end + 1, &end, 10);
+      if (*end == ':') {
+        e.expire_ms = expire;
+        e.delta_ms = delta;
+        e.value = raw.substr(end + 1 - raw.c_str());
+        return e;
+      }
+    }
+  }
+  e.value = std::move(raw);
+  return e;
+}
+
+bool RedisCache::should_refresh(const CachedEntry &e) {
+  if (e.expire_ms == 0)
+    return false;
+  long long now = wall_ms();
+  if (now >= e.expire_ms)
+    return true;
+  // XFetch: now - delta * beta * ln(rand) >= expiry
+  // 越接近过期、重建越慢，提前刷新的概率越高；每次读取独立抽样
+  static thread_local std::mt19937 rng(std::random_device{}());
+  std::uniform_real_distribution<double> dist(
+      std::numeric_limits<double>::min(), 1.0);
+  double gap = -static_cast<double>(std::max(e.delta_ms, 1LL)) *
+               XFETCH_BETA * std::log(dist(rng));
+  return now + static_cast<long long>(gap) >= e.expire_ms;
+}
+
+long long RedisCache::fresh_ttl_ms(const CachedEntry &e, long long pttl_ms) {
+  if (e.expire_ms == 0 || pttl_ms == -2)
+    return pttl_ms;
+  long long remain = e.expire_ms - wall_ms();
+  if (remain <= 0)
+    return -2;
+  return pttl_ms < 0 ? remain : std::min(pttl_ms, remain);
+}
+
+// ── 后台刷新（stale-while-revalidate） ─────────────────────────────────
+
+void RedisCache::schedule_refresh(
+    const std::string &key,
+    const DbQuery &db_query, int base_ttl,
+    long long stale_expire_ms) {
+  // 本进程已有同 key 的刷新或重建在途
+  if (!flights_.try_lead(key))
+    return;
+  {
+    std::lock_guard<std::mutex> lock(refresh_mutex_);
+    if (refresh_queue_.size() < REFRESH_QUEUE_MAX && refresher_.joinable()) {
+      refresh_queue_.push_back({key, db_query, base_ttl, stale_expire_ms});
+      refresh_cv_.notify_one();
+      return;
+    }
+  }
+  // 队列已满: 放弃本次刷新，旧值继续服务，后续读取会再次触发
+  SingleFlight::Result res;
+  res.locked = true;
+  flights_.finish(key, res);
+}
+
+void RedisCache::refresh_loop() {
+  for (;;) {
+    RefreshTask task;
+    {
+      std::unique_lock<std::mutex> lock(refresh_mutex_);
+      refresh_cv_.wait(lock,
+                       [this] { return refresh_stop_ || !refresh_queue_.empty(); });
+      if (refresh_stop_)
+        return;
+      task = std::move(refresh_queue_.front());
+      refresh_queue_.pop_front();
+    }
+    refresh(task);
+  }
+}
+
+void RedisCache::refresh(const RefreshTask &task) {
+  SingleFlight::Result res;
+  res.locked = true;
+  size_t shard = shard_of(task.key);
+  CircuitBreaker &breaker = breaker_for(shard);
+  if (breaker.allow_request()) {
+    redisContext *ctx = nullptr;
+    redisConnectionRAII conn(&ctx, pool_, shard);
+    bool answered = false;
+    // 跨节点只需一个刷新者: 拿不到锁说明其他节点正在刷新，直接放弃
+    if (ctx && try_lock(ctx, task.key, LOCK_TTL, &answered)) {
+      res.value = fill_locked(ctx, task.key, task.db_query, task.base_ttl,
+                              task.stale_expire_ms);
+      res.locked = false;
+    } else if (answered) {
+      breaker.on_success();
+    } else {
+      // 借不到连接或 SETNX 出错: 必须给出结果，否则半开时白占探测名额
+      breaker.on_failure();
+    }
+  }
+  // 阻塞在本 key 上的未命中请求直接取用刷新结果
+  flights_.finish(task.key, res);
+}
+
 // ── 布隆过滤器预热 ──────────────────────────────────────────────────────
 
 void RedisCache::warm_bloom(const std::vector<std::string> &keys,
                             size_t expected_elements) {
-  std::lock_guard<std::mutex> lock(bloom_warm_mutex_);
-  if (expected_elements > 0) {
-    bloom_filter_.reset(expected_elements);
-  }
-  for (const auto &key : keys) {
-    bloom_filter_.insert(key);
-  }
-  bloom_warmed_ = true;
+  // 离线构建新表后原子发布，期间查询照常走旧表
+  filter_->rebuild(keys, expected_elements);
+  bloom_warmed_.store(true);
   LOG_INFO("Bloom filter warmed: %zu keys (capacity=%zu)", keys.size(),
            expected_elements);
 }
 
+bool RedisCache::set_filter_kind(const std::string &kind) {
+  if (kind == "bloom")
+    filter_ = std::make_unique<BloomFilter>();
+  else if (kind == "cuckoo")
+    filter_ = std::make_unique<CuckooFilter>();
+  else
+    return false;
+  bloom_warmed_.store(false);
+  return true;
+}
+
+void RedisCache::start_bloom_warmup(const std::string &snapshot_path) {
+  bloom_warmer_ = std::make_unique<BloomWarmer>(
+      snapshot_path, *filter_, pool_,
+      [this]() { bloom_warmed_.store(true); });
+  bloom_warmer_->start();
+}
+
+void RedisCache::bloom_sync(uint64_t student_id) {
+  if (!bloom_warmer_ || !bloom_warmed_)
+    return; // 未预热时过滤器不参与判断，全量加载会带上这一行
+  if (!bloom_warmer_->wait_caught_up(student_id, BLOOM_SYNC_WAIT_MS))
+    LOG_WARN("Key filter catch-up for student#%llu timed out",
+             static_cast<unsigned long long>(student_id));
+}
+
+void RedisCache::bloom_add(const std::string &key) {
+  filter_->insert(key);
+  journal_key("k", key);
+}
+
+void RedisCache::bloom_remove(const std::string &key) {
+  if (!filter_->supports_remove())
+    return;
+  filter_->remove(key);
+  journal_key("d", key);
+}
+
+void RedisCache::journal_key(const char *op, const std::string &key) {
+  // 日志流按自身 key 路由到一个分片
+  if (!pool_ || !pool_->is_initialized())
+    return;
+  size_t shard = shard_of(BloomWarmer::JOURNAL_KEY);
+  if (breaker_for(shard).state() != CircuitState::CLOSED) // 不占用半开探测名额
+    return;
+  // 尽力而为: 改键的插入丢失时其他节点对新键误拒，直到每日全量重建，
+  // 删除丢失只是多一个误判，每日全量重建清除
+  redisContext *ctx = nullptr;
+  redisConnectionRAII conn(&ctx, pool_, shard);
+  if (!ctx)
+    return;
+  redisReply *reply = pool_->exec(
+      ctx, "XADD %s MAXLEN ~ %ld * %s %b src %s", BloomWarmer::JOURNAL_KEY,
+      BloomWarmer::JOURNAL_MAXLEN, op, key.data(), key.size(),
+      BloomWarmer::node_id().c_str());
+  if (!reply || reply->type == REDIS_REPLY_ERROR)
+    LOG_WARN("Bloom journal XADD failed: %s",
+             reply ? reply->str : ctx->errstr);
+  freeReplyObject(reply);
+}
+
+bool RedisCache::filter_rejects(const std::string &key) {
+  if (!bloom_warmed_ || filter_->contains(key))
+    return false;
+  filter_rejects_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void RedisCache::note_false_positive() {
+  if (bloom_warmed_)
+    filter_false_positives_.fetch_add(1, std::memory_order_relaxed);
+}
+
+RedisCache::FilterStats RedisCache::filter_stats() const {
+  FilterStats s;
+  s.filter = filter_->stats();
+  s.rejects = filter_rejects_.load(std::memory_order_relaxed);
+  s.false_positives = filter_false_positives_.load(std::memory_order_relaxed);
+  return s;
+}
+
 // ── 底层 Redis 操作 ─────────────────────────────────────────────────────
 
 std::optional<std::string> RedisCache::redis_raw_get(redisContext *ctx,
                                                       const std::string &key) {
   if (!ctx) return std::nullopt;
 
-  redisReply *reply = static_cast<redisReply *>(
-      redisCommand(ctx, "GET %s", key.c_str()));
+  redisReply *reply = pool_->exec(ctx, "GET %s", key.c_str());
 
   std::optional<std::string> result;
   if (reply && reply->type == REDIS_REPLY_STRING) {
@@ -61,9 +340,8 @@ bool RedisCache::redis_raw_set(redisContext *ctx, const std::string &key,
                                 const std::string &value, int ttl) {
   if (!ctx) return false;
 
-  redisReply *reply = static_cast<redisReply *>(
-      redisCommand(ctx, "SETEX %s %d %b", key.c_str(), ttl, value.c_str(),
-                   value.size()));
+  redisReply *reply = pool_->exec(ctx, "SETEX %s %d %b", key.c_str(), ttl,
+                                  value.c_str(), value.size());
 
   bool ok = (reply && reply->type == REDIS_REPLY_STATUS &&
              strcmp(reply->str, "OK") == 0);
@@ -74,35 +352,226 @@ bool RedisCache::redis_raw_set(redisContext *ctx, const std::string &key,
 bool RedisCache::redis_raw_del(redisContext *ctx, const std::string &key) {
   if (!ctx) return false;
 
-  redisReply *reply = static_cast<redisReply *>(
-      redisCommand(ctx, "DEL %s", key.c_str()));
+  redisReply *reply = pool_->exec(ctx, "DEL %s", key.c_str());
 
   bool ok = (reply && reply->type == REDIS_REPLY_INTEGER);
   freeReplyObject(reply);
   return ok;
 }
 
+std::optional<std::string>
+RedisCache::redis_raw_get_pttl(redisContext *ctx, const std::string &key,
+                               long long &pttl_ms) {
+  pttl_ms = -2;
+  if (!ctx) return std::nullopt;
+
+  redisAppendCommand(ctx, "GET %s", key.c_str());
+  redisAppendCommand(ctx, "PTTL %s", key.c_str());
+
+  std::optional<std::string> result;
+  redisReply *reply = nullptr;
+  if (redisGetReply(ctx, reinterpret_cast<void **>(&reply)) != REDIS_OK)
+    reply = nullptr;
+  if (pool_->is_redirect(reply)) {
+    // 槽已迁走: 丢弃同样被重定向的 PTTL，两条命令各自经 exec() 重发
+    freeReplyObject(reply);
+    reply = nullptr;
+    if (redisGetReply(ctx, reinterpret_cast<void **>(&reply)) == REDIS_OK)
+      freeReplyObject(reply);
+    reply = pool_->exec(ctx, "GET %s", key.c_str());
+    redisReply *pttl = pool_->exec(ctx, "PTTL %s", key.c_str());
+    if (pttl && pttl->type == REDIS_REPLY_INTEGER)
+      pttl_ms = pttl->integer;
+    freeReplyObject(pttl);
+    if (reply && reply->type == REDIS_REPLY_STRING)
+      result = std::string(reply->str, reply->len);
+    freeReplyObject(reply);
+    return result;
+  }
+  if (reply && reply->type == REDIS_REPLY_STRING) {
+    result = std::string(reply->str, reply->len);
+  }
+  freeReplyObject(reply);
+
+  reply = nullptr;
+  if (redisGetReply(ctx, reinterpret_cast<void **>(&reply)) == REDIS_OK &&
+      reply && reply->type == REDIS_REPLY_INTEGER) {
+    pttl_ms = reply->integer;
+  }
+  freeReplyObject(reply);
+  return result;
+}
+
+// 把已 append 的命令立即写出 socket（redisGetReply 直到读取时才会写），
+// 多个分片的请求因此同时在途；写失败留给随后的读取报告
+static void flush_pipeline(redisContext *ctx) {
+  int done = 0;
+  while (!done && redisBufferWrite(ctx, &done) == REDIS_OK) {
+  }
+}
+
+void RedisCache::redis_append_mget_pttl(
+    redisContext *ctx, const std::vector<const std::string *> &keys) {
+  if (!ctx || keys.empty()) return;
+
+  std::vector<const char *> argv;
+  std::vector<size_t> argvlen;
+  argv.reserve(keys.size() + 1);
+  argvlen.reserve(keys.size() + 1);
+  if (pool_->is_cluster()) {
+    // 集群中同一节点上的 key 也可能分属不同槽，MGET 会报 CROSSSLOT，逐个 GET
+    for (const std::string *k : keys)
+      redisAppendCommand(ctx, "GET %b", k->data(), k->size());
+  } else {
+    argv.push_back("MGET");
+    argvlen.push_back(4);
+    for (const std::string *k : keys) {
+      argv.push_back(k->data());
+      argvlen.push_back(k->size());
+    }
+    redisAppendCommandArgv(ctx, static_cast<int>(argv.size()), argv.data(),
+                           argvlen.data());
+  }
+  for (const std::string *k : keys)
+    redisAppendCommand(ctx, "PTTL %b", k->data(), k->size());
+  flush_pipeline(ctx);
+}
+
+bool RedisCache::redis_read_mget_pttl(
+    redisContext *ctx, size_t n, std::vector<std::optional<std::string>> &values,
+    std::vector<long long> &pttl_ms, std::vector<bool> &redirected) {
+  values.assign(n, std::nullopt);
+  pttl_ms.assign(n, -2);
+  redirected.assign(n, false);
+  if (!ctx || n == 0) return ctx != nullptr;
+
+  // 无论 MGET 结果如何都要读完全部回复，保持连接上的请求 / 回复对齐
+  bool ok = true;
+  redisReply *reply = nullptr;
+  if (pool_->is_cluster()) {
+    for (size_t i = 0; i < n; ++i) {
+      reply = nullptr;
+      if (redisGetReply(ctx, reinterpret_cast<void **>(&reply)) != REDIS_OK)
+        return false;
+      if (reply && reply->type == REDIS_REPLY_STRING)
+        values[i] = std::string(reply->str, reply->len);
+      else if (pool_->is_redirect(reply))
+        redirected[i] = true;
+      freeReplyObject(reply);
+    }
+  } else {
+    if (redisGetReply(ctx, reinterpret_cast<void **>(&reply)) != REDIS_OK) {
+      return false; // 连接已损坏，剩余回复无从读取
+    }
+    if (reply && reply->type == REDIS_REPLY_ARRAY && reply->elements == n) {
+      for (size_t i = 0; i < reply->elements; ++i) {
+        redisReply *e = reply->element[i];
+        if (e->type == REDIS_REPLY_STRING)
+          values[i] = std::string(e->str, e->len);
+      }
+    } else {
+      ok = false;
+    }
+    freeReplyObject(reply);
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    reply = nullptr;
+    if (redisGetReply(ctx, reinterpret_cast<void **>(&reply)) != REDIS_OK)
+      return false;
+    if (reply && reply->type == REDIS_REPLY_INTEGER)
+      pttl_ms[i] = reply->integer;
+    freeReplyObject(reply);
+  }
+  return ok;
+}
+
+void RedisCache::redis_append_set_batch(
+    redisContext *ctx,
+    const std::vector<std::pair<const std::string *, const std::string *>> &kvs,
+    const std::vector<int> &ttls) {
+  if (!ctx) return;
+
+  for (size_t i = 0; i < kvs.size(); ++i) {
+    const std::string &k = *kvs[i].first;
+    const std::string &v = *kvs[i].second;
+    redisAppendCommand(ctx, "SETEX %b %d %b", k.data(), k.size(), ttls[i],
+                       v.data(), v.size());
+  }
+  flush_pipeline(ctx);
+}
+
+size_t RedisCache::redis_read_set_batch(redisContext *ctx, size_t n) {
+  if (!ctx) return 0;
+
+  size_t ok = 0;
+  for (size_t i = 0; i < n; ++i) {
+    redisReply *reply = nullptr;
+    if (redisGetReply(ctx, reinterpret_cast<void **>(&reply)) != REDIS_OK)
+      break;
+    if (reply && reply->type == REDIS_REPLY_STATUS &&
+        strcmp(reply->str, "OK") == 0)
+      ++ok;
+    else
+      pool_->is_redirect(reply); // 回写尽力而为，重定向只用来更新槽位表
+    freeReplyObject(reply);
+  }
+  return ok;
+}
+
+// ── L1 回填 ─────────────────────────────────────────────────────────────
+
+void RedisCache::l1_fill(const std::string &key, const std::string &value,
+                         long long redis_ttl_ms, uint64_t epoch) {
+  // -1: Redis 中无过期时间，仅受 L1 上限约束；-2: key 已不存在，不回填
+  if (redis_ttl_ms == -2)
+    return;
+  // 集群启动后新增的主节点没有失效监听，出现后 L1 回落到短 TTL
+  bool tracked = l1_tracking_.load() &&
+                 l1_tracked_shards_.load() >= pool_->shard_count();
+  long long cap = tracked ? L1_TRACKED_TTL_MS : L1_TTL_MS;
+  long long ttl = redis_ttl_ms < 0 ? cap : std::min(cap, redis_ttl_ms);
+  l1_.put(key, value, ttl);
+  // 先写后校验: 与 l1_invalidate 的"先递增后删除"配合，
+  // 读取 Redis 之后到达的失效消息不会被这次回填覆盖
+  if (l1_epoch_.load() != epoch)
+    l1_.erase(key);
+}
+
+void RedisCache::l1_invalidate(std::string_view key) {
+  l1_epoch_.fetch_add(1);
+  l1_.erase(key);
+}
+
+void RedisCache::l1_flush() {
+  l1_epoch_.fetch_add(1);
+  l1_.clear();
+}
+
 // ── 分布式锁 ────────────────────────────────────────────────────────────
 
 bool RedisCache::try_lock(redisContext *ctx, const std::string &key,
-                           int lock_ttl) {
+                           int lock_ttl, bool *answered) {
+  if (answered)
+    *answered = false;
   if (!ctx) return false;
 
-  std::string lock_key = "lock:" + key;
-  redisReply *reply = static_cast<redisReply *>(
-      redisCommand(ctx, "SET %s 1 NX EX %d", lock_key.c_str(), lock_ttl));
+  std::string lock_key = lock_key_of(key);
+  redisReply *reply =
+      pool_->exec(ctx, "SET %s 1 NX EX %d", lock_key.c_str(), lock_ttl);
 
   bool got = (reply && reply->type == REDIS_REPLY_STATUS &&
               strcmp(reply->str, "OK") == 0);
+  if (answered) // NX 未设置时回复 nil
+    *answered = got || (reply && reply->type == REDIS_REPLY_NIL);
   freeReplyObject(reply);
   return got;
 }
 
 void RedisCache::unlock(redisContext *ctx, const std::string &key) {
   if (!ctx) return;
-  std::string lock_key = "lock:" + key;
-  redisReply *reply =
-      static_cast<redisReply *>(redisCommand(ctx, "DEL %s", lock_key.c_str()));
+  std::string lock_key = lock_key_of(key);
+  redisReply *reply = pool_->exec(ctx, "DEL %s", lock_key.c_str());
   freeReplyObject(reply);
 }
 
@@ -110,113 +579,402 @@ void RedisCache::unlock(redisContext *ctx, const std::string &key) {
 
 std::optional<std::string>
 RedisCache::get(const std::string &key,
-                std::function<std::optional<std::string>()> db_query,
+                DbQuery db_query,
                 int base_ttl) {
   // ═══════════════════════════════════════════════════════════════════
   // 第一层: 防缓存穿透 —— 布隆过滤器
   // ═══════════════════════════════════════════════════════════════════
-  if (bloom_warmed_ && !bloom_filter_.contains(key)) {
+  if (filter_rejects(key)) {
     // 布隆判断 key 一定不存在，直接返回 nullopt，不访问 Redis / DB
     return std::nullopt;
   }
 
   // ═══════════════════════════════════════════════════════════════════
-  // 第二层: 容错降级 —— 熔断器
+  // 进程内 L1 —— 命中时不借 Redis 连接、不发网络请求
   // ═══════════════════════════════════════════════════════════════════
-  if (circuit_breaker_.is_open()) {
-    // 熔断器打开 → 跳过 Redis，直接查 DB（降级）
-    return db_query();
+  {
+    std::string value;
+    if (l1_.get(key, value)) {
+      if (value == "__NULL__") {
+        note_false_positive();
+        return std::nullopt;
+      }
+      return value;
+    }
   }
 
-  bool breaker_ok = circuit_breaker_.allow_request();
+  // ═══════════════════════════════════════════════════════════════════
+  // 第二层: 容错降级 —— 熔断器（key 所在分片）
+  // ═══════════════════════════════════════════════════════════════════
+  size_t shard = shard_of(key);
+  CircuitBreaker &breaker = breaker_for(shard);
+  // 先问 allow_request(): 恢复超时已到时由它转入半开并放行探测，
+  // 只看 is_open() 的话分片恢复（如后台重连成功）后永远不会再试 Redis
+  bool breaker_ok = breaker.allow_request();
+  if (!breaker_ok && breaker.is_open()) {
+    // 熔断器打开 → 跳过 Redis，直接查 DB（降级）
+    return load_direct(key, db_query);
+  }
 
   // ═══════════════════════════════════════════════════════════════════
   // 首次缓存查询
   // ═══════════════════════════════════════════════════════════════════
   if (breaker_ok) {
     redisContext *ctx = nullptr;
-    redisConnectionRAII conn(&ctx, pool_);
+    redisConnectionRAII conn(&ctx, pool_, shard);
 
     if (ctx) {
-      auto cached = redis_raw_get(ctx, key);
+      long long pttl_ms = -2;
+      uint64_t epoch = l1_epoch_.load();
+      auto start = std::chrono::steady_clock::now();
+      auto cached = redis_raw_get_pttl(ctx, key, pttl_ms);
+      auto latency = std::chrono::steady_clock::now() - start;
       if (cached.has_value()) {
+        CachedEntry e = unwrap_entry(std::move(cached.value()));
+        l1_fill(key, e.value, fresh_ttl_ms(e, pttl_ms), epoch);
+        breaker.on_success(latency);
         // 检查是否为穿透保护的空值标记
-        if (cached.value() == "__NULL__") {
+        if (e.value == "__NULL__") {
+          note_false_positive();
           return std::nullopt;
         }
-        circuit_breaker_.on_success();
-        return cached;
+        // 已过期或临近过期: 照常返回当前值，后台刷新
+        if (should_refresh(e))
+          schedule_refresh(key, db_query, base_ttl, e.expire_ms);
+        return std::move(e.value);
       }
     } else {
-      circuit_breaker_.on_failure();
-      return db_query(); // 获取连接失败，直接降级到 DB
+      breaker.on_failure();
+      return load_direct(key, db_query); // 获取连接失败，直接降级到 DB
     }
   }
 
   // ═══════════════════════════════════════════════════════════════════
   // 第三层: 防缓存击穿 —— 分布式互斥锁
   // ═══════════════════════════════════════════════════════════════════
-  // 缓存未命中，尝试获取重建锁
+  return rebuild(key, db_query, base_ttl);
+}
+
+// ── 异步读取 ────────────────────────────────────────────────────────────
+
+RedisCache::Lookup RedisCache::get_async(
+    const std::string &key,
+    DbQuery db_query, int base_ttl,
+    AsyncResult &out, AsyncDone done, int delay_ms) {
+  if (filter_rejects(key)) {
+    out.status = AsyncResult::NEGATIVE;
+    return Lookup::DONE;
+  }
+  if (l1_.get(key, out.value)) {
+    if (out.value == "__NULL__") {
+      note_false_positive();
+      out.status = AsyncResult::NEGATIVE;
+    } else {
+      out.status = AsyncResult::HIT;
+    }
+    return Lookup::DONE;
+  }
+  // 半开探测、降级等分支保留在同步路径里，异步路径只服务 CLOSED 状态
+  AsyncRedis *redis = AsyncRedis::GetInstance();
+  size_t shard = shard_of(key);
+  CircuitBreaker &breaker = breaker_for(shard);
+  if (breaker.state() != CircuitState::CLOSED || !redis->connected(shard))
+    return Lookup::UNAVAILABLE;
+
+  uint64_t epoch = l1_epoch_.load();
+  auto start = std::chrono::steady_clock::now();
+  bool ok = redis->submit(
+      {{"GET", key}, {"PTTL", key}},
+      [this, key, epoch, start, base_ttl, &breaker, db_query = std::move(db_query),
+       done = std::move(done)](const std::vector<redisReply *> &replies) {
+        AsyncResult res;
+        redisReply *get = replies[0];
+        if (pool_->is_redirect(get)) {
+          // 槽已迁走不是节点故障: 不计入熔断，调用方改走同步路径（跟随重定向）
+          res.status = AsyncResult::ERROR;
+        } else if (!get || get->type == REDIS_REPLY_ERROR) {
+          breaker.on_failure();
+          res.status = AsyncResult::ERROR;
+        } else if (get->type == REDIS_REPLY_STRING) {
+          redisReply *pttl = replies[1];
+          CachedEntry e = unwrap_entry(std::string(get->str, get->len));
+          l1_fill(key, e.value,
+                  fresh_ttl_ms(e, pttl && pttl->type == REDIS_REPLY_INTEGER
+                                      ? pttl->integer
+                                      : -2),
+                  epoch);
+          breaker.on_success(std::chrono::steady_clock::now() - start);
+          if (e.value == "__NULL__") {
+            note_false_positive();
+            res.status = AsyncResult::NEGATIVE;
+          } else {
+            // 只入队，不在事件循环线程做阻塞 I/O
+            if (should_refresh(e))
+              schedule_refresh(key, db_query, base_ttl, e.expire_ms);
+            res.status = AsyncResult::HIT;
+            res.value = std::move(e.value);
+          }
+        } else {
+          res.status = AsyncResult::MISS;
+        }
+        done(std::move(res));
+      },
+      delay_ms, shard);
+  return ok ? Lookup::PENDING : Lookup::UNAVAILABLE;
+}
+
+// ── 缓存重建（singleflight + 互斥锁 + Double Check） ───────────────────
+
+std::optional<std::string>
+RedisCache::rebuild(const std::string &key,
+                    const DbQuery &db_query,
+                    int base_ttl) {
+  return coalesce(key, [&]() {
+    return rebuild_locked(key, db_query, base_ttl, nullptr);
+  });
+}
+
+std::optional<std::string> RedisCache::load_direct(
+    const std::string &key,
+    const DbQuery &db_query) {
+  return coalesce(key, [&]() { return db_query().value; });
+}
+
+std::optional<std::string> RedisCache::coalesce(
+    const std::string &key,
+    const std::function<std::optional<std::string>()> &fn) {
+  SingleFlight::Result res;
+  // 异步 leader 未获锁时会不带结果结束在途记录，此时重新竞争
+  while (!flights_.lead_or_wait(key, res)) {
+    if (!res.locked)
+      return res.value;
+  }
+  res.value = fn();
+  res.locked = false;
+  flights_.finish(key, res);
+  return res.value;
+}
+
+RedisCache::Rebuild RedisCache::rebuild_async(
+    const std::string &key,
+    const DbQuery &db_query, int base_ttl,
+    std::optional<std::string> &value, AsyncDone done, PendingLoad *deferred) {
+  bool leader = flights_.lead_or_join(
+      key, [done = std::move(done)](const SingleFlight::Result &r) {
+        AsyncResult res;
+        if (r.locked) {
+          res.status = AsyncResult::MISS;
+        } else if (r.value.has_value()) {
+          res.status = AsyncResult::HIT;
+          res.value = r.value.value();
+        } else {
+          res.status = AsyncResult::NEGATIVE;
+        }
+        // leader 是 worker 线程，回调统一回到事件循环线程执行
+        AsyncRedis::GetInstance()->post(
+            [done, res = std::move(res)]() mutable { done(std::move(res)); });
+      });
+  if (!leader)
+    return Rebuild::JOINED;
+
+  SingleFlight::Result res;
+  if (deferred) {
+    // 只在 worker 里完成取锁与 Double Check（两次 Redis 往返），
+    // 查库交给调用方异步进行，在途记录与重建锁保留到 finish_rebuild()
+    size_t shard = shard_of(key);
+    redisContext *ctx = nullptr;
+    redisConnectionRAII conn(&ctx, pool_, shard);
+    if (ctx) {
+      if (!try_lock(ctx, key, LOCK_TTL)) {
+        res.locked = true;
+      } else if (!recheck_locked(ctx, key, -1, res.value)) {
+        deferred->key = key;
+        deferred->base_ttl = base_ttl;
+        deferred->epoch = l1_epoch_.load();
+        deferred->start = std::chrono::steady_clock::now();
+        return Rebuild::LOAD;
+      }
+      flights_.finish(key, res);
+      value = std::move(res.value);
+      return res.locked ? Rebuild::LOCKED : Rebuild::DONE;
+    }
+    // 借不到 Redis 连接: 走下面的同步路径（含降级直查）
+  }
+
+  res.value = rebuild_locked(key, db_query, base_ttl, &res.locked);
+  flights_.finish(key, res);
+  value = std::move(res.value);
+  return res.locked ? Rebuild::LOCKED : Rebuild::DONE;
+}
+
+void RedisCache::finish_rebuild(const PendingLoad &load,
+                                const DbResult &result) {
+  const std::string &key = load.key;
+  size_t shard = shard_of(key);
+  SingleFlight::Result res;
+  if (result.unavailable) {
+    // 熔断 / DB 出错: 结果未知，只释放锁（异步连接不可用时由 LOCK_TTL 兜底）
+    AsyncRedis::GetInstance()->submit({{"DEL", lock_key_of(key)}},
+                                      [](const std::vector<redisReply *> &) {},
+                                      0, shard);
+    res.locked = true;
+    flights_.finish(key, res);
+    return;
+  }
+
+  const std::optional<std::string> &value = result.value;
+  long long delta_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - load.start)
+                           .count();
+  std::string entry;
+  int expire_s;
+  if (value.has_value()) {
+    int ttl = random_ttl(load.base_ttl);
+    entry = wrap_entry(value.value(), ttl, delta_ms);
+    expire_s = ttl + STALE_GRACE_SEC;
+    l1_fill(key, value.value(), ttl * 1000LL, load.epoch);
+  } else {
+    note_false_positive();
+    entry = "__NULL__";
+    expire_s = NULL_CACHE_TTL;
+    l1_fill(key, "__NULL__", NULL_CACHE_TTL * 1000LL, load.epoch);
+  }
+
+  // 回写 + 解锁同一流水线发出；异步连接不可用时放弃回写，锁由 LOCK_TTL 兜底过期
+  CircuitBreaker &breaker = breaker_for(shard);
+  AsyncRedis::GetInstance()->submit(
+      {{"SETEX", key, std::to_string(expire_s), std::move(entry)},
+       {"DEL", lock_key_of(key)}},
+      [this, &breaker](const std::vector<redisReply *> &replies) {
+        redisReply *set = replies[0];
+        if (pool_->is_redirect(set))
+          return; // 槽已迁走，不计入熔断
+        if (!set || set->type == REDIS_REPLY_ERROR)
+          breaker.on_failure();
+        else
+          breaker.on_success();
+      },
+      0, shard);
+
+  res.value = value;
+  flights_.finish(key, res);
+}
+
+std::optional<std::string> RedisCache::rebuild_locked(
+    const std::string &key,
+    const DbQuery &db_query, int base_ttl,
+    bool *locked) {
+  // 缓存未命中，尝试获取重建锁（锁与数据同在 key 所在分片）
   {
+    size_t shard = shard_of(key);
+    CircuitBreaker &breaker = breaker_for(shard);
     redisContext *ctx = nullptr;
-    redisConnectionRAII conn(&ctx, pool_);
+    redisConnectionRAII conn(&ctx, pool_, shard);
 
     if (ctx && try_lock(ctx, key, LOCK_TTL)) {
       // —— 获得锁，负责重建缓存 ——
-      // Double-check: 其他线程可能已经重建完成
-      auto cached = redis_raw_get(ctx, key);
-      if (cached.has_value()) {
-        unlock(ctx, key);
-        if (cached.value() == "__NULL__") return std::nullopt;
-        circuit_breaker_.on_success();
-        return cached;
-      }
+      return fill_locked(ctx, key, db_query, base_ttl, -1);
+    }
 
-      // 查询数据库
-      auto db_result = db_query();
-
-      if (db_result.has_value()) {
-        // 有效数据 → 写入缓存 + 插入布隆
-        int ttl = random_ttl(base_ttl);
-        redis_raw_set(ctx, key, db_result.value(), ttl);
-        {
-          std::lock_guard<std::mutex> lock(bloom_warm_mutex_);
-          bloom_filter_.insert(key);
-          bloom_warmed_ = true; // 首次插入即标记已预热
-        }
-        unlock(ctx, key);
-        circuit_breaker_.on_success();
-        return db_result;
-      } else {
-        // 空值 → 缓存短 TTL 标记，防止穿透
-        redis_raw_set(ctx, key, "__NULL__", NULL_CACHE_TTL);
-        unlock(ctx, key);
-        circuit_breaker_.on_success();
-        return std::nullopt;
-      }
+    // —— 未获得锁 ——
+    if (locked && ctx) {
+      // 异步调用方: 不在 worker 里 sleep，交回事件循环延迟重试
+      *locked = true;
+      return std::nullopt;
     }
 
-    // —— 未获得锁，等待并重试 ——
+    // 同步调用方: 等待并重试
     int retries = MAX_RETRIES;
     while (retries-- > 0) {
       std::this_thread::sleep_for(
           std::chrono::milliseconds(RETRY_SLEEP_MS));
 
       redisContext *retry_ctx = nullptr;
-      redisConnectionRAII retry_conn(&retry_ctx, pool_);
+      redisConnectionRAII retry_conn(&retry_ctx, pool_, shard);
       if (!retry_ctx) break;
 
       auto cached = redis_raw_get(retry_ctx, key);
       if (cached.has_value()) {
-        if (cached.value() == "__NULL__") return std::nullopt;
-        circuit_breaker_.on_success();
-        return cached;
+        CachedEntry e = unwrap_entry(std::move(cached.value()));
+        if (e.value == "__NULL__") {
+          note_false_positive();
+          return std::nullopt;
+        }
+        breaker.on_success();
+        return std::move(e.value);
       }
     }
 
     // 重试耗尽，最终降级: 直接查 DB
-    circuit_breaker_.on_failure();
-    return db_query();
+    breaker.on_failure();
+    return db_query().value;
+  }
+}
+
+bool RedisCache::recheck_locked(redisContext *ctx, const std::string &key,
+                                long long stale_expire_ms,
+                                std::optional<std::string> &out) {
+  // Double-check: 其他线程 / 节点可能已经重建（或刷新）完成
+  auto cached = redis_raw_get(ctx, key);
+  if (!cached.has_value())
+    return false;
+  CachedEntry e = unwrap_entry(std::move(cached.value()));
+  if (stale_expire_ms >= 0 && e.expire_ms <= stale_expire_ms)
+    return false;
+  unlock(ctx, key);
+  breaker_for(shard_of(key)).on_success();
+  if (e.value == "__NULL__") {
+    note_false_positive();
+    out = std::nullopt;
+  } else {
+    out = std::move(e.value);
+  }
+  return true;
+}
+
+std::optional<std::string> RedisCache::fill_locked(
+    redisContext *ctx, const std::string &key,
+    const DbQuery &db_query, int base_ttl,
+    long long stale_expire_ms) {
+  CircuitBreaker &breaker = breaker_for(shard_of(key));
+  std::optional<std::string> rechecked;
+  if (recheck_locked(ctx, key, stale_expire_ms, rechecked))
+    return rechecked;
+
+  // 查询数据库（记录耗时，供 XFetch 估计提前量）
+  uint64_t epoch = l1_epoch_.load();
+  auto start = std::chrono::steady_clock::now();
+  auto db_result = db_query();
+  long long delta_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+  if (db_result.unavailable) {
+    // 熔断 / DB 出错: 结果未知，不写空值标记，只释放锁，下一个请求重新回源
+    // （Redis 本身应答正常，照常记成功）
+    unlock(ctx, key);
+    breaker.on_success();
+    return std::nullopt;
+  }
+  if (db_result.value.has_value()) {
+    // 有效数据 → 写入缓存（不回填过滤器: 键能走到这里说明已通过过滤器，
+    // 且布谷鸟按次计数，回填会让之后的删除删不干净）
+    // 物理 TTL 比逻辑 TTL 多 STALE_GRACE_SEC，过期后仍可返回旧值
+    int ttl = random_ttl(base_ttl);
+    redis_raw_set(ctx, key, wrap_entry(db_result.value.value(), ttl, delta_ms),
+                  ttl + STALE_GRACE_SEC);
+    l1_fill(key, db_result.value.value(), ttl * 1000LL, epoch);
+    unlock(ctx, key);
+    breaker.on_success();
+    return std::move(db_result.value);
+  } else {
+    // 空值 → 缓存短 TTL 标记，防止穿透
+    note_false_positive();
+    redis_raw_set(ctx, key, "__NULL__", NULL_CACHE_TTL);
+    l1_fill(key, "__NULL__", NULL_CACHE_TTL * 1000LL, epoch);
+    unlock(ctx, key);
+    breaker.on_success();
+    return std::nullopt;
   }
 }
 
@@ -224,21 +982,25 @@ RedisCache::get(const std::string &key,
 
 bool RedisCache::set(const std::string &key, const std::string &value,
                       int base_ttl) {
-  if (circuit_breaker_.is_open()) return false;
+  size_t shard = shard_of(key);
+  CircuitBreaker &breaker = breaker_for(shard);
+  if (breaker.is_open()) return false;
 
   redisContext *ctx = nullptr;
-  redisConnectionRAII conn(&ctx, pool_);
+  redisConnectionRAII conn(&ctx, pool_, shard);
   if (!ctx) {
-    circuit_breaker_.on_failure();
+    breaker.on_failure();
     return false;
   }
 
   int ttl = random_ttl(base_ttl);
-  bool ok = redis_raw_set(ctx, key, value, ttl);
+  bool ok = redis_raw_set(ctx, key, wrap_entry(value, ttl, 0),
+                          ttl + STALE_GRACE_SEC);
+  l1_invalidate(key); // 其他节点由 CLIENT TRACKING 推送失效
   if (ok) {
-    circuit_breaker_.on_success();
+    breaker.on_success();
   } else {
-    circuit_breaker_.on_failure();
+    breaker.on_failure();
   }
   return ok;
 }
@@ -246,27 +1008,197 @@ bool RedisCache::set(const std::string &key, const std::string &value,
 // ── 删除缓存 (Cache Aside 写操作流程) ───────────────────────────────────
 
 bool RedisCache::del(const std::string &key) {
+  l1_invalidate(key);
+
   redisContext *ctx = nullptr;
-  redisConnectionRAII conn(&ctx, pool_);
+  redisConnectionRAII conn(&ctx, pool_, shard_of(key));
   if (!ctx) return false;
 
   return redis_raw_del(ctx, key);
 }
 
 // ── 批量读取 ────────────────────────────────────────────────────────────
+//
+// 与逐个 get() 的区别:
+//   - 每个分片只借一次连接，MGET + PTTL 流水线一次往返；各分片先全部发出
+//     再依次收取，网络等待相互重叠，不需要额外线程
+//   - 未命中（以及所在分片熔断 / 不可用）的 key 合并为一次 db_query 调用，
+//     回写按分片各一次 SETEX 流水线，同样先全部发出再收取
+//   - 不走 SETNX 互斥锁: 批量重建若逐 key 加锁会退化回 N 次往返，
+//     并发重建同一 key 的代价只是重复一次批量 DB 查询，结果相同
+// 布隆过滤、L1、空值标记、熔断器语义与 get() 一致（按分片判定）。
+// 多个分片的连接按分片号升序借用，并发批量请求之间不会互相等待成环。
 
 std::vector<std::optional<std::string>>
-RedisCache::mget(const std::vector<std::string> &keys,
-                 std::function<std::optional<std::string>(const std::string &)>
-                     db_query,
+RedisCache::mget(const std::vector<std::string> &keys, BatchQuery db_query,
                  int base_ttl) {
-  std::vector<std::optional<std::string>> results;
-  results.reserve(keys.size());
+  std::vector<std::optional<std::string>> results(keys.size());
+
+  // 布隆过滤 + L1，剩余的下标按分片进入 pending
+  // 集群模式下分片数可能随时增长: 每个 key 的分片号只算一次，按需扩容
+  std::vector<std::vector<size_t>> pending(pool_ ? pool_->shard_count() : 1);
+  std::vector<size_t> key_shard(keys.size(), 0);
+  bool any_pending = false;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (filter_rejects(keys[i]))
+      continue;
+    std::string value;
+    if (l1_.get(keys[i], value)) {
+      if (value != "__NULL__") results[i] = std::move(value);
+      else note_false_positive();
+      continue;
+    }
+    size_t s = key_shard[i] = shard_of(keys[i]);
+    if (s >= pending.size())
+      pending.resize(s + 1);
+    pending[s].push_back(i);
+    any_pending = true;
+  }
+  if (!any_pending) return results;
+
+  // 直接查 DB（回调条数不对时返回 false）
+  auto query_db = [&](const std::vector<size_t> &idx) {
+    std::vector<std::string> miss_keys;
+    miss_keys.reserve(idx.size());
+    for (size_t i : idx) miss_keys.push_back(keys[i]);
+    auto rows = db_query(miss_keys);
+    for (size_t j = 0; j < idx.size() && j < rows.size(); ++j)
+      results[idx[j]] = std::move(rows[j]);
+    return rows.size() == idx.size();
+  };
+
+  // ── 借连接: 熔断或借不到的分片整体降级到 DB（不回写） ──
+  struct ShardBatch {
+    size_t shard = 0;
+    const std::vector<size_t> *idx = nullptr;
+    redisContext *ctx = nullptr;
+    std::unique_ptr<redisConnectionRAII> conn;
+  };
+  std::vector<ShardBatch> batches;
+  std::vector<size_t> degraded;
+  for (size_t s = 0; s < pending.size(); ++s) {
+    if (pending[s].empty())
+      continue;
+    CircuitBreaker &breaker = breaker_for(s);
+    ShardBatch b;
+    b.shard = s;
+    b.idx = &pending[s];
+    if (!breaker.is_open() && breaker.allow_request()) {
+      b.conn = std::make_unique<redisConnectionRAII>(&b.ctx, pool_, s);
+      if (!b.ctx)
+        breaker.on_failure();
+    }
+    if (!b.ctx) {
+      degraded.insert(degraded.end(), pending[s].begin(), pending[s].end());
+      continue;
+    }
+    batches.push_back(std::move(b));
+  }
+
+  // ── 一次往返: 各分片 MGET + PTTL 先全部发出，再逐个收取 ──
+  std::vector<std::vector<const std::string *>> batch_keys(batches.size());
+  for (size_t b = 0; b < batches.size(); ++b) {
+    for (size_t i : *batches[b].idx) batch_keys[b].push_back(&keys[i]);
+    redis_append_mget_pttl(batches[b].ctx, batch_keys[b]);
+  }
+
+  std::vector<size_t> misses;  // 需要回写的未命中
+  std::vector<size_t> live;    // 读取成功、可回写的 batches 下标
+  uint64_t epoch = l1_epoch_.load();
+  auto start = std::chrono::steady_clock::now();
+  for (size_t b = 0; b < batches.size(); ++b) {
+    ShardBatch &batch = batches[b];
+    const std::vector<size_t> &idx = *batch.idx;
+    std::vector<std::optional<std::string>> cached;
+    std::vector<long long> pttl_ms;
+    std::vector<bool> redirected;
+    if (!redis_read_mget_pttl(batch.ctx, idx.size(), cached, pttl_ms,
+                              redirected)) {
+      breaker_for(batch.shard).on_failure();
+      degraded.insert(degraded.end(), idx.begin(), idx.end());
+      continue;
+    }
+    breaker_for(batch.shard).on_success(std::chrono::steady_clock::now() - start);
+    live.push_back(b);
+
+    for (size_t j = 0; j < idx.size(); ++j) {
+      size_t i = idx[j];
+      if (redirected[j]) {
+        // 槽已迁走: 本次回源，不回写到旧节点
+        degraded.push_back(i);
+        continue;
+      }
+      if (!cached[j].has_value()) {
+        misses.push_back(i);
+        continue;
+      }
+      CachedEntry e = unwrap_entry(std::move(cached[j].value()));
+      // 批量接口没有逐 key 的后台刷新，逻辑过期的条目随本批一起重建
+      if (e.expire_ms != 0 && wall_ms() >= e.expire_ms) {
+        misses.push_back(i);
+        continue;
+      }
+      l1_fill(keys[i], e.value, fresh_ttl_ms(e, pttl_ms[j]), epoch);
+      if (e.value != "__NULL__") results[i] = std::move(e.value);
+      else note_false_positive();
+    }
+  }
+  if (misses.empty() && degraded.empty())
+    return results;
+
+  // ── 未命中 + 降级: 一次批量 DB 查询 ──
+  std::vector<size_t> to_query = misses;
+  to_query.insert(to_query.end(), degraded.begin(), degraded.end());
+  epoch = l1_epoch_.load();
+  start = std::chrono::steady_clock::now();
+  if (!query_db(to_query)) {
+    // 回调返回的条数不对，不回写，避免把错位的值写入缓存
+    LOG_WARN("RedisCache::mget: db_query returned mismatched row count");
+    return results;
+  }
+  if (misses.empty())
+    return results;
+
+  long long delta_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+  // ── 回写: 按分片 SETEX 流水线，先全部发出再收取 ──
+  static const std::string NULL_MARKER = "__NULL__";
+  std::vector<std::string> wrapped(misses.size());
+  std::vector<int> ttls(misses.size());
+  struct ShardWrite {
+    std::vector<std::pair<const std::string *, const std::string *>> kvs;
+    std::vector<int> physical_ttls;
+  };
+  std::vector<ShardWrite> writes(pending.size());
+  for (size_t j = 0; j < misses.size(); ++j) {
+    size_t i = misses[j];
+    ShardWrite &w = writes[key_shard[i]];
+    if (results[i].has_value()) {
+      int ttl = random_ttl(base_ttl);
+      wrapped[j] = wrap_entry(results[i].value(), ttl, delta_ms);
+      w.kvs.emplace_back(&keys[i], &wrapped[j]);
+      ttls[j] = ttl;
+      w.physical_ttls.push_back(ttl + STALE_GRACE_SEC);
+    } else {
+      note_false_positive();
+      w.kvs.emplace_back(&keys[i], &NULL_MARKER);
+      ttls[j] = NULL_CACHE_TTL;
+      w.physical_ttls.push_back(NULL_CACHE_TTL);
+    }
+  }
+  for (size_t b : live) {
+    const ShardWrite &w = writes[batches[b].shard];
+    redis_append_set_batch(batches[b].ctx, w.kvs, w.physical_ttls);
+  }
+  for (size_t b : live)
+    redis_read_set_batch(batches[b].ctx, writes[batches[b].shard].kvs.size());
 
-  for (const auto &key : keys) {
-    // 为每个 key 包装一个无参 db_query
-    results.push_back(get(
-        key, [&db_query, &key]() { return db_query(key); }, base_ttl));
+  for (size_t j = 0; j < misses.size(); ++j) {
+    size_t i = misses[j];
+    l1_fill(keys[i], results[i].has_value() ? results[i].value() : NULL_MARKER,
+            ttls[j] * 1000LL, epoch);
   }
   return results;
 }
@@ -1,94 +1,358 @@
 #ifndef REDIS_CACHE_H
 #define REDIS_CACHE_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "async_redis.h"
 #include "bloom_filter.h"
+#include "bloom_warmer.h"
+#include "cache_invalidator.h"
 #include "circuit_breaker.h"
+#include "cuckoo_filter.h"
+#include "l1_cache.h"
 #include "redis_pool.h"
+#include "single_flight.h"
 
 // Redis 缓存工具类 —— 考研成绩查询系统
 //
 // 核心能力:
-//   - 防缓存穿透: 布隆过滤器 + 空值缓存（短 TTL）
-//   - 防缓存击穿: 分布式互斥锁 (SETNX)，仅一个线程重建缓存
+//   - 防缓存穿透: 布隆 / 布谷鸟过滤器（见 key_filter.h）+ 空值缓存（短 TTL）
+//   - 防缓存击穿: 进程内 singleflight 合并 + 分布式互斥锁 (SETNX)，仅一个线程重建缓存
 //   - 防缓存雪崩: 随机 TTL 抖动 (±10%)，避免集中过期
+//   - 过期不等待: 值内携带逻辑过期时间，物理 TTL 多留 STALE_GRACE_SEC；
+//     逻辑过期后继续返回旧值并由后台线程刷新（stale-while-revalidate），
+//     临近过期时按 XFetch 概率提前刷新，把重建分散到过期之前
 //   - 容错降级: 熔断器 + 直连数据库回退
+//   - 进程内 L1: W-TinyLFU 分片缓存，TTL 不超过 Redis 剩余 TTL（见 l1_cache.h）
+//   - 跨节点失效: CLIENT TRACKING 推送驱动 L1 淘汰，跟踪生效时 L1 可用更长 TTL
+//   - 异步读取: get_async() 经 AsyncRedis 走事件循环，等待 Redis 期间不占 worker
+//   - 多实例分片: key 按 redis_pool::shard_of() 落到分片，每个分片独立熔断，
+//     批量读写按分片拆分并流水线并发发送
+//   - Redis Cluster: 命令经 redis_pool::exec() 跟随 MOVED / ASK；流水线中的
+//     重定向无法就地重发，该 key 本次按未命中处理（回源 MySQL）
 //
 // 单例模式，线程安全。
 class RedisCache {
 public:
   static RedisCache *GetInstance();
+  ~RedisCache();
 
-  // 初始化（须在 Redis 连接池 init 之后调用）
+  // 初始化（须在 Redis 连接池 init 之后调用），同时启动后台刷新线程
   void init(redis_pool *pool);
 
+  // 启动 L1 跨节点失效监听（每个分片一条独立连接 + 后台线程，见 cache_invalidator.h）
+  // 全部分片跟踪生效时 L1 才放宽 TTL。endpoints 按分片号排列；可重复调用，
+  // 只为尚无监听的新分片启动（连不上的实例由监听线程自行重连）
+  void start_invalidation(const std::vector<RedisEndpoint> &endpoints,
+                          const std::string &password);
+
+  // 成绩缓存键（/4 查询与学生增删改共用）
+  static std::string score_key(const std::string &name,
+                               const std::string &id_card) {
+    return std::string(SCORE_KEY_PREFIX) + name + ":" + id_card;
+  }
+
   // ── 核心缓存操作 ────────────────────────────────────
 
+  // 回源查询的结果: value 为 nullopt 表示记录不存在（写空值标记防穿透）；
+  // unavailable 表示熔断 / DB 出错、结果未知，此时不写空值标记
+  struct DbResult {
+    DbResult(std::optional<std::string> v = std::nullopt) : value(std::move(v)) {}
+    static DbResult unavailable_result() {
+      DbResult r;
+      r.unavailable = true;
+      return r;
+    }
+    std::optional<std::string> value;
+    bool unavailable = false;
+  };
+  using DbQuery = std::function<DbResult()>;
+
   // 带三级防护的缓存读取
   //   key:      缓存键
-  //   db_query: 缓存未命中时的 DB 查询回调（返回值 nullopt 表示记录不存在）
-  //   base_ttl: 基础过期时间（秒），默认 3600，实际写入会加随机抖动
+  //   db_query: 缓存未命中时的 DB 查询回调（见 DbResult）；
+  //             命中过期值时会被复制到后台刷新线程执行，捕获的数据须按值持有
+  //   base_ttl: 基础（逻辑）过期时间（秒），默认 3600，实际写入会加随机抖动
   std::optional<std::string> get(const std::string &key,
-                                 std::function<std::optional<std::string>()> db_query,
+                                 DbQuery db_query,
                                  int base_ttl = 3600);
 
+  // ── 异步读取（事件循环驱动） ─────────────────────────
+
+  struct AsyncResult {
+    enum Status {
+      HIT,      // 命中，value 有效
+      NEGATIVE, // 确认不存在（布隆过滤 / 空值标记）
+      MISS,     // Redis 未命中，需调用 rebuild_async()
+      ERROR     // Redis 出错 / 超时，需回退到 get()
+    } status = ERROR;
+    std::string value;
+  };
+  using AsyncDone = std::function<void(AsyncResult &&)>;
+  enum class Lookup { DONE, PENDING, UNAVAILABLE };
+
+  // 布隆过滤 / L1 可就地判定时返回 DONE 并填写 out；
+  // 否则提交 GET + PTTL 后返回 PENDING，回复到达时在事件循环线程调用 done；
+  // 异步连接不可用或熔断器非 CLOSED 时返回 UNAVAILABLE，调用方改用 get()
+  //   db_query / base_ttl: 同 get()，命中过期值时用于后台刷新
+  //   delay_ms: 延迟发送（锁竞争重试）
+  Lookup get_async(const std::string &key,
+                   DbQuery db_query,
+                   int base_ttl, AsyncResult &out, AsyncDone done,
+                   int delay_ms = 0);
+
+  // 未命中后的重建（get() 的第三层）: singleflight + SETNX 互斥锁 + Double Check + 回写
+  // 本进程已有同 key 重建在途时阻塞等待其结果，未获分布式锁时原地等待重试
+  std::optional<std::string>
+  rebuild(const std::string &key,
+          const DbQuery &db_query,
+          int base_ttl = 3600);
+
+  // 异步调用方的重建，不在 worker 里等待:
+  //   DONE:   本线程完成重建，value 有效
+  //   LOCKED: 其他节点持有分布式锁，调用方经 get_async(delay_ms) 稍后重试
+  //   JOINED: 本进程已有同 key 重建在途，完成后在事件循环线程调用 done
+  //           （leader 未获锁时 done 收到 MISS）
+  //   LOAD:   仅当传入 deferred 时: 本线程成为 leader、已持有重建锁且 Double
+  //           Check 未命中。调用方自行（异步）查库，之后必须以查询结果调用
+  //           一次 finish_rebuild(*deferred, ...)，在此之前同 key 的等待者一直挂起
+  struct PendingLoad {
+    std::string key;
+    int base_ttl = 0;
+    uint64_t epoch = 0; // 查库前的 L1 失效纪元
+    std::chrono::steady_clock::time_point start;
+  };
+  enum class Rebuild { DONE, LOCKED, JOINED, LOAD };
+  Rebuild rebuild_async(const std::string &key,
+                        const DbQuery &db_query,
+                        int base_ttl, std::optional<std::string> &value,
+                        AsyncDone done, PendingLoad *deferred = nullptr);
+
+  // LOAD 的后半段，任意线程调用且不阻塞（可在事件循环线程）: 填 L1，
+  // 经 AsyncRedis 流水线回写并释放重建锁，唤醒同 key 的等待者。
+  // 查无此人时与同步路径一样写入空值标记；result.unavailable 时只释放锁
+  // （不回写、不填 L1、不计误判），等待者按未获锁处理、自行重新回源
+  void finish_rebuild(const PendingLoad &load, const DbResult &result);
+
+  // 降级直查 DB（不回写缓存），同 key 的并发调用合并为一次查询
+  std::optional<std::string>
+  load_direct(const std::string &key,
+              const DbQuery &db_query);
+
   // 写入缓存（含随机 TTL 防雪崩）
   bool set(const std::string &key, const std::string &value, int base_ttl = 3600);
 
   // 删除缓存（Cache Aside 模式：先写 DB 再删缓存）
   bool del(const std::string &key);
 
-  // 批量读取
+  // 批量读取: 每个分片一次 MGET(+PTTL) 流水线，各分片先全部发出再依次收取，
+  // 总耗时约为最慢分片的一次往返；未命中的 key 合并为一次 DB 回调，
+  // 回写同样按分片流水线并发
+  //   db_query: 入参为未命中的 key 列表，返回等长结果（nullopt 表示记录不存在）；
+  //             查询失败时返回空 vector，条数不符的结果一律不回写
+  using BatchQuery = std::function<std::vector<std::optional<std::string>>(
+      const std::vector<std::string> &)>;
   std::vector<std::optional<std::string>>
-  mget(const std::vector<std::string> &keys,
-       std::function<std::optional<std::string>(const std::string &)> db_query,
+  mget(const std::vector<std::string> &keys, BatchQuery db_query,
        int base_ttl = 3600);
 
   // 预热布隆过滤器（从 DB 加载已有键集合，防止冷启动穿透）
   // expected_elements: 预期元素总数，用于按最优参数重新分配位数组
+  // 新表离线构建后原子发布，不阻塞并发查询与插入
   void warm_bloom(const std::vector<std::string> &keys, size_t expected_elements = 0);
 
-  // 重置熔断器（运维接口）
-  void reset_breaker() { circuit_breaker_.reset(); }
+  // 选择过滤器实现: "bloom"（默认）或 "cuckoo"（支持删除）；未知名称返回 false
+  // 须在 start_bloom_warmup() 之前、开始服务之前调用
+  bool set_filter_kind(const std::string &kind);
+
+  // 启动过滤器快照加载与后台追赶（见 bloom_warmer.h），须在 init() 之后调用
+  void start_bloom_warmup(const std::string &snapshot_path);
+
+  // 新增学生后调用: 新行只经后台 MySQL 水位线追赶进入过滤器（每行恰好一次），
+  // 这里唤醒追赶并最多等 BLOOM_SYNC_WAIT_MS，使本节点随后的查询不被误拒
+  void bloom_sync(uint64_t student_id);
+  // 改键后登记新键: 本地插入，并写入 Redis 流供其他节点追赶
+  void bloom_add(const std::string &key);
+  // 删除 / 改键后从过滤器移除（仅布谷鸟过滤器生效），同样经 Redis 流广播
+  void bloom_remove(const std::string &key);
+
+  // 过滤器统计: 占用率 / 估算误判率，以及实际观测到的误判
+  //   rejects:         过滤器判定不存在、直接拒绝的查询
+  //   false_positives: 通过过滤器但结果为"不存在"的查询（空值标记命中或 DB 查无）
+  //   observed_fpr = false_positives / (false_positives + rejects)
+  struct FilterStats {
+    KeyFilter::Stats filter;
+    uint64_t rejects = 0;
+    uint64_t false_positives = 0;
+  };
+  FilterStats filter_stats() const;
+
+  // 重置熔断器（运维接口，所有分片）
+  void reset_breaker();
+
+  CircuitState breaker_state(size_t shard = 0);
 
-  CircuitState breaker_state() const { return circuit_breaker_.state(); }
+  // L1 命中 / 未命中 / 淘汰计数
+  L1Cache::Stats l1_stats() const { return l1_.stats(); }
 
   // 是否已预热
-  bool is_bloom_warmed() const { return bloom_warmed_; }
+  bool is_bloom_warmed() const { return bloom_warmed_.load(); }
+
+  static constexpr int RETRY_SLEEP_MS = 100;  // 未获锁时重试间隔
+  static constexpr int MAX_RETRIES = 5;       // 最大重试次数
 
 private:
   RedisCache() = default;
 
+  // Redis 中的值: 逻辑过期信封 + 原始值（见 wrap_entry）
+  struct CachedEntry {
+    std::string value;
+    long long expire_ms = 0; // 逻辑过期（Unix 毫秒），0 = 无信封（空值标记 / 旧格式）
+    long long delta_ms = 0;  // 上次重建耗时，XFetch 据此决定提前量
+  };
+  static std::string wrap_entry(const std::string &value, int ttl,
+                                long long delta_ms);
+  static CachedEntry unwrap_entry(std::string raw);
+  static long long wall_ms();
+  // 逻辑过期或 XFetch 抽中时返回 true
+  static bool should_refresh(const CachedEntry &e);
+  // L1 存活时间不超过逻辑剩余时间，过期值不进 L1（返回 -2）
+  static long long fresh_ttl_ms(const CachedEntry &e, long long pttl_ms);
+
+  // 后台刷新: 每个 key 同时只排队一次（借用 singleflight 在途记录）
+  struct RefreshTask {
+    std::string key;
+    DbQuery db_query;
+    int base_ttl = 0;
+    long long stale_expire_ms = -1;
+  };
+  void schedule_refresh(const std::string &key,
+                        const DbQuery &db_query,
+                        int base_ttl, long long stale_expire_ms);
+  void refresh_loop();
+  void refresh(const RefreshTask &task);
+
   // 底层 Redis 操作
   std::optional<std::string> redis_raw_get(redisContext *ctx,
                                            const std::string &key);
+  // GET + PTTL 流水线发送（一次往返），pttl_ms 为剩余毫秒数（无过期为 -1）
+  std::optional<std::string> redis_raw_get_pttl(redisContext *ctx,
+                                                const std::string &key,
+                                                long long &pttl_ms);
   bool redis_raw_set(redisContext *ctx, const std::string &key,
                      const std::string &value, int ttl);
   bool redis_raw_del(redisContext *ctx, const std::string &key);
+  // MGET（集群模式逐个 GET）+ 逐个 PTTL 流水线: append 只写入发送缓冲，read 发出并读取全部回复；
+  // 拆成两步以便多个分片先全部发出再依次收取。read 失败返回 false（连接异常）
+  void redis_append_mget_pttl(redisContext *ctx,
+                              const std::vector<const std::string *> &keys);
+  // redirected: 集群模式下该 key 的回复是 MOVED / ASK（值不可用）
+  bool redis_read_mget_pttl(redisContext *ctx, size_t n,
+                            std::vector<std::optional<std::string>> &values,
+                            std::vector<long long> &pttl_ms,
+                            std::vector<bool> &redirected);
+  // SETEX 批量流水线写入（同上两步），read 返回成功条数
+  void redis_append_set_batch(
+      redisContext *ctx,
+      const std::vector<std::pair<const std::string *, const std::string *>> &kvs,
+      const std::vector<int> &ttls);
+  size_t redis_read_set_batch(redisContext *ctx, size_t n);
+
+  size_t shard_of(const std::string &key) const {
+    return pool_ ? pool_->shard_of(key) : 0;
+  }
+  // 分片的命令熔断器（随 redis_pool 分片一起创建，集群新增主节点时自动获得）
+  CircuitBreaker &breaker_for(size_t shard);
+
+  // 同 key 并发调用只执行一次 fn，其余调用方阻塞等待其结果
+  std::optional<std::string>
+  coalesce(const std::string &key,
+           const std::function<std::optional<std::string>()> &fn);
+
+  // rebuild 的锁内部分（由 singleflight leader 执行）
+  //   locked == nullptr: 未获锁时原地等待重试
+  //   locked != nullptr: 未获锁时立即返回 nullopt 并置 *locked = true
+  std::optional<std::string>
+  rebuild_locked(const std::string &key,
+                 const DbQuery &db_query,
+                 int base_ttl, bool *locked);
+
+  // 已持有分布式锁: Double Check + 查库 + 回写 + 解锁
+  //   stale_expire_ms: Double Check 只接受逻辑过期晚于此值的缓存（-1 = 任意）
+  std::optional<std::string>
+  fill_locked(redisContext *ctx, const std::string &key,
+              const DbQuery &db_query,
+              int base_ttl, long long stale_expire_ms);
+  // fill_locked 的 Double Check: 其他线程 / 节点已重建（或刷新）完成时
+  // 释放锁、把结果写入 out 并返回 true
+  bool recheck_locked(redisContext *ctx, const std::string &key,
+                      long long stale_expire_ms,
+                      std::optional<std::string> &out);
 
   // 分布式锁 — SETNX + TTL，防击穿
-  bool try_lock(redisContext *ctx, const std::string &key, int lock_ttl = 10);
+  // answered 非空时写入 Redis 是否正常应答（锁被占用也算应答），供调用方记熔断结果
+  bool try_lock(redisContext *ctx, const std::string &key, int lock_ttl = 10,
+                bool *answered = nullptr);
   void unlock(redisContext *ctx, const std::string &key);
 
   // 随机 TTL: base ± 10%，防雪崩
   int random_ttl(int base_ttl) const;
 
+  // 写入 L1，存活时间取 min(L1 上限, Redis 剩余 TTL)
+  // epoch: 读取 Redis 之前的失效纪元，期间若有失效消息则不保留本次回填
+  void l1_fill(const std::string &key, const std::string &value,
+               long long redis_ttl_ms, uint64_t epoch);
+  void l1_invalidate(std::string_view key);
+  void l1_flush();
+
+  // 过滤器判定不存在时计数并返回 true（未预热时一律放行）
+  bool filter_rejects(const std::string &key);
+  // 通过过滤器的查询最终得到"不存在"，计入观测误判
+  void note_false_positive();
+  // 过滤器增删写入 Redis 流（op: "k" = 插入, "d" = 删除），尽力而为
+  void journal_key(const char *op, const std::string &key);
+
   redis_pool *pool_ = nullptr;
-  BloomFilter bloom_filter_;
-  CircuitBreaker circuit_breaker_;
-  bool bloom_warmed_ = false;
-  std::mutex bloom_warm_mutex_;
+  std::unique_ptr<KeyFilter> filter_ = std::make_unique<BloomFilter>();
+  SingleFlight flights_;
+  L1Cache l1_{L1_BYTES};
+  std::atomic<uint64_t> l1_epoch_{0};  // 每条失效消息 +1
+  std::atomic<bool> l1_tracking_{false};
+  std::atomic<size_t> l1_tracked_shards_{0};
+  std::vector<std::unique_ptr<CacheInvalidator>> invalidators_;
+  // 仅在 warm_bloom() 用全量键集合建表后置位: 单条插入不代表集合完整，
+  // 未预热时布隆判定"不存在"会把从未查过的真实考生误判为不存在
+  std::atomic<bool> bloom_warmed_{false};
+  std::unique_ptr<BloomWarmer> bloom_warmer_;
+  std::atomic<uint64_t> filter_rejects_{0};
+  std::atomic<uint64_t> filter_false_positives_{0};
+
+  std::thread refresher_;
+  std::mutex refresh_mutex_;
+  std::condition_variable refresh_cv_;
+  std::deque<RefreshTask> refresh_queue_;
+  bool refresh_stop_ = false;
 
   static constexpr int NULL_CACHE_TTL = 60;   // 空值缓存 TTL（秒）
+  static constexpr int BLOOM_SYNC_WAIT_MS = 200; // bloom_sync() 等待上限
   static constexpr int LOCK_TTL = 10;         // 互斥锁 TTL（秒）
-  static constexpr int RETRY_SLEEP_MS = 100;  // 未获锁时重试间隔
-  static constexpr int MAX_RETRIES = 5;       // 最大重试次数
+  static constexpr int STALE_GRACE_SEC = 600; // 逻辑过期后旧值的保留时间（秒）
+  static constexpr double XFETCH_BETA = 1.0;  // XFetch 提前系数，>1 更激进
+  static constexpr size_t REFRESH_QUEUE_MAX = 1024;
+  static constexpr size_t L1_BYTES = 64 << 20; // L1 字节预算
+  static constexpr long long L1_TTL_MS = 5000;           // 无失效通知时的 L1 上限
+  static constexpr long long L1_TRACKED_TTL_MS = 300000; // 跟踪生效时的 L1 上限
+  static constexpr const char *SCORE_KEY_PREFIX = "exam:score:";
 };
 
 #endif
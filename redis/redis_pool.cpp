@@ -1,126 +1,535 @@
 #include "redis_pool.h"
+#include "bloom_filter.h" // bloom_detail::wyhash
 #include "log/log.h"
-#include <deque>
+#include <chrono>
+#include <cstdarg>
+#include <cstdlib>
 #include <mutex>
 #include <string>
 #include <thread>
 
-redis_pool::redis_pool()
-    : m_CurConn(0), m_FreeConn(0), m_MaxConn(0) {}
+redis_pool::Shard::Shard(const RedisEndpoint &ep, const std::string &name_suffix)
+    : endpoint(ep),
+      breaker("redis_pool" + name_suffix,
+              CircuitBreaker::Options{.slow_call_ms = 200, .slow_rate = 0.5}),
+      // Redis 往返正常在 1ms 内，超过 100ms 即视为慢调用
+      command_breaker("redis" + name_suffix,
+                      CircuitBreaker::Options{.slow_call_ms = 100,
+                                              .slow_rate = 0.5}) {}
 
 redis_pool *redis_pool::GetInstance() {
   static redis_pool pool;
   return &pool;
 }
 
-void redis_pool::init(const std::string &host, int port,
-                                  const std::string &password, int max_conn,
-                                  int db_index) {
-  m_host = host;
-  m_port = port;
+// ── 分片路由 ────────────────────────────────────────────────────────────
+
+std::vector<RedisEndpoint> redis_pool::parse_endpoints(const std::string &spec,
+                                                       int default_port) {
+  std::vector<RedisEndpoint> out;
+  size_t pos = 0;
+  while (pos <= spec.size()) {
+    size_t comma = spec.find(',', pos);
+    if (comma == std::string::npos)
+      comma = spec.size();
+    std::string item = spec.substr(pos, comma - pos);
+    pos = comma + 1;
+    if (item.empty())
+      continue;
+
+    RedisEndpoint ep;
+    ep.port = default_port;
+    size_t colon = item.rfind(':');
+    if (colon == std::string::npos) {
+      ep.host = item;
+    } else {
+      ep.host = item.substr(0, colon);
+      ep.port = atoi(item.c_str() + colon + 1);
+    }
+    if (ep.host.empty() || ep.port <= 0 || ep.port > 65535) {
+      LOG_WARN("Ignoring malformed Redis endpoint '%s'", item.c_str());
+      continue;
+    }
+    out.push_back(std::move(ep));
+  }
+  return out;
+}
+
+size_t redis_pool::jump_hash(uint64_t key, size_t buckets) {
+  int64_t b = -1, j = 0;
+  while (j < static_cast<int64_t>(buckets)) {
+    b = j;
+    key = key * 2862933555777941757ULL + 1;
+    j = static_cast<int64_t>((b + 1) * (static_cast<double>(1LL << 31) /
+                                        static_cast<double>((key >> 33) + 1)));
+  }
+  return static_cast<size_t>(b);
+}
+
+// {tag}: 只对第一对花括号之间的非空内容求哈希
+static std::string_view hash_tag(std::string_view key) {
+  size_t open = key.find('{');
+  if (open != std::string_view::npos) {
+    size_t close = key.find('}', open + 1);
+    if (close != std::string_view::npos && close > open + 1)
+      return key.substr(open + 1, close - open - 1);
+  }
+  return key;
+}
+
+// CRC16-CCITT (XMODEM): 多项式 0x1021，初值 0，与 Redis Cluster 一致
+static const std::array<uint16_t, 256> CRC16_TABLE = [] {
+  std::array<uint16_t, 256> t{};
+  for (int i = 0; i < 256; ++i) {
+    uint16_t crc = static_cast<uint16_t>(i << 8);
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021)
+                           : static_cast<uint16_t>(crc << 1);
+    t[i] = crc;
+  }
+  return t;
+}();
+
+uint16_t redis_pool::hash_slot(std::string_view key) {
+  key = hash_tag(key);
+  uint16_t crc = 0;
+  for (unsigned char c : key)
+    crc = static_cast<uint16_t>((crc << 8) ^ CRC16_TABLE[((crc >> 8) ^ c) & 0xff]);
+  return crc & (CLUSTER_SLOTS - 1);
+}
+
+size_t redis_pool::shard_of(std::string_view key) const {
+  size_t n = shard_count();
+  if (m_cluster) {
+    size_t shard = m_slots[hash_slot(key)].load(std::memory_order_relaxed);
+    return shard < n ? shard : 0;
+  }
+  if (n <= 1)
+    return 0;
+  key = hash_tag(key);
+  return jump_hash(bloom_detail::wyhash(key.data(), key.size(), SHARD_SEED), n);
+}
+
+std::vector<RedisEndpoint> redis_pool::endpoints() const {
+  std::vector<RedisEndpoint> out;
+  size_t n = shard_count();
+  out.reserve(n);
+  for (size_t i = 0; i < n; ++i)
+    out.push_back(m_shards[i]->endpoint);
+  return out;
+}
+
+int redis_pool::find_shard(const RedisEndpoint &ep) const {
+  size_t n = shard_count();
+  for (size_t i = 0; i < n; ++i)
+    if (m_shards[i]->endpoint == ep)
+      return static_cast<int>(i);
+  return -1;
+}
+
+// ── 初始化 ──────────────────────────────────────────────────────────────
+
+redisContext *redis_pool::connect(const RedisEndpoint &ep) const {
+  struct timeval timeout = {1, 500000}; // 1.5s 连接超时
+  redisContext *ctx = redisConnectWithTimeout(ep.host.c_str(), ep.port, timeout);
+  if (!ctx || ctx->err) {
+    if (ctx) {
+      LOG_WARN("Redis connection to %s:%d failed: %s", ep.host.c_str(),
+               ep.port, ctx->errstr);
+      redisFree(ctx);
+    } else {
+      LOG_WARN("Redis connection failed: cannot allocate context");
+    }
+    return nullptr;
+  }
+
+  // 认证
+  if (!m_password.empty()) {
+    redisReply *reply = static_cast<redisReply *>(
+        redisCommand(ctx, "AUTH %s", m_password.c_str()));
+    if (!reply || reply->type == REDIS_REPLY_ERROR) {
+      LOG_WARN("Redis AUTH on %s:%d failed", ep.host.c_str(), ep.port);
+      if (reply) freeReplyObject(reply);
+      redisFree(ctx);
+      return nullptr;
+    }
+    freeReplyObject(reply);
+  }
+
+  // 选择数据库
+  if (m_db_index > 0) {
+    redisReply *reply =
+        static_cast<redisReply *>(redisCommand(ctx, "SELECT %d", m_db_index));
+    freeReplyObject(reply);
+  }
+  return ctx;
+}
+
+int redis_pool::add_shard(const RedisEndpoint &ep,
+                          const std::string &name_suffix) {
+  size_t index = shard_count();
+  if (index >= MAX_SHARDS) {
+    LOG_ERROR("Redis: too many shards (max %zu), ignoring %s:%d", MAX_SHARDS,
+              ep.host.c_str(), ep.port);
+    return -1;
+  }
+  auto shard = std::make_unique<Shard>(ep, name_suffix);
+  if (!connect_shard(*shard)) {
+    // 一个分片不可用不影响其他分片: 落在它上面的 key 降级到 MySQL，直到后台重连成功
+    LOG_WARN("Redis shard %s:%d init failed, its keys degrade to MySQL-only "
+             "(retrying every %ds)",
+             ep.host.c_str(), ep.port, SHARD_RETRY_S);
+  }
+  m_shards[index] = std::move(shard);
+  m_shard_count.store(index + 1, std::memory_order_release);
+  return static_cast<int>(index);
+}
+
+bool redis_pool::connect_shard(Shard &shard) {
+  std::vector<redisContext *> conns;
+  for (int i = 0; i < m_max_conn; ++i) {
+    redisContext *ctx = connect(shard.endpoint);
+    if (!ctx)
+      break;
+    conns.push_back(ctx);
+  }
+  if (static_cast<int>(conns.size()) < m_max_conn) {
+    for (redisContext *ctx : conns)
+      redisFree(ctx);
+    return false;
+  }
+  shard.conns.init(conns.size());
+  for (redisContext *ctx : conns)
+    shard.conns.add(ctx);
+  shard.m_MaxConn = static_cast<int>(conns.size());
+  // 连接池就绪后才发布: GetConnection() 先检查 m_initialized 再碰 conns
+  shard.m_initialized.store(true, std::memory_order_release);
+  m_initialized = true;
+  return true;
+}
+
+bool redis_pool::retry_shards() {
+  std::lock_guard<std::mutex> topology(m_topology_mutex);
+  bool pending = false;
+  for (size_t i = 0; i < shard_count(); ++i) {
+    Shard &shard = *m_shards[i];
+    if (shard.m_initialized.load(std::memory_order_acquire))
+      continue;
+    if (connect_shard(shard))
+      LOG_INFO("Redis shard %zu (%s:%d) reconnected: %d connections", i,
+               shard.endpoint.host.c_str(), shard.endpoint.port,
+               shard.m_MaxConn);
+    else
+      pending = true;
+  }
+  return pending;
+}
+
+void redis_pool::init(const std::vector<RedisEndpoint> &endpoints,
+                      const std::string &password, int max_conn_per_shard,
+                      int db_index, bool cluster) {
   m_password = password;
   m_db_index = db_index;
+  m_max_conn = max_conn_per_shard;
+  m_cluster = cluster;
 
-  for (int i = 0; i < max_conn; ++i) {
-    struct timeval timeout = {1, 500000}; // 1.5s 连接超时
-    redisContext *ctx = redisConnectWithTimeout(host.c_str(), port, timeout);
-    if (!ctx || ctx->err) {
-      if (ctx) {
-        redisFree(ctx);
-      }
-      if (ctx) {
-        LOG_WARN("Redis connection failed: %s", ctx->errstr);
-        redisFree(ctx);
-      } else {
-        LOG_WARN("Redis connection failed: cannot allocate context");
-      }
-      LOG_WARN("Redis pool init failed, server will degrade to MySQL-only");
-      return;
+  if (cluster) {
+    if (db_index != 0) {
+      LOG_WARN("Redis Cluster only supports db 0, ignoring db_index=%d",
+               db_index);
+      m_db_index = 0;
+    }
+    m_seeds = endpoints;
+    if (!refresh_slots(m_seeds))
+      LOG_WARN("Redis cluster: no seed answered CLUSTER SLOTS, "
+               "will keep retrying in the background");
+  } else {
+    std::lock_guard<std::mutex> topology(m_topology_mutex);
+    for (const RedisEndpoint &ep : endpoints) {
+      // 单实例时沿用原名称，统计输出保持不变
+      add_shard(ep, endpoints.size() == 1
+                        ? std::string()
+                        : "@" + ep.host + ":" + std::to_string(ep.port));
     }
+  }
+  // 拓扑变化（迁槽、故障转移、扩容）与未连上分片的重连由后台线程跟进
+  m_refresher = std::thread(&redis_pool::refresh_loop, this);
+
+  if (!m_initialized) {
+    LOG_WARN("Redis pool init failed, server will degrade to MySQL-only");
+    return;
+  }
+  size_t n = shard_count();
+  if (n == 1 && !cluster) {
+    LOG_INFO("Redis pool initialized: %d connections", m_shards[0]->m_MaxConn);
+  } else {
+    for (size_t i = 0; i < n; ++i)
+      LOG_INFO("Redis %s %zu (%s:%d): %d connections",
+               cluster ? "cluster master" : "shard", i,
+               m_shards[i]->endpoint.host.c_str(), m_shards[i]->endpoint.port,
+               m_shards[i]->m_MaxConn);
+  }
+}
 
-    // 认证
-    if (!password.empty()) {
-      redisReply *reply =
-          static_cast<redisReply *>(redisCommand(ctx, "AUTH %s", password.c_str()));
-      if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply) freeReplyObject(reply);
-        redisFree(ctx);
-        return;
+// ── Redis Cluster: 槽位表 ───────────────────────────────────────────────
+
+bool redis_pool::refresh_slots(const std::vector<RedisEndpoint> &seeds) {
+  struct Range {
+    int start, end;
+    RedisEndpoint master;
+  };
+  std::vector<Range> ranges;
+  bool fetched = false;
+
+  for (const RedisEndpoint &seed : seeds) {
+    redisContext *ctx = connect(seed);
+    if (!ctx)
+      continue;
+    redisReply *reply =
+        static_cast<redisReply *>(redisCommand(ctx, "CLUSTER SLOTS"));
+    // [[start, end, [host, port, id, ...], replica...], ...]
+    if (reply && reply->type == REDIS_REPLY_ARRAY && reply->elements > 0) {
+      for (size_t i = 0; i < reply->elements; ++i) {
+        redisReply *r = reply->element[i];
+        if (r->type != REDIS_REPLY_ARRAY || r->elements < 3 ||
+            r->element[2]->type != REDIS_REPLY_ARRAY ||
+            r->element[2]->elements < 2)
+          continue;
+        redisReply *node = r->element[2];
+        Range range;
+        range.start = static_cast<int>(r->element[0]->integer);
+        range.end = static_cast<int>(r->element[1]->integer);
+        // 空主机名表示"与被询问的节点相同"
+        range.master.host = node->element[0]->len
+                                ? std::string(node->element[0]->str,
+                                              node->element[0]->len)
+                                : seed.host;
+        range.master.port = static_cast<int>(node->element[1]->integer);
+        if (range.start < 0 || range.end >= static_cast<int>(CLUSTER_SLOTS) ||
+            range.start > range.end)
+          continue;
+        ranges.push_back(std::move(range));
       }
-      freeReplyObject(reply);
+      fetched = !ranges.empty();
+    } else {
+      LOG_WARN("Redis cluster: CLUSTER SLOTS on %s:%d failed: %s",
+               seed.host.c_str(), seed.port,
+               reply && reply->type == REDIS_REPLY_ERROR ? reply->str
+                                                         : ctx->errstr);
     }
+    freeReplyObject(reply);
+    redisFree(ctx);
+    if (fetched)
+      break;
+  }
+  if (!fetched)
+    return false;
 
-    // 选择数据库
-    if (db_index > 0) {
-      redisReply *reply =
-          static_cast<redisReply *>(redisCommand(ctx, "SELECT %d", db_index));
-      freeReplyObject(reply);
+  std::lock_guard<std::mutex> topology(m_topology_mutex);
+  size_t before = shard_count();
+  size_t remapped = 0;
+  for (const Range &range : ranges) {
+    int shard = find_shard(range.master);
+    if (shard < 0)
+      shard = add_shard(range.master, "@" + range.master.host + ":" +
+                                          std::to_string(range.master.port));
+    if (shard < 0)
+      continue;
+    for (int slot = range.start; slot <= range.end; ++slot) {
+      if (m_slots[slot].load(std::memory_order_relaxed) != shard) {
+        m_slots[slot].store(static_cast<uint16_t>(shard),
+                            std::memory_order_relaxed);
+        ++remapped;
+      }
     }
+  }
+  if (before > 0 && (remapped > 0 || shard_count() != before))
+    LOG_INFO("Redis cluster slot map refreshed: %zu masters, %zu slots remapped",
+             shard_count(), remapped);
+  return true;
+}
 
-    connList.emplace_back(ctx);
-    ++m_FreeConn;
+void redis_pool::request_refresh() {
+  {
+    std::lock_guard<std::mutex> lock(m_refresh_mutex);
+    m_refresh_requested = true;
   }
+  m_refresh_cv.notify_one();
+}
 
-  semaphore_.release(m_FreeConn);
-  m_MaxConn = m_FreeConn;
-  m_initialized = true;
-  LOG_INFO("Redis pool initialized: %d connections", m_FreeConn);
+void redis_pool::refresh_loop() {
+  std::unique_lock<std::mutex> lock(m_refresh_mutex);
+  bool pending = true; // 有分片未连上: 缩短间隔，尽快重连（首轮按短间隔检查）
+  while (!m_refresh_stop) {
+    m_refresh_cv.wait_for(
+        lock, std::chrono::seconds(pending ? SHARD_RETRY_S : REFRESH_INTERVAL_S),
+        [this] { return m_refresh_stop || m_refresh_requested; });
+    if (m_refresh_stop)
+      break;
+    m_refresh_requested = false;
+    lock.unlock();
+
+    if (m_cluster) {
+      // 先问已知主节点，都不可达时回到种子列表
+      std::vector<RedisEndpoint> seeds = endpoints();
+      seeds.insert(seeds.end(), m_seeds.begin(), m_seeds.end());
+      if (!refresh_slots(seeds))
+        LOG_WARN("Redis cluster: slot map refresh failed");
+    }
+    pending = retry_shards();
+
+    lock.lock();
+    // 迁槽期间 MOVED 会成批到达，两次刷新之间至少间隔 REFRESH_MIN_GAP_MS
+    m_refresh_cv.wait_for(lock, std::chrono::milliseconds(REFRESH_MIN_GAP_MS),
+                          [this] { return m_refresh_stop; });
+  }
 }
 
-redisContext *redis_pool::GetConnection() {
-  // 未初始化 → 立即返回 nullptr，不阻塞
-  if (!m_initialized) return nullptr;
+// ── Redis Cluster: 重定向 ───────────────────────────────────────────────
 
-  semaphore_.acquire();
+bool redis_pool::parse_redirect(const redisReply *reply, bool &ask, int &slot,
+                                RedisEndpoint &target) {
+  if (!reply || reply->type != REDIS_REPLY_ERROR)
+    return false;
+  std::string_view msg(reply->str, reply->len);
+  if (msg.rfind("MOVED ", 0) == 0) {
+    ask = false;
+    msg.remove_prefix(6);
+  } else if (msg.rfind("ASK ", 0) == 0) {
+    ask = true;
+    msg.remove_prefix(4);
+  } else {
+    return false;
+  }
+  size_t space = msg.find(' ');
+  if (space == std::string_view::npos)
+    return false;
+  slot = atoi(std::string(msg.substr(0, space)).c_str());
+  std::string_view addr = msg.substr(space + 1);
+  size_t colon = addr.rfind(':');
+  if (colon == std::string_view::npos || slot < 0 ||
+      slot >= static_cast<int>(CLUSTER_SLOTS))
+    return false;
+  target.host = std::string(addr.substr(0, colon));
+  target.port = atoi(std::string(addr.substr(colon + 1)).c_str());
+  return !target.host.empty() && target.port > 0;
+}
 
-  redisContext *ctx = nullptr;
-  {
-    std::lock_guard<std::mutex> lockGuard(lock);
-    ctx = connList.front();
-    connList.pop_front();
-    --m_FreeConn;
-    ++m_CurConn;
+bool redis_pool::is_redirect(const redisReply *reply) {
+  bool ask;
+  int slot;
+  RedisEndpoint target;
+  if (!m_cluster || !parse_redirect(reply, ask, slot, target))
+    return false;
+  if (!ask) {
+    // 槽已迁走: 先改这一个槽让后续请求直达，整表由后台线程刷新
+    int shard = find_shard(target);
+    if (shard >= 0)
+      m_slots[slot].store(static_cast<uint16_t>(shard), std::memory_order_relaxed);
+    request_refresh();
   }
+  return true;
+}
 
-  // 健康检查（冷却 60 秒，避免每次获取都 ping）
-  time_t now = time(NULL);
-  bool need_check = false;
-  {
-    std::lock_guard<std::mutex> health_lock(m_health_mutex);
-    auto it = m_last_health_check.find(ctx);
-    if (it == m_last_health_check.end() || now - it->second > 60) {
-      need_check = true;
+redisReply *redis_pool::follow_redirects(redisReply *reply, const char *cmd,
+                                         size_t len) {
+  for (int hop = 0; hop < MAX_REDIRECTS; ++hop) {
+    bool ask;
+    int slot;
+    RedisEndpoint target;
+    if (!parse_redirect(reply, ask, slot, target))
+      return reply;
+    is_redirect(reply);
+    freeReplyObject(reply);
+    reply = nullptr;
+
+    // 目标是已知主节点时借它的连接（不等待，避免持有源连接时互相等待），
+    // 新节点或池已耗尽时用临时连接
+    int shard = find_shard(target);
+    redisContext *ctx = shard >= 0 ? GetConnection(shard, false) : nullptr;
+    bool pooled = ctx != nullptr;
+    if (!ctx)
+      ctx = connect(target);
+    if (!ctx)
+      return nullptr;
+
+    // ASK: 只对下一条命令生效，先发 ASKING，不更新槽位表
+    if (ask)
+      redisAppendCommand(ctx, "ASKING");
+    redisAppendFormattedCommand(ctx, cmd, len);
+    void *r = nullptr;
+    if (ask && redisGetReply(ctx, &r) == REDIS_OK) {
+      freeReplyObject(r);
+      r = nullptr;
     }
+    if (redisGetReply(ctx, &r) != REDIS_OK)
+      r = nullptr;
+    reply = static_cast<redisReply *>(r);
+
+    if (pooled)
+      ReleaseConnection(ctx, shard);
+    else
+      redisFree(ctx);
   }
+  return reply;
+}
+
+redisReply *redis_pool::exec(redisContext *ctx, const char *format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  if (!m_cluster) {
+    void *reply = redisvCommand(ctx, format, ap);
+    va_end(ap);
+    return static_cast<redisReply *>(reply);
+  }
+  // 集群模式: 先格式化，重定向时原样重发到目标节点
+  char *cmd = nullptr;
+  int len = redisvFormatCommand(&cmd, format, ap);
+  va_end(ap);
+  if (len < 0)
+    return nullptr;
 
-  if (need_check) {
-    redisReply *reply = static_cast<redisReply *>(redisCommand(ctx, "PING"));
+  void *reply = nullptr;
+  if (redisAppendFormattedCommand(ctx, cmd, len) != REDIS_OK ||
+      redisGetReply(ctx, &reply) != REDIS_OK)
+    reply = nullptr;
+  redisReply *result =
+      follow_redirects(static_cast<redisReply *>(reply), cmd, len);
+  redisFreeCommand(cmd);
+  return result;
+}
+
+// ── 借 / 还连接 ─────────────────────────────────────────────────────────
+
+redisContext *redis_pool::GetConnection(size_t shard_index, bool wait) {
+  // 未初始化 → 立即返回 nullptr，不阻塞
+  if (shard_index >= shard_count()) return nullptr;
+  Shard &shard = *m_shards[shard_index];
+  if (!shard.m_initialized) return nullptr;
+  if (!shard.breaker.allow_request()) return nullptr;
+
+  // 有空闲连接时只有几次原子操作；池耗尽才阻塞（wait = false 则直接返回）
+  LockFreePool<redisContext>::Lease lease;
+  if (!shard.conns.acquire(lease, wait)) return nullptr;
+  redisContext *ctx = lease.conn;
+
+  // 健康检查: 坏槽、上次调用已出错（hiredis 出错后上下文不可再用）或空闲过久时才检查，
+  // 热连接不付 PING 往返
+  if (!ctx || ctx->err || lease.idle_ms > HEALTH_CHECK_IDLE_MS) {
+    redisReply *reply =
+        ctx && !ctx->err
+            ? static_cast<redisReply *>(redisCommand(ctx, "PING"))
+            : nullptr;
     if (!reply || reply->type == REDIS_REPLY_ERROR) {
       // 连接失效，重连
-      {
-        std::lock_guard<std::mutex> health_lock(m_health_mutex);
-        m_last_health_check.erase(ctx);
-      }
       if (reply) freeReplyObject(reply);
-      redisFree(ctx);
-
-      struct timeval timeout = {1, 500000};
-      ctx = redisConnectWithTimeout(m_host.c_str(), m_port, timeout);
-      if (!ctx || ctx->err) {
-        if (ctx) {
-          redisFree(ctx);
-        }
-        ctx = nullptr;
-      } else if (!m_password.empty()) {
-        redisReply *auth_reply =
-            static_cast<redisReply *>(redisCommand(ctx, "AUTH %s", m_password.c_str()));
-        freeReplyObject(auth_reply);
-      }
+      if (ctx) redisFree(ctx);
 
+      ctx = connect(shard.endpoint);
       if (!ctx) {
-        std::lock_guard<std::mutex> lockGuard(lock);
-        --m_CurConn;
-        semaphore_.release();
+        // 放回坏槽，名额不丢，下一个借到它的调用方再重连
+        shard.conns.release(nullptr);
+        shard.breaker.on_failure();
         return nullptr;
       }
     } else {
@@ -128,46 +537,38 @@ redisContext *redis_pool::GetConnection() {
     }
   }
 
-  if (ctx) {
-    std::lock_guard<std::mutex> health_lock(m_health_mutex);
-    m_last_health_check[ctx] = now;
-  }
-
+  shard.breaker.on_checkout(lease.waited);
   return ctx;
 }
 
-bool redis_pool::ReleaseConnection(redisContext *ctx) {
-  if (!ctx) return false;
-
-  {
-    std::lock_guard<std::mutex> lockGuard(lock);
-    connList.emplace_back(ctx);
-    ++m_FreeConn;
-    --m_CurConn;
-  }
-  semaphore_.release();
+bool redis_pool::ReleaseConnection(redisContext *ctx, size_t shard_index) {
+  if (!ctx || shard_index >= shard_count()) return false;
+  m_shards[shard_index]->conns.release(ctx);
   return true;
 }
 
 redis_pool::~redis_pool() {
-  {
-    std::lock_guard<std::mutex> lockGuard(lock);
-    for (redisContext *ctx : connList) {
-      redisFree(ctx);
+  // 先停刷新线程，它可能正在建新分片
+  if (m_refresher.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_refresh_mutex);
+      m_refresh_stop = true;
     }
-    m_CurConn = 0;
-    m_FreeConn = 0;
-    connList.clear();
+    m_refresh_cv.notify_one();
+    m_refresher.join();
   }
+  for (size_t i = 0; i < shard_count(); ++i)
+    m_shards[i]->conns.drain([](redisContext *ctx) { redisFree(ctx); });
 }
 
 redisConnectionRAII::redisConnectionRAII(redisContext **redis_conn,
-                                          redis_pool *connPool) {
-  *redis_conn = connPool->GetConnection();
+                                         redis_pool *connPool, size_t shard) {
+  *redis_conn = connPool->GetConnection(shard);
   conRAII = *redis_conn;
   poolRAII = connPool;
+  shardRAII = shard;
 }
 
 redisConnectionRAII::~redisConnectionRAII() {
-  poolRAII->ReleaseConnection(conRAII);
+  poolRAII->ReleaseConnection(conRAII, shardRAII);
 }
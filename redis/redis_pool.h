@@ -1,60 +1,187 @@
 #ifndef REDIS_CONNECTION_POOL_H
 #define REDIS_CONNECTION_POOL_H
 
-#include <deque>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <mutex>
-#include <semaphore>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <thread>
+#include <vector>
 #include <hiredis/hiredis.h>
 
-const int MAX_REDIS_SEM = 10000;
+#include "circuit_breaker.h"
+#include "pool/lockfree_pool.h"
 
+struct RedisEndpoint {
+  std::string host;
+  int port = 6379;
+
+  bool operator==(const RedisEndpoint &o) const {
+    return port == o.port && host == o.host;
+  }
+};
+
+// Redis 连接池 —— 多实例分片 / Redis Cluster
+//
+// 每个 Redis 实例（分片）一个子池: 独立的连接队列、信号量、健康检查与熔断器，
+// 一个分片宕机只影响落在它上面的 key，其余分片照常服务。key 中含 {tag} 时
+// 只对 tag 求哈希（Redis Cluster 的 hash tag 约定），需要同分片的 key 可共用 tag。
+//
+// 两种路由模式:
+//   - 客户端分片（默认）: 实例列表固定，key → 分片用 jump consistent hash
+//     （Lamping & Veach），在列表末尾追加实例时只有约 1/n 的 key 迁移
+//   - Redis Cluster: 从种子节点取 CLUSTER SLOTS，key 按 CRC16 哈希槽路由到
+//     主节点；槽位表为原子数组，后台线程定时（及收到 MOVED 后）刷新，
+//     读路径不加锁。exec() 跟随 MOVED / ASK 重定向，新出现的主节点自动建子池
+// 分片号一经分配不再变化（只追加），外部按分片号保存的状态始终有效。
 class redis_pool {
 public:
-  redisContext *GetConnection();
-  bool ReleaseConnection(redisContext *conn);
+  // 借 / 还连接须使用同一个分片号；wait = false 时池耗尽立即返回 nullptr
+  redisContext *GetConnection(size_t shard = 0, bool wait = true);
+  bool ReleaseConnection(redisContext *conn, size_t shard = 0);
 
   static redis_pool *GetInstance();
 
+  // cluster = true 时 endpoints 为种子节点，实际分片由 CLUSTER SLOTS 决定
+  void init(const std::vector<RedisEndpoint> &endpoints,
+            const std::string &password, int max_conn_per_shard,
+            int db_index = 0, bool cluster = false);
   void init(const std::string &host, int port, const std::string &password,
-            int max_conn, int db_index = 0);
+            int max_conn, int db_index = 0) {
+    init({RedisEndpoint{host, port}}, password, max_conn, db_index);
+  }
+
+  // 至少一个分片可用
+  bool is_initialized() const { return m_initialized.load(); }
+  bool is_cluster() const { return m_cluster; }
+
+  size_t shard_count() const {
+    return m_shard_count.load(std::memory_order_acquire);
+  }
+  size_t shard_of(std::string_view key) const;
+  const RedisEndpoint &endpoint(size_t shard) const {
+    return m_shards[shard]->endpoint;
+  }
+  // 当前全部分片的地址（按分片号）
+  std::vector<RedisEndpoint> endpoints() const;
+
+  // 连接池熔断器（每分片一个）: 借连接等待过久（池耗尽）或重连失败时熔断，
+  // 熔断期间 GetConnection() 立即返回 nullptr，调用方按 Redis 不可用降级
+  CircuitBreaker &breaker(size_t shard = 0) { return m_shards[shard]->breaker; }
+  // 命令熔断器（每分片一个，供 RedisCache 上报命令结果），随分片一起创建
+  CircuitBreaker &command_breaker(size_t shard = 0) {
+    return m_shards[shard]->command_breaker;
+  }
+  // 借连接统计: 次数、线程缓存命中、阻塞等待直方图
+  LockFreePool<redisContext>::Stats checkout_stats(size_t shard = 0) const {
+    return m_shards[shard]->conns.stats();
+  }
+
+  // 在 ctx 上执行一条命令（格式同 redisCommand）。集群模式下遇到 MOVED / ASK
+  // 时在目标节点重发并返回其回复；MOVED 同时更新该槽并唤醒后台刷新
+  redisReply *exec(redisContext *ctx, const char *format, ...);
+
+  // 流水线中的回复无法就地重发: 是重定向错误时记录（MOVED 更新槽位并
+  // 唤醒刷新）并返回 true，调用方按该 key 不可用处理
+  bool is_redirect(const redisReply *reply);
+
+  // "host:port,host:port"，省略端口时用 default_port；格式错误的项跳过
+  static std::vector<RedisEndpoint> parse_endpoints(const std::string &spec,
+                                                    int default_port = 6379);
 
-  bool is_initialized() const { return m_initialized; }
+  // jump consistent hash: 把 64 位哈希均匀映射到 [0, buckets)
+  static size_t jump_hash(uint64_t key, size_t buckets);
+  // Redis Cluster 哈希槽: CRC16(XMODEM) 的低 14 位（已处理 {tag}）
+  static uint16_t hash_slot(std::string_view key);
+
+  static constexpr size_t MAX_SHARDS = 128;
+  static constexpr size_t CLUSTER_SLOTS = 16384;
 
 private:
-  redis_pool();
+  redis_pool() = default;
   ~redis_pool();
 
-  int m_MaxConn;
-  int m_CurConn;
-  int m_FreeConn;
-  std::mutex lock;
-  std::deque<redisContext *> connList;
-  std::counting_semaphore<MAX_REDIS_SEM> semaphore_{0};
+  struct Shard {
+    Shard(const RedisEndpoint &ep, const std::string &name_suffix);
+
+    RedisEndpoint endpoint;
+    int m_MaxConn = 0;
+    std::atomic<bool> m_initialized{false}; // 建满连接后置位（可能由后台线程重连后置位）
+    LockFreePool<redisContext> conns; // 空闲连接（线程缓存槽 + 无锁栈）
+
+    CircuitBreaker breaker;
+    CircuitBreaker command_breaker;
+  };
+
+  // 新建一条已认证、已选库的连接，失败返回 nullptr
+  redisContext *connect(const RedisEndpoint &ep) const;
+  // 创建分片并建满连接，返回分片号（超过 MAX_SHARDS 返回 -1）；
+  // 连不上的分片照样登记，由后台线程重连。调用方持有 m_topology_mutex
+  int add_shard(const RedisEndpoint &ep, const std::string &name_suffix);
+  // 为未初始化的分片建满连接并发布，连不满时全部释放、返回 false；
+  // 调用方持有 m_topology_mutex
+  bool connect_shard(Shard &shard);
+  // 重连所有未初始化的分片（后台线程）；返回是否仍有分片未连上
+  bool retry_shards();
+  int find_shard(const RedisEndpoint &ep) const;
+
+  // ── 集群 ──
+  // 依次向 seeds 请求 CLUSTER SLOTS，成功后更新槽位表（新主节点建子池）
+  bool refresh_slots(const std::vector<RedisEndpoint> &seeds);
+  void request_refresh();
+  // 后台线程: 集群模式定时刷新槽位表；两种模式都重连初始化失败的分片
+  void refresh_loop();
+  // 解析 "MOVED <slot> <host:port>" / "ASK <slot> <host:port>"
+  static bool parse_redirect(const redisReply *reply, bool &ask, int &slot,
+                             RedisEndpoint &target);
+  // 在目标节点重发已格式化的命令，跟随后续重定向；释放传入的 reply
+  redisReply *follow_redirects(redisReply *reply, const char *cmd, size_t len);
+
+  static constexpr uint64_t SHARD_SEED = 0x5348415244ULL; // 与过滤器哈希错开
+  static constexpr int MAX_REDIRECTS = 3;
+  static constexpr int REFRESH_INTERVAL_S = 30;   // 槽位表定时刷新
+  static constexpr int REFRESH_MIN_GAP_MS = 500;  // MOVED 风暴时的刷新间隔下限
+  static constexpr int SHARD_RETRY_S = 5;         // 有分片未连上时的重连间隔
+  // 空闲超过该时长才在借出时 ping（出错的连接随时重连）
+  static constexpr int64_t HEALTH_CHECK_IDLE_MS = 60 * 1000;
+
+  // 分片只追加: 先写入 m_shards[i] 再发布 m_shard_count，读者不加锁
+  std::array<std::unique_ptr<Shard>, MAX_SHARDS> m_shards;
+  std::atomic<size_t> m_shard_count{0};
+  std::mutex m_topology_mutex; // 串行化 add_shard / 槽位表刷新
 
-  std::string m_host;
-  int m_port;
   std::string m_password;
-  int m_db_index;
-  bool m_initialized = false;
+  int m_db_index = 0;
+  int m_max_conn = 0;
+  std::atomic<bool> m_initialized{false}; // 刷新线程可能晚于 init() 建出首个分片
+  bool m_cluster = false;
+
+  std::array<std::atomic<uint16_t>, CLUSTER_SLOTS> m_slots{}; // 槽 → 分片号
+  std::vector<RedisEndpoint> m_seeds;
 
-  // 健康检查冷却: 每60秒最多 ping 一次
-  std::mutex m_health_mutex;
-  std::unordered_map<redisContext *, time_t> m_last_health_check;
+  std::thread m_refresher;
+  std::mutex m_refresh_mutex;
+  std::condition_variable m_refresh_cv;
+  bool m_refresh_requested = false;
+  bool m_refresh_stop = false;
 };
 
 // RAII 包装器，构造时获取连接，析构时自动释放
 class redisConnectionRAII {
 public:
-  redisConnectionRAII(redisContext **redis_conn,
-                      redis_pool *connPool);
+  redisConnectionRAII(redisContext **redis_conn, redis_pool *connPool,
+                      size_t shard = 0);
   ~redisConnectionRAII();
 
 private:
   redisContext *conRAII;
   redis_pool *poolRAII;
+  size_t shardRAII;
 };
 
 #endif
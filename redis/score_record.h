@@ -0,0 +1,231 @@
+#ifndef SCORE_RECORD_H
+#define SCORE_RECORD_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+// 成绩记录的紧凑二进制编码 —— 缓存里存记录本身，响应时再渲染 JSON
+//
+// 缓存整段 JSON 时每条记录都重复携带字段名（"student_id" / "subject" / "score" ...），
+// 这里改为按固定字段顺序存储，Redis 内存与每次命中的网络字节都随之下降；
+// 同一条缓存记录也可以渲染成不同的响应格式。
+//
+// 布局（版本 1）:
+//   magic 0xE5 | version u8 | flags u8 | [flags&LZ4: varint 原始长度] | body
+//   body: 6 个定长字段（student_id, name, id_card, gender, province, school）
+//         varint 科目数，每科 { subject, score }
+//   字符串一律 varint 长度 + 原始字节；score 保留 MySQL 返回的数字文本，渲染结果与原先一致
+// body 超过 LZ4_THRESHOLD 且编译时启用 LZ4（HAVE_LZ4）时压缩，压缩无收益则存原文。
+// 首字节 0xE5 不是合法的 JSON 开头，decode() 失败的值可按旧格式（JSON 文本）处理。
+struct ScoreRecord {
+  struct Subject {
+    std::string name;
+    std::string score;
+  };
+
+  std::string student_id;
+  std::string name;
+  std::string id_card;
+  std::string gender;
+  std::string province;
+  std::string school;
+  std::vector<Subject> subjects;
+
+  static constexpr uint8_t MAGIC = 0xE5;
+  static constexpr uint8_t VERSION = 1;
+  static constexpr uint8_t FLAG_LZ4 = 0x01;
+  static constexpr size_t LZ4_THRESHOLD = 256;
+
+  std::string encode() const {
+    std::string body;
+    body.reserve(64 + student_id.size() + name.size() + id_card.size() +
+                 province.size() + school.size() + subjects.size() * 16);
+    for (const std::string *f : fixed_fields())
+      put_str(body, *f);
+    put_varint(body, subjects.size());
+    for (const Subject &s : subjects) {
+      put_str(body, s.name);
+      put_str(body, s.score);
+    }
+
+    std::string out;
+    out.push_back(static_cast<char>(MAGIC));
+    out.push_back(static_cast<char>(VERSION));
+#ifdef HAVE_LZ4
+    if (body.size() > LZ4_THRESHOLD) {
+      std::string packed(LZ4_compressBound(static_cast<int>(body.size())), '\0');
+      int n = LZ4_compress_default(body.data(), packed.data(),
+                                   static_cast<int>(body.size()),
+                                   static_cast<int>(packed.size()));
+      if (n > 0 && static_cast<size_t>(n) < body.size()) {
+        out.push_back(static_cast<char>(FLAG_LZ4));
+        put_varint(out, body.size());
+        out.append(packed.data(), n);
+        return out;
+      }
+    }
+#endif
+    out.push_back(0);
+    out.append(body);
+    return out;
+  }
+
+  // 首字节是否为本格式（区分旧版本缓存的 JSON 文本）
+  static bool is_record(std::string_view in) {
+    return !in.empty() && static_cast<uint8_t>(in[0]) == MAGIC;
+  }
+
+  // 格式不符 / 版本不识别 / 未启用 LZ4 却遇到压缩数据时返回 false
+  bool decode(std::string_view in) {
+    if (in.size() < 3 || static_cast<uint8_t>(in[0]) != MAGIC ||
+        static_cast<uint8_t>(in[1]) != VERSION)
+      return false;
+    uint8_t flags = static_cast<uint8_t>(in[2]);
+    in.remove_prefix(3);
+
+    std::string unpacked;
+    if (flags & FLAG_LZ4) {
+#ifdef HAVE_LZ4
+      uint64_t raw_len = 0;
+      if (!get_varint(in, raw_len) || raw_len > MAX_RAW_BYTES)
+        return false;
+      unpacked.resize(raw_len);
+      int n = LZ4_decompress_safe(in.data(), unpacked.data(),
+                                  static_cast<int>(in.size()),
+                                  static_cast<int>(raw_len));
+      if (n < 0 || static_cast<uint64_t>(n) != raw_len)
+        return false;
+      in = unpacked;
+#else
+      return false;
+#endif
+    } else if (flags != 0) {
+      return false;
+    }
+
+    for (std::string *f : fixed_fields())
+      if (!get_str(in, *f))
+        return false;
+    uint64_t n = 0;
+    if (!get_varint(in, n) || n > in.size()) // 每科至少 2 字节，粗略防御
+      return false;
+    subjects.resize(n);
+    for (Subject &s : subjects)
+      if (!get_str(in, s.name) || !get_str(in, s.score))
+        return false;
+    return in.empty();
+  }
+
+  // /4 接口的 JSON 格式
+  std::string to_json() const {
+    size_t est = 128 + subjects.size() * 32;
+    for (const std::string *f : fixed_fields())
+      est += f->size();
+    for (const Subject &s : subjects)
+      est += s.name.size() + s.score.size();
+
+    std::string json;
+    json.reserve(est);
+    json += "{\"student\":{\"student_id\":\"";
+    append_escaped(json, student_id);
+    json += "\",\"name\":\"";
+    append_escaped(json, name);
+    json += "\",\"id_card\":\"";
+    append_escaped(json, id_card);
+    json += "\",\"gender\":\"";
+    append_escaped(json, gender);
+    json += "\",\"province\":\"";
+    append_escaped(json, province);
+    json += "\",\"school\":\"";
+    append_escaped(json, school);
+    json += "\"},\"scores\":[";
+    for (size_t i = 0; i < subjects.size(); ++i) {
+      if (i)
+        json += ',';
+      json += "{\"subject\":\"";
+      append_escaped(json, subjects[i].name);
+      json += "\",\"score\":";
+      json += subjects[i].score;
+      json += '}';
+    }
+    json += "]}";
+    return json;
+  }
+
+  // 无需转义的连续片段整段追加，只在特殊字符处逐个处理
+  static void append_escaped(std::string &out, std::string_view s) {
+    size_t run = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+      unsigned char c = static_cast<unsigned char>(s[i]);
+      if (c >= 0x20 && c != '"' && c != '\\')
+        continue;
+      out.append(s.data() + run, i - run);
+      run = i + 1;
+      switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\b': out += "\\b"; break;
+      case '\f': out += "\\f"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default: {
+        static const char HEX[] = "0123456789abcdef";
+        char u[7] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF], 0};
+        out.append(u, 6);
+      }
+      }
+    }
+    out.append(s.data() + run, s.size() - run);
+  }
+
+private:
+  static constexpr uint64_t MAX_RAW_BYTES = 1 << 20;
+
+  std::array<const std::string *, 6> fixed_fields() const {
+    return {&student_id, &name, &id_card, &gender, &province, &school};
+  }
+  std::array<std::string *, 6> fixed_fields() {
+    return {&student_id, &name, &id_card, &gender, &province, &school};
+  }
+
+  static void put_varint(std::string &out, uint64_t v) {
+    while (v >= 0x80) {
+      out.push_back(static_cast<char>(v | 0x80));
+      v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+  }
+  static void put_str(std::string &out, const std::string &s) {
+    put_varint(out, s.size());
+    out.append(s);
+  }
+  static bool get_varint(std::string_view &in, uint64_t &v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+      uint8_t b = static_cast<uint8_t>(in[0]);
+      in.remove_prefix(1);
+      v |= static_cast<uint64_t>(b & 0x7F) << shift;
+      if (!(b & 0x80))
+        return true;
+    }
+    return false;
+  }
+  static bool get_str(std::string_view &in, std::string &s) {
+    uint64_t n = 0;
+    if (!get_varint(in, n) || n > in.size())
+      return false;
+    s.assign(in.data(), n);
+    in.remove_prefix(n);
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef SINGLE_FLIGHT_H
+#define SINGLE_FLIGHT_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 进程内请求合并（singleflight）—— 同一 key 的并发未命中只放行一个 leader
+//
+// SETNX 分布式锁只能保证跨进程只有一个重建者；同一进程内的并发未命中
+// 仍会各自往返 try_lock，失败后按固定间隔 sleep 轮询。这里在进程内先合并:
+//   - 第一个到达的调用方成为 leader，负责 Redis / DB 往返，完成后 finish()
+//   - 其余调用方挂在同一个在途记录上: 同步调用方阻塞在条件变量上，
+//     异步调用方登记回调；leader 发布结果的瞬间全部唤醒，无固定 sleep
+// 在途记录在 finish() 时移除，之后的调用方重新走完整流程（结果已在缓存中）。
+class SingleFlight {
+public:
+  struct Result {
+    bool locked = false;  // leader 未拿到分布式锁（其他节点正在重建）
+    std::optional<std::string> value;
+  };
+  // 由 leader 线程在 finish() 中调用，不得阻塞
+  using Waiter = std::function<void(const Result &)>;
+
+  // 成为 leader 返回 true；否则阻塞到 leader 完成并把结果写入 out
+  bool lead_or_wait(const std::string &key, Result &out) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = flights_.find(key);
+    if (it == flights_.end()) {
+      flights_.emplace(key, std::make_shared<Flight>());
+      return true;
+    }
+    std::shared_ptr<Flight> f = it->second;
+    cv_.wait(lock, [&f] { return f->done; });
+    out = f->result;
+    return false;
+  }
+
+  // 成为 leader 返回 true；否则登记 waiter 并返回 false
+  bool lead_or_join(const std::string &key, Waiter waiter) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = flights_.find(key);
+    if (it == flights_.end()) {
+      flights_.emplace(key, std::make_shared<Flight>());
+      return true;
+    }
+    it->second->waiters.push_back(std::move(waiter));
+    return false;
+  }
+
+  // 无在途调用时成为 leader 并返回 true；已有在途调用时直接返回 false（不等待）
+  bool try_lead(const std::string &key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flights_.emplace(key, std::make_shared<Flight>()).second;
+  }
+
+  // leader 发布结果，唤醒全部等待者
+  void finish(const std::string &key, const Result &result) {
+    std::vector<Waiter> waiters;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = flights_.find(key);
+      if (it == flights_.end())
+        return;
+      Flight &f = *it->second;
+      f.done = true;
+      f.result = result;
+      waiters.swap(f.waiters);
+      flights_.erase(it);  // 阻塞等待者持有 shared_ptr，记录在其读取后释放
+    }
+    cv_.notify_all();
+    for (Waiter &w : waiters)
+      w(result);
+  }
+
+private:
+  struct Flight {
+    bool done = false;
+    Result result;
+    std::vector<Waiter> waiters;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable cv_;  // 在途记录很少，共用一个条件变量即可
+  std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;
+};
+
+#endif
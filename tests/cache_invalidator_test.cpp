@@ -0,0 +1,185 @@
+// CacheInvalidator 集成测试 —— 需要本地 redis-server（>= 6，支持 RESP3 / CLIENT TRACKING）
+//
+// 按 RedisCache::start_invalidation() 的方式把失效回调接到 L1Cache，另开一条连接
+// 模拟其他节点:
+//   1. 写入 / 删除跟踪前缀下的 key → 对应 L1 条目被淘汰，前缀外的写入不影响
+//   2. FLUSHALL → L1 整体清空
+//   3. CLIENT KILL 跟踪连接 → on_state(false)；重连后先清空 L1 再 on_state(true)
+//
+// 地址取 REDIS_HOST / REDIS_PORT（默认 127.0.0.1:6379）；连不上时返回 77（ctest 记为跳过）。
+
+#include "redis/cache_invalidator.h"
+#include "redis/l1_cache.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace {
+
+constexpr int SKIP = 77;
+constexpr const char *PREFIX = "test:inv:";
+
+int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+// 轮询 pred 直到成立或超时
+bool wait_until(const std::function<bool()> &pred, int timeout_ms = 3000) {
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeout_ms);
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (pred())
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return pred();
+}
+
+bool cached(L1Cache &l1, const std::string &key) {
+  std::string value;
+  return l1.get(key, value);
+}
+
+bool command(redisContext *ctx, const char *fmt, const char *arg = nullptr) {
+  redisReply *reply =
+      static_cast<redisReply *>(arg ? redisCommand(ctx, fmt, arg)
+                                    : redisCommand(ctx, fmt));
+  bool ok = reply && reply->type != REDIS_REPLY_ERROR;
+  freeReplyObject(reply);
+  return ok;
+}
+
+// 找出开启了 CLIENT TRACKING 的连接（flags 含 t）并断开
+bool kill_tracking_client(redisContext *ctx) {
+  redisReply *reply =
+      static_cast<redisReply *>(redisCommand(ctx, "CLIENT LIST"));
+  if (!reply || (reply->type != REDIS_REPLY_STRING &&
+                 reply->type != REDIS_REPLY_VERB)) {
+    freeReplyObject(reply);
+    return false;
+  }
+  std::string list(reply->str, reply->len);
+  freeReplyObject(reply);
+
+  size_t pos = 0;
+  bool killed = false;
+  while (pos < list.size()) {
+    size_t end = list.find('\n', pos);
+    std::string line =
+        list.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+    pos = end == std::string::npos ? list.size() : end + 1;
+
+    size_t flags = line.find(" flags=");
+    size_t id = line.find("id=");
+    if (flags == std::string::npos || id != 0)
+      continue;
+    std::string f = line.substr(flags + 7, line.find(' ', flags + 7) - flags - 7);
+    if (f.find('t') == std::string::npos)
+      continue;
+    std::string client_id = line.substr(3, line.find(' ') - 3);
+    killed |= command(ctx, "CLIENT KILL ID %s", client_id.c_str());
+  }
+  return killed;
+}
+
+} // namespace
+
+int main() {
+  const char *host = getenv("REDIS_HOST") ? getenv("REDIS_HOST") : "127.0.0.1";
+  int port = getenv("REDIS_PORT") ? atoi(getenv("REDIS_PORT")) : 6379;
+
+  struct timeval timeout = {1, 0};
+  redisContext *writer = redisConnectWithTimeout(host, port, timeout);
+  if (!writer || writer->err || !command(writer, "PING")) {
+    fprintf(stderr, "SKIP: no redis-server at %s:%d\n", host, port);
+    if (writer)
+      redisFree(writer);
+    return SKIP;
+  }
+
+  L1Cache l1(1 << 20);
+  std::atomic<bool> tracking{false};
+  std::atomic<int> flushes{0};
+  CacheInvalidator inv(
+      PREFIX, [&](std::string_view key) { l1.erase(key); },
+      [&]() {
+        l1.clear();
+        flushes.fetch_add(1);
+      },
+      [&](bool on) { tracking.store(on); });
+  inv.start(host, port, "");
+
+  if (!wait_until([&] { return tracking.load(); })) {
+    fprintf(stderr, "SKIP: CLIENT TRACKING unavailable on %s:%d\n", host, port);
+    inv.stop();
+    redisFree(writer);
+    return SKIP;
+  }
+
+  const std::string k1 = std::string(PREFIX) + "k1";
+  const std::string k2 = std::string(PREFIX) + "k2";
+  const std::string other = "test:other:k1";
+
+  // 1. 其他客户端写入 / 删除 → 失效；前缀外的 key 不推送
+  l1.put(k1, "v1", 60000);
+  l1.put(k2, "v2", 60000);
+  l1.put(other, "v3", 60000);
+  CHECK(command(writer, "SET %s x", k1.c_str()));
+  CHECK(wait_until([&] { return !cached(l1, k1); }));
+  CHECK(cached(l1, k2));
+
+  CHECK(command(writer, "SET %s x", other.c_str()));
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  CHECK(cached(l1, other));
+
+  CHECK(command(writer, "DEL %s", k2.c_str()));
+  CHECK(command(writer, "SET %s x", k2.c_str())); // 不存在的 key 删除不推送，先建后删
+  CHECK(wait_until([&] { return !cached(l1, k2); }));
+  l1.put(k2, "v2", 60000);
+  CHECK(command(writer, "DEL %s", k2.c_str()));
+  CHECK(wait_until([&] { return !cached(l1, k2); }));
+
+  // 2. FLUSHALL → invalidate nil → 整体清空
+  l1.put(k1, "v1", 60000);
+  l1.put(other, "v3", 60000);
+  int before = flushes.load();
+  CHECK(command(writer, "FLUSHALL"));
+  CHECK(wait_until([&] { return flushes.load() > before; }));
+  CHECK(!cached(l1, k1));
+  CHECK(!cached(l1, other));
+
+  // 3. 断线: 断开期间放入的条目在重连后被清空，之后失效照常
+  CHECK(kill_tracking_client(writer));
+  CHECK(wait_until([&] { return !tracking.load(); }));
+  l1.put(k1, "stale", 60000);
+  CHECK(wait_until([&] { return tracking.load(); }, 5000));
+  CHECK(!cached(l1, k1));
+
+  l1.put(k1, "v1", 60000);
+  CHECK(command(writer, "SET %s y", k1.c_str()));
+  CHECK(wait_until([&] { return !cached(l1, k1); }));
+
+  command(writer, "DEL %s", k1.c_str());
+  command(writer, "DEL %s", other.c_str());
+  inv.stop();
+  redisFree(writer);
+
+  if (failures) {
+    fprintf(stderr, "cache_invalidator_test: %d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("cache_invalidator_test: OK\n");
+  return 0;
+}
@@ -0,0 +1,209 @@
+// redis_pool 分片测试 —— 路由纯函数 + 多个本地 redis-server 实例
+//
+// 纯函数（无需 Redis）:
+//   1. hash_slot 与 Redis Cluster 一致（已知向量、{tag} 规则）
+//   2. jump_hash 在列表末尾追加实例时只有约 1/(n+1) 的 key 迁移，且只迁往新实例
+//   3. parse_endpoints 的默认端口与非法项
+// 多实例（REDIS_NODES="host:port,host:port,..."，至少两个）:
+//   4. 经连接池写入的 key 落在 shard_of() 所指的实例上，并能经池读回
+//   5. 停掉最后一个实例（SHUTDOWN NOSAVE）后只有它上面的 key 不可用
+//
+// REDIS_NODES 中最后一个实例会被停掉，只能指向专供测试启动的实例；
+// 未设置或有实例连不上时返回 77（ctest 记为跳过），纯函数检查失败时仍返回 1。
+
+#include "redis/redis_pool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int SKIP = 77;
+constexpr const char *PREFIX = "test:shard:";
+constexpr int KEYS = 300;
+
+int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+std::string key_of(int i) { return PREFIX + std::to_string(i); }
+
+redisContext *connect(const RedisEndpoint &ep) {
+  struct timeval timeout = {1, 0};
+  redisContext *ctx = redisConnectWithTimeout(ep.host.c_str(), ep.port, timeout);
+  if (ctx && ctx->err) {
+    redisFree(ctx);
+    return nullptr;
+  }
+  return ctx;
+}
+
+// GET 的结果: 出错返回 false，不存在时 value 为空
+bool get(redisContext *ctx, const std::string &key, std::string &value) {
+  redisReply *reply =
+      static_cast<redisReply *>(redisCommand(ctx, "GET %s", key.c_str()));
+  bool ok = reply && reply->type != REDIS_REPLY_ERROR;
+  value = reply && reply->type == REDIS_REPLY_STRING
+              ? std::string(reply->str, reply->len)
+              : "";
+  freeReplyObject(reply);
+  return ok;
+}
+
+// 经连接池读 key，连接借不到或命令出错时返回 false
+bool pool_get(redis_pool *pool, const std::string &key, std::string &value) {
+  size_t shard = pool->shard_of(key);
+  redisContext *ctx = nullptr;
+  redisConnectionRAII conn(&ctx, pool, shard);
+  return ctx && get(ctx, key, value);
+}
+
+void check_hash_slot() {
+  // Redis Cluster 规范中的 CRC16 校验向量
+  CHECK(redis_pool::hash_slot("123456789") == 12739);
+  CHECK(redis_pool::hash_slot("foo") == 12182);
+  // 只对第一对花括号内的内容求哈希
+  CHECK(redis_pool::hash_slot("{user1000}.following") ==
+        redis_pool::hash_slot("{user1000}.followers"));
+  CHECK(redis_pool::hash_slot("{user1000}.following") ==
+        redis_pool::hash_slot("user1000"));
+  // 空 tag 不算 tag: 对整个 key 求哈希
+  CHECK(redis_pool::hash_slot("foo{}{bar}") == 8363);
+  CHECK(redis_pool::hash_slot("foo{{bar}}zap") == redis_pool::hash_slot("{bar"));
+}
+
+void check_jump_hash() {
+  constexpr int N = 100000;
+  for (size_t n = 1; n <= 8; ++n) {
+    int moved = 0;
+    for (uint64_t k = 0; k < N; ++k) {
+      uint64_t key = k * 0x9E3779B97F4A7C15ULL;
+      size_t before = redis_pool::jump_hash(key, n);
+      size_t after = redis_pool::jump_hash(key, n + 1);
+      CHECK(before < n);
+      if (before != after) {
+        CHECK(after == n); // 只迁往新追加的实例
+        ++moved;
+      }
+    }
+    double expect = static_cast<double>(N) / (n + 1);
+    CHECK(moved > expect * 0.9 && moved < expect * 1.1);
+  }
+  CHECK(redis_pool::jump_hash(12345, 1) == 0);
+}
+
+void check_parse_endpoints() {
+  auto eps = redis_pool::parse_endpoints("10.0.0.1:7000,,redis-b,:7001,h:0,h:7002",
+                                         6380);
+  CHECK(eps.size() == 3);
+  if (eps.size() == 3) {
+    CHECK((eps[0] == RedisEndpoint{"10.0.0.1", 7000}));
+    CHECK((eps[1] == RedisEndpoint{"redis-b", 6380}));
+    CHECK((eps[2] == RedisEndpoint{"h", 7002}));
+  }
+  CHECK(redis_pool::parse_endpoints("").empty());
+}
+
+} // namespace
+
+int main() {
+  check_hash_slot();
+  check_jump_hash();
+  check_parse_endpoints();
+  if (failures) {
+    fprintf(stderr, "redis_shard_test: %d check(s) failed\n", failures);
+    return 1;
+  }
+
+  const char *spec = getenv("REDIS_NODES");
+  std::vector<RedisEndpoint> nodes =
+      redis_pool::parse_endpoints(spec ? spec : "");
+  if (nodes.size() < 2) {
+    fprintf(stderr, "SKIP: set REDIS_NODES to two or more redis-server "
+                    "instances (the last one is shut down)\n");
+    return SKIP;
+  }
+  std::vector<redisContext *> direct;
+  for (const RedisEndpoint &ep : nodes) {
+    redisContext *ctx = connect(ep);
+    if (!ctx) {
+      fprintf(stderr, "SKIP: no redis-server at %s:%d\n", ep.host.c_str(),
+              ep.port);
+      for (redisContext *c : direct)
+        redisFree(c);
+      return SKIP;
+    }
+    direct.push_back(ctx);
+  }
+
+  redis_pool *pool = redis_pool::GetInstance();
+  pool->init(nodes, "", 2);
+  CHECK(pool->is_initialized());
+  CHECK(pool->shard_count() == nodes.size());
+
+  // 4. 经池写入 → 只在 shard_of() 所指的实例上，且能经池读回
+  std::vector<int> per_shard(nodes.size(), 0);
+  for (int i = 0; i < KEYS; ++i) {
+    std::string key = key_of(i);
+    size_t shard = pool->shard_of(key);
+    ++per_shard[shard];
+    redisContext *ctx = nullptr;
+    redisConnectionRAII conn(&ctx, pool, shard);
+    CHECK(ctx);
+    if (!ctx)
+      continue;
+    redisReply *reply = pool->exec(ctx, "SET %s v%d", key.c_str(), i);
+    CHECK(reply && reply->type == REDIS_REPLY_STATUS);
+    freeReplyObject(reply);
+  }
+  for (size_t s = 0; s < nodes.size(); ++s)
+    CHECK(per_shard[s] > 0); // 每个实例都分到 key
+
+  for (int i = 0; i < KEYS; ++i) {
+    std::string key = key_of(i), value;
+    size_t shard = pool->shard_of(key);
+    for (size_t s = 0; s < nodes.size(); ++s) {
+      CHECK(get(direct[s], key, value));
+      CHECK(value == (s == shard ? "v" + std::to_string(i) : ""));
+    }
+    CHECK(pool_get(pool, key, value) && value == "v" + std::to_string(i));
+  }
+
+  // 5. 停掉最后一个实例: 路由不变，只有它上面的 key 读不到
+  size_t down = nodes.size() - 1;
+  freeReplyObject(redisCommand(direct[down], "SHUTDOWN NOSAVE"));
+  redisFree(direct[down]);
+  direct.pop_back();
+
+  for (int i = 0; i < KEYS; ++i) {
+    std::string key = key_of(i), value;
+    size_t shard = pool->shard_of(key);
+    if (shard == down)
+      CHECK(!pool_get(pool, key, value));
+    else
+      CHECK(pool_get(pool, key, value) && value == "v" + std::to_string(i));
+  }
+
+  for (int i = 0; i < KEYS; ++i) {
+    size_t shard = pool->shard_of(key_of(i));
+    if (shard != down)
+      freeReplyObject(redisCommand(direct[shard], "DEL %s", key_of(i).c_str()));
+  }
+  for (redisContext *ctx : direct)
+    redisFree(ctx);
+
+  if (failures) {
+    fprintf(stderr, "redis_shard_test: %d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("redis_shard_test: OK\n");
+  return 0;
+}
@@ -120,6 +120,8 @@ template <typename T> void thread_pool<T>::run() {
     } // unique_lock 析构 → 自动解锁，其他 worker 或生产者可以拿锁
     if (request) {
       // 在锁外处理请求，不阻塞其他 worker 从队列取任务
+      // 请求内的数据库访问共用一条连接（见 connection_pool::Affinity）
+      connection_pool::RequestScope db_scope(m_connPool);
       request->process();
     }
   }
@@ -104,8 +104,8 @@ int Utils::u_epollfd = 0;
 
 class Utils;
 void cb_func(client_data *user_data) {
-  epoll_ctl(Utils::u_epollfd, EPOLL_CTL_DEL, user_data->sockfd, 0);
   assert(user_data);
-  close(user_data->sockfd);
-  http_conn::m_user_count--;
+  // 与 worker 关闭连接走同一路径: 移出 epoll、关闭套接字、计数减一，
+  // 并递增连接代数；worker 已关闭时不会重复 close 同一（可能已复用的）fd
+  user_data->conn->close_conn();
 }
@@ -24,12 +24,14 @@
 #include <unistd.h>
 
 class util_timer;
+class http_conn;
 
 // 面向网络层，存储每个客户端连接的相关数据，包括客户端地址、套接字描述符、定时器等。
 struct client_data {
   sockaddr_in address;
   int sockfd;
   util_timer *timer;
+  http_conn *conn; // 超时关闭经由 close_conn()，使在途异步回调失效
 };
 
 class util_timer {
@@ -1,9 +1,24 @@
 #include "webserver.h"
 #include "rate_limiter/rate_limiter.h"
+#include "mysql/async_mysql.h"
+#include "mysql/audit_log.h"
+#include "redis/async_redis.h"
 #include "log/log.h"
 #include <cerrno>
 #include <cstring>
 
+// 借连接统计（每分钟输出）；等待分位数只统计池耗尽时的阻塞等待
+template <typename Stats>
+static void log_checkout_stats(const std::string &name, const Stats &s) {
+  LOG_INFO("Pool [%s]: conns=%zu checkouts=%llu thread_cache_hit=%.1f%% "
+           "waits=%llu wait_p50=%lluus wait_p99=%lluus wait_max=%lluus",
+           name.c_str(), s.capacity, (unsigned long long)s.checkouts,
+           s.checkouts ? 100.0 * s.cache_hits / s.checkouts : 0.0,
+           (unsigned long long)s.waits, (unsigned long long)s.wait_p50_us,
+           (unsigned long long)s.wait_p99_us,
+           (unsigned long long)s.wait_max_us);
+}
+
 WebServer::WebServer() {
   // http_conn类对象
   users = std::make_unique<http_conn[]>(MAX_FD);
@@ -25,6 +40,8 @@ WebServer::WebServer() {
 }
 
 WebServer::~WebServer() {
+  // 写完队列中的审计记录（连接池仍可用）
+  AuditLog::GetInstance()->stop();
   close(m_epollfd);
   close(m_listenfd);
   close(m_pipefd[1]);
@@ -43,25 +60,92 @@ void WebServer::init(int port, string user, string passWord,
   http_conn::s_auth_enabled = auth_enabled;
 }
 
-void WebServer::init_mysql_pool() {
-  LOG_INFO("Initializing MySQL connection pool (%d connections)", m_sql_num);
+void WebServer::init_mysql_pool(const string &db_affinity, int async_db_conns) {
+  LOG_INFO("Initializing MySQL connection pool (%d connections, affinity=%s)",
+           m_sql_num, db_affinity.c_str());
   m_connPool = connection_pool::GetInstance();
   m_connPool->init("192.168.19.1", m_user, m_passWord, m_databaseName, 3306,
                    m_sql_num);
+
+  connection_pool::Affinity affinity = connection_pool::Affinity::REQUEST;
+  if (!connection_pool::parse_affinity(db_affinity, affinity))
+    LOG_WARN("Unknown DB affinity '%s', using request", db_affinity.c_str());
+  // 每个 worker 常驻一条后，后台线程（过滤器预热、缓存刷新）还要能借到连接
+  if (affinity == connection_pool::Affinity::THREAD &&
+      m_sql_num < m_thread_num + DB_RESERVED_CONNS) {
+    LOG_WARN("DB affinity 'thread' needs sql_num >= threads + %d (%d < %d), "
+             "using request",
+             DB_RESERVED_CONNS, m_sql_num, m_thread_num + DB_RESERVED_CONNS);
+    affinity = connection_pool::Affinity::REQUEST;
+  }
+  m_connPool->set_affinity(affinity);
+  m_async_db_conns = async_db_conns;
   LOG_INFO("MySQL connection pool initialized successfully");
 }
 
-void WebServer::init_redis_pool() {
-  LOG_INFO("Initializing Redis connection pool (host=%s, port=%d, pool=%d)",
-           m_redis_host.c_str(), m_redis_port, m_redis_pool_size);
+void WebServer::init_redis_pool(const string &redis_nodes,
+                                const string &redis_mode) {
+  bool cluster = redis_mode == "cluster";
+  if (!cluster && redis_mode != "shard")
+    LOG_WARN("Unknown Redis mode '%s', using shard", redis_mode.c_str());
+  m_redis_nodes = redis_pool::parse_endpoints(redis_nodes, m_redis_port);
+  if (m_redis_nodes.empty())
+    m_redis_nodes.push_back(RedisEndpoint{m_redis_host, m_redis_port});
+  if (cluster)
+    LOG_INFO("Initializing Redis cluster client (%zu seeds, pool=%d per master)",
+             m_redis_nodes.size(), m_redis_pool_size);
+  else if (m_redis_nodes.size() == 1)
+    LOG_INFO("Initializing Redis connection pool (host=%s, port=%d, pool=%d)",
+             m_redis_nodes[0].host.c_str(), m_redis_nodes[0].port,
+             m_redis_pool_size);
+  else
+    LOG_INFO("Initializing Redis connection pool (%zu shards, pool=%d per shard)",
+             m_redis_nodes.size(), m_redis_pool_size);
   m_redisPool = redis_pool::GetInstance();
-  m_redisPool->init(m_redis_host, m_redis_port, m_redis_password,
-                    m_redis_pool_size, m_redis_db_index);
+  m_redisPool->init(m_redis_nodes, m_redis_password, m_redis_pool_size,
+                    m_redis_db_index, cluster);
+  // 集群模式换成发现到的主节点；之后新增的主节点由 eventLoop 定时补上
+  m_redis_nodes = m_redisPool->endpoints();
 
   RedisCache::GetInstance()->init(m_redisPool);
+  // 启动时连不上的分片照样监听，监听线程自行重连
+  RedisCache::GetInstance()->start_invalidation(m_redis_nodes,
+                                                m_redis_password);
   LOG_INFO("Redis cache layer initialized (bloom + circuit_breaker)");
 }
 
+void WebServer::init_bloom(const string &filter_kind,
+                           const string &snapshot_path) {
+  LOG_INFO("Initializing key filter (kind=%s, snapshot=%s)",
+           filter_kind.c_str(), snapshot_path.c_str());
+  if (!RedisCache::GetInstance()->set_filter_kind(filter_kind))
+    LOG_WARN("Unknown key filter '%s', using bloom", filter_kind.c_str());
+  RedisCache::GetInstance()->start_bloom_warmup(snapshot_path);
+}
+
+void WebServer::init_audit_log(const string &audit_mode,
+                               const string &spill_path) {
+  if (audit_mode == "sync") {
+    LOG_INFO("Audit log: synchronous single-row writes");
+    return;
+  }
+  bool durable = audit_mode == "durable";
+  if (!durable && audit_mode != "async")
+    LOG_WARN("Unknown audit mode '%s', using async", audit_mode.c_str());
+  LOG_INFO("Initializing audit log writer (mode=%s, spill=%s)",
+           durable ? "durable" : "async", spill_path.c_str());
+  AuditLog::GetInstance()->start(spill_path, durable);
+}
+
+void WebServer::init_tls(const string &cert_file, const string &key_file) {
+  LOG_INFO("Initializing TLS (cert=%s)", cert_file.c_str());
+  if (!TlsConn::init_context(cert_file, key_file)) {
+    LOG_ERROR("TLS initialization failed");
+    exit(1);
+  }
+  LOG_INFO("TLS enabled (kTLS offload when supported by the kernel)");
+}
+
 void WebServer::init_thread_pool() {
   LOG_INFO("Initializing thread pool (%d threads)", m_thread_num);
   m_pool = std::make_unique<thread_pool<http_conn>>(m_connPool, m_thread_num);
@@ -126,7 +210,12 @@ void WebServer::eventListen() {
   // 设置管道写端为非阻塞，避免信号处理阻塞
   utils.setNonBlocking(m_pipefd[1]);
   // 将管道读端添加到 epoll 中，监听信号事件（通过管道传递）
-  utils.addfd(m_epollfd, m_pipefd[0]);
+  // 与监听 fd 一样不使用 EPOLLONESHOT，否则首个信号之后定时 tick 与 SIGTERM 都收不到
+  epoll_event pipe_ev{};
+  pipe_ev.data.fd = m_pipefd[0];
+  pipe_ev.events = EPOLLIN;
+  epoll_ctl(m_epollfd, EPOLL_CTL_ADD, m_pipefd[0], &pipe_ev);
+  utils.setNonBlocking(m_pipefd[0]);
 
   // 注册信号处理器：忽略 SIGPIPE（防止管道破裂导致程序崩溃）
   utils.addsig(SIGPIPE, SIG_IGN);
@@ -137,12 +226,35 @@ void WebServer::eventListen() {
   // 设置定时器，每 TIMESLOT 秒触发一次 SIGALRM，用于定时任务（如清理超时连接）
   alarm(TIMESLOT);
 
+  // 初始化响应头 Date 缓存，之后由 eventLoop 每秒刷新
+  ResponseHeader::refresh_date();
+
   // 设置工具类的全局管道和 epoll 描述符，便于信号处理器访问
   Utils::u_pipefd = m_pipefd;
   Utils::u_epollfd = m_epollfd;
 
-  LOG_INFO("Server listening on 0.0.0.0:%d (auth=%s)", m_port,
-           http_conn::s_auth_enabled ? "on" : "off");
+  // 异步 Redis 客户端挂到同一个 epoll 上，成绩查询等待 Redis 时不占 worker；
+  // 启动时 Redis 不可用也照常启用，tick() 负责重连
+  if (m_redisPool &&
+      AsyncRedis::GetInstance()->init(m_epollfd, m_redis_nodes,
+                                      m_redis_password, m_redis_db_index)) {
+    // 回调总在事件循环线程执行: 请求队列已满时暂存，由 eventLoop 稍后重新投递
+    // （不能就地 process()，阻塞的查库 / 锁等待会卡住整个事件循环）
+    http_conn::s_async_resume = [this](http_conn *conn) {
+      if (!m_resume_backlog.empty() || !m_pool->append_p(conn))
+        m_resume_backlog.push_back({conn, conn->conn_gen()});
+    };
+
+    // 非阻塞 MySQL 依赖上面的重新投递，缓存重建的查库阶段也不再占 worker
+    if (m_async_db_conns > 0)
+      AsyncMysql::GetInstance()->init(m_epollfd, m_connPool->m_url, m_user,
+                                      m_passWord, m_databaseName, 3306,
+                                      m_async_db_conns);
+  }
+
+  LOG_INFO("Server listening on 0.0.0.0:%d (auth=%s, tls=%s)", m_port,
+           http_conn::s_auth_enabled ? "on" : "off",
+           TlsConn::enabled() ? "on" : "off");
 }
 
 void WebServer::timer(int connfd, struct sockaddr_in client_address) {
@@ -153,6 +265,7 @@ void WebServer::timer(int connfd, struct sockaddr_in client_address) {
   // 创建定时器，设置回调函数和超时时间，绑定用户数据，将定时器添加到链表中
   users_timer[connfd].address = client_address;
   users_timer[connfd].sockfd = connfd;
+  users_timer[connfd].conn = &users[connfd];
   util_timer *timer = new util_timer;
   timer->user_data = &users_timer[connfd];
   timer->cb_func = cb_func;
@@ -248,6 +361,17 @@ bool WebServer::dealwithsignal(bool &timeout, bool &stop_server) {
 void WebServer::dealwithread(int sockfd) {
   util_timer *timer = users_timer[sockfd].timer;
 
+  // TLS 握手未完成: 主线程推进握手，不投递到线程池
+  if (users[sockfd].tls_handshaking()) {
+    if (users[sockfd].tls_handshake()) {
+      if (timer)
+        adjust_timer(timer);
+    } else {
+      deal_timer(timer, sockfd);
+    }
+    return;
+  }
+
   // Proactor 模式：主线程完成读操作后，将请求交给线程池处理
   if (users[sockfd].read_once()) {
     // 将该事件放入请求队列
@@ -264,8 +388,10 @@ void WebServer::dealwithread(int sockfd) {
 void WebServer::dealwithwrite(int sockfd) {
   util_timer *timer = users_timer[sockfd].timer;
 
-  // Proactor 模式：主线程完成写操作
-  if (users[sockfd].write()) {
+  // Proactor 模式：主线程完成写操作（握手阶段的 EPOLLOUT 继续推进握手）
+  bool ok = users[sockfd].tls_handshaking() ? users[sockfd].tls_handshake()
+                                            : users[sockfd].write();
+  if (ok) {
     if (timer) {
       adjust_timer(timer);
     }
@@ -274,16 +400,30 @@ void WebServer::dealwithwrite(int sockfd) {
   }
 }
 
+void WebServer::drain_resume_backlog() {
+  while (!m_resume_backlog.empty()) {
+    ParkedConn &p = m_resume_backlog.front();
+    if (p.conn->conn_gen() == p.gen && !m_pool->append_p(p.conn))
+      return;
+    m_resume_backlog.pop_front();
+  }
+}
+
 void WebServer::eventLoop() {
   bool timeout = false;
   bool stop_server = false;
+  int stats_ticks = 0;
 
   while (!stop_server) {
-    int number = epoll_wait(m_epollfd, events, MAX_EVENT_NUMBER, -1);
+    // 有暂存的待恢复连接时短暂等待，及时重试投递
+    int number = epoll_wait(m_epollfd, events, MAX_EVENT_NUMBER,
+                            m_resume_backlog.empty() ? -1 : RESUME_RETRY_MS);
     if (number < 0 && errno != EINTR) {
       LOG_ERROR("epoll_wait failed: %s", strerror(errno));
       break;
     }
+    // 秒数变化时刷新 Date 缓存，worker 生成响应头时直接 memcpy
+    ResponseHeader::refresh_date();
 
     for (int i = 0; i < number; i++) {
       int sockfd = events[i].data.fd;
@@ -293,6 +433,12 @@ void WebServer::eventLoop() {
         bool flag = dealclientdata();
         if (false == flag)
           continue;
+      } else if (AsyncRedis::GetInstance()->owns(sockfd)) {
+        // 异步 Redis: 命令提交 / 延迟重试 / 回复读取，回调在本线程执行
+        AsyncRedis::GetInstance()->handle_event(sockfd, events[i].events);
+      } else if (AsyncMysql::GetInstance()->owns(sockfd)) {
+        // 非阻塞 MySQL: 查询提交 / 超时 / 连接与结果集推进
+        AsyncMysql::GetInstance()->handle_event(sockfd, events[i].events);
       } else if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
         // 服务器端关闭连接，移除对应的定时器
         util_timer *timer = users_timer[sockfd].timer;
@@ -309,12 +455,71 @@ void WebServer::eventLoop() {
         dealwithwrite(sockfd);
       }
     }
+    drain_resume_backlog();
     if (timeout) {
       utils.timer_handler();
 
       // 每 5 秒清理一次超过 120 秒无活动的限流桶
       RateLimiter::GetInstance()->cleanup_idle(120);
 
+      // 集群启动后新发现的主节点: 补建异步连接与失效监听
+      if (m_redisPool && m_redisPool->shard_count() > m_redis_nodes.size()) {
+        m_redis_nodes = m_redisPool->endpoints();
+        AsyncRedis::GetInstance()->add_shards(m_redis_nodes);
+        RedisCache::GetInstance()->start_invalidation(m_redis_nodes,
+                                                      m_redis_password);
+      }
+
+      // 异步 Redis 断线重连
+      AsyncRedis::GetInstance()->tick();
+      AsyncMysql::GetInstance()->tick();
+
+      // 每分钟输出一次 L1 缓存统计
+      if (++stats_ticks >= 60 / TIMESLOT) {
+        stats_ticks = 0;
+        L1Cache::Stats st = RedisCache::GetInstance()->l1_stats();
+        uint64_t lookups = st.hits + st.misses;
+        LOG_INFO("L1 cache: hits=%llu misses=%llu hit_rate=%.1f%% "
+                 "evictions=%llu rejections=%llu entries=%zu bytes=%zu",
+                 (unsigned long long)st.hits, (unsigned long long)st.misses,
+                 lookups ? 100.0 * st.hits / lookups : 0.0,
+                 (unsigned long long)st.evictions,
+                 (unsigned long long)st.rejections, st.entries, st.bytes);
+
+        RedisCache::FilterStats fs = RedisCache::GetInstance()->filter_stats();
+        uint64_t negatives = fs.rejects + fs.false_positives;
+        LOG_INFO("Key filter: kind=%s items=%zu bytes=%zu occupancy=%.1f%% "
+                 "est_fpr=%.4f%% observed_fpr=%.4f%% rejects=%llu "
+                 "false_positives=%llu%s",
+                 fs.filter.kind, fs.filter.items, fs.filter.bytes,
+                 100.0 * fs.filter.occupancy, 100.0 * fs.filter.est_fpr,
+                 negatives ? 100.0 * fs.false_positives / negatives : 0.0,
+                 (unsigned long long)fs.rejects,
+                 (unsigned long long)fs.false_positives,
+                 fs.filter.saturated ? " SATURATED" : "");
+
+        for (const CircuitBreaker::Snapshot &cb : CircuitBreaker::snapshot_all())
+          LOG_INFO("Circuit breaker [%s]: state=%s calls=%u failure_rate=%.1f%% "
+                   "slow_rate=%.1f%% trips=%llu rejected=%llu",
+                   cb.name.c_str(), CircuitBreaker::state_name(cb.state),
+                   cb.calls, 100.0 * cb.failure_rate, 100.0 * cb.slow_rate,
+                   (unsigned long long)cb.trips,
+                   (unsigned long long)cb.rejected);
+
+        AuditLog::Stats as = AuditLog::GetInstance()->stats();
+        LOG_INFO("Audit log: written=%llu spilled=%llu replayed=%llu "
+                 "dropped=%llu queued=%zu",
+                 (unsigned long long)as.written, (unsigned long long)as.spilled,
+                 (unsigned long long)as.replayed,
+                 (unsigned long long)as.dropped, as.queued);
+
+        log_checkout_stats(m_connPool->pool_breaker().name(),
+                           m_connPool->checkout_stats());
+        for (size_t i = 0; m_redisPool && i < m_redisPool->shard_count(); ++i)
+          log_checkout_stats(m_redisPool->breaker(i).name(),
+                             m_redisPool->checkout_stats(i));
+      }
+
       timeout = false;
     }
   }
@@ -3,6 +3,7 @@
 
 #include <arpa/inet.h>
 #include <cassert>
+#include <deque>
 #include <errno.h>
 #include <fcntl.h>
 #include <memory>
@@ -20,6 +21,7 @@
 const int MAX_FD = 65536;           // 最大文件描述符
 const int MAX_EVENT_NUMBER = 10000; // 最大事件数
 const int TIMESLOT = 5;             // 最小超时单位
+const int DB_RESERVED_CONNS = 4;    // thread 亲和模式下留给非 worker 线程的连接
 
 class WebServer {
 public:
@@ -30,8 +32,16 @@ public:
             int sql_num, int thread_num, bool auth_enabled = true);
 
   void init_thread_pool();
-  void init_mysql_pool();
-  void init_redis_pool();
+  // db_affinity: query / request / thread（见 connection_pool::Affinity）
+  // async_db_conns: 非阻塞 MySQL 连接数（在 eventListen 中随异步 Redis 启用），0 = 关闭
+  void init_mysql_pool(const string &db_affinity, int async_db_conns = 0);
+  // redis_nodes: "host:port,host:port"（多实例分片），空则用单实例默认地址
+  // redis_mode: "shard"（客户端分片）或 "cluster"（redis_nodes 为集群种子节点）
+  void init_redis_pool(const string &redis_nodes, const string &redis_mode);
+  void init_bloom(const string &filter_kind, const string &snapshot_path);
+  // audit_mode: async / durable / sync（见 AuditLog）
+  void init_audit_log(const string &audit_mode, const string &spill_path);
+  void init_tls(const string &cert_file, const string &key_file);
   void eventListen();
   void eventLoop();
   void timer(int connfd, struct sockaddr_in client_address);
@@ -41,6 +51,8 @@ public:
   bool dealwithsignal(bool &timeout, bool &stop_server);
   void dealwithread(int sockfd);
   void dealwithwrite(int sockfd);
+  // 按到达顺序重新投递暂存的连接，队列再次满时停止；已关闭的连接直接丢弃
+  void drain_resume_backlog();
 
 public:
   // 基础
@@ -57,6 +69,7 @@ public:
   string m_passWord;     // 登陆数据库密码
   string m_databaseName; // 使用数据库名
   int m_sql_num;
+  int m_async_db_conns = 0;
 
   // 线程池相关
   std::unique_ptr<thread_pool<http_conn>> m_pool;
@@ -72,11 +85,21 @@ public:
   redis_pool *m_redisPool;
   std::string m_redis_host;
   int m_redis_port;
+  // 分片列表: 客户端分片为 -n 指定的实例，集群为启动时发现的主节点
+  std::vector<RedisEndpoint> m_redis_nodes;
   std::string m_redis_password;
   int m_redis_pool_size;
   int m_redis_db_index;
   int m_cache_ttl;
 
+  // 异步查询完成但线程池队列已满、尚未投递的连接（仅事件循环线程访问）
+  struct ParkedConn {
+    http_conn *conn;
+    uint32_t gen; // 暂存时的连接代数，不一致说明期间已被关闭
+  };
+  std::deque<ParkedConn> m_resume_backlog;
+  static constexpr int RESUME_RETRY_MS = 2;
+
   // 定时器相关
   std::unique_ptr<client_data[]> users_timer;
   Utils utils;